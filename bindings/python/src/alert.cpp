@@ -91,6 +91,27 @@ list dht_stats_routing_table(dht_stats_alert const& a)
    return result;
 }
 
+list outgoing_interface_stats_interfaces(outgoing_interface_stats_alert const& a)
+{
+   list result;
+
+   for (auto const& i : a.interfaces)
+   {
+		dict d;
+
+		d["device"] = i.device;
+		d["weight"] = i.weight;
+		d["num_connections"] = i.num_connections;
+		d["num_utp_connections"] = i.num_utp_connections;
+		d["rate"] = i.rate;
+		d["connect_attempts"] = i.connect_attempts;
+		d["connect_failures"] = i.connect_failures;
+
+      result.append(d);
+   }
+   return result;
+}
+
 dict dht_immutable_item(dht_immutable_item_alert const& alert)
 {
     dict d;
@@ -274,6 +295,8 @@ namespace boost
 	POLY(file_prio_alert)
 	POLY(oversized_file_alert)
 	POLY(torrent_conflict_alert)
+	POLY(storage_move_progress_alert)
+	POLY(outgoing_interface_stats_alert)
 
 #if TORRENT_ABI_VERSION == 1
 	POLY(anonymous_mode_alert)
@@ -1153,6 +1176,17 @@ void bind_alert()
         .add_property("metadata", make_getter(&torrent_conflict_alert::metadata, by_value()))
         ;
 
+    class_<storage_move_progress_alert, bases<torrent_alert>, noncopyable>(
+        "storage_move_progress_alert", no_init)
+        .def_readonly("bytes_copied", &storage_move_progress_alert::bytes_copied)
+        .def_readonly("total_bytes", &storage_move_progress_alert::total_bytes)
+        ;
+
+    class_<outgoing_interface_stats_alert, bases<alert>, noncopyable>(
+        "outgoing_interface_stats_alert", no_init)
+        .add_property("interfaces", &outgoing_interface_stats_interfaces)
+        ;
+
 }
 
 #ifdef _MSC_VER
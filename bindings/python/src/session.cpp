@@ -658,6 +658,19 @@ namespace
 		return ret;
 	}
 
+	dict get_peer_class_stats(lt::session& ses, lt::peer_class_t const pc)
+	{
+		lt::peer_class_stats pcs;
+		{
+			allow_threading_guard guard;
+			pcs = ses.get_peer_class_stats(pc);
+		}
+		dict ret;
+		ret["total_upload"] = pcs.total_upload;
+		ret["total_download"] = pcs.total_download;
+		return ret;
+	}
+
 	void set_peer_class(lt::session& ses, peer_class_t const pc, dict info)
 	{
 		lt::peer_class_info pci;
@@ -1135,6 +1148,7 @@ void bind_session()
 #endif
         .def("post_torrent_updates", allow_threads(&lt::session::post_torrent_updates), arg("flags") = 0xffffffff)
         .def("post_dht_stats", allow_threads(&lt::session::post_dht_stats))
+        .def("post_outgoing_interface_stats", allow_threads(&lt::session::post_outgoing_interface_stats))
         .def("post_session_stats", allow_threads(&lt::session::post_session_stats))
         .def("is_listening", allow_threads(&lt::session::is_listening))
         .def("listen_port", allow_threads(&lt::session::listen_port))
@@ -1216,9 +1230,11 @@ void bind_session()
         .def("set_peer_class_filter", &lt::session::set_peer_class_filter)
         .def("set_peer_class_type_filter", &lt::session::set_peer_class_type_filter)
         .def("create_peer_class", &lt::session::create_peer_class)
+        .def("interface_peer_class", &lt::session::interface_peer_class)
         .def("delete_peer_class", &lt::session::delete_peer_class)
         .def("get_peer_class", &get_peer_class)
         .def("set_peer_class", &set_peer_class)
+        .def("get_peer_class_stats", &get_peer_class_stats)
 
 #if TORRENT_ABI_VERSION == 1
         .def("id", depr(&lt::session::id))
@@ -40,6 +40,12 @@ void bind_session_settings()
 #endif
         .value("disable_os_cache", settings_pack::disable_os_cache)
         .value("write_through", settings_pack::write_through)
+        .value("direct_io", settings_pack::direct_io)
+    ;
+
+    enum_<settings_pack::file_pool_eviction_t>("file_pool_eviction_t")
+        .value("lru_eviction", settings_pack::lru_eviction)
+        .value("two_queue_eviction", settings_pack::two_queue_eviction)
     ;
 
     enum_<settings_pack::bandwidth_mixed_algo_t>("bandwidth_mixed_algo_t")
@@ -98,7 +98,7 @@ namespace libtorrent {
 	constexpr int user_alert_id = 10000;
 
 	// this constant represents "max_alert_index" + 1
-	constexpr int num_alert_types = 100;
+	constexpr int num_alert_types = 102;
 
 	// internal
 	constexpr int abi_alert_count = 128;
@@ -3033,6 +3033,72 @@ TORRENT_VERSION_NAMESPACE_3_END
 		std::shared_ptr<torrent_info> metadata;
 	};
 
+	// this alert is posted every second while the files of a torrent are
+	// being copied to another file system, as part of a call to
+	// torrent_handle::move_storage(). The torrent keeps using the files in the
+	// old location until they have all been copied, once the move completes a
+	// storage_moved_alert is posted.
+	struct TORRENT_EXPORT storage_move_progress_alert final : torrent_alert
+	{
+		// internal
+		TORRENT_UNEXPORT storage_move_progress_alert(aux::stack_allocator& alloc
+			, torrent_handle h, std::int64_t copied, std::int64_t total);
+		TORRENT_DEFINE_ALERT(storage_move_progress_alert, 100)
+
+		static constexpr alert_category_t static_category = alert_category::storage;
+		std::string message() const override;
+
+		// the number of bytes copied so far, out of the total number of bytes
+		// to copy
+		std::int64_t const bytes_copied;
+		std::int64_t const total_bytes;
+	};
+
+	// the load the session has put on one of the interfaces in the
+	// outgoing_interfaces setting, as reported by
+	// outgoing_interface_stats_alert.
+	struct TORRENT_EXPORT outgoing_interface_stats
+	{
+		// the device name or IP address of the interface, as it appears in
+		// outgoing_interfaces
+		std::string device;
+
+		// the weight of the interface, from outgoing_interface_weights
+		int weight;
+
+		// the number of peer connections bound to the interface, and how
+		// many of them are uTP connections
+		int num_connections;
+		int num_utp_connections;
+
+		// the sum of the upload and download rates of those connections, in
+		// bytes per second
+		int rate;
+
+		// the number of connection attempts through this interface whose
+		// outcome is known, and how many of them failed. These are halved
+		// every minute, to weigh recent attempts more
+		int connect_attempts;
+		int connect_failures;
+	};
+
+	// posted in response to session_handle::post_outgoing_interface_stats().
+	// It contains the load of each of the outgoing interfaces, which is what
+	// new outgoing connections are balanced by.
+	struct TORRENT_EXPORT outgoing_interface_stats_alert final : alert
+	{
+		// internal
+		TORRENT_UNEXPORT outgoing_interface_stats_alert(aux::stack_allocator& alloc
+			, std::vector<outgoing_interface_stats> ifs);
+		TORRENT_DEFINE_ALERT(outgoing_interface_stats_alert, 101)
+
+		static constexpr alert_category_t static_category = {};
+		std::string message() const override;
+
+		// one entry per interface in outgoing_interfaces, in the same order
+		std::vector<outgoing_interface_stats> interfaces;
+	};
+
 	// internal
 	TORRENT_EXTRA_EXPORT char const* performance_warning_str(performance_alert::performance_warning_t i);
 
@@ -0,0 +1,167 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_BLOCK_CACHE_HPP_INCLUDE
+#define TORRENT_BLOCK_CACHE_HPP_INCLUDE
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/span.hpp"
+#include "libtorrent/aux_/store_buffer.hpp" // for torrent_location
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace libtorrent {
+
+	struct counters;
+
+namespace aux {
+
+	// a size-bounded cache of blocks, keyed by torrent_location. It's meant to
+	// keep the blocks of popular pieces in memory, independent of the
+	// operating system's page cache. Entries are kept in LRU order, but a
+	// block is only admitted if it's accessed more often than the entry it
+	// would evict (TinyLFU). Access frequencies are estimated by a count-min
+	// sketch, which is periodically halved so that old popularity fades.
+	// The cache is split into shards, each with its own mutex, to let disk
+	// threads use it concurrently.
+	struct TORRENT_EXTRA_EXPORT block_cache
+	{
+		// sets the max number of bytes of blocks to keep in the cache. 0
+		// disables the cache and frees all blocks
+		void set_max_size(std::int64_t bytes);
+
+		bool enabled() const { return m_enabled; }
+
+		// if the block at ``loc`` is in the cache, and at least ``size`` bytes
+		// long, call ``f`` with a pointer to its data and return true. Every
+		// lookup counts as an access to the block, when deciding whether to
+		// admit it later
+		template <typename Fun>
+		bool get(torrent_location const loc, int const size, Fun f)
+		{
+			if (!m_enabled) return false;
+			shard& s = shard_for(loc);
+			std::lock_guard<std::mutex> l(s.mutex);
+			s.record_access(loc);
+			auto const it = s.index.find(loc);
+			if (it == s.index.end() || it->second->size < size)
+			{
+				++m_misses;
+				return false;
+			}
+			s.lru.splice(s.lru.begin(), s.lru, it->second);
+			++m_hits;
+			f(const_cast<char const*>(it->second->buf.get()));
+			return true;
+		}
+
+		// offer a block to the cache. If there's an entry for ``loc`` already,
+		// it's replaced. Otherwise the block is only inserted if there's room
+		// for it, or if it's accessed more frequently than the least recently
+		// used block(s) it would evict. If ``count_access`` is true, the
+		// insertion itself counts as an access (this is used for blocks we
+		// just downloaded, which we expect peers to request soon)
+		void insert(torrent_location loc, span<char const> buf, bool count_access);
+
+		// drop all blocks of the specified piece. This must be called when the
+		// piece is cleared, as its blocks will be downloaded again
+		void erase_piece(storage_index_t storage, piece_index_t piece);
+
+		// drop all blocks of the specified storage. This is called when the
+		// torrent is removed or its files are deleted
+		void erase_storage(storage_index_t storage);
+
+		void update_stats_counters(counters& c) const;
+
+	private:
+
+		struct entry
+		{
+			entry(torrent_location const l, int const s)
+				: loc(l), size(s), buf(new char[std::size_t(s)]) {}
+			torrent_location loc;
+			int size;
+			std::unique_ptr<char[]> buf;
+		};
+
+		struct shard
+		{
+			void record_access(torrent_location const& loc);
+			int frequency(torrent_location const& loc) const;
+			void evict_lru();
+			void resize_sketch();
+
+			mutable std::mutex mutex;
+
+			// front is the most recently used
+			std::list<entry> lru;
+			std::unordered_map<torrent_location, std::list<entry>::iterator> index;
+
+			std::int64_t size = 0;
+			std::int64_t max_size = 0;
+
+			// the count-min sketch of access frequencies. It has sketch_depth
+			// rows of 4-bit saturating counters (stored one per byte). The
+			// width of the rows is a power of two, proportional to the number
+			// of blocks that fit in the shard
+			std::vector<std::uint8_t> sketch;
+			std::uint32_t sketch_mask = 0;
+
+			// the number of accesses recorded since the counters were last
+			// halved
+			std::int64_t additions = 0;
+
+			// counters for this shard, summed up by update_stats_counters()
+			std::int64_t evictions = 0;
+			std::int64_t rejections = 0;
+		};
+
+		shard& shard_for(torrent_location const& loc);
+
+		static constexpr int num_shards = 16;
+		std::array<shard, num_shards> m_shards;
+
+		std::atomic<bool> m_enabled{false};
+		std::atomic<std::int64_t> m_hits{0};
+		std::atomic<std::int64_t> m_misses{0};
+	};
+}
+}
+
+#endif
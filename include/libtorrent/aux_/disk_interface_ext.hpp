@@ -0,0 +1,75 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_DISK_INTERFACE_EXT_HPP_INCLUDE
+#define TORRENT_DISK_INTERFACE_EXT_HPP_INCLUDE
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/disk_interface.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace libtorrent {
+namespace aux {
+
+	// operations of the built-in disk I/O subsystems (like mmap_disk_io)
+	// that custom ones don't need to support. They're kept out of
+	// disk_interface, to not change its ABI. The session looks this up with
+	// dynamic_cast on the disk I/O object it constructs.
+	struct TORRENT_EXTRA_EXPORT disk_interface_ext
+	{
+		// these are the same as disk_interface::async_read() and
+		// disk_interface::async_hash(), except the jobs are executed ahead of
+		// all other queued jobs. They're used for pieces with a deadline (see
+		// torrent_handle::set_piece_deadline()).
+		virtual void async_read_time_critical(storage_index_t storage, peer_request const& r
+			, std::function<void(disk_buffer_holder, storage_error const&)> handler
+			, disk_job_flags_t flags = {}) = 0;
+		virtual void async_hash_time_critical(storage_index_t storage, piece_index_t piece
+			, span<sha256_hash> v2, disk_job_flags_t flags
+			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) = 0;
+
+		// returns the number of bytes copied so far and the total number of
+		// bytes to copy, for an async_move_storage() in progress on the
+		// specified storage. Both are 0 unless files are being copied to
+		// another file system
+		virtual std::pair<std::int64_t, std::int64_t> move_storage_progress(storage_index_t) const = 0;
+
+	protected:
+		~disk_interface_ext() = default;
+	};
+}
+}
+
+#endif
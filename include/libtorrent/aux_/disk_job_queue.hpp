@@ -0,0 +1,130 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_DISK_JOB_QUEUE_HPP_INCLUDE
+#define TORRENT_DISK_JOB_QUEUE_HPP_INCLUDE
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/tailqueue.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/aux_/mmap_disk_job.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// the classes of disk jobs, in the order they are executed by the disk
+	// threads
+	enum class job_priority_t : std::uint8_t
+	{
+		// reads and hashes of pieces with a deadline
+		time_critical,
+
+		// reads of blocks requested by peers
+		read,
+
+		// writes of downloaded blocks, as well as all jobs not doing any
+		// bulk I/O (like move_storage, release_files and clear_piece)
+		write,
+
+		// hashing of downloaded pieces and checking of files
+		hash,
+
+		num_priorities
+	};
+
+	TORRENT_EXTRA_EXPORT job_priority_t priority_for_job(mmap_disk_job const& j);
+
+	// a queue of disk jobs, holding one FIFO per job_priority_t. Jobs are
+	// popped from the highest priority class that has any, except when the
+	// first job of some class has been waiting for longer than the aging
+	// limit. Then the job that has been waiting the longest is popped
+	// instead, so that lower priority jobs are not starved.
+	// This is not thread safe, the disk I/O subsystem protects it with its
+	// job mutex.
+	struct TORRENT_EXTRA_EXPORT disk_job_queue
+	{
+		static constexpr int num_priorities = int(job_priority_t::num_priorities);
+
+		struct iterator
+		{
+			mmap_disk_job* get() const { return m_it.get(); }
+			void next();
+
+		private:
+			friend struct disk_job_queue;
+			iterator(disk_job_queue& q, int prio);
+			disk_job_queue& m_queue;
+			int m_priority;
+			tailqueue_iterator<mmap_disk_job> m_it;
+		};
+
+		// iterates over all queued jobs, in priority order (not necessarily
+		// the order they will be popped in, due to aging)
+		iterator iterate() { return iterator(*this, 0); }
+
+		void push_back(mmap_disk_job* j);
+		void append(tailqueue<mmap_disk_job> jobs);
+
+		// pops the next job to execute. ``aging_limit`` is the max time the
+		// first job of a lower priority class is left waiting before it's
+		// executed ahead of the higher priority ones. The queue must not be
+		// empty
+		mmap_disk_job* pop_front(time_duration aging_limit);
+
+		int size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		int size(job_priority_t p) const { return m_queues[std::size_t(p)].size(); }
+
+		// the number of jobs popped from each class, and the sum of the time
+		// they spent in the queue, in microseconds
+		std::int64_t num_popped(job_priority_t p) const { return m_popped[std::size_t(p)]; }
+		std::int64_t queue_time(job_priority_t p) const { return m_queue_time[std::size_t(p)]; }
+
+		// the number of jobs popped ahead of higher priority ones, because
+		// they had been waiting for longer than the aging limit
+		std::int64_t num_aged() const { return m_aged; }
+
+	private:
+
+		std::array<tailqueue<mmap_disk_job>, num_priorities> m_queues;
+		std::array<std::int64_t, num_priorities> m_popped{};
+		std::array<std::int64_t, num_priorities> m_queue_time{};
+		std::int64_t m_aged = 0;
+		int m_size = 0;
+	};
+}
+}
+
+#endif
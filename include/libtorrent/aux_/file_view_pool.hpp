@@ -40,6 +40,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 
 #include <map>
+#include <deque>
 #include <mutex>
 #include <vector>
 #include <memory>
@@ -57,8 +58,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
 
 #include <boost/intrusive/list.hpp>
 
@@ -68,6 +69,7 @@ namespace libtorrent {
 
 class file_storage;
 struct open_file_state;
+struct counters;
 
 namespace aux {
 
@@ -110,18 +112,73 @@ namespace aux {
 		// by the file_view_pool.
 		int size_limit() const { return m_size; }
 
+		// the policy used to pick which file to close when the pool is full.
+		// This is one of the settings_pack::file_pool_eviction_t values.
+		void set_eviction_policy(int policy);
+
+		// the max number of bytes mapped by all open files combined. Files
+		// are closed to stay below this limit. 0 means no limit.
+		void set_mapped_limit(std::int64_t bytes);
+
 		std::vector<open_file_state> get_status(storage_index_t st) const;
 
+		struct file_stats
+		{
+			file_index_t file_index;
+
+			// the number of bytes of the file that are mapped into memory
+			std::int64_t mapped_bytes;
+
+			// the number of bytes written to the file since it was opened or
+			// last flushed
+			std::int64_t dirty_bytes;
+
+			// the number of times the file was requested while it was open
+			std::int64_t hits;
+		};
+
+		// returns the statistics of the open files of the storage ``st``
+		std::vector<file_stats> get_file_stats(storage_index_t st) const;
+
+		void update_stats_counters(counters& c) const;
+
 		void close_oldest();
 
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 		void flush_next_file();
-		void record_file_write(storage_index_t st, file_index_t file_index
-			, uint64_t pages);
 #endif
+		// record that ``bytes`` bytes were written at ``offset`` in the
+		// specified file
+		void record_file_write(storage_index_t st, file_index_t file_index
+			, std::int64_t offset, std::uint64_t bytes);
+
+		// when enabled, the ranges of files that have been written to are
+		// recorded, for flush_dirty() to write them back
+		void track_dirty_ranges(bool enable);
+
+		// the number of bytes written to the open files that have not been
+		// flushed yet
+		std::int64_t dirty_bytes() const;
+
+		struct flush_result
+		{
+			std::int64_t bytes = 0;
+			int operations = 0;
+		};
+
+		// initiate write-back of the dirty ranges of the files with the most
+		// dirty bytes, until at least ``bytes`` bytes have been flushed or
+		// there are no more dirty ranges. The ranges of each file are flushed
+		// in offset order, with adjacent ranges coalesced into large
+		// sequential batches. If ``wait`` is true, block until the pages have
+		// been written to disk
+		flush_result flush_dirty(std::int64_t bytes, bool wait);
 
 	private:
 
+		// removes the file that should be closed next, according to the
+		// eviction policy, and returns its mapping. Closing the file is
+		// deferred to the caller, to happen without holding the mutex
 		std::shared_ptr<file_mapping> remove_oldest(std::unique_lock<std::mutex>&);
 
 		int m_size;
@@ -150,9 +207,31 @@ namespace aux {
 			file_id key;
 			std::shared_ptr<file_mapping> mapping;
 			time_point last_use{aux::time_now()};
-#if TORRENT_HAVE_MAP_VIEW_OF_FILE
-			std::uint64_t dirty_bytes;
-#endif
+
+			// the number of bytes written to this file since it was opened or
+			// last flushed
+			std::uint64_t dirty_bytes = 0;
+
+			// if dirty ranges are tracked, this maps the start offset of each
+			// range written to since it was last flushed, to its end. Ranges
+			// never overlap or abut, they are merged when inserted
+			std::map<std::int64_t, std::int64_t> dirty_ranges;
+
+			// the number of times this file was requested from the pool while
+			// it was open
+			std::int64_t hits = 0;
+
+			// this is a monotonically increasing counter, ordering files by
+			// when they were used (or opened, for files in the probation
+			// segment)
+			std::uint64_t sequence = 0;
+
+			// with the two_queue eviction policy, files that have been
+			// closed and re-opened recently are "hot", and protected from
+			// being evicted by files only opened once, for instance by a scan
+			// of all files in a recheck
+			bool hot = false;
+
 			open_mode_t mode{};
 		};
 
@@ -161,15 +240,22 @@ namespace aux {
 			mi::indexed_by<
 			// look up files by (torrent, file) key
 			mi::ordered_unique<mi::member<file_entry, file_id, &file_entry::key>>,
-			// look up files by least recently used
-			mi::sequenced<>
-#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+			// look up files by eviction order. Cold files are ordered before
+			// hot ones, and within each segment by sequence number
+			mi::ordered_non_unique<mi::composite_key<file_entry
+				, mi::member<file_entry, bool, &file_entry::hot>
+				, mi::member<file_entry, std::uint64_t, &file_entry::sequence>>>,
 			// look up files with dirty pages
-			, mi::ordered_non_unique<mi::member<file_entry, std::uint64_t, &file_entry::dirty_bytes>>
-#endif
+			mi::ordered_non_unique<mi::member<file_entry, std::uint64_t, &file_entry::dirty_bytes>>
 			>
 		>;
 
+		using evict_iterator = files_container::nth_index<1>::type::iterator;
+
+		// returns the file the eviction policy would close next. There must be
+		// at least one file in the pool
+		evict_iterator eviction_candidate();
+
 		struct wait_open_entry
 		{
 			boost::intrusive::list_member_hook<> list_hook;
@@ -222,6 +308,33 @@ namespace aux {
 		files_container m_files;
 		mutable std::mutex m_mutex;
 
+		// the sequence number to assign to the next file that's used
+		std::uint64_t m_sequence = 0;
+
+		int m_eviction_policy = 0;
+		std::int64_t m_mapped_limit = 0;
+		bool m_track_dirty_ranges = false;
+
+		// the number of files in m_files that are in the hot segment
+		int m_num_hot = 0;
+
+		// the sum of all mapped bytes and dirty bytes of the files in m_files
+		std::int64_t m_mapped_bytes = 0;
+		std::int64_t m_dirty_bytes = 0;
+
+		// keys of files recently evicted from the cold segment, mapping to
+		// the sequence number they had when evicted. If any of them is opened
+		// again, it enters the hot segment. The deque keeps the order they
+		// were evicted in, to bound the size of the map. Entries in the deque
+		// whose sequence number doesn't match the map are stale
+		std::map<file_id, std::uint64_t> m_ghost_files;
+		std::deque<std::pair<file_id, std::uint64_t>> m_ghost_order;
+
+		// cumulative stats. protected by m_mutex
+		std::int64_t m_hits = 0;
+		std::int64_t m_misses = 0;
+		std::int64_t m_evictions = 0;
+
 		// the boost.multi-index container is not no-throw move constructable. In
 		// order to destruct m_files without holding the mutex, we need this
 		// separate pre-allocated container to move it into before releasing the
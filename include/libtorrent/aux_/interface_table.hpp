@@ -0,0 +1,102 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_INTERFACE_TABLE_HPP_INCLUDED
+#define TORRENT_INTERFACE_TABLE_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/enum_net.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/string_view.hpp"
+#include "libtorrent/time.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace libtorrent { namespace aux {
+
+	// a snapshot of the network interfaces and routes on the system. The
+	// session owns one and refreshes it when the ip_change_notifier fires,
+	// rather than enumerating interfaces every time it needs to know which
+	// device an address belongs to.
+	struct TORRENT_EXTRA_EXPORT interface_table
+	{
+		// enumerate the interfaces and routes on the system and replace the
+		// current snapshot with them. Errors from enumerating interfaces and
+		// routes are reported separately. If enumerating interfaces fails,
+		// the previous interfaces are kept.
+		void refresh(io_context& ios, error_code& if_ec, error_code& route_ec);
+
+		// replace the snapshot with the specified interfaces and routes
+		void update(std::vector<ip_interface> ifs, std::vector<ip_route> routes);
+
+		// mark the snapshot as out of date. The next call to stale() will
+		// return true until it's refreshed
+		void invalidate() { m_stale = true; }
+		bool stale() const { return m_stale; }
+
+		// incremented every time the snapshot is replaced. This can be used by
+		// callers that cache information derived from the table
+		std::uint32_t version() const { return m_version; }
+		time_point last_refresh() const { return m_last_refresh; }
+
+		std::vector<ip_interface> const& interfaces() const { return m_interfaces; }
+		std::vector<ip_route> const& routes() const { return m_routes; }
+
+		// returns the name of the device that has ``addr`` as one of its
+		// addresses, or an empty string if there is none.
+		string_view device_for_address(address const& addr) const;
+
+	private:
+
+		struct address_hash
+		{
+			std::size_t operator()(address const& a) const;
+		};
+
+		std::vector<ip_interface> m_interfaces;
+		std::vector<ip_route> m_routes;
+
+		// maps each interface address to its device name
+		std::unordered_map<address, std::string, address_hash> m_devices;
+
+		time_point m_last_refresh = min_time();
+		std::uint32_t m_version = 0;
+		bool m_stale = true;
+	};
+}}
+
+#endif
@@ -116,6 +116,9 @@ struct TORRENT_EXTRA_EXPORT merkle_tree
 	// returns true if all block hashes in the specified range have been verified
 	bool blocks_verified(int block_idx, int num_blocks) const;
 
+	// the approximate number of bytes of heap memory used by this tree
+	std::int64_t memory_usage() const;
+
 	bool load_piece_layer(span<char const> piece_layer);
 
 	// the leafs in "tree" must be block hashes (i.e. leaf hashes in the this
@@ -143,9 +146,28 @@ struct TORRENT_EXTRA_EXPORT merkle_tree
 	std::tuple<set_block_result, int, int> set_block(int block_index
 		, sha256_hash const& h);
 
+	// sets the hashes of a range of consecutive blocks, typically all blocks
+	// of a piece. All hashes are stored before any are verified, so each
+	// subtree that can be verified is hashed once. The result is ok only if
+	// all blocks in the range were verified, in which case the returned range
+	// covers all of them. block_hash_failed is returned if any block failed,
+	// hash_failed if a subtree in the range failed its hash check.
+	std::tuple<set_block_result, int, int> set_block(int block_index
+		, span<sha256_hash const> leafs);
+
 	std::vector<sha256_hash> get_hashes(int base
 		, int index, int count, int proof_layers) const;
 
+	// in piece_layer mode, the block hashes of verified pieces are dropped.
+	// To answer requests for hashes below the piece layer of such a piece,
+	// this takes its block hashes as computed from the data on disk
+	// (``blocks``). They are validated against the piece hash, and only used
+	// for this request. Returns an empty vector if they don't match or the
+	// request can't be answered.
+	std::vector<sha256_hash> get_hashes(int base
+		, int index, int count, int proof_layers
+		, int piece, span<sha256_hash const> blocks);
+
 private:
 
 	// set to an empty tree
@@ -167,6 +189,35 @@ private:
 	void optimize_storage_piece_layer();
 	void allocate_full();
 
+	// in full_tree mode, verifies the largest subtree including
+	// ``block_index`` whose block hashes are all set, against the lowest
+	// known node above them. This is the second half of set_block()
+	std::tuple<set_block_result, int, int> verify_block_subtree(int block_index);
+
+	// the piece_layer mode counterparts of set_block() and add_hashes()
+	std::tuple<set_block_result, int, int> set_piece_block(int block_index
+		, sha256_hash const& h);
+	std::tuple<set_block_result, int, int> set_piece_blocks(int block_index
+		, span<sha256_hash const> leafs);
+	boost::optional<add_hashes_result_t> add_piece_hashes(
+		int dest_start_idx
+		, piece_index_t::diff_type file_piece_offset
+		, span<sha256_hash const> hashes
+		, span<sha256_hash const> uncle_hashes);
+
+	// returns the hash of the specified block, if we have it in piece_layer
+	// mode. Otherwise all zeros
+	sha256_hash piece_block_hash(int block_index) const;
+
+	// in piece_layer mode, returns the hash of the node ``idx`` below the
+	// piece layer, computed from the block hashes of its piece. All zeros if
+	// they are not known and verified
+	sha256_hash piece_subtree_hash(int idx, std::vector<sha256_hash>& scratch_space) const;
+
+	bool piece_verified(int piece) const;
+	void set_piece_verified(int piece);
+	int blocks_in_piece(int piece) const;
+
 	// a pointer to the root hash for this file.
 	char const* m_root = nullptr;
 
@@ -191,6 +242,36 @@ private:
 	// this is necessary to know which layer in the tree the piece layer is.
 	std::uint8_t m_blocks_per_piece_log = 0;
 
+	// in piece_layer mode, the block hashes of the pieces we're currently
+	// downloading (or that we have received hashes for). Each piece is
+	// dropped once all of its blocks have been checked against the piece
+	// hash, leaving just a bit in m_piece_verified.
+	struct piece_blocks
+	{
+		// one hash per block in the piece, all zeros for the ones we don't
+		// know yet
+		aux::vector<sha256_hash> hashes;
+
+		// the number of all-zero entries in hashes
+		int missing = 0;
+
+		// for pieces whose hashes have been verified (i.e. received from
+		// a peer along with proof), one bit per block whose data has been
+		// checked against its hash
+		bitfield checked;
+
+		// true if the hashes are verified against the piece hash. If false,
+		// they are the hashes of the blocks we have received, to be checked
+		// once the piece is complete
+		bool verified = false;
+	};
+	std::map<int, piece_blocks> m_piece_blocks;
+
+	// in piece_layer mode, one bit per piece, set if the block hashes of
+	// the piece have been verified. Allocated lazily, the first time a
+	// piece is verified.
+	bitfield m_piece_verified;
+
 	enum class mode_t : std::uint8_t
 	{
 		// a default constructed tree is truly empty. It does not even have a
@@ -205,7 +286,10 @@ private:
 		full_tree,
 
 		// in this mode, m_tree represents the piece layer only, no padding
-		// and all piece layer hashes are stored and valid
+		// and all piece layer hashes are stored and valid. The block hashes
+		// of pieces in progress are kept in m_piece_blocks, and only a bit
+		// in m_piece_verified is kept for pieces that have been verified.
+		// This avoids allocating the full tree while downloading.
 		piece_layer,
 
 		// in this mode, m_tree represents the block (leaf) layer only, no padding
@@ -72,6 +72,7 @@ namespace aux {
 		file_mapping_handle& operator=(file_mapping_handle&& fm) &;
 
 		HANDLE handle() const { return m_mapping; }
+		handle_type fd() const { return m_file.fd(); }
 	private:
 		void close();
 		file_handle m_file;
@@ -103,6 +104,24 @@ namespace aux {
 
 		// ...
 		file_view view();
+
+		// the number of bytes of the file that are mapped
+		std::int64_t size() const { return m_size; }
+
+		// initiate writing back the dirty pages in the range [offset,
+		// offset + len) of the file to disk. If ``wait`` is true, block until
+		// the pages have been written
+		void write_back(std::int64_t offset, std::int64_t len, bool wait);
+
+		// true if pread() and pwrite() bypass the page cache. Their offsets,
+		// sizes and buffers must then be aligned to direct_io_alignment
+		bool direct_io() const { return m_direct_io; }
+
+		// read or write the file through its file descriptor, rather than
+		// through the mapping. Returns the number of bytes transferred, or -1
+		// on error. In direct_io mode, a short transfer is not retried
+		int pread(span<char> buf, std::int64_t offset, error_code& ec);
+		int pwrite(span<char const> buf, std::int64_t offset, error_code& ec);
 	private:
 
 		void close();
@@ -122,6 +141,10 @@ namespace aux {
 		// flushed to disk
 		void page_out(span<byte const> range);
 
+		// hint the kernel that we're about to read this part of the file, and
+		// that it should start reading it in asynchronously
+		void will_need(span<byte const> range);
+
 		std::int64_t m_size;
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 		file_mapping_handle m_file;
@@ -130,6 +153,7 @@ namespace aux {
 		file_handle m_file;
 #endif
 		void* m_mapping;
+		bool m_direct_io = false;
 	};
 
 	struct TORRENT_EXTRA_EXPORT file_view
@@ -162,6 +186,29 @@ namespace aux {
 			m_mapping->page_out(range);
 		}
 
+		void will_need(span<byte const> range)
+		{
+			TORRENT_ASSERT(m_mapping);
+			m_mapping->will_need(range);
+		}
+
+		bool direct_io() const
+		{
+			TORRENT_ASSERT(m_mapping);
+			return m_mapping->direct_io();
+		}
+
+		int pread(span<char> buf, std::int64_t offset, error_code& ec)
+		{
+			TORRENT_ASSERT(m_mapping);
+			return m_mapping->pread(buf, offset, ec);
+		}
+
+		int pwrite(span<char const> buf, std::int64_t offset, error_code& ec)
+		{
+			TORRENT_ASSERT(m_mapping);
+			return m_mapping->pwrite(buf, offset, ec);
+		}
 
 	private:
 		explicit file_view(std::shared_ptr<file_mapping> m) : m_mapping(std::move(m)) {}
@@ -44,6 +44,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/units.hpp"
 #include "libtorrent/session_types.hpp"
 #include "libtorrent/flags.hpp"
+#include "libtorrent/time.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/variant/variant.hpp>
@@ -211,6 +212,18 @@ namespace aux {
 
 		move_flags_t move_flags = move_flags_t::always_replace_files;
 
+		// this is set on read jobs whose file range has been hinted to the
+		// operating system while the job was sitting in the queue
+		bool prefetched = false;
+
+		// this is set on the time critical read and hash jobs (see
+		// disk_interface_ext). They're executed ahead of other jobs
+		bool time_critical = false;
+
+		// the time this job was added to the disk_job_queue. It's used to
+		// age jobs, and to measure the time spent in the queue
+		time_point queued_time;
+
 #if TORRENT_USE_ASSERTS
 		bool in_use = false;
 
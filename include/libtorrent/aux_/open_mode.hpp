@@ -53,7 +53,17 @@ namespace aux {
 		constexpr open_mode_t sparse = 6_bit;
 		constexpr open_mode_t executable = 7_bit;
 		constexpr open_mode_t allow_set_file_valid_data = 8_bit;
+
+		// bypass the page cache for reads and writes made through the file
+		// descriptor (O_DIRECT). Such I/O must be aligned to
+		// direct_io_alignment. This is best-effort, file systems not supporting
+		// it will open the file without it
+		constexpr open_mode_t direct_io = 9_bit;
 	}
+
+	// the alignment of file offsets, sizes and memory buffers required for
+	// I/O on files opened with open_mode::direct_io
+	constexpr int direct_io_alignment = 4096;
 } // aux
 
 } // libtorrent
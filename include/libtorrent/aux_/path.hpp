@@ -104,6 +104,13 @@ namespace libtorrent {
 	enum { dont_follow_links = 1 };
 	TORRENT_EXTRA_EXPORT void stat_file(std::string const& f, file_status* s
 		, error_code& ec, int flags = 0);
+
+	// returns true if the paths ``f1`` and ``f2`` are on the same file system
+	// (volume), i.e. if a file can be renamed from one to the other. Paths that
+	// don't exist are considered to be on the file system of their closest
+	// existing parent directory
+	TORRENT_EXTRA_EXPORT bool same_filesystem(std::string const& f1
+		, std::string const& f2, error_code& ec);
 	TORRENT_EXTRA_EXPORT void rename(std::string const& f
 		, std::string const& newf, error_code& ec);
 	TORRENT_EXTRA_EXPORT void create_directories(std::string const& f
@@ -0,0 +1,104 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_READ_AHEAD_HPP_INCLUDE
+#define TORRENT_READ_AHEAD_HPP_INCLUDE
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/storage_defs.hpp" // for storage_index_t
+
+#include <array>
+#include <mutex>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// keeps track of a small number of recent read streams, to detect
+	// sequential access patterns (a peer requesting the rest of a piece, or
+	// the pieces following it). For each read, it decides which range, if any,
+	// should be hinted to the kernel ahead of the actual read jobs. All
+	// offsets are absolute offsets into the torrent.
+	struct TORRENT_EXTRA_EXPORT read_ahead
+	{
+		struct result
+		{
+			// true if the read was covered by a range previously returned in
+			// ``prefetch_offset`` and ``prefetch_length``
+			bool hit = false;
+
+			// the range to prefetch. ``prefetch_length`` is 0 if there's
+			// nothing to prefetch
+			std::int64_t prefetch_offset = 0;
+			std::int64_t prefetch_length = 0;
+		};
+
+		// record a read of ``len`` bytes at ``offset`` in the torrent stored
+		// in ``storage``. ``max_window`` is the upper limit of how far ahead of
+		// a sequential stream we're allowed to prefetch.
+		result on_read(storage_index_t storage, std::int64_t offset, int len
+			, int piece_length, std::int64_t total_size, int max_window);
+
+		// forget all streams belonging to the specified storage. This is
+		// called when a torrent is removed
+		void remove_storage(storage_index_t storage);
+
+	private:
+
+		struct stream
+		{
+			// the offset we expect the next read on this stream to start at.
+			// -1 means this slot is unused
+			std::int64_t next = -1;
+
+			// the end of the range we have prefetched so far
+			std::int64_t prefetched = 0;
+
+			// the current read-ahead window, in bytes. It grows for every
+			// sequential read and is reset when the stream is replaced
+			int window = 0;
+
+			// the value of m_clock when this stream was last used. This is used
+			// to evict the least recently used stream
+			std::uint32_t last_use = 0;
+
+			storage_index_t storage{0};
+		};
+
+		std::mutex m_mutex;
+		std::uint32_t m_clock = 0;
+		std::array<stream, 32> m_streams;
+	};
+}
+}
+
+#endif
@@ -40,20 +40,35 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <unordered_map>
 #include <vector>
-#include <map>
+#include <memory>
+#include <functional>
+#include <thread>
 
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/socket.hpp"
 #include "libtorrent/aux_/resolver_interface.hpp"
 #include "libtorrent/address.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/optional.hpp"
 
 namespace libtorrent {
 namespace aux {
 
 struct TORRENT_EXTRA_EXPORT resolver final : resolver_interface
 {
-	explicit resolver(io_context& ios);
+	// the function used to look up a host name. It's called on one of the
+	// resolver's threads and is expected to block until the lookup completes
+	using lookup_function = std::function<std::vector<address>(
+		std::string const& hostname, error_code& ec)>;
+
+	// if no lookup function is passed in, host names are looked up by the
+	// operating system
+	explicit resolver(io_context& ios, lookup_function lookup = {});
+	~resolver();
+
+	resolver(resolver const&) = delete;
+	resolver& operator=(resolver const&) = delete;
 
 	void async_resolve(std::string const& host, resolver_flags flags
 		, callback_t h) override;
@@ -62,10 +77,55 @@ struct TORRENT_EXTRA_EXPORT resolver final : resolver_interface
 
 	void set_cache_timeout(seconds timeout) override;
 
+	// the number of seconds failed lookups are cached
+	void set_negative_cache_timeout(seconds timeout);
+
+	// the max number of host names looked up in parallel
+	void set_max_threads(int n);
+
+	// lookup threads exit after having been idle for this long
+	void set_idle_timeout(time_duration timeout);
+
+	// the number of lookup threads currently running
+	int num_threads();
+
+	struct host_stats
+	{
+		// the number of lookups of the host name that completed, and how many
+		// of them failed
+		int lookups = 0;
+		int failures = 0;
+
+		// the number of times the host name was served from the cache, and
+		// how many of those were served a stale entry while it was being
+		// looked up again
+		int cache_hits = 0;
+		int stale_hits = 0;
+
+		// the duration of the last lookup, and the moving average over the
+		// previous ones
+		time_duration last_latency = time_duration(0);
+		time_duration average_latency = time_duration(0);
+	};
+
+	// returns the stats of the lookups of the specified host name, or
+	// nothing if it's not in the cache
+	boost::optional<host_stats> stats(std::string const& hostname) const;
+
 private:
 
-	void on_lookup(error_code const& ec, tcp::resolver::results_type ips
-		, std::string const& hostname);
+	struct lookup_queue;
+
+	static void thread_fun(std::shared_ptr<lookup_queue> q);
+
+	// joins the lookup threads that have exited
+	void join_exited_threads();
+
+	void on_lookup(std::string const& hostname, error_code const& ec
+		, std::vector<address> const& ips, time_duration latency);
+
+	// starts looking up the host name, unless it's already being looked up
+	void start_lookup(std::string const& hostname);
 
 	void callback(resolver_interface::callback_t h
 		, error_code const& ec, std::vector<address> const& ips);
@@ -74,16 +134,46 @@ private:
 	{
 		time_point last_seen;
 		std::vector<address> addresses;
+
+		// if the last lookup failed, and there are no addresses to fall back
+		// to, this is the error it failed with. last_seen is when it failed
+		error_code error;
+
+		// the number of times the entry was served from the cache since it
+		// was last looked up. Entries that are hit at least twice are looked up
+		// again ahead of expiring
+		int hits = 0;
+
+		host_stats stats;
+	};
+
+	struct pending_lookup
+	{
+		// the callbacks to call when a host resolution completes. This allows
+		// to attach more callbacks if the same host is looked up mutliple times
+		std::vector<resolver_interface::callback_t> callbacks;
+
+		// true if all callbacks are to be aborted by abort()
+		bool abort_on_shutdown = true;
 	};
 
 	std::unordered_map<std::string, dns_cache_entry> m_cache;
 	io_context& m_ios;
 
-	// all lookups in this resolver are aborted on shutdown.
-	tcp::resolver m_resolver;
+	// the host names currently being looked up
+	std::unordered_map<std::string, pending_lookup> m_pending;
+
+	// the queue of host names to look up, shared with the lookup threads
+	std::shared_ptr<lookup_queue> m_queue;
 
-	// lookups in this resolver are not aborted on shutdown
-	tcp::resolver m_critical_resolver;
+	// the lookup threads. They're joined once they exit, and by the
+	// destructor
+	std::vector<std::thread> m_threads;
+
+#if defined TORRENT_BUILD_SIMULATOR
+	// lookups are done by the simulated resolver
+	tcp::resolver m_resolver;
+#endif
 
 	// max number of cached entries
 	int m_max_size;
@@ -91,9 +181,8 @@ private:
 	// timeout of cache entries
 	time_duration m_timeout;
 
-	// the callbacks to call when a host resolution completes. This allows to
-	// attach more callbacks if the same host is looked up mutliple times
-	std::multimap<std::string, resolver_interface::callback_t> m_callbacks;
+	// timeout of negative cache entries
+	time_duration m_negative_timeout;
 };
 
 }
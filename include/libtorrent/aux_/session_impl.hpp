@@ -65,6 +65,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/piece_block_progress.hpp"
 #include "libtorrent/ip_filter.hpp"
 #include "libtorrent/aux_/ip_notifier.hpp"
+#include "libtorrent/aux_/interface_table.hpp"
 #include "libtorrent/session_status.hpp"
 #include "libtorrent/add_torrent_params.hpp"
 #include "libtorrent/stat.hpp"
@@ -102,6 +103,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <algorithm>
 #include <vector>
 #include <set>
+#include <map>
 #include <list>
 #include <deque>
 #include <condition_variable>
@@ -266,6 +268,11 @@ namespace aux {
 		std::shared_ptr<tcp::acceptor> sock;
 		std::shared_ptr<aux::session_udp_socket> udp_sock;
 
+		// additional TCP listen sockets bound to the same endpoint as sock,
+		// each with its own accept queue. These are only opened when
+		// listen_accept_queues is greater than 1
+		std::vector<std::shared_ptr<tcp::acceptor>> accept_queues;
+
 		// since udp packets are expected to be dispatched frequently, this saves
 		// time on handler allocation every time we read again.
 		aux::handler_storage<aux::udp_handler_max_size, aux::udp_handler> udp_handler_storage;
@@ -332,6 +339,70 @@ namespace aux {
 		TORRENT_EXTRA_EXPORT void expand_devices(span<ip_interface const>
 			, std::vector<listen_endpoint_t>& eps);
 
+		// the load we've put on one of the outgoing interfaces. This is used
+		// to pick which interface to bind new outgoing connections to
+		struct TORRENT_EXTRA_EXPORT outgoing_interface_load
+		{
+			// the relative capacity of the interface, from the
+			// outgoing_interface_weights setting
+			int weight = 1;
+
+			// the number of connections bound to this interface as of the last
+			// tick, plus the connection attempts made since then
+			int num_connections = 0;
+
+			// how many of num_connections are uTP connections, made through
+			// a listen socket on this interface
+			int num_utp_connections = 0;
+
+			// the sum of the upload and download rates of those connections
+			int rate = 0;
+
+			// the number of connection attempts whose outcome is known, and
+			// how many of them failed. These are halved periodically, to
+			// favor recent attempts
+			int connect_attempts = 0;
+			int connect_failures = 0;
+
+			// the load of the interface, if another connection was added to
+			// it, relative to its weight
+			std::int64_t cost() const;
+		};
+
+		// returns the index of the interface with the lowest cost. Ties are
+		// broken by picking the first one at or after ``start``, wrapping around
+		TORRENT_EXTRA_EXPORT int pick_outgoing_interface(
+			span<outgoing_interface_load const> ifs, int start);
+
+		// returns the index of the outgoing interface the listen socket is on,
+		// by device name or address, or -1 if it's not on any of them.
+		// ``addresses`` holds the address of each of ``interfaces`` that is an
+		// IP address, and an unspecified address for device names
+		TORRENT_EXTRA_EXPORT int outgoing_interface_index(listen_socket_t const& ls
+			, span<std::string const> interfaces, span<address const> addresses);
+
+		// the listen socket an outgoing uTP connection is made through, and
+		// the outgoing interface it's on (or -1)
+		struct utp_socket_choice
+		{
+			std::shared_ptr<listen_socket_t> socket;
+			int outgoing_interface = -1;
+		};
+
+		// picks the listen socket to make an outgoing uTP connection to
+		// ``remote`` through. A listen socket on the remote's local network is
+		// preferred. Otherwise it's the one on the least loaded outgoing
+		// interface, where ties are broken starting at the outgoing interface
+		// ``start``. ``interfaces``, ``addresses`` and ``loads`` are indexed by
+		// outgoing interface. If no listen socket is on an outgoing interface,
+		// a random one with a gateway is picked
+		TORRENT_EXTRA_EXPORT utp_socket_choice pick_utp_listen_socket(
+			span<std::shared_ptr<listen_socket_t> const> sockets
+			, address const& remote, transport ssl
+			, span<std::string const> interfaces
+			, span<address const> addresses
+			, span<outgoing_interface_load const> loads, int start);
+
 		// this is the link between the main thread and the
 		// thread started to run the main downloader loop
 		struct TORRENT_EXTRA_EXPORT session_impl final
@@ -409,6 +480,11 @@ namespace aux {
 			void on_error(error_code const& ec) override;
 
 			void on_ip_change(error_code const& ec);
+
+			// returns the snapshot of the system's interfaces and routes,
+			// refreshing it first if it's out of date
+			interface_table const& net_interfaces(error_code& if_ec
+				, error_code& route_ec);
 			void reopen_listen_sockets(bool map_ports = true);
 			void reopen_outgoing_sockets();
 			void reopen_network_sockets(reopen_network_flags_t options);
@@ -570,6 +646,9 @@ namespace aux {
 
 			// implements session_interface
 			void set_peer_classes(peer_class_set* s, address const& a, socket_type_t st) override;
+			void add_interface_peer_class(peer_class_set* s
+				, address const& local, int outgoing_interface) override;
+			peer_class_t interface_peer_class(std::string const& device);
 			peer_class_pool const& peer_classes() const override { return m_classes; }
 			peer_class_pool& peer_classes() override { return m_classes; }
 			bool ignore_unchoke_slots_set(peer_class_set const& set) const override;
@@ -587,6 +666,7 @@ namespace aux {
 			peer_class_type_filter get_peer_class_type_filter();
 
 			peer_class_info get_peer_class(peer_class_t cid) const;
+			peer_class_stats get_peer_class_stats(peer_class_t cid) const;
 			void set_peer_class(peer_class_t cid, peer_class_info const& pci);
 
 			bool is_listening() const;
@@ -618,6 +698,7 @@ namespace aux {
 			void post_torrent_updates(status_flags_t flags);
 			void post_session_stats();
 			void post_dht_stats();
+			void post_outgoing_interface_stats();
 
 			std::vector<torrent_handle> get_torrents() const;
 
@@ -703,6 +784,7 @@ namespace aux {
 
 			alert_manager& alerts() override { return m_alerts; }
 			disk_interface& disk_thread() override { return *m_disk_thread; }
+			aux::disk_interface_ext* disk_thread_ext() override;
 
 			void abort() noexcept;
 			void abort_stage2() noexcept;
@@ -792,7 +874,10 @@ namespace aux {
 
 			// implements session_interface
 			tcp::endpoint bind_outgoing_socket(socket_type& s
-				, address const& remote_address, error_code& ec) const override;
+				, address const& remote_address, int& outgoing_interface
+				, error_code& ec) override;
+			void outgoing_interface_connected(int outgoing_interface
+				, bool success) override;
 			bool verify_incoming_interface(address const& addr);
 			bool verify_bound_address(address const& addr, bool utp
 				, error_code& ec) override;
@@ -841,6 +926,7 @@ namespace aux {
 			void update_auto_sequential();
 			void update_max_failcount();
 			void update_resolver_cache_timeout();
+			void update_resolver_threads();
 
 			void update_ip_notifier();
 			void update_upnp();
@@ -1013,14 +1099,23 @@ namespace aux {
 			// posts a notification when the set of local IPs changes
 			std::unique_ptr<ip_change_notifier> m_ip_notifier;
 
+			// set if m_ip_notifier failed with an error, and won't notify us
+			// of any more changes
+			bool m_ip_notifier_failed = false;
+
+			// the network interfaces and routes on the system. This is
+			// refreshed when m_ip_notifier fires, so that we don't have to
+			// enumerate interfaces for every connection we verify
+			interface_table m_net_interfaces;
+
 			// the addresses or device names of the interfaces we are supposed to
 			// listen on. if empty, it means that we should let the os decide
 			// which interface to listen on
 			std::vector<listen_interface_t> m_listen_interfaces;
 
 			// the network interfaces outgoing connections are opened through. If
-			// there is more then one, they are used in a round-robin fashion
-			// each element is a device name or IP address (in string form) and
+			// there is more then one, the least loaded one is used (see
+			// m_outgoing_load). each element is a device name or IP address (in string form) and
 			// a port number. The port determines which port to bind the listen
 			// socket to, and the device or IP determines which network adapter
 			// to be used. If no adapter with the specified name exists, the listen
@@ -1044,12 +1139,39 @@ namespace aux {
 			void ssl_handshake(error_code const& ec, socket_type* s);
 #endif
 
-			// round-robin index into m_outgoing_interfaces
-			mutable std::uint8_t m_interface_index = 0;
+			// the peer classes of local interfaces, keyed by device name or IP
+			// address (as they appear in listen_interfaces and
+			// outgoing_interfaces). These are created on demand by
+			// interface_peer_class()
+			std::map<std::string, peer_class_t, std::less<>> m_interface_peer_classes;
+
+			// the load on each of m_outgoing_interfaces (at the same index)
+			std::vector<outgoing_interface_load> m_outgoing_load;
+
+			// the address of each of m_outgoing_interfaces (at the same index)
+			// that is an IP address. Device names have an unspecified address
+			std::vector<address> m_outgoing_addresses;
+
+			// the interface to start at, in m_outgoing_interfaces, when looking
+			// for the least loaded one. This rotates so that ties are spread
+			// across interfaces
+			int m_interface_index = 0;
+
+			// counts ticks until the connection attempt counters in
+			// m_outgoing_load are halved
+			int m_outgoing_load_ticks = 0;
+
+			// recounts the connections and rates on each outgoing interface
+			void update_outgoing_load();
 
 			std::shared_ptr<listen_socket_t> setup_listener(
 				listen_endpoint_t const& lep, error_code& ec);
 
+			// opens the additional accept queues of a listen socket, once its
+			// primary TCP socket is bound to bind_ep
+			void open_accept_queues(listen_socket_t& ls
+				, listen_endpoint_t const& lep, tcp::endpoint const& bind_ep);
+
 #ifndef TORRENT_DISABLE_DHT
 			dht::dht_state m_dht_state;
 #endif
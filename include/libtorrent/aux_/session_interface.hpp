@@ -78,6 +78,7 @@ namespace aux {
 	struct bandwidth_manager;
 	struct resolver_interface;
 	struct alert_manager;
+	struct disk_interface_ext;
 }
 
 	// hidden
@@ -151,6 +152,10 @@ namespace aux {
 
 		virtual disk_interface& disk_thread() = 0;
 
+		// the disk I/O object, if it implements disk_interface_ext. nullptr
+		// otherwise
+		virtual aux::disk_interface_ext* disk_thread_ext() = 0;
+
 		virtual alert_manager& alerts() = 0;
 
 		virtual torrent_peer_allocator_interface& get_peer_allocator() = 0;
@@ -198,9 +203,16 @@ namespace aux {
 
 		virtual void for_each_listen_socket(std::function<void(aux::listen_socket_handle const&)> f) = 0;
 
-		// ask for which interface and port to bind outgoing peer connections on
+		// ask for which interface and port to bind outgoing peer connections on.
+		// ``outgoing_interface`` is set to the index of the outgoing interface
+		// the socket was bound to, or -1 if there are none
 		virtual tcp::endpoint bind_outgoing_socket(socket_type& s, address const&
-			remote_address, error_code& ec) const = 0;
+			remote_address, int& outgoing_interface, error_code& ec) = 0;
+
+		// reports whether a connection attempt made through the outgoing
+		// interface ``outgoing_interface`` succeeded
+		virtual void outgoing_interface_connected(int outgoing_interface
+			, bool success) = 0;
 		virtual bool verify_bound_address(address const& addr, bool utp
 			, error_code& ec) = 0;
 
@@ -229,6 +241,13 @@ namespace aux {
 
 		// peer-classes
 		virtual void set_peer_classes(peer_class_set* s, address const& a, socket_type_t st) = 0;
+
+		// adds the peer class of the local interface a connection is bound to
+		// (if one has been created) to ``s``. ``local`` is the local address of
+		// the connection and ``outgoing_interface`` the index of the outgoing
+		// interface it was bound to, or -1
+		virtual void add_interface_peer_class(peer_class_set* s
+			, address const& local, int outgoing_interface) = 0;
 		virtual peer_class_pool const& peer_classes() const = 0;
 		virtual peer_class_pool& peer_classes() = 0;
 		virtual bool ignore_unchoke_slots_set(peer_class_set const& set) const = 0;
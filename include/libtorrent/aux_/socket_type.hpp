@@ -88,6 +88,10 @@ namespace aux {
 	bool is_i2p(socket_type const& s);
 #endif
 
+	// returns true if s is an SSL socket whose handshake resumed an earlier
+	// session
+	bool ssl_session_reused(socket_type& s);
+
 	// assuming the socket_type s is an ssl socket, make sure it
 	// verifies the hostname in its SSL handshake
 	void setup_ssl_hostname(socket_type& s, std::string const& hostname, error_code& ec);
@@ -0,0 +1,191 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_STORAGE_MOVER_HPP_INCLUDE
+#define TORRENT_STORAGE_MOVER_HPP_INCLUDE
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/units.hpp"
+#include "libtorrent/storage_defs.hpp" // for storage_index_t
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace libtorrent {
+namespace aux {
+
+	// the files of a storage that have been copied to ``destination`` ahead of
+	// a move across file systems, while the torrent kept using the source
+	// files. The copies are made under temporary names (see precopy_path())
+	// and renamed into place by the move. The copy of a file is only valid as
+	// long as the source hasn't been written to since it was copied. Both
+	// arrays are indexed by file. The copies that are left when this object
+	// is destructed are deleted, i.e. the stale ones once the move completes,
+	// or all of them if the move is abandoned (re-targeted, aborted, the
+	// torrent removed or the session shut down)
+	struct TORRENT_EXTRA_EXPORT precopy_state
+	{
+		precopy_state(std::string dest, int num_files);
+		~precopy_state();
+		precopy_state(precopy_state const&) = delete;
+		precopy_state& operator=(precopy_state const&) = delete;
+
+		bool is_copied(file_index_t const f) const
+		{
+			auto const i = std::size_t(static_cast<int>(f));
+			return copied[i] && !written[i];
+		}
+
+		// called once file ``f`` has been copied to ``path``
+		void set_copied(file_index_t f, std::string path);
+
+		// the complete save path the files are copied into
+		std::string const destination;
+
+		std::vector<std::atomic<bool>> copied;
+		std::vector<std::atomic<bool>> written;
+
+		// set once all files have been copied
+		std::atomic<bool> complete{false};
+
+	private:
+
+		std::mutex m_mutex;
+
+		// the paths of the copies that have been made
+		std::vector<std::string> m_files;
+	};
+
+	// copies the files of storages being moved to another file system on a
+	// pool of threads, several files at a time. This runs outside of the disk
+	// job queue, and the torrent keeps reading from (and writing to) the
+	// source files in the meantime. Only the final move_storage job is fenced
+	struct TORRENT_EXTRA_EXPORT storage_mover
+	{
+		struct file_copy
+		{
+			file_index_t file;
+			std::string source;
+			std::string destination;
+			std::int64_t size;
+		};
+
+		// called once all files have been copied, one of them failed to copy
+		// (``file`` is the one that failed), or the copy was aborted
+		using copy_handler = std::function<void(error_code const&, file_index_t file)>;
+
+		explicit storage_mover(io_context& ios);
+		~storage_mover();
+		storage_mover(storage_mover const&) = delete;
+		storage_mover& operator=(storage_mover const&) = delete;
+
+		// the max number of files copied in parallel
+		void set_max_threads(int n);
+
+		// start copying ``files``. Each file that's successfully copied is
+		// marked as such in ``state``. ``handler`` is posted to the
+		// io_context when done
+		void async_copy(storage_index_t storage, std::vector<file_copy> files
+			, std::shared_ptr<precopy_state> state, copy_handler handler);
+
+		// stops copying files for the specified storage. The handler is called
+		// with operation_aborted
+		void abort(storage_index_t storage);
+
+		// aborts all copies and waits for the threads to exit
+		void abort();
+
+		// the number of bytes copied and the total number of bytes to copy for
+		// the storage. Both are 0 if it isn't being copied
+		std::pair<std::int64_t, std::int64_t> progress(storage_index_t storage) const;
+
+	private:
+
+		struct task
+		{
+			explicit task(io_context& ios) : work(make_work_guard(ios)) {}
+
+			// keeps the io_context running until the completion handler
+			// has been posted
+			executor_work_guard<io_context::executor_type> work;
+
+			storage_index_t storage;
+			std::vector<file_copy> files;
+			std::shared_ptr<precopy_state> state;
+			copy_handler handler;
+
+			// the next file to hand out to a thread
+			std::size_t next = 0;
+
+			// the number of files being copied right now
+			int in_flight = 0;
+
+			std::int64_t total = 0;
+			std::atomic<std::int64_t> copied{0};
+			std::atomic<bool> aborted{false};
+
+			// the first error copying a file, and the file it happened to
+			error_code error;
+			file_index_t error_file{-1};
+		};
+
+		void thread_fun();
+
+		// must be called with m_mutex held
+		void maybe_complete(std::shared_ptr<task> const& t);
+
+		io_context& m_ios;
+
+		// protects all members below
+		mutable std::mutex m_mutex;
+		std::condition_variable m_cond;
+
+		std::vector<std::shared_ptr<task>> m_tasks;
+		std::vector<std::thread> m_threads;
+		int m_max_threads = 2;
+		bool m_abort = false;
+	};
+}
+}
+
+#endif
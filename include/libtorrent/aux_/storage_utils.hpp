@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <cstdint>
 #include <string>
 #include <functional>
+#include <atomic>
 
 #include "libtorrent/config.hpp"
 #include "libtorrent/fwd.hpp"
@@ -70,14 +71,35 @@ namespace aux {
 
 	// moves the files in file_storage f from ``save_path`` to
 	// ``destination_save_path`` according to the rules defined by ``flags``.
-	// returns the status code and the new save_path.
+	// ``precopied_path`` (if set) is asked about every file before it's
+	// moved. If it returns a path, an up-to-date copy of the file exists there
+	// (see precopy_file()). It's renamed into place and the source file is
+	// just deleted. returns the status code and the new save_path.
 	TORRENT_EXTRA_EXPORT std::pair<status_t, std::string>
 	move_storage(file_storage const& f
 		, std::string save_path
 		, std::string const& destination_save_path
 		, std::function<void(std::string const&, lt::error_code&)> const& move_partfile
+		, std::function<std::string(file_index_t)> const& precopied_path
 		, move_flags_t flags, storage_error& ec);
 
+	// copies the file ``from`` to ``to`` in large chunks, adding the number of
+	// bytes copied to ``progress`` as it goes. Regions of zeros in the source
+	// are left as holes in the destination. ``to`` is meant to be a temporary
+	// name (see precopy_path()), it's only renamed to its final path once the
+	// move completes. If the copy fails, ``to`` is removed. Setting ``abort``
+	// stops the copy, failing it with operation_aborted.
+	TORRENT_EXTRA_EXPORT void precopy_file(std::string const& from
+		, std::string const& to
+		, std::atomic<std::int64_t>& progress
+		, std::atomic<bool> const& abort
+		, error_code& ec);
+
+	// the path a file that will be moved to ``path`` is copied to ahead of
+	// time. It only gets its final name when the move completes, to never
+	// replace an existing file with a copy that may be abandoned
+	TORRENT_EXTRA_EXPORT std::string precopy_path(std::string const& path);
+
 	// deletes the files on fs from save_path according to options. Options may
 	// opt to only delete the partfile
 	TORRENT_EXTRA_EXPORT void
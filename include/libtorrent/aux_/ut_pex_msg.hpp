@@ -0,0 +1,60 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_UT_PEX_MSG_HPP_INCLUDE
+#define TORRENT_UT_PEX_MSG_HPP_INCLUDE
+
+#include "libtorrent/config.hpp"
+
+#ifndef TORRENT_DISABLE_EXTENSIONS
+
+#include "libtorrent/socket.hpp"
+#include "libtorrent/pex_flags.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace libtorrent {
+namespace aux {
+
+	// bencodes a ut_pex message straight into ``out``, replacing its
+	// content (but keeping its capacity). The keys are written in the
+	// sorted order bencoding requires
+	TORRENT_EXTRA_EXPORT void write_pex_msg(std::vector<char>& out
+		, std::vector<std::pair<tcp::endpoint, pex_flags_t>> const& added
+		, std::vector<tcp::endpoint> const& dropped);
+}
+}
+
+#endif // TORRENT_DISABLE_EXTENSIONS
+
+#endif
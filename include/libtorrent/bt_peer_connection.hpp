@@ -221,6 +221,8 @@ namespace libtorrent {
 		void on_piece(int received);
 		void on_cancel(int received);
 		void on_hash_request(int received);
+		void on_block_hashes(hash_request const& hr, sha256_hash const& file_root
+			, std::vector<sha256_hash> hashes);
 		void on_hashes(int received);
 		void on_hash_reject(int received);
 
@@ -464,6 +466,10 @@ namespace libtorrent {
 
 		std::vector<hash_request> m_hash_requests;
 
+		// the number of hash requests we're answering by hashing a piece
+		// from disk (see torrent::async_get_block_hashes())
+		int m_outstanding_hash_reads = 0;
+
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		// initialized during write_pe1_2_dhkey, and destroyed on
 		// creation of m_enc_handler. Cannot reinitialize once
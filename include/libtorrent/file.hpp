@@ -89,16 +89,32 @@ namespace libtorrent {
 
 namespace aux {
 
-	int pwrite_all(handle_type handle
+	TORRENT_EXTRA_EXPORT int pwrite_all(handle_type handle
 		, span<char const> buf
 		, std::int64_t file_offset
 		, error_code& ec);
 
-	int pread_all(handle_type handle
+	TORRENT_EXTRA_EXPORT int pread_all(handle_type handle
 		, span<char> buf
 		, std::int64_t file_offset
 		, error_code& ec);
 
+	// release the disk space backing the range [offset, offset + len) of the
+	// file, leaving a hole that reads back as zeros. This is best-effort.
+	// Errors are ignored, e.g. on file systems not supporting it. On Windows,
+	// files that aren't sparse are left alone
+	void punch_hole(handle_type handle, std::int64_t offset, std::int64_t len);
+
+	// copy ``len`` bytes at ``in_offset`` in ``in`` to ``out_offset`` in
+	// ``out`` without passing the data through user space. File systems
+	// supporting it share the extents between the files (reflink) rather than
+	// copying them. Returns the number of bytes copied. If this is not
+	// supported, by the platform or by the file systems, ``ec`` is set to
+	// ``operation_not_supported`` and nothing is copied
+	std::int64_t clone_range(handle_type in, std::int64_t in_offset
+		, handle_type out, std::int64_t out_offset, std::int64_t len
+		, error_code& ec);
+
 	struct TORRENT_EXTRA_EXPORT file_handle
 	{
 		file_handle(): m_fd(invalid_handle) {}
@@ -113,6 +129,11 @@ namespace aux {
 
 		std::int64_t get_size() const;
 
+		// returns true if I/O on fd() bypasses the page cache, and has to be
+		// aligned to direct_io_alignment. This is only the case if the file was
+		// opened with open_mode::direct_io and the file system supports it
+		bool direct_io() const;
+
 		handle_type fd() const { return m_fd; }
 	private:
 		void close();
@@ -221,6 +221,7 @@ struct dht_storage_interface;
 
 // include/libtorrent/peer_class.hpp
 struct peer_class_info;
+struct peer_class_stats;
 
 // include/libtorrent/peer_class_type_filter.hpp
 struct peer_class_type_filter;
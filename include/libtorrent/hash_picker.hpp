@@ -140,8 +140,12 @@ namespace libtorrent
 		hash_request pick_hashes(typed_bitfield<piece_index_t> const& pieces);
 
 		add_hashes_result add_hashes(hash_request const& req, span<sha256_hash const> hashes);
-		// TODO: support batched adding of block hashes for reduced overhead?
 		set_block_hash_result set_block_hash(piece_index_t piece, int offset, sha256_hash const& h);
+
+		// sets the hashes of consecutive blocks, starting at offset in the
+		// piece. The result is success only if all blocks were verified
+		set_block_hash_result set_block_hashes(piece_index_t piece, int offset
+			, span<sha256_hash const> h);
 		void hashes_rejected(hash_request const& req);
 		void verify_block_hashes(piece_index_t index);
 
@@ -154,6 +158,9 @@ namespace libtorrent
 
 		int piece_layer() const { return m_piece_layer; }
 
+		// the number of bytes of memory used by the merkle trees
+		std::int64_t tree_memory() const { return m_tree_memory; }
+
 	private:
 		// returns the number of proof layers needed to verify the node's hash
 		int layers_to_verify(node_index idx) const;
@@ -228,6 +235,10 @@ namespace libtorrent
 		// the granularity with which we send hash requests. The number of layers
 		// all the way down the the block level.
 		int const m_piece_tree_root_layer;
+
+		// the sum of memory_usage() of all merkle trees, kept up to date as
+		// hashes are added
+		std::int64_t m_tree_memory = 0;
 	};
 } // namespace libtorrent
 
@@ -35,7 +35,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_HTTP_PARSER_HPP_INCLUDED
 #define TORRENT_HTTP_PARSER_HPP_INCLUDED
 
-#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -47,7 +46,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/string_view.hpp"
 #include "libtorrent/time.hpp" // for seconds32
 #include "libtorrent/optional.hpp"
-#include "libtorrent/aux_/strview_less.hpp"
 
 namespace libtorrent {
 
@@ -117,10 +115,18 @@ namespace libtorrent {
 
 		bool connection_close() const { return m_connection_close; }
 
-		std::multimap<std::string, std::string, aux::strview_less> const& headers() const { return m_header; }
+		// the headers received so far, in the order they were received. The
+		// header names are lower case
+		span<std::pair<std::string, std::string> const> headers() const
+		{ return {m_header.data(), m_num_headers}; }
 		std::vector<std::pair<std::int64_t, std::int64_t>> const& chunks() const { return m_chunked_ranges; }
 
 	private:
+
+		// appends a header to the header table, and returns it
+		std::pair<std::string, std::string> const& add_header(string_view name
+			, string_view value);
+
 		std::int64_t m_recv_pos = 0;
 		std::string m_method;
 		std::string m_path;
@@ -131,7 +137,13 @@ namespace libtorrent {
 		std::int64_t m_range_start = -1;
 		std::int64_t m_range_end = -1;
 
-		std::multimap<std::string, std::string, aux::strview_less> m_header;
+		// the header table. Only the first m_num_headers entries are valid,
+		// the ones past it are left over from previous responses. They're
+		// kept to reuse the memory of their strings, so parsing a response
+		// on a kept-alive connection doesn't allocate
+		std::vector<std::pair<std::string, std::string>> m_header;
+		int m_num_headers = 0;
+
 		span<char const> m_recv_buffer;
 		// contains offsets of the first and one-past-end of
 		// each chunked range in the response
@@ -52,6 +52,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/vector.hpp"
 #include "libtorrent/aux_/open_mode.hpp" // for aux::open_mode_t
 #include "libtorrent/disk_interface.hpp" // for disk_job_flags_t
+#include "libtorrent/aux_/storage_mover.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/optional.hpp>
@@ -100,6 +101,15 @@ namespace aux {
 		status_t initialize(settings_interface const&, storage_error&);
 		std::pair<status_t, std::string> move_storage(std::string save_path
 			, move_flags_t, storage_error&);
+
+		// called with the fence raised, before moving the storage to
+		// ``save_path``. If that's on a different file system, returns the
+		// files to copy there before the move, while the storage keeps being
+		// used. The copies are recorded in precopy_state(). Returns an empty
+		// list when the move can be carried out right away.
+		std::vector<aux::storage_mover::file_copy> files_to_precopy(
+			std::string const& save_path, move_flags_t);
+		std::shared_ptr<aux::precopy_state> precopy_state() const { return m_precopy; }
 		bool verify_resume_data(add_torrent_params const& rd
 			, aux::vector<std::string, file_index_t> const& links
 			, storage_error&);
@@ -120,6 +130,13 @@ namespace aux {
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags, storage_error&);
 
+		// hint the operating system that the specified range is about to be
+		// read. This does not block on the disk. Ranges backed by the part
+		// file or pad files are ignored. Returns the number of bytes covered
+		int prefetch(settings_interface const&, std::ptrdiff_t len
+			, piece_index_t piece, int offset, aux::open_mode_t mode
+			, storage_error&);
+
 		// if the files in this storage are mapped, returns the mapped
 		// file_storage, otherwise returns the original file_storage object.
 		file_storage const& files() const { return m_mapped_files ? *m_mapped_files : m_files; }
@@ -219,6 +236,10 @@ namespace aux {
 #endif
 
 		bool m_allocate_files;
+
+		// files copied ahead of a move to another file system. Set and reset
+		// by fence jobs only. Writes to a file invalidate its copy
+		std::shared_ptr<aux::precopy_state> m_precopy;
 	};
 
 }
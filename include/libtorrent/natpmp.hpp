@@ -93,6 +93,12 @@ struct TORRENT_EXTRA_EXPORT natpmp final
 
 	void start(ip_interface const& ip);
 
+	// like start(), but uses the specified routing table instead of
+	// enumerating routes. ``route_ec`` is the error (if any) from
+	// enumerating them
+	void start(ip_interface const& ip, span<ip_route const> routes
+		, error_code const& route_ec);
+
 	// maps the ports, if a port is set to 0
 	// it will not be mapped
 	port_mapping_t add_mapping(portmap_protocol p, int external_port, tcp::endpoint local_ep
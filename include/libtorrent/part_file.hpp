@@ -38,7 +38,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <string>
 #include <vector>
 #include <mutex>
-#include <unordered_map>
 #include <cstdint>
 #include <memory>
 
@@ -49,6 +48,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/aux_/open_mode.hpp"
 #include "libtorrent/aux_/storage_utils.hpp" // for iovec_t
+#include "libtorrent/aux_/vector.hpp"
 
 namespace libtorrent {
 
@@ -67,7 +67,7 @@ namespace libtorrent {
 		int hash2(hasher256& ph, std::ptrdiff_t len, piece_index_t piece, int offset, error_code& ec);
 
 		// free the slot the given piece is stored in. We no longer need to store this
-		// piece in the part file
+		// piece in the part file. The disk space of the slot is released
 		void free_piece(piece_index_t piece);
 
 		void move_partfile(std::string const& path, error_code& ec);
@@ -78,6 +78,15 @@ namespace libtorrent {
 		void export_file(std::function<void(std::int64_t, span<char>)> f
 			, std::int64_t offset, std::int64_t size, error_code& ec);
 
+		// like the overload above, but the blocks are copied straight into
+		// ``dst`` (at the offset within the range) by the file system, where
+		// supported. On file systems that support it, the extents are shared
+		// between the files rather than copied. ``f`` is only called for
+		// blocks that could not be copied this way
+		void export_file(aux::file_handle const& dst
+			, std::function<void(std::int64_t, span<char>)> f
+			, std::int64_t offset, std::int64_t size, error_code& ec);
+
 		// flush the metadata
 		void flush_metadata(error_code& ec);
 
@@ -85,6 +94,17 @@ namespace libtorrent {
 
 		aux::file_handle open_file(aux::open_mode_t mode, error_code& ec);
 		void flush_metadata_impl(error_code& ec);
+		void export_file_impl(aux::file_handle const* dst
+			, std::function<void(std::int64_t, span<char>)> const& f
+			, std::int64_t offset, std::int64_t size, error_code& ec);
+
+		// the mutex must be held when calling this, and it's held while the
+		// disk space of the slot is released
+		void free_piece_impl(piece_index_t piece, std::unique_lock<std::mutex>& l);
+
+		// record that the slot entry for ``piece`` needs to be written to the
+		// header
+		void mark_dirty(piece_index_t piece);
 
 		std::int64_t slot_offset(slot_index_t const slot) const
 		{
@@ -130,8 +150,19 @@ namespace libtorrent {
 		// need to flush the metadata before closing the file
 		bool m_dirty_metadata = false;
 
-		// maps a piece index to the part-file slot it is stored in
-		std::unordered_map<piece_index_t, slot_index_t> m_piece_map;
+		// true if the part file has a valid header on disk. In which case only
+		// the entries in the range [m_dirty_first, m_dirty_last] need to be
+		// written when flushing the metadata
+		bool m_header_on_disk = false;
+		piece_index_t m_dirty_first{0};
+		piece_index_t m_dirty_last{0};
+
+		// maps a piece index to the part-file slot it is stored in, or -1 if
+		// it's not in the part file. This mirrors the index in the header
+		aux::vector<slot_index_t, piece_index_t> m_piece_map;
+
+		// the number of pieces stored in the part file
+		int m_num_pieces = 0;
 	};
 }
 
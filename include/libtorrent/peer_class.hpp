@@ -88,6 +88,16 @@ namespace libtorrent {
 		int download_priority;
 	};
 
+	// the number of bytes transferred by the members of a peer class, as
+	// returned by session_handle::get_peer_class_stats()
+	struct TORRENT_EXPORT peer_class_stats
+	{
+		// the total number of bytes (payload and protocol) sent and received
+		// by peers while they were members of this class
+		std::int64_t total_upload = 0;
+		std::int64_t total_download = 0;
+	};
+
 	struct TORRENT_EXTRA_EXPORT peer_class
 	{
 		friend struct peer_class_pool;
@@ -111,6 +121,7 @@ namespace libtorrent {
 
 		void set_info(peer_class_info const* pci);
 		void get_info(peer_class_info* pci) const;
+		void get_stats(peer_class_stats* pcs) const;
 
 		void set_upload_limit(int limit);
 		void set_download_limit(int limit);
@@ -130,6 +141,9 @@ namespace libtorrent {
 		// the name of this peer class
 		std::string label;
 
+		// bytes sent and received by peers in this class, indexed by channel
+		std::int64_t total_transferred[2] = {0, 0};
+
 	private:
 		// this is set to false when this slot is not in use for a peer_class
 		bool in_use;
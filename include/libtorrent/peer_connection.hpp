@@ -411,6 +411,8 @@ namespace aux {
 			return m_superseed_piece[0] == index
 				|| m_superseed_piece[1] == index;
 		}
+		std::array<piece_index_t, 2> const& super_seeded_pieces() const
+		{ return m_superseed_piece; }
 #endif
 
 		// tells if this connection has data it want to send
@@ -451,6 +453,12 @@ namespace aux {
 		// bytes as if they've been requested
 		time_duration download_queue_time(int extra_bytes = 0) const;
 
+		// estimate of how long it would take to receive one more block, if
+		// we requested it now. This is the download queue time, padded by
+		// how erratic the peer's response times have been. Time critical
+		// blocks are assigned to the peers predicted to deliver first
+		time_duration block_delivery_time() const;
+
 		bool is_interesting() const { return m_interesting; }
 		bool is_choked() const override { return m_choked; }
 
@@ -491,6 +499,8 @@ namespace aux {
 		aux::socket_type& get_socket() { return m_socket; }
 		tcp::endpoint const& remote() const override { return m_remote; }
 		tcp::endpoint local_endpoint() const override { return m_local; }
+		int outgoing_interface() const { return m_outgoing_interface; }
+		void set_outgoing_interface(int const i) { m_outgoing_interface = std::int16_t(i); }
 
 		typed_bitfield<piece_index_t> const& get_bitfield() const;
 		std::vector<piece_index_t> const& allowed_fast();
@@ -783,6 +793,9 @@ namespace aux {
 
 		void account_received_bytes(int bytes_transferred);
 
+		// adds bytes to the transfer totals of the peer classes we belong to
+		void count_class_bytes(int channel, int bytes);
+
 		void do_update_interest();
 		void fill_send_buffer();
 		void on_disk_read_complete(disk_buffer_holder buffer
@@ -1088,6 +1101,11 @@ namespace aux {
 		// are preferred.
 		std::uint16_t m_prefer_contiguous_blocks = 0;
 
+		// the index of the outgoing interface (in the outgoing_interfaces
+		// setting) this connection was bound to, or -1 if it wasn't bound to
+		// one (including all incoming connections)
+		std::int16_t m_outgoing_interface = -1;
+
 		// this is the number of times this peer has had
 		// a request rejected because of a disk I/O failure.
 		// once this reaches a certain threshold, the
@@ -80,6 +80,14 @@ namespace libtorrent {
 			error_tcp_peers,
 			error_utp_peers,
 
+			web_seed_requests,
+			web_seed_keepalive_requests,
+
+			// the number of SSL peer handshakes (incoming and outgoing)
+			// that were full handshakes and that resumed an earlier session
+			ssl_full_handshakes,
+			ssl_resumed_handshakes,
+
 			// the number of times the piece picker was
 			// successfully invoked, split by the reason
 			// it was invoked
@@ -103,6 +111,14 @@ namespace libtorrent {
 			piece_picker_rand_loops,
 			piece_picker_busy_loops,
 
+			// pieces with a deadline (set_piece_deadline()) that completed
+			// before and after their deadline respectively, and the number of
+			// requests duplicated to another peer because a deadline was at
+			// risk
+			deadline_pieces_hit,
+			deadline_pieces_missed,
+			deadline_duplicate_requests,
+
 			// reasons to disconnect peers
 			connect_timeouts,
 			uninteresting_peers,
@@ -208,6 +224,37 @@ namespace libtorrent {
 			disk_hash_time,
 			disk_job_time,
 
+			num_prefetch_ops,
+			num_prefetch_hits,
+			num_prefetch_misses,
+			disk_prefetch_hit_time,
+			disk_prefetch_miss_time,
+			disk_prefetch_saved_time,
+
+			file_pool_hits,
+			file_pool_misses,
+			file_pool_evictions,
+
+			num_write_back_ops,
+			num_write_back_throttled,
+			disk_write_back_time,
+
+			block_cache_hits,
+			block_cache_misses,
+			block_cache_evictions,
+			block_cache_rejections,
+
+			// these must be in the same order as job_priority_t
+			time_critical_queue_jobs,
+			read_queue_jobs,
+			write_queue_jobs,
+			hash_queue_jobs,
+			time_critical_queue_time,
+			read_queue_time,
+			write_queue_time,
+			hash_queue_time,
+			num_aged_disk_jobs,
+
 			waste_piece_timed_out,
 			waste_piece_cancelled,
 			waste_piece_unknown,
@@ -459,6 +506,21 @@ namespace libtorrent {
 
 			num_queued_tracker_announces,
 
+			num_open_files,
+			num_hot_open_files,
+			file_pool_mapped_bytes,
+			file_pool_dirty_bytes,
+
+			block_cache_bytes,
+
+			// these must be in the same order as job_priority_t
+			queued_time_critical_jobs,
+			queued_read_jobs,
+			queued_write_jobs,
+			queued_hash_jobs,
+
+			merkle_tree_bytes,
+
 			num_counters,
 			num_gauges_counters = num_counters - num_stats_counters
 		};
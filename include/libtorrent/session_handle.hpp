@@ -234,6 +234,10 @@ namespace libtorrent {
 		// This will cause a dht_stats_alert to be posted.
 		void post_dht_stats();
 
+		// This will cause an outgoing_interface_stats_alert to be posted, with
+		// the load of each interface in the outgoing_interfaces setting.
+		void post_outgoing_interface_stats();
+
 		// internal
 		io_context& get_context();
 
@@ -716,6 +720,21 @@ namespace libtorrent {
 		// For more information on peer classes, see peer-classes_.
 		peer_class_t create_peer_class(char const* name);
 
+		// Returns the peer class of the local network interface ``device``,
+		// creating it the first time it's requested. ``device`` is a device
+		// name or IP address, as it appears in listen_interfaces or
+		// outgoing_interfaces. Once it exists, every connection made through
+		// that interface is added to the class, TCP connections by the address
+		// or outgoing interface they are bound to and uTP connections by the
+		// listen socket they use. This can be used to rate limit each uplink
+		// of a multi-homed host separately, and get_peer_class_stats() reports
+		// how many bytes were transferred over it.
+		//
+		// Passing the class to delete_peer_class() detaches it from the
+		// interface. New connections are no longer added to it, and the next
+		// call creates a new class for the interface.
+		peer_class_t interface_peer_class(std::string const& device);
+
 		// This call dereferences the reference count of the specified peer
 		// class. When creating a peer class it's automatically referenced by 1.
 		// If you want to recycle a peer class, you may call this function. You
@@ -753,6 +772,11 @@ namespace libtorrent {
 		peer_class_info get_peer_class(peer_class_t cid) const;
 		void set_peer_class(peer_class_t cid, peer_class_info const& pci);
 
+		// returns the number of bytes sent and received by the peers of the
+		// peer class ``cid``, while they were members of it. ``cid`` must
+		// refer to an existing peer class.
+		peer_class_stats get_peer_class_stats(peer_class_t cid) const;
+
 #if TORRENT_ABI_VERSION == 1
 		// if the listen port failed in some way you can retry to listen on
 		// another port- range with this function. If the listener succeeded and
@@ -247,8 +247,9 @@ namespace aux {
 			// interface names. An empty string will not bind TCP sockets to a
 			// device, and let the network stack assign the local address.
 			//
-			// A list of names will be used to bind outgoing TCP sockets in a
-			// round-robin fashion. An IP address will simply be used to `bind()`
+			// A list of names will be used to bind outgoing TCP sockets, picking
+			// the least loaded interface for each connection (see
+			// outgoing_interface_weights). An IP address will simply be used to `bind()`
 			// the socket. An interface name will attempt to bind the socket to
 			// that interface. If that fails, or is unsupported, one of the IP
 			// addresses configured for that interface is used to `bind()` the
@@ -260,6 +261,11 @@ namespace aux {
 			// local IP does not necessarily make the connection via the
 			// associated NIC/Adapter.
 			//
+			// Outgoing uTP connections are sent through the UDP socket of a
+			// listen socket (see listen_interfaces). When a peer isn't on the
+			// local network of any listen socket, the listen socket on the least
+			// loaded outgoing interface is used, by the same policy as TCP.
+			//
 			// When outgoing interfaces are specified, incoming connections or
 			// packets sent to a local interface or IP that's *not* in this list
 			// will be rejected with a peer_blocked_alert with
@@ -378,6 +384,17 @@ namespace aux {
 			// effect until the DHT is restarted.
 			dht_bootstrap_nodes,
 
+			// a comma-separated list of weights for the interfaces in
+			// outgoing_interfaces, in the same order. When there is more than
+			// one outgoing interface, each new outgoing connection is bound to
+			// the interface with the lowest load relative to its weight. The
+			// load of an interface is the payload rate of its connections plus
+			// a nominal cost per connection, scaled up by its connection failure
+			// rate. Interfaces without a weight (or a weight less than 1) have a
+			// weight of 1. For example, ``4,1`` for a 400 Mbit/s and a 100 Mbit/s
+			// uplink.
+			outgoing_interface_weights,
+
 			max_string_setting_internal
 		};
 
@@ -1005,6 +1022,13 @@ namespace aux {
 			// protocol may not be valid from the proxy's point of view.
 			socks5_udp_send_local_ep,
 
+			// when ``listen_accept_queues`` opens more than one TCP listen
+			// socket per endpoint, assign each of them to a CPU. The kernel
+			// then prefers to hand a connection to the socket whose CPU
+			// received it, keeping the connection's state local to that CPU.
+			// This only has an effect on Linux.
+			listen_accept_queue_affinity,
+
 			max_bool_setting_internal
 		};
 
@@ -1271,6 +1295,21 @@ namespace aux {
 			//   disabled, enabling this may reduce performance.
 			// write_through
 			//   flush pieces to disk as they complete validation.
+			// direct_io
+			//   Bypass the page cache by opening files with ``O_DIRECT`` and
+			//   reading and writing the 4 kiB aligned part of each block with
+			//   positional I/O. The unaligned head and tail of a block (only
+			//   present for files not starting at an aligned offset in the
+			//   torrent) still go through the page cache. This is only
+			//   supported on Linux, other platforms, and file systems not
+			//   supporting ``O_DIRECT``, fall back to enable_os_cache.
+			//   Since there is no cache in front of the files, hashing a piece
+			//   after it has been written reads it back from the disk.
+			//   The files are still mapped into memory, for the unaligned
+			//   parts. Linux writes back and invalidates the cached pages
+			//   around each direct write, which keeps the mapping coherent
+			//   as long as nothing accesses the same pages through a mapping
+			//   while the write is in progress.
 			//
 			// One reason to disable caching is that it may help the operating
 			// system from growing its file cache indefinitely.
@@ -2028,6 +2067,100 @@ namespace aux {
 			// torrents, this limit may have to be raised.
 			metadata_token_limit,
 
+			// ``disk_prefetch_queue_depth`` is the number of queued read jobs the
+			// disk threads look ahead at. The file ranges those jobs will read
+			// are hinted to the operating system (``MADV_WILLNEED``) so that
+			// the page faults can be serviced in parallel, rather than one at a
+			// time when each job is executed. Setting this to 0 disables
+			// prefetching of queued reads.
+			disk_prefetch_queue_depth,
+
+			// ``disk_read_ahead_limit`` is the max number of bytes to read ahead
+			// of a sequential read stream. When a peer starts reading a piece,
+			// the remainder of the piece is prefetched. If it continues to read
+			// sequentially, the read-ahead window grows up to this size. Setting
+			// this to 0 disables read-ahead.
+			disk_read_ahead_limit,
+
+			// ``file_pool_eviction_policy`` determines which file to close
+			// when the number of open files reaches ``file_pool_size``. See
+			// file_pool_eviction_t for options.
+			file_pool_eviction_policy,
+
+			// ``file_pool_mapped_limit`` is the max number of MiB of files the
+			// disk I/O subsystem keeps mapped into memory at any given time.
+			// Files are closed, according to ``file_pool_eviction_policy``, to
+			// stay below this limit. 0 means there's no limit, other than
+			// ``file_pool_size``.
+			file_pool_mapped_limit,
+
+			// ``disk_write_back_limit`` is the max number of MiB of dirty pages
+			// written to files, that have not been flushed to disk yet. Once
+			// half of this budget is used, a disk thread starts flushing the
+			// dirty pages of the files with the most of them, in offset order
+			// and in large sequential batches, rather than leaving it to the
+			// operating system's write-back. If the budget is exceeded, peers
+			// stop receiving data until the dirty pages have been written. 0
+			// leaves flushing to the operating system.
+			disk_write_back_limit,
+
+			// ``disk_block_cache_size`` is the max number of MiB of blocks to
+			// keep in the user-space block cache, used to serve popular blocks
+			// to peers without reading them from disk. A block read from disk is
+			// only admitted to the cache if it is requested more frequently than
+			// the least recently used block it would evict. Blocks that have just
+			// been downloaded are offered to the cache as well, so they can be
+			// uploaded to other peers straight away. 0 disables the cache.
+			disk_block_cache_size,
+
+			// ``disk_job_aging_limit`` is the max number of milliseconds a queued
+			// disk job is passed over in favor of higher priority jobs. Disk
+			// jobs are executed in priority order: reads and hashes of pieces
+			// with a deadline first, then reads requested by peers, writes, and
+			// finally hashing and checking of files. Once a job has been waiting
+			// for longer than this, the job that has been waiting the longest is
+			// executed next. Setting this to 0 executes jobs in the order they
+			// were issued.
+			disk_job_aging_limit,
+
+			// ``move_storage_threads`` is the max number of files copied in
+			// parallel when a torrent's storage is moved to another file
+			// system. The files are copied in the background while the torrent
+			// keeps seeding from the old location, the torrent's disk jobs are
+			// only blocked for the final step, where the sources are deleted
+			// (and files written to during the copy are copied again).
+			// Setting this to 0 copies the files as part of the final step
+			// instead, one at a time.
+			move_storage_threads,
+
+			// ``urlseed_connections`` is the number of connections opened to
+			// each URL seed (BEP 19) in parallel. Each connection requests its
+			// own large, contiguous range of pieces. Every connection counts
+			// towards ``max_web_seed_connections``.
+			urlseed_connections,
+
+			// ``resolver_threads`` is the max number of host names looked up
+			// in parallel by the internal host name resolver. Lookups are
+			// blocking calls to the operating system, each running on its
+			// own thread.
+			resolver_threads,
+
+			// the number of seconds the internal host name resolver caches a
+			// failed lookup. Lookups of the host name fail immediately until
+			// it times out.
+			resolver_negative_cache_timeout,
+
+			// ``listen_accept_queues`` is the number of TCP listen sockets
+			// opened on each listen endpoint. Each socket has its own accept
+			// queue of ``listen_queue_size`` connections and its own
+			// outstanding accept, which lets a session absorb bursts of
+			// incoming connections. The sockets share the endpoint using
+			// ``SO_REUSEPORT``, which also allows other processes of the same
+			// user to bind it. On systems without ``SO_REUSEPORT`` only one
+			// socket is opened. Like ``listen_queue_size``, it will not take
+			// effect until the ``listen_interfaces`` settings is updated.
+			listen_accept_queues,
+
 			max_int_setting_internal
 		};
 
@@ -2090,6 +2223,23 @@ namespace aux {
 			disable_os_cache = 2,
 
 			write_through = 3,
+
+			direct_io = 4,
+		};
+
+		enum file_pool_eviction_t : std::uint8_t
+		{
+			// close the least recently used file
+			lru_eviction = 0,
+
+			// files opened for the first time are closed in the order they
+			// were opened. Files that are opened again shortly after having
+			// been closed are considered hot, and are only closed (in least
+			// recently used order) when hot files take up more than 3/4 of the
+			// pool. This prevents scans over all files, such as rechecking a
+			// torrent, from evicting the files that are actively used for
+			// seeding.
+			two_queue_eviction = 1,
 		};
 
 		enum bandwidth_mixed_algo_t : std::uint8_t
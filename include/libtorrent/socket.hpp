@@ -278,6 +278,44 @@ struct udp : boost::asio::ip::udp {
 	};
 #endif // TORRENT_USE_NETLINK
 
+#if defined SO_REUSEPORT && !defined TORRENT_BUILD_SIMULATOR
+#define TORRENT_HAS_REUSE_PORT
+
+	// allows several sockets to bind to the same endpoint. The kernel
+	// distributes incoming connections across the listening sockets
+	struct reuse_port
+	{
+		explicit reuse_port(int enable) : m_value(enable) {}
+		template<class Protocol>
+		int level(Protocol const&) const { return SOL_SOCKET; }
+		template<class Protocol>
+		int name(Protocol const&) const { return SO_REUSEPORT; }
+		template<class Protocol>
+		int const* data(Protocol const&) const { return &m_value; }
+		template<class Protocol>
+		std::size_t size(Protocol const&) const { return sizeof(m_value); }
+		int m_value;
+	};
+
+#ifdef SO_INCOMING_CPU
+	// hints which CPU a listen socket should receive its connections on,
+	// when several sockets share an endpoint
+	struct incoming_cpu
+	{
+		explicit incoming_cpu(int cpu) : m_value(cpu) {}
+		template<class Protocol>
+		int level(Protocol const&) const { return SOL_SOCKET; }
+		template<class Protocol>
+		int name(Protocol const&) const { return SO_INCOMING_CPU; }
+		template<class Protocol>
+		int const* data(Protocol const&) const { return &m_value; }
+		template<class Protocol>
+		std::size_t size(Protocol const&) const { return sizeof(m_value); }
+		int m_value;
+	};
+#endif
+#endif // SO_REUSEPORT
+
 #ifdef TCP_NOTSENT_LOWAT
 	struct tcp_notsent_lowat
 	{
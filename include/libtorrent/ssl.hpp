@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/string_view.hpp"
 #include "libtorrent/aux_/export.hpp"
+#include "libtorrent/socket.hpp"
 
 #if TORRENT_USE_SSL
 
@@ -52,6 +53,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <boost/system/system_error.hpp>
 #endif
 
+#include <map>
+
 #ifdef TORRENT_USE_OPENSSL
 #include <openssl/opensslv.h> // for OPENSSL_VERSION_NUMBER
 #if OPENSSL_VERSION_NUMBER < 0x1000000fL
@@ -178,6 +181,42 @@ TORRENT_EXTRA_EXPORT void set_context(stream_handle_type s, context_handle_type
 TORRENT_EXTRA_EXPORT bool has_context(stream_handle_type s, context_handle_type c);
 TORRENT_EXTRA_EXPORT context_handle_type get_context(stream_handle_type s);
 
+// returns true if the handshake on this stream resumed an earlier session
+// instead of performing a full handshake
+TORRENT_EXTRA_EXPORT bool session_reused(stream_handle_type s);
+
+// sessions are only resumed by a server within the same session ID context.
+// Contexts that verify peers against different roots of trust must use
+// different IDs
+TORRENT_EXTRA_EXPORT void set_session_id_context(context_handle_type c
+	, string_view id, error_code& ec);
+
+#if defined TORRENT_USE_OPENSSL
+// keeps the most recent resumable session for each remote endpoint we've
+// made an outgoing connection to with a specific context. Constructing it
+// installs it on the context, and prepare() must be called on each new
+// outgoing stream, before the handshake, to have it resume a cached session
+// (and to have the session it establishes cached)
+struct TORRENT_EXTRA_EXPORT client_session_cache
+{
+	client_session_cache(context_handle_type c, int max_size);
+	~client_session_cache();
+	client_session_cache(client_session_cache const&) = delete;
+	client_session_cache& operator=(client_session_cache const&) = delete;
+
+	void prepare(stream_handle_type s, tcp::endpoint const& ep);
+
+	int size() const { return int(m_sessions.size()); }
+
+private:
+	static int on_new_session(SSL* s, SSL_SESSION* sess);
+
+	context_handle_type m_ctx;
+	int m_max_size;
+	std::map<tcp::endpoint, SSL_SESSION*> m_sessions;
+};
+#endif
+
 } // ssl
 } // libtorrent
 
@@ -155,6 +155,16 @@ namespace libtorrent {
 		bool operator<(time_critical_piece const& rhs) const
 		{ return deadline < rhs.deadline; }
 	};
+
+	// returns the number of times each block of a time critical piece may be
+	// requested from an additional peer, when all of its blocks have been
+	// requested, the last one at ``last_requested``. This is more than 0 if
+	// the piece appears stalled (compared to the average piece download
+	// time), or if its outstanding requests are projected to arrive after a
+	// deadline that hasn't passed yet
+	TORRENT_EXTRA_EXPORT int time_critical_timeouts(time_point now
+		, time_point last_requested, time_point deadline
+		, int average_piece_time, int piece_time_deviation);
 #endif // TORRENT_DISABLE_STREAMING
 
 	// this is the internal representation of web seeds
@@ -208,6 +218,12 @@ namespace libtorrent {
 		// web seed from resolving to any local network IPs.
 		bool no_local_ips = false;
 
+		// this is set for the additional entries created for a URL seed to
+		// connect to it more than once (see urlseed_connections). They share
+		// the URL of the entry they were created for, and are removed along
+		// with it.
+		bool parallel = false;
+
 		// if the web server doesn't support keepalive or a block request was
 		// interrupted, the block received so far is kept here for the next
 		// connection to pick up
@@ -239,6 +255,7 @@ namespace libtorrent {
 			removed = std::move(rhs.removed);
 			ephemeral = std::move(rhs.ephemeral);
 			no_local_ips = std::move(rhs.no_local_ips);
+			parallel = std::move(rhs.parallel);
 			restart_request = std::move(rhs.restart_request);
 			restart_piece = std::move(rhs.restart_piece);
 			redirects = std::move(rhs.redirects);
@@ -276,6 +293,10 @@ namespace libtorrent {
 		// this is stored in file_storage and no longer need to be kept here.
 		std::int64_t m_size_on_disk = 0;
 
+		// the memory used by m_merkle_trees, as last reported to the
+		// merkle_tree_bytes gauge
+		std::int64_t m_merkle_tree_memory = 0;
+
 		// a back reference to the session
 		// this torrent belongs to.
 		aux::session_interface& m_ses;
@@ -475,7 +496,9 @@ namespace libtorrent {
 			bool fail;
 			error_code error;
 		};
-		void read_piece(piece_index_t);
+		// if ``time_critical`` is set, the disk reads are executed ahead of
+		// other disk jobs. It's used for pieces with a deadline
+		void read_piece(piece_index_t, bool time_critical);
 		void on_disk_read_complete(disk_buffer_holder, storage_error const&
 			, peer_request const&, std::shared_ptr<read_piece_struct>);
 
@@ -964,6 +987,10 @@ namespace libtorrent {
 		// are outstanding operations on it
 		void remove_web_seed_iter(std::list<web_seed_t>::iterator web);
 
+		// adds or removes parallel entries of the connected URL seeds, to
+		// have urlseed_connections connections to each of them
+		void update_parallel_web_seeds();
+
 		// this is called when the torrent has finished. i.e.
 		// all the pieces we have not filtered have been downloaded.
 		// If no pieces are filtered, this is called first and then
@@ -1053,6 +1080,11 @@ namespace libtorrent {
 		}
 
 		void need_hash_picker();
+
+		// updates the merkle_tree_bytes gauge after the merkle trees may
+		// have changed
+		void update_merkle_tree_memory();
+
 		bool has_hash_picker() const
 		{
 			return m_hash_picker.get() != nullptr;
@@ -1077,6 +1109,13 @@ namespace libtorrent {
 
 		hash_request pick_hashes(peer_connection* peer);
 		std::vector<sha256_hash> get_hashes(hash_request const& req) const;
+		// answers a request for block hashes (or nodes below the piece layer)
+		// of a piece we have, whose hashes get_hashes() can't return because
+		// they have been dropped. The piece is hashed again and ``handler`` is
+		// called with the hashes, or an empty vector on failure. Returns false
+		// if the request can't be answered this way.
+		bool async_get_block_hashes(hash_request const& req
+			, std::function<void(std::vector<sha256_hash>)> handler);
 		bool add_hashes(hash_request const& req, span<sha256_hash> hashes);
 		void hashes_rejected(hash_request const& req);
 		void verify_block_hashes(piece_index_t index);
@@ -1259,6 +1298,21 @@ namespace libtorrent {
 
 		void ip_filter_updated();
 
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+		// builds m_swarm_copies from the bitfields of all connected peers
+		void init_swarm_copies();
+
+		// adds or removes one copy of every piece set in ``bits`` to
+		// m_swarm_copies, if it's in use
+		void update_swarm_copies(typed_bitfield<piece_index_t> const& bits
+			, int delta);
+		void update_swarm_copies(piece_index_t index, int delta);
+
+		// the distributed copies of the swarm, based on m_swarm_copies. The
+		// integer part and the fraction in thousandths
+		std::pair<int, int> swarm_distributed_copies() const;
+#endif
+
 		void inc_stats_counter(int c, int value = 1);
 
 		// initialize the torrent_state structure passed to peer_list
@@ -1329,6 +1383,13 @@ namespace libtorrent {
 #ifdef TORRENT_SSL_PEERS
 		std::unique_ptr<ssl::context> m_ssl_ctx;
 
+#ifdef TORRENT_USE_OPENSSL
+		// sessions from our outgoing SSL connections, to resume them when
+		// reconnecting to the same peers. This must be destructed before
+		// m_ssl_ctx
+		std::unique_ptr<ssl::client_session_cache> m_ssl_sessions;
+#endif
+
 		bool verify_peer_cert(bool const preverified, ssl::verify_context& ctx);
 
 		void init_ssl(string_view cert);
@@ -1412,6 +1473,20 @@ namespace libtorrent {
 		// v2 merkle tree for each file
 		aux::vector<aux::merkle_tree, file_index_t> m_merkle_trees;
 
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+		// when super seeding without a piece picker, this is the number of
+		// connected peers we know have each piece, as advertised by their
+		// bitfields and HAVE messages. It's built lazily the first time we
+		// pick a piece to super seed, and empty when not in use.
+		aux::vector<std::uint16_t, piece_index_t> m_swarm_copies;
+
+		// the number of times each piece has been handed out to a peer as
+		// its super seeded piece. Among pieces with the same number of
+		// copies in the swarm, the one revealed the fewest times is picked,
+		// to spread our upload across as many distinct pieces as possible
+		aux::vector<std::uint16_t, piece_index_t> m_superseed_reveals;
+#endif
+
 		// the performance counters of this session
 		counters& m_stats_counters;
 
@@ -375,7 +375,9 @@ TORRENT_VERSION_NAMESPACE_3
 		//
 		// If we are a seed, the piece picker is deallocated as an optimization,
 		// and piece availability is no longer tracked. In this case the
-		// distributed copies members are set to -1.
+		// distributed copies members are set to -1, unless the torrent is
+		// super seeding, in which case availability among the connected peers
+		// is still tracked, to pick which pieces to reveal.
 		int distributed_fraction = 0;
 
 		// the number of distributed copies of the file. note that one copy may
@@ -90,6 +90,9 @@ namespace libtorrent {
 		void handle_error(int bytes_left);
 		void maybe_harvest_piece();
 
+		// updates the stats counters for an HTTP request about to be sent
+		void count_request();
+
 		// returns the block currently being
 		// downloaded. And the progress of that
 		// block. If the peer isn't downloading
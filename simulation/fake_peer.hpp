@@ -46,6 +46,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/io.hpp"
 #include "libtorrent/bdecode.hpp"
+#include "libtorrent/bencode.hpp"
+#include "libtorrent/entry.hpp"
 #include "libtorrent/random.hpp"
 
 using namespace sim;
@@ -159,6 +161,23 @@ struct fake_peer
 		lt::aux::write_uint8(0, ptr);
 	}
 
+	// queues an extension handshake (BEP 10) with the specified content,
+	// and advertises support for the extension protocol in our handshake
+	void send_extension_handshake(lt::entry const& e)
+	{
+		m_extensions = true;
+		std::vector<char> msg;
+		lt::bencode(std::back_inserter(msg), e);
+		int const len = 4 + 2 + int(msg.size());
+		m_send_buffer.resize(m_send_buffer.size() + std::size_t(len));
+		char* ptr = m_send_buffer.data() + m_send_buffer.size() - len;
+
+		lt::aux::write_uint32(len - 4, ptr);
+		lt::aux::write_uint8(20, ptr);
+		lt::aux::write_uint8(0, ptr);
+		std::memcpy(ptr, msg.data(), msg.size());
+	}
+
 	void flush_send_buffer()
 	{
 		TORRENT_ASSERT(!m_writing);
@@ -201,6 +220,7 @@ private:
 		int const len = sizeof(handshake) - 1;
 		memcpy(m_out_buffer.data(), handshake, len);
 		memcpy(&m_out_buffer[28], ih.data(), 20);
+		if (m_extensions) m_out_buffer[25] |= 0x10;
 		lt::aux::random_bytes({&m_out_buffer[48], 20});
 
 		TORRENT_ASSERT(!m_writing);
@@ -320,6 +340,9 @@ private:
 	// socket
 	bool m_writing = false;
 
+	// set to true if we support the extension protocol
+	bool m_extensions = false;
+
 	std::vector<char> m_send_buffer;
 };
 
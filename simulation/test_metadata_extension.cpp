@@ -35,6 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "settings.hpp"
 #include "setup_swarm.hpp"
 #include "utils.hpp"
+#include "fake_peer.hpp"
 
 #include "libtorrent/session.hpp"
 #include "libtorrent/alert_types.hpp"
@@ -72,6 +73,9 @@ enum flags_t
 
 	// token limit is too low
 	token_limit = 64,
+
+	// another peer announces the wrong metadata size, after the seed
+	lying_peer = 128,
 };
 
 void run_metadata_test(int flags)
@@ -102,6 +106,12 @@ void run_metadata_test(int flags)
 
 	std::shared_ptr<lt::torrent_info> ti;
 
+	// supports ut_metadata, but announces the wrong size and never sends
+	// any of it
+	std::unique_ptr<fake_peer> liar;
+	if (flags & lying_peer)
+		liar.reset(new fake_peer(sim, "60.0.0.0"));
+
 	// TODO: we use real_disk here because the test disk io doesn't support
 	// multiple torrents, and readd will add back the same torrent before the
 	// first one is done being removed
@@ -135,6 +145,16 @@ void run_metadata_test(int flags)
 		// on alert
 		, [&](lt::alert const* a, lt::session& ses) {
 
+			if (liar && alert_cast<add_torrent_alert>(a))
+			{
+				entry e;
+				e["m"]["ut_metadata"] = 3;
+				e["metadata_size"] = ti->info_section().size() + 3 * 16 * 1024;
+				liar->send_extension_handshake(e);
+				liar->connect_to(lt::tcp::endpoint(lt::make_address_v4("50.0.0.1"), 6881)
+					, ti->info_hashes().get_best());
+			}
+
 			if (alert_cast<metadata_failed_alert>(a))
 			{
 				metadata_failed_alerts += 1;
@@ -195,6 +215,12 @@ void run_metadata_test(int flags)
 			return false;
 		});
 
+	if (liar)
+	{
+		TEST_CHECK(liar->connected());
+		liar->close();
+	}
+
 	if (flags & token_limit)
 	{
 		TEST_EQUAL(metadata_failed_alerts, 1);
@@ -245,6 +271,11 @@ TORRENT_TEST(ut_metadata_token_limit)
 	run_metadata_test(token_limit);
 }
 
+TORRENT_TEST(ut_metadata_lying_peer)
+{
+	run_metadata_test(lying_peer);
+}
+
 #else
 TORRENT_TEST(disabled) {}
 #endif // TORRENT_DISABLE_EXTENSIONS
@@ -3022,7 +3022,8 @@ namespace {
 		"picker_log", "session_error", "dht_live_nodes",
 		"session_stats_header", "dht_sample_infohashes",
 		"block_uploaded", "alerts_dropped", "socks5",
-		"file_prio", "oversized_file", "torrent_conflict"
+		"file_prio", "oversized_file", "torrent_conflict",
+		"storage_move_progress", "outgoing_interface_stats"
 		}};
 
 		TORRENT_ASSERT(alert_type >= 0);
@@ -3110,6 +3111,49 @@ namespace {
 #endif
 	}
 
+	storage_move_progress_alert::storage_move_progress_alert(aux::stack_allocator& alloc
+		, torrent_handle h, std::int64_t const copied, std::int64_t const total)
+		: torrent_alert(alloc, std::move(h))
+		, bytes_copied(copied)
+		, total_bytes(total)
+	{}
+
+	std::string storage_move_progress_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		char msg[200];
+		std::snprintf(msg, sizeof(msg), " moving storage: %" PRId64 " of %" PRId64 " bytes copied"
+			, bytes_copied, total_bytes);
+		return torrent_alert::message() + msg;
+#endif
+	}
+
+	outgoing_interface_stats_alert::outgoing_interface_stats_alert(aux::stack_allocator&
+		, std::vector<outgoing_interface_stats> ifs)
+		: interfaces(std::move(ifs))
+	{}
+
+	std::string outgoing_interface_stats_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		std::string ret = "outgoing interface stats:";
+		for (auto const& i : interfaces)
+		{
+			char buf[300];
+			std::snprintf(buf, sizeof(buf), " [%s weight: %d connections: %d (uTP: %d)"
+				" rate: %d B/s connect attempts: %d failures: %d]"
+				, i.device.c_str(), i.weight, i.num_connections, i.num_utp_connections
+				, i.rate, i.connect_attempts, i.connect_failures);
+			ret += buf;
+		}
+		return ret;
+#endif
+	}
+
 	// this will no longer be necessary in C++17
 	constexpr alert_category_t torrent_removed_alert::static_category;
 	constexpr alert_category_t read_piece_alert::static_category;
@@ -3204,6 +3248,8 @@ namespace {
 	constexpr alert_category_t file_prio_alert::static_category;
 	constexpr alert_category_t oversized_file_alert::static_category;
 	constexpr alert_category_t torrent_conflict_alert::static_category;
+	constexpr alert_category_t storage_move_progress_alert::static_category;
+	constexpr alert_category_t outgoing_interface_stats_alert::static_category;
 #if TORRENT_ABI_VERSION == 1
 	constexpr alert_category_t anonymous_mode_alert::static_category;
 	constexpr alert_category_t mmap_cache_alert::static_category;
@@ -0,0 +1,260 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/block_cache.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+
+#include <algorithm>
+#include <cstring>
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+	// the number of rows in the count-min sketch. Each row is indexed by a
+	// different hash of the block's location
+	int const sketch_depth = 4;
+
+	// counters saturate at this value, like 4-bit counters would
+	std::uint8_t const max_frequency = 15;
+
+	// the counters are halved once this many accesses (per counter in a
+	// row) have been recorded, to let the sketch adapt to changes in
+	// popularity
+	int const sample_factor = 10;
+
+	std::uint32_t sketch_index(std::size_t const hash, int const row
+		, std::uint32_t const mask)
+	{
+		// derive the row hashes from a single hash (double hashing)
+		std::uint64_t const h = hash;
+		std::uint32_t const h1 = std::uint32_t(h);
+		std::uint32_t const h2 = std::uint32_t(h >> 32) * 0x9e3779b9 | 1;
+		return (h1 + std::uint32_t(row) * h2) & mask;
+	}
+}
+
+	void block_cache::set_max_size(std::int64_t const bytes)
+	{
+		std::int64_t const shard_size = std::max(std::int64_t(0), bytes) / num_shards;
+		for (auto& s : m_shards)
+		{
+			std::lock_guard<std::mutex> l(s.mutex);
+			if (s.max_size == shard_size) continue;
+			s.max_size = shard_size;
+			while (s.size > s.max_size) s.evict_lru();
+			s.resize_sketch();
+		}
+		m_enabled = bytes >= num_shards * std::int64_t(default_block_size);
+	}
+
+	void block_cache::insert(torrent_location const loc, span<char const> const buf
+		, bool const count_access)
+	{
+		TORRENT_ASSERT(buf.size() > 0);
+		if (!m_enabled) return;
+
+		int const size = int(buf.size());
+		shard& s = shard_for(loc);
+		std::lock_guard<std::mutex> l(s.mutex);
+		if (count_access) s.record_access(loc);
+
+		auto const it = s.index.find(loc);
+		bool const replace = it != s.index.end();
+		if (replace)
+		{
+			// the block was written again (for instance after the piece failed
+			// the hash check). Replace the content
+			s.size -= it->second->size;
+			s.lru.erase(it->second);
+			s.index.erase(it);
+		}
+
+		if (s.max_size < size) return;
+
+		if (!replace)
+		{
+			// TinyLFU admission. Only evict blocks that are accessed less
+			// frequently than the new one
+			int const freq = s.frequency(loc);
+			while (s.size + size > s.max_size)
+			{
+				TORRENT_ASSERT(!s.lru.empty());
+				if (s.frequency(s.lru.back().loc) >= freq)
+				{
+					++s.rejections;
+					return;
+				}
+				s.evict_lru();
+			}
+		}
+
+		while (s.size + size > s.max_size) s.evict_lru();
+
+		s.lru.emplace_front(loc, size);
+		std::memcpy(s.lru.front().buf.get(), buf.data(), std::size_t(size));
+		s.index.emplace(loc, s.lru.begin());
+		s.size += size;
+	}
+
+	void block_cache::erase_piece(storage_index_t const storage
+		, piece_index_t const piece)
+	{
+		for (auto& s : m_shards)
+		{
+			std::lock_guard<std::mutex> l(s.mutex);
+			for (auto it = s.lru.begin(); it != s.lru.end();)
+			{
+				if (it->loc.torrent != storage || it->loc.piece != piece)
+				{
+					++it;
+					continue;
+				}
+				s.index.erase(it->loc);
+				s.size -= it->size;
+				it = s.lru.erase(it);
+			}
+		}
+	}
+
+	void block_cache::erase_storage(storage_index_t const storage)
+	{
+		for (auto& s : m_shards)
+		{
+			std::lock_guard<std::mutex> l(s.mutex);
+			for (auto it = s.lru.begin(); it != s.lru.end();)
+			{
+				if (it->loc.torrent != storage)
+				{
+					++it;
+					continue;
+				}
+				s.index.erase(it->loc);
+				s.size -= it->size;
+				it = s.lru.erase(it);
+			}
+		}
+	}
+
+	void block_cache::update_stats_counters(counters& c) const
+	{
+		std::int64_t size = 0;
+		std::int64_t evictions = 0;
+		std::int64_t rejections = 0;
+		for (auto const& s : m_shards)
+		{
+			std::lock_guard<std::mutex> l(s.mutex);
+			size += s.size;
+			evictions += s.evictions;
+			rejections += s.rejections;
+		}
+		c.set_value(counters::block_cache_hits, m_hits);
+		c.set_value(counters::block_cache_misses, m_misses);
+		c.set_value(counters::block_cache_evictions, evictions);
+		c.set_value(counters::block_cache_rejections, rejections);
+		c.set_value(counters::block_cache_bytes, size);
+	}
+
+	block_cache::shard& block_cache::shard_for(torrent_location const& loc)
+	{
+		// the low bits of the hash are used to index the sketch, use the high
+		// ones to pick the shard
+		std::size_t const h = std::hash<torrent_location>{}(loc);
+		return m_shards[(h >> 24) % num_shards];
+	}
+
+	void block_cache::shard::record_access(torrent_location const& loc)
+	{
+		if (sketch.empty()) return;
+		std::size_t const h = std::hash<torrent_location>{}(loc);
+		std::size_t const width = sketch_mask + 1;
+		for (int row = 0; row < sketch_depth; ++row)
+		{
+			std::uint8_t& c = sketch[std::size_t(row) * width + sketch_index(h, row, sketch_mask)];
+			if (c < max_frequency) ++c;
+		}
+
+		if (++additions < std::int64_t(width) * sample_factor) return;
+
+		for (auto& c : sketch) c /= 2;
+		additions /= 2;
+	}
+
+	int block_cache::shard::frequency(torrent_location const& loc) const
+	{
+		if (sketch.empty()) return 0;
+		std::size_t const h = std::hash<torrent_location>{}(loc);
+		std::size_t const width = sketch_mask + 1;
+		int ret = max_frequency;
+		for (int row = 0; row < sketch_depth; ++row)
+		{
+			ret = std::min(ret, int(sketch[std::size_t(row) * width
+				+ sketch_index(h, row, sketch_mask)]));
+		}
+		return ret;
+	}
+
+	void block_cache::shard::evict_lru()
+	{
+		TORRENT_ASSERT(!lru.empty());
+		entry const& e = lru.back();
+		index.erase(e.loc);
+		size -= e.size;
+		lru.pop_back();
+		++evictions;
+	}
+
+	void block_cache::shard::resize_sketch()
+	{
+		if (max_size == 0)
+		{
+			sketch.clear();
+			sketch.shrink_to_fit();
+			sketch_mask = 0;
+			additions = 0;
+			return;
+		}
+
+		// make room for twice as many counters per row as there are blocks
+		// in the shard, to keep the collisions down
+		std::int64_t const blocks = std::max(std::int64_t(1), max_size / default_block_size);
+		std::uint32_t width = 64;
+		while (width < blocks * 2 && width < 0x1000000) width *= 2;
+		if (width == sketch_mask + 1 && !sketch.empty()) return;
+
+		sketch.assign(std::size_t(width) * sketch_depth, 0);
+		sketch_mask = width - 1;
+		additions = 0;
+	}
+}
+}
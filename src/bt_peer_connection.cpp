@@ -1205,6 +1205,21 @@ namespace {
 
 		std::vector<sha256_hash> hashes = t->get_hashes(hr);
 
+		// the block hashes of pieces we have may have been dropped. In that
+		// case, hash the piece again. Since that reads a whole piece from
+		// disk, limit the number of outstanding ones
+		int const max_outstanding_hash_reads = 2;
+		if (hashes.empty()
+			&& m_outstanding_hash_reads < max_outstanding_hash_reads
+			&& t->async_get_block_hashes(hr
+				, [self = std::static_pointer_cast<bt_peer_connection>(self()), hr, file_root]
+				(std::vector<sha256_hash> h)
+				{ self->on_block_hashes(hr, file_root, std::move(h)); }))
+		{
+			++m_outstanding_hash_reads;
+			return;
+		}
+
 		if (hashes.empty())
 		{
 			write_hash_reject(hr, file_root);
@@ -1214,6 +1229,19 @@ namespace {
 		write_hashes(hr, hashes);
 	}
 
+	void bt_peer_connection::on_block_hashes(hash_request const& hr
+		, sha256_hash const& file_root, std::vector<sha256_hash> hashes)
+	{
+		TORRENT_ASSERT(m_outstanding_hash_reads > 0);
+		--m_outstanding_hash_reads;
+		if (is_disconnecting()) return;
+
+		if (hashes.empty())
+			write_hash_reject(hr, file_root);
+		else
+			write_hashes(hr, hashes);
+	}
+
 	void bt_peer_connection::on_hashes(int received)
 	{
 		INVARIANT_CHECK;
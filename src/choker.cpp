@@ -41,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/torrent.hpp"
 
 #include <functional>
+#include <algorithm>
+#include <utility>
 
 using namespace std::placeholders;
 
@@ -48,99 +50,7 @@ namespace libtorrent {
 
 namespace {
 
-	int compare_peers(peer_connection const* lhs, peer_connection const* rhs)
-	{
-		int const prio1 = lhs->get_priority(peer_connection::upload_channel);
-		int const prio2 = rhs->get_priority(peer_connection::upload_channel);
-
-		if (prio1 != prio2) return prio1 > prio2 ? 1 : -1;
-
-		// compare how many bytes they've sent us
-		std::int64_t const c1 = lhs->downloaded_in_last_round();
-		std::int64_t const c2 = rhs->downloaded_in_last_round();
-
-		if (c1 != c2) return c1 > c2 ? 1 : -1;
-		return 0;
-	}
-
-	// return true if 'lhs' peer should be preferred to be unchoke over 'rhs'
-	bool unchoke_compare_rr(peer_connection const* lhs
-		, peer_connection const* rhs, int pieces)
-	{
-		int const cmp = compare_peers(lhs, rhs);
-		if (cmp != 0) return cmp > 0;
-
-		// when seeding, rotate which peer is unchoked in a round-robin fasion
-
-		// the amount uploaded since unchoked (not just in the last round)
-		std::int64_t const u1 = lhs->uploaded_since_unchoked();
-		std::int64_t const u2 = rhs->uploaded_since_unchoked();
-
-		// the way the round-robin unchoker works is that it,
-		// by default, prioritizes any peer that is already unchoked.
-		// this maintain the status quo across unchoke rounds. However,
-		// peers that are unchoked, but have sent more than one quota
-		// since they were unchoked, they get de-prioritized.
-
-		std::shared_ptr<torrent> const t1 = lhs->associated_torrent().lock();
-		std::shared_ptr<torrent> const t2 = rhs->associated_torrent().lock();
-		TORRENT_ASSERT(t1);
-		TORRENT_ASSERT(t2);
-
-		// if a peer is already unchoked, the number of bytes sent since it was unchoked
-		// is greater than the send quanta, and it has been unchoked for at least one minute
-		// then it's done with its upload slot, and we can de-prioritize it
-		bool const c1_quota_complete = !lhs->is_choked()
-			&& u1 > std::int64_t(t1->torrent_file().piece_length()) * pieces
-			&& aux::time_now() - lhs->time_of_last_unchoke() > minutes(1);
-		bool const c2_quota_complete = !rhs->is_choked()
-			&& u2 > std::int64_t(t2->torrent_file().piece_length()) * pieces
-			&& aux::time_now() - rhs->time_of_last_unchoke() > minutes(1);
-
-		// if c2 has completed a quanta, it should be de-prioritized
-		// and vice versa
-		if (c1_quota_complete != c2_quota_complete)
-			return int(c1_quota_complete) < int(c2_quota_complete);
-
-		// when seeding, prefer the peer we're uploading the fastest to
-
-		// force the upload rate to zero for choked peers because
-		// if the peers just got choked the previous round
-		// there may have been a residual transfer which was already
-		// in-flight at the time and we don't want that to cause the peer
-		// to be ranked at the top of the choked peers
-		std::int64_t const c1 = lhs->is_choked() ? 0 : lhs->uploaded_in_last_round();
-		std::int64_t const c2 = rhs->is_choked() ? 0 : rhs->uploaded_in_last_round();
-
-		if (c1 != c2) return c1 > c2;
-
-		// if the peers are still identical (say, they're both waiting to be unchoked)
-		// prioritize the one that has waited the longest to be unchoked
-		// the round-robin unchoker relies on this logic. Don't change it
-		// without moving this into that unchoker logic
-		return lhs->time_of_last_unchoke() < rhs->time_of_last_unchoke();
-	}
-
-	// return true if 'lhs' peer should be preferred to be unchoke over 'rhs'
-	bool unchoke_compare_fastest_upload(peer_connection const* lhs
-		, peer_connection const* rhs)
-	{
-		int const cmp = compare_peers(lhs, rhs);
-		if (cmp != 0) return cmp > 0;
-
-		// when seeding, prefer the peer we're uploading the fastest to
-		std::int64_t const c1 = lhs->uploaded_in_last_round();
-		std::int64_t const c2 = rhs->uploaded_in_last_round();
-
-		if (c1 != c2) return c1 > c2;
-
-		// prioritize the one that has waited the longest to be unchoked
-		// the round-robin unchoker relies on this logic. Don't change it
-		// without moving this into that unchoker logic
-		return lhs->time_of_last_unchoke() < rhs->time_of_last_unchoke();
-	}
-
-	int anti_leech_score(peer_connection const* peer)
+	int anti_leech_score(peer_connection const* peer, torrent const& t)
 	{
 		// the anti-leech seeding algorithm is based on the paper "Improving
 		// BitTorrent: A Simple Approach" from Chow et. al. and ranks peers based
@@ -162,43 +72,117 @@ namespace {
 		//   |             V             |
 		//   +---------------------------+
 		//   0%    num have pieces     100%
-		std::shared_ptr<torrent> const t = peer->associated_torrent().lock();
-		TORRENT_ASSERT(t);
-
-		std::int64_t const total_size = t->torrent_file().total_size();
+		std::int64_t const total_size = t.torrent_file().total_size();
 		if (total_size == 0) return 0;
 		std::int64_t const have_size = std::max(peer->statistics().total_payload_upload()
-			, std::int64_t(t->torrent_file().piece_length()) * peer->num_have_pieces());
+			, std::int64_t(t.torrent_file().piece_length()) * peer->num_have_pieces());
 		return int(std::abs((have_size - total_size / 2) * 2000 / total_size));
 	}
 
-	// return true if 'lhs' peer should be preferred to be unchoke over 'rhs'
-	bool unchoke_compare_anti_leech(peer_connection const* lhs
-		, peer_connection const* rhs)
+	// the properties of a peer the unchoke order is based on. They're
+	// computed once per peer, up-front, rather than in every comparison,
+	// which would dereference the peer, its torrent and its stats each time
+	struct unchoke_key
 	{
-		int const cmp = compare_peers(lhs, rhs);
-		if (cmp != 0) return cmp > 0;
+		// the priority of the peer's upload channel, higher is better
+		int priority;
+
+		// how many bytes the peer sent us in the last round, higher is better
+		std::int64_t downloaded;
 
-		int const score1 = anti_leech_score(lhs);
-		int const score2 = anti_leech_score(rhs);
-		if (score1 != score2) return score1 > score2;
+		// round-robin only: true if the peer is done with its upload slot.
+		// Peers that aren't are preferred
+		bool quota_complete;
 
-		// prioritize the one that has waited the longest to be unchoked
-		// the round-robin unchoker relies on this logic. Don't change it
+		// depends on the seed choking algorithm: the upload rate to the peer
+		// (round-robin and fastest upload) or its anti-leech score. Higher is
+		// better
+		std::int64_t score;
+
+		// the peer that has waited the longest to be unchoked is preferred.
+		// The round-robin unchoker relies on this logic. Don't change it
 		// without moving this into that unchoker logic
-		return lhs->time_of_last_unchoke() < rhs->time_of_last_unchoke();
-	}
+		time_point last_unchoke;
+
+		peer_connection* peer;
+	};
 
-	bool upload_rate_compare(peer_connection const* lhs
-		, peer_connection const* rhs)
+	// return true if 'lhs' peer should be preferred to be unchoke over 'rhs'
+	bool unchoke_compare(unchoke_key const& lhs, unchoke_key const& rhs)
 	{
-		// take torrent priority into account
-		std::int64_t const c1 = lhs->uploaded_in_last_round()
-			* lhs->get_priority(peer_connection::upload_channel);
-		std::int64_t const c2 = rhs->uploaded_in_last_round()
-			* rhs->get_priority(peer_connection::upload_channel);
+		if (lhs.priority != rhs.priority) return lhs.priority > rhs.priority;
+
+		// compare how many bytes they've sent us
+		if (lhs.downloaded != rhs.downloaded) return lhs.downloaded > rhs.downloaded;
+
+		// if rhs has completed a quanta, it should be de-prioritized
+		// and vice versa
+		if (lhs.quota_complete != rhs.quota_complete)
+			return int(lhs.quota_complete) < int(rhs.quota_complete);
+
+		if (lhs.score != rhs.score) return lhs.score > rhs.score;
+
+		return lhs.last_unchoke < rhs.last_unchoke;
+	}
 
-		return c1 > c2;
+	unchoke_key make_key(peer_connection* p, int const algorithm, int const pieces
+		, time_point const now)
+	{
+		unchoke_key k;
+		k.priority = p->get_priority(peer_connection::upload_channel);
+		k.downloaded = p->downloaded_in_last_round();
+		k.quota_complete = false;
+		k.last_unchoke = p->time_of_last_unchoke();
+		k.peer = p;
+
+		switch (algorithm)
+		{
+			case settings_pack::fastest_upload:
+				// when seeding, prefer the peer we're uploading the fastest to
+				k.score = p->uploaded_in_last_round();
+				break;
+			case settings_pack::anti_leech:
+			{
+				std::shared_ptr<torrent> const t = p->associated_torrent().lock();
+				TORRENT_ASSERT(t);
+				k.score = anti_leech_score(p, *t);
+				break;
+			}
+			default:
+			{
+				TORRENT_ASSERT(algorithm == settings_pack::round_robin);
+
+				// the way the round-robin unchoker works is that it,
+				// by default, prioritizes any peer that is already unchoked.
+				// this maintain the status quo across unchoke rounds. However,
+				// peers that are unchoked, but have sent more than one quota
+				// since they were unchoked, they get de-prioritized.
+
+				// if a peer is already unchoked, the number of bytes sent since
+				// it was unchoked is greater than the send quanta, and it has
+				// been unchoked for at least one minute then it's done with its
+				// upload slot, and we can de-prioritize it
+				if (!p->is_choked())
+				{
+					std::shared_ptr<torrent> const t = p->associated_torrent().lock();
+					TORRENT_ASSERT(t);
+					k.quota_complete = p->uploaded_since_unchoked()
+							> std::int64_t(t->torrent_file().piece_length()) * pieces
+						&& now - p->time_of_last_unchoke() > minutes(1);
+				}
+
+				// when seeding, prefer the peer we're uploading the fastest to
+
+				// force the upload rate to zero for choked peers because
+				// if the peers just got choked the previous round
+				// there may have been a residual transfer which was already
+				// in-flight at the time and we don't want that to cause the peer
+				// to be ranked at the top of the choked peers
+				k.score = p->is_choked() ? 0 : p->uploaded_in_last_round();
+				break;
+			}
+		}
+		return k;
 	}
 
 	} // anonymous namespace
@@ -236,19 +220,35 @@ namespace {
 			// it purely based on the current state of our peers.
 			upload_slots = 0;
 
-			int rate_threshold = sett.get_int(settings_pack::rate_choker_initial_threshold);
-
-			std::sort(peers.begin(), peers.end()
-				, [](peer_connection const* lhs, peer_connection const* rhs)
-				{ return upload_rate_compare(lhs, rhs); });
+			int const initial_threshold = sett.get_int(settings_pack::rate_choker_initial_threshold);
+			std::int64_t const interval = std::max(std::int64_t(1)
+				, std::int64_t(total_milliseconds(unchoke_interval)));
 
+			// the peers are ordered by upload rate, taking torrent priority into
+			// account. The first peer below the initial threshold ends the
+			// traversal, so only the peers ordered ahead of it need sorting
+			std::vector<std::pair<std::int64_t, int>> rates;
+			std::int64_t end_key = -1;
 			for (auto const* p : peers)
 			{
-				int const rate = int(p->uploaded_in_last_round()
-					* 1000 / total_milliseconds(unchoke_interval));
-
+				int const rate = int(p->uploaded_in_last_round() * 1000 / interval);
+				std::int64_t const key = p->uploaded_in_last_round()
+					* p->get_priority(peer_connection::upload_channel);
+				if (rate < initial_threshold) end_key = std::max(end_key, key);
+				else rates.emplace_back(key, rate);
+			}
+			rates.erase(std::remove_if(rates.begin(), rates.end()
+				, [=](std::pair<std::int64_t, int> const& r) { return r.first <= end_key; })
+				, rates.end());
+			std::sort(rates.begin(), rates.end()
+				, [](std::pair<std::int64_t, int> const& lhs, std::pair<std::int64_t, int> const& rhs)
+				{ return lhs.first > rhs.first; });
+
+			int rate_threshold = initial_threshold;
+			for (auto const& r : rates)
+			{
 				// always have at least 1 unchoke slot
-				if (rate < rate_threshold) break;
+				if (r.second < rate_threshold) break;
 
 				++upload_slots;
 
@@ -268,42 +268,26 @@ namespace {
 
 		int const slots = std::min(upload_slots, int(peers.size()));
 
-		if (sett.get_int(settings_pack::seed_choking_algorithm)
-			== settings_pack::round_robin)
+		int algorithm = sett.get_int(settings_pack::seed_choking_algorithm);
+		if (algorithm != settings_pack::round_robin
+			&& algorithm != settings_pack::fastest_upload
+			&& algorithm != settings_pack::anti_leech)
 		{
-			int const pieces = sett.get_int(settings_pack::seeding_piece_quota);
-
-			std::nth_element(peers.begin(), peers.begin()
-				+ slots, peers.end()
-				, [pieces](peer_connection const* lhs, peer_connection const* rhs)
-				{ return unchoke_compare_rr(lhs, rhs, pieces); });
-		}
-		else if (sett.get_int(settings_pack::seed_choking_algorithm)
-			== settings_pack::fastest_upload)
-		{
-			std::nth_element(peers.begin(), peers.begin()
-				+ slots, peers.end()
-				, [](peer_connection const* lhs, peer_connection const* rhs)
-				{ return unchoke_compare_fastest_upload(lhs, rhs); });
-		}
-		else if (sett.get_int(settings_pack::seed_choking_algorithm)
-			== settings_pack::anti_leech)
-		{
-			std::nth_element(peers.begin(), peers.begin()
-				+ slots, peers.end()
-				, [](peer_connection const* lhs, peer_connection const* rhs)
-				{ return unchoke_compare_anti_leech(lhs, rhs); });
-		}
-		else
-		{
-			int const pieces = sett.get_int(settings_pack::seeding_piece_quota);
-			std::nth_element(peers.begin(), peers.begin()
-				+ slots, peers.end()
-				, [pieces](peer_connection const* lhs, peer_connection const* rhs)
-				{ return unchoke_compare_rr(lhs, rhs, pieces); } );
-
 			TORRENT_ASSERT_FAIL();
+			algorithm = settings_pack::round_robin;
 		}
+		int const pieces = sett.get_int(settings_pack::seeding_piece_quota);
+		time_point const now = aux::time_now();
+
+		std::vector<unchoke_key> keys;
+		keys.reserve(peers.size());
+		for (auto* p : peers)
+			keys.push_back(make_key(p, algorithm, pieces, now));
+
+		std::nth_element(keys.begin(), keys.begin() + slots, keys.end(), &unchoke_compare);
+
+		for (std::size_t i = 0; i < keys.size(); ++i)
+			peers[i] = keys[i].peer;
 
 		return upload_slots;
 	}
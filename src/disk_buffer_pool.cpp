@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/disk_observer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/aux_/open_mode.hpp" // for direct_io_alignment
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
@@ -50,6 +51,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <linux/unistd.h>
 #endif
 
+#ifdef TORRENT_WINDOWS
+#include <malloc.h> // for _aligned_malloc
+#else
+#include <cstdlib> // for posix_memalign
+#endif
+
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
 namespace libtorrent {
@@ -67,6 +74,28 @@ namespace {
 		}
 	}
 
+	// disk buffers are aligned to direct_io_alignment, to allow them to be
+	// passed straight to files opened with open_mode::direct_io
+	char* allocate_aligned(std::size_t const size)
+	{
+#ifdef TORRENT_WINDOWS
+		return static_cast<char*>(_aligned_malloc(size, direct_io_alignment));
+#else
+		void* ret = nullptr;
+		if (posix_memalign(&ret, direct_io_alignment, size) != 0) return nullptr;
+		return static_cast<char*>(ret);
+#endif
+	}
+
+	void free_aligned(char* buf)
+	{
+#ifdef TORRENT_WINDOWS
+		_aligned_free(buf);
+#else
+		std::free(buf);
+#endif
+	}
+
 } // anonymous namespace
 
 	disk_buffer_pool::disk_buffer_pool(io_context& ios)
@@ -136,7 +165,7 @@ namespace {
 		TORRENT_ASSERT(l.owns_lock());
 		TORRENT_UNUSED(l);
 
-		char* ret = static_cast<char*>(std::malloc(default_block_size));
+		char* ret = allocate_aligned(default_block_size);
 
 		if (ret == nullptr)
 		{
@@ -226,7 +255,7 @@ namespace {
 		TORRENT_ASSERT(l.owns_lock());
 		TORRENT_UNUSED(l);
 
-		std::free(buf);
+		free_aligned(buf);
 
 		--m_in_use;
 	}
@@ -0,0 +1,130 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/disk_job_queue.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+	job_priority_t priority_for_job(mmap_disk_job const& j)
+	{
+		switch (j.action)
+		{
+			case job_action_t::read:
+			case job_action_t::partial_read:
+				return j.time_critical
+					? job_priority_t::time_critical : job_priority_t::read;
+			case job_action_t::hash:
+			case job_action_t::hash2:
+				return j.time_critical
+					? job_priority_t::time_critical : job_priority_t::hash;
+			case job_action_t::check_fastresume:
+				return job_priority_t::hash;
+			case job_action_t::write:
+			case job_action_t::move_storage:
+			case job_action_t::release_files:
+			case job_action_t::delete_files:
+			case job_action_t::rename_file:
+			case job_action_t::stop_torrent:
+			case job_action_t::file_priority:
+			case job_action_t::clear_piece:
+			case job_action_t::num_job_ids:
+				break;
+		}
+		return job_priority_t::write;
+	}
+
+	disk_job_queue::iterator::iterator(disk_job_queue& q, int const prio)
+		: m_queue(q)
+		, m_priority(prio)
+		, m_it(q.m_queues[std::size_t(prio)].iterate())
+	{
+		if (m_it.get() == nullptr) next();
+	}
+
+	void disk_job_queue::iterator::next()
+	{
+		if (m_it.get() != nullptr) m_it.next();
+		while (m_it.get() == nullptr && m_priority < num_priorities - 1)
+		{
+			++m_priority;
+			m_it = m_queue.m_queues[std::size_t(m_priority)].iterate();
+		}
+	}
+
+	void disk_job_queue::push_back(mmap_disk_job* j)
+	{
+		j->queued_time = clock_type::now();
+		m_queues[std::size_t(priority_for_job(*j))].push_back(j);
+		++m_size;
+	}
+
+	void disk_job_queue::append(tailqueue<mmap_disk_job> jobs)
+	{
+		while (!jobs.empty()) push_back(jobs.pop_front());
+	}
+
+	mmap_disk_job* disk_job_queue::pop_front(time_duration const aging_limit)
+	{
+		TORRENT_ASSERT(m_size > 0);
+		time_point const now = clock_type::now();
+
+		// the highest priority class with any jobs
+		int prio = 0;
+		while (m_queues[std::size_t(prio)].empty()) ++prio;
+		TORRENT_ASSERT(prio < num_priorities);
+
+		// if the first job of any class has been waiting for too long, pick the
+		// one that has been waiting the longest
+		int oldest = prio;
+		for (int i = prio + 1; i < num_priorities; ++i)
+		{
+			auto const& q = m_queues[std::size_t(i)];
+			if (q.empty()) continue;
+			if (q.first()->queued_time < m_queues[std::size_t(oldest)].first()->queued_time)
+				oldest = i;
+		}
+		if (oldest != prio
+			&& now - m_queues[std::size_t(oldest)].first()->queued_time >= aging_limit)
+		{
+			prio = oldest;
+			++m_aged;
+		}
+
+		mmap_disk_job* j = m_queues[std::size_t(prio)].pop_front();
+		--m_size;
+		++m_popped[std::size_t(prio)];
+		m_queue_time[std::size_t(prio)] += total_microseconds(now - j->queued_time);
+		return j;
+	}
+}
+}
@@ -155,6 +155,31 @@ namespace aux {
 
 		return int(bytes_written);
 	}
+
+	void punch_hole(handle_type const fd, std::int64_t const offset
+		, std::int64_t const len)
+	{
+		// this only deallocates the range if the file is sparse. Otherwise it
+		// writes zeros, which is just I/O without saving any space
+		BY_HANDLE_FILE_INFORMATION info;
+		if (GetFileInformationByHandle(fd, &info) == FALSE
+			|| (info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) == 0)
+			return;
+
+		FILE_ZERO_DATA_INFORMATION zero;
+		zero.FileOffset.QuadPart = offset;
+		zero.BeyondFinalZero.QuadPart = offset + len;
+		DWORD temp;
+		::DeviceIoControl(fd, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero)
+			, nullptr, 0, &temp, nullptr);
+	}
+
+	std::int64_t clone_range(handle_type, std::int64_t, handle_type
+		, std::int64_t, std::int64_t, error_code& ec)
+	{
+		ec = boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
+		return 0;
+	}
 #else
 
 	int pread_all(handle_type const handle
@@ -206,6 +231,70 @@ namespace aux {
 		} while (buf.size() > 0);
 		return ret;
 	}
+
+	void punch_hole(handle_type const handle, std::int64_t const offset
+		, std::int64_t const len)
+	{
+#if defined FALLOC_FL_PUNCH_HOLE && defined FALLOC_FL_KEEP_SIZE
+		::fallocate(handle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len);
+#elif defined F_PUNCHHOLE
+		// the range must be aligned to the file system block size. Only
+		// deallocate the blocks entirely within the range
+		struct stat st;
+		if (::fstat(handle, &st) != 0 || st.st_blksize <= 0) return;
+		std::int64_t const block = st.st_blksize;
+		std::int64_t const start = (offset + block - 1) / block * block;
+		std::int64_t const end = (offset + len) / block * block;
+		if (end <= start) return;
+		fpunchhole_t hole{};
+		hole.fp_offset = start;
+		hole.fp_length = end - start;
+		::fcntl(handle, F_PUNCHHOLE, &hole);
+#else
+		TORRENT_UNUSED(handle);
+		TORRENT_UNUSED(offset);
+		TORRENT_UNUSED(len);
+#endif
+	}
+
+	std::int64_t clone_range(handle_type const in, std::int64_t const in_offset
+		, handle_type const out, std::int64_t const out_offset
+		, std::int64_t const len, error_code& ec)
+	{
+#if TORRENT_HAS_COPY_FILE_RANGE
+		off_t in_pos = off_t(in_offset);
+		off_t out_pos = off_t(out_offset);
+		std::int64_t copied = 0;
+		while (copied < len)
+		{
+			auto const r = ::copy_file_range(in, &in_pos, out, &out_pos
+				, std::size_t(len - copied), 0);
+			if (r == 0) break;
+			if (r < 0)
+			{
+				int const err = errno;
+				// these are the errors for file systems (or combinations of
+				// them) that don't support copying within the kernel
+				if (copied == 0 && (err == EXDEV || err == EINVAL
+					|| err == ENOSYS || err == EOPNOTSUPP))
+					ec = boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
+				else
+					ec = error_code(err, system_category());
+				return copied;
+			}
+			copied += r;
+		}
+		return copied;
+#else
+		TORRENT_UNUSED(in);
+		TORRENT_UNUSED(in_offset);
+		TORRENT_UNUSED(out);
+		TORRENT_UNUSED(out_offset);
+		TORRENT_UNUSED(len);
+		ec = boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
+		return 0;
+#endif
+	}
 #endif
 
 namespace {
@@ -390,6 +479,9 @@ typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
 #endif
 #ifdef O_SYNC
 			| ((mode & open_mode::no_cache) ? O_SYNC : 0)
+#endif
+#ifdef O_DIRECT
+			| ((mode & open_mode::direct_io) ? O_DIRECT : 0)
 #endif
 			;
 	}
@@ -420,6 +512,14 @@ typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
 			ret = ::open(filename.c_str()
 				, file_flags(mode & ~open_mode::no_atime), file_perms(mode));
 		}
+#endif
+#ifdef O_DIRECT
+		if (ret < 0 && errno == EINVAL && (mode & open_mode::direct_io))
+		{
+			// some file systems (like tmpfs) don't support O_DIRECT. It's
+			// best-effort, so fall back to using the page cache
+			return open_file(filename, mode & ~open_mode::direct_io);
+		}
 #endif
 		if (ret < 0) throw_ex<storage_error>(error_code(errno, system_category()), operation_t::file_open);
 		return ret;
@@ -617,6 +717,16 @@ file_handle& file_handle::operator=(file_handle&& rhs) &
 	return *this;
 }
 
+bool file_handle::direct_io() const
+{
+#if !defined TORRENT_WINDOWS && defined O_DIRECT
+	int const flags = ::fcntl(m_fd, F_GETFL);
+	return flags != -1 && (flags & O_DIRECT);
+#else
+	return false;
+#endif
+}
+
 std::int64_t file_handle::get_size() const
 {
 #ifdef  TORRENT_WINDOWS
@@ -45,11 +45,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/disk_interface.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/aux_/throw.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/performance_counters.hpp"
 #ifdef TORRENT_WINDOWS
 #include "libtorrent/aux_/win_util.hpp"
 #endif
 
 #include <limits>
+#include <algorithm>
 
 #if TRACE_FILE_VIEW_POOL
 #include <iostream>
@@ -61,6 +64,36 @@ using namespace libtorrent::flags;
 
 namespace libtorrent { namespace aux {
 
+namespace {
+
+	// ranges of dirty pages separated by less than this are flushed by a
+	// single call. The kernel skips clean pages in the gap between them
+	std::int64_t const write_back_max_gap = 1024 * 1024;
+
+	// inserts the range [start, end) into ``ranges``, merging it with all
+	// ranges it overlaps or abuts. Returns the number of bytes that were not
+	// already covered by ``ranges``
+	std::int64_t add_range(std::map<std::int64_t, std::int64_t>& ranges
+		, std::int64_t const start, std::int64_t const end)
+	{
+		std::int64_t added = end - start;
+		std::int64_t merged_start = start;
+		std::int64_t merged_end = end;
+		auto it = ranges.upper_bound(start);
+		if (it != ranges.begin() && std::prev(it)->second >= start) --it;
+		while (it != ranges.end() && it->first <= end)
+		{
+			added -= std::max(std::int64_t(0)
+				, std::min(it->second, end) - std::max(it->first, start));
+			merged_start = std::min(merged_start, it->first);
+			merged_end = std::max(merged_end, it->second);
+			it = ranges.erase(it);
+		}
+		ranges.emplace_hint(it, merged_start, merged_end);
+		return added;
+	}
+}
+
 	file_view_pool::file_view_pool(int size) : m_size(size) {}
 	file_view_pool::~file_view_pool() = default;
 
@@ -131,21 +164,29 @@ namespace libtorrent { namespace aux {
 		if (i != key_view.end()
 			&& (!(m & open_mode::write) || (i->mode & open_mode::write)))
 		{
+			// with the two_queue policy, files in the cold segment are evicted
+			// in the order they were opened, regardless of how many times
+			// they're used in the meantime. Only files that are re-opened after
+			// having been evicted are considered hot
+			bool const update_sequence = i->hot
+				|| m_eviction_policy != settings_pack::two_queue_eviction;
 			key_view.modify(i, [&](file_entry& e)
 			{
 				e.last_use = aux::time_now();
+				++e.hits;
+				if (update_sequence) e.sequence = m_sequence++;
 			});
-
-			auto& lru_view = m_files.get<1>();
-			lru_view.relocate(m_files.project<1>(i), lru_view.begin());
+			++m_hits;
 
 			return i->mapping->view();
 		}
 
+		++m_misses;
+
 		if (int(m_files.size()) >= m_size - 1)
 		{
 			// the file cache is at its maximum size, close
-			// the least recently used file
+			// the file picked by the eviction policy
 			defer_destruction1 = remove_oldest(l);
 		}
 
@@ -187,9 +228,28 @@ namespace libtorrent { namespace aux {
 			// insertion failed.
 			// if the insertion failed, check to see if we can use the existing
 			// entry. If not, overwrite it with the newly opened file ``e``.
+			e.sequence = m_sequence++;
+			if (m_eviction_policy == settings_pack::two_queue_eviction)
+			{
+				auto const ghost = m_ghost_files.find(file_key);
+				if (ghost != m_ghost_files.end())
+				{
+					// this file was evicted recently and is now needed again. It
+					// belongs in the hot segment. Its entry in m_ghost_order
+					// is left behind, as a stale entry
+					m_ghost_files.erase(ghost);
+					e.hot = true;
+				}
+			}
+
 			bool added;
 			std::tie(i, added) = key_view.insert(e);
-			if (added == false)
+			if (added)
+			{
+				m_mapped_bytes += i->mapping->size();
+				if (i->hot) ++m_num_hot;
+			}
+			else
 			{
 				// this is the case where this file was already in the pool. Make
 				// sure we can use it. If we asked for write mode, it must have been
@@ -198,18 +258,43 @@ namespace libtorrent { namespace aux {
 
 				if ((m & open_mode::write) && !(i->mode & open_mode::write))
 				{
+					m_mapped_bytes += e.mapping->size() - i->mapping->size();
+					m_dirty_bytes -= std::int64_t(i->dirty_bytes);
+					if (i->hot) --m_num_hot;
+					if (e.hot) ++m_num_hot;
 					key_view.modify(i, [&](file_entry& fe)
 					{
 						defer_destruction2 = std::move(fe.mapping);
 						fe = std::move(e);
 					});
 				}
+				else
+				{
+					key_view.modify(i, [&](file_entry& fe)
+					{
+						fe.sequence = m_sequence++;
+					});
+				}
+			}
 
-				auto& lru_view = m_files.get<1>();
-				lru_view.relocate(m_files.project<1>(i), lru_view.begin());
+			// if we're over the budget of mapped bytes, close files until we're
+			// not. Never close the file we just opened though
+			std::vector<std::shared_ptr<file_mapping>> over_budget;
+			while (m_mapped_limit > 0
+				&& m_mapped_bytes > m_mapped_limit
+				&& m_files.size() > 1)
+			{
+				if (eviction_candidate()->key == file_key) break;
+				over_budget.emplace_back(remove_oldest(l));
 			}
+
 			notify_file_open(ofe, i->mapping, storage_error());
-			return i->mapping->view();
+			file_view ret = i->mapping->view();
+
+			// close the files without holding the mutex
+			l.unlock();
+			over_budget.clear();
+			return ret;
 		}
 		catch (storage_error const& se)
 		{
@@ -290,18 +375,122 @@ namespace libtorrent { namespace aux {
 		return ret;
 	}
 
+	std::vector<file_view_pool::file_stats> file_view_pool::get_file_stats(
+		storage_index_t const st) const
+	{
+		std::vector<file_stats> ret;
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+
+			auto& key_view = m_files.get<0>();
+			auto const start = key_view.lower_bound(file_id{st, file_index_t(0)});
+			auto const end = key_view.upper_bound(file_id{st, std::numeric_limits<file_index_t>::max()});
+
+			for (auto i = start; i != end; ++i)
+			{
+				ret.push_back({i->key.second
+					, i->mapping->size()
+					, std::int64_t(i->dirty_bytes)
+					, i->hits});
+			}
+		}
+		return ret;
+	}
+
+	void file_view_pool::update_stats_counters(counters& c) const
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		c.set_value(counters::file_pool_hits, m_hits);
+		c.set_value(counters::file_pool_misses, m_misses);
+		c.set_value(counters::file_pool_evictions, m_evictions);
+		c.set_value(counters::num_open_files, std::int64_t(m_files.size()));
+		c.set_value(counters::num_hot_open_files, m_num_hot);
+		c.set_value(counters::file_pool_mapped_bytes, m_mapped_bytes);
+		c.set_value(counters::file_pool_dirty_bytes, m_dirty_bytes);
+	}
+
+	void file_view_pool::set_eviction_policy(int const policy)
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		if (policy == m_eviction_policy) return;
+		m_eviction_policy = policy;
+
+		// all files start out in the cold segment with the new policy, to keep
+		// the LRU order intact
+		auto& key_view = m_files.get<0>();
+		for (auto i = key_view.begin(); i != key_view.end(); ++i)
+			key_view.modify(i, [](file_entry& e) { e.hot = false; });
+		m_num_hot = 0;
+		m_ghost_files.clear();
+		m_ghost_order.clear();
+	}
+
+	void file_view_pool::set_mapped_limit(std::int64_t const bytes)
+	{
+		std::vector<std::shared_ptr<file_mapping>> defer_destruction;
+
+		std::unique_lock<std::mutex> l(m_mutex);
+		m_mapped_limit = bytes;
+		while (m_mapped_limit > 0 && m_mapped_bytes > m_mapped_limit && !m_files.empty())
+			defer_destruction.emplace_back(remove_oldest(l));
+	}
+
+	file_view_pool::evict_iterator file_view_pool::eviction_candidate()
+	{
+		auto& evict_view = m_files.get<1>();
+		TORRENT_ASSERT(!evict_view.empty());
+
+		// the eviction index orders cold files first, in the order they were
+		// used. For the LRU policy all files are cold
+		if (m_eviction_policy == settings_pack::two_queue_eviction && m_num_hot > 0)
+		{
+			// the cold (probation) segment is allowed a quarter of the pool.
+			// If it's smaller than that, evict the least recently used hot file
+			// instead
+			int const num_cold = int(m_files.size()) - m_num_hot;
+			if (num_cold <= m_size / 4)
+				return evict_view.lower_bound(boost::make_tuple(true));
+		}
+		return evict_view.begin();
+	}
+
 	std::shared_ptr<file_mapping> file_view_pool::remove_oldest(std::unique_lock<std::mutex>&)
 	{
-		auto& lru_view = m_files.get<1>();
-		if (lru_view.size() == 0) return {};
+		auto& evict_view = m_files.get<1>();
+		if (evict_view.size() == 0) return {};
+
+		auto const victim = eviction_candidate();
+		bool const two_queue = m_eviction_policy == settings_pack::two_queue_eviction;
 
 #if TRACE_FILE_VIEW_POOL
 		std::cout << std::this_thread::get_id() << " removing: ("
-			<< lru_view.back().key.first << ", " << lru_view.back().key.second << ")\n";
+			<< victim->key.first << ", " << victim->key.second << ")\n";
 #endif
 
-		auto mapping = std::move(lru_view.back().mapping);
-		lru_view.pop_back();
+		if (two_queue && !victim->hot)
+		{
+			// remember that we evicted this file. If it's opened again soon, it
+			// goes straight into the hot segment
+			m_ghost_files[victim->key] = victim->sequence;
+			m_ghost_order.emplace_back(victim->key, victim->sequence);
+			std::size_t const max_ghosts = std::size_t(std::max(m_size / 2, 1));
+			while (m_ghost_order.size() > max_ghosts)
+			{
+				auto const& front = m_ghost_order.front();
+				auto const it = m_ghost_files.find(front.first);
+				if (it != m_ghost_files.end() && it->second == front.second)
+					m_ghost_files.erase(it);
+				m_ghost_order.pop_front();
+			}
+		}
+
+		if (victim->hot) --m_num_hot;
+		m_mapped_bytes -= victim->mapping->size();
+		m_dirty_bytes -= std::int64_t(victim->dirty_bytes);
+		++m_evictions;
+
+		auto mapping = std::move(victim->mapping);
+		evict_view.erase(victim);
 
 		// closing a file may be long running operation (mac os x)
 		// let the caller destruct it once it has released the mutex
@@ -316,6 +505,9 @@ namespace libtorrent { namespace aux {
 		auto const i = key_view.find(file_id{st, file_index});
 		if (i == key_view.end()) return;
 
+		if (i->hot) --m_num_hot;
+		m_mapped_bytes -= i->mapping->size();
+		m_dirty_bytes -= std::int64_t(i->dirty_bytes);
 		auto mapping = std::move(i->mapping);
 		key_view.erase(i);
 
@@ -331,6 +523,9 @@ namespace libtorrent { namespace aux {
 		std::unique_lock<std::mutex> l(m_mutex);
 		std::unique_lock<std::mutex> l2(m_destruction_mutex);
 		m_deferred_destruction = std::move(m_files);
+		m_num_hot = 0;
+		m_mapped_bytes = 0;
+		m_dirty_bytes = 0;
 		l.unlock();
 
 		// the files and mappings will be destructed here, not holding the main
@@ -349,7 +544,12 @@ namespace libtorrent { namespace aux {
 		auto const end = key_view.upper_bound(file_id{st, std::numeric_limits<file_index_t>::max()});
 
 		for (auto it = begin; it != end; ++it)
+		{
+			if (it->hot) --m_num_hot;
+			m_mapped_bytes -= it->mapping->size();
+			m_dirty_bytes -= std::int64_t(it->dirty_bytes);
 			defer_destruction.emplace_back(std::move(it->mapping));
+		}
 
 		if (begin != end) key_view.erase(begin, end);
 		l.unlock();
@@ -369,7 +569,7 @@ namespace libtorrent { namespace aux {
 		m_size = size;
 		if (int(m_files.size()) <= m_size) return;
 
-		// close the least recently used files
+		// close files until we're within the new limit
 		while (int(m_files.size()) > m_size)
 			defer_destruction.emplace_back(remove_oldest(l));
 	}
@@ -396,23 +596,111 @@ namespace libtorrent { namespace aux {
 			auto it = std::prev(flush_view.end());
 			if (it->dirty_bytes == 0) return;
 			mapping = it->mapping;
-			flush_view.modify(it, [](file_entry& e) { e.dirty_bytes = 0; });
+			m_dirty_bytes -= std::int64_t(it->dirty_bytes);
+			flush_view.modify(it, [](file_entry& e)
+			{
+				e.dirty_bytes = 0;
+				e.dirty_ranges.clear();
+			});
 		}
 
 		// we invoke flush after we release the mutex
 		mapping->flush();
 	}
+#endif
 
 	void file_view_pool::record_file_write(storage_index_t const st
-		, file_index_t const file_index, uint64_t const bytes)
+		, file_index_t const file_index, std::int64_t const offset
+		, std::uint64_t const bytes)
 	{
 		std::unique_lock<std::mutex> l(m_mutex);
 		auto& key_view = m_files.get<0>();
 		auto i = key_view.find(file_id{st, file_index});
 		if (i == key_view.end()) return;
-		key_view.modify(i, [bytes](file_entry& e) { e.dirty_bytes += bytes; });
+		std::uint64_t added = bytes;
+		bool const track = m_track_dirty_ranges;
+		key_view.modify(i, [&](file_entry& e)
+		{
+			if (track)
+			{
+				added = std::uint64_t(add_range(e.dirty_ranges, offset
+					, offset + std::int64_t(bytes)));
+			}
+			e.dirty_bytes += added;
+		});
+		m_dirty_bytes += std::int64_t(added);
+	}
+
+	void file_view_pool::track_dirty_ranges(bool const enable)
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		if (m_track_dirty_ranges == enable) return;
+		m_track_dirty_ranges = enable;
+		if (enable) return;
+
+		auto& key_view = m_files.get<0>();
+		for (auto i = key_view.begin(); i != key_view.end(); ++i)
+			key_view.modify(i, [](file_entry& e) { e.dirty_ranges.clear(); });
+	}
+
+	std::int64_t file_view_pool::dirty_bytes() const
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		return m_dirty_bytes;
+	}
+
+	file_view_pool::flush_result file_view_pool::flush_dirty(std::int64_t const bytes
+		, bool const wait)
+	{
+		flush_result ret;
+
+		// the files to flush, along with their dirty ranges
+		std::vector<std::pair<std::shared_ptr<file_mapping>
+			, std::map<std::int64_t, std::int64_t>>> files;
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			auto& flush_view = m_files.get<2>();
+			while (ret.bytes < bytes && !flush_view.empty())
+			{
+				auto it = std::prev(flush_view.end());
+				if (it->dirty_bytes == 0) break;
+				ret.bytes += std::int64_t(it->dirty_bytes);
+				m_dirty_bytes -= std::int64_t(it->dirty_bytes);
+				files.emplace_back(it->mapping, std::map<std::int64_t, std::int64_t>{});
+				auto& ranges = files.back().second;
+				flush_view.modify(it, [&ranges](file_entry& e)
+				{
+					e.dirty_bytes = 0;
+					e.dirty_ranges.swap(ranges);
+				});
+			}
+		}
+
+		// we flush the files after releasing the mutex
+		for (auto& f : files)
+		{
+			file_mapping& mapping = *f.first;
+			if (f.second.empty())
+			{
+				// we don't know which parts of the file are dirty
+				mapping.write_back(0, mapping.size(), wait);
+				++ret.operations;
+				continue;
+			}
+
+			auto it = f.second.begin();
+			while (it != f.second.end())
+			{
+				std::int64_t const start = it->first;
+				std::int64_t end = it->second;
+				for (++it; it != f.second.end() && it->first - end < write_back_max_gap; ++it)
+					end = it->second;
+				mapping.write_back(start, end - start, wait);
+				++ret.operations;
+			}
+		}
+		return ret;
 	}
-#endif
 }
 }
 
@@ -102,6 +102,7 @@ bool validate_hash_request(hash_request const& hr, file_storage const& fs)
 		m_piece_hash_requested.resize(trees.size());
 		for (file_index_t f(0); f != m_files.end_file(); ++f)
 		{
+			m_tree_memory += m_merkle_trees[f].memory_usage();
 			if (m_files.pad_file_at(f)) continue;
 
 			auto const& tree = m_merkle_trees[f];
@@ -274,7 +275,9 @@ bool validate_hash_request(hash_request const& hr, file_storage const& fs)
 		auto& dst_tree = m_merkle_trees[req.file];
 		int const dest_start_idx = merkle_to_flat_index(base_layer_idx, req.index);
 		auto const file_piece_offset = m_files.piece_index_at_file(req.file) - piece_index_t{0};
+		auto const tree_memory = dst_tree.memory_usage();
 		auto results = dst_tree.add_hashes(dest_start_idx, file_piece_offset, hashes, uncle_hashes);
+		m_tree_memory += dst_tree.memory_usage() - tree_memory;
 
 		if (!results)
 			return add_hashes_result(false);
@@ -287,8 +290,15 @@ bool validate_hash_request(hash_request const& hr, file_storage const& fs)
 
 	set_block_hash_result hash_picker::set_block_hash(piece_index_t const piece
 		, int const offset, sha256_hash const& h)
+	{
+		return set_block_hashes(piece, offset, {&h, 1});
+	}
+
+	set_block_hash_result hash_picker::set_block_hashes(piece_index_t const piece
+		, int const offset, span<sha256_hash const> const h)
 	{
 		TORRENT_ASSERT(offset >= 0);
+		TORRENT_ASSERT(!h.empty());
 		auto const f = m_files.file_index_at_piece(piece);
 
 		if (m_files.pad_file_at(f))
@@ -302,7 +312,7 @@ bool validate_hash_request(hash_request const& hr, file_storage const& fs)
 			+ offset - m_files.file_offset(f);
 		int const block_index = aux::numeric_cast<int>(block_offset / default_block_size);
 
-		if (h.is_all_zeros())
+		if (std::any_of(h.begin(), h.end(), [](sha256_hash const& b) { return b.is_all_zeros(); }))
 		{
 			TORRENT_ASSERT_FAIL();
 			return set_block_hash_result::block_hash_failed();
@@ -312,7 +322,9 @@ bool validate_hash_request(hash_request const& hr, file_storage const& fs)
 		aux::merkle_tree::set_block_result result;
 		int leafs_index;
 		int leafs_size;
+		auto const tree_memory = merkle_tree.memory_usage();
 		std::tie(result, leafs_index, leafs_size) = merkle_tree.set_block(block_index, h);
+		m_tree_memory += merkle_tree.memory_usage() - tree_memory;
 
 		if (result == aux::merkle_tree::set_block_result::unknown)
 			return set_block_hash_result::unknown();
@@ -44,12 +44,51 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/assert.hpp"
 #include "libtorrent/parse_url.hpp" // for parse_url_components
 #include "libtorrent/string_util.hpp" // for ensure_trailing_slash, to_lower
-#include "libtorrent/aux_/escape_string.hpp" // for read_until
 #include "libtorrent/time.hpp" // for seconds32
 #include "libtorrent/aux_/numeric_cast.hpp"
 
 namespace libtorrent {
 
+namespace {
+
+	// returns a pointer to the first LF in the range, or end if there is
+	// none. memchr() is vectorized by the C library, which scans long header
+	// blocks several times faster than a byte-by-byte loop
+	char const* find_newline(char const* pos, char const* end)
+	{
+		if (pos == end) return end;
+		auto const* ret = static_cast<char const*>(
+			std::memchr(pos, '\n', std::size_t(end - pos)));
+		return ret == nullptr ? end : ret;
+	}
+
+	// returns the string up to the next delim (or end) and advances str past
+	// it and any repeated delimiters
+	string_view next_token(char const*& str, char const delim, char const* end)
+	{
+		TORRENT_ASSERT(str <= end);
+		char const* const start = str;
+		while (str != end && *str != delim) ++str;
+		string_view const ret(start, std::size_t(str - start));
+		while (str != end && *str == delim) ++str;
+		return ret;
+	}
+
+	// splits a header line into its name and value. Returns false if the
+	// line isn't a header (i.e. it has no colon)
+	bool split_header(string_view const line, string_view& name, string_view& value)
+	{
+		auto const separator = line.find(':');
+		if (separator == string_view::npos) return false;
+		name = line.substr(0, separator);
+		value = line.substr(separator + 1);
+		// skip whitespace
+		while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+			value.remove_prefix(1);
+		return true;
+	}
+}
+
 	bool is_ok_status(int http_status)
 	{
 		return http_status == 206 // partial content
@@ -137,32 +176,31 @@ namespace libtorrent {
 	std::string const& http_parser::header(string_view const key) const
 	{
 		static std::string const empty;
-		// at least GCC-5.4 for ARM (on travis) has a libstdc++ whose debug map$
-		// doesn't seem to support transparent comparators$
-#if ! defined _GLIBCXX_DEBUG
-		auto const i = m_header.find(key);
-#else
-		auto const i = m_header.find(std::string(key));
-#endif
-		if (i == m_header.end()) return empty;
-		return i->second;
+		for (auto const& h : headers())
+			if (h.first == key) return h.second;
+		return empty;
 	}
 
 	boost::optional<seconds32> http_parser::header_duration(string_view const key) const
 	{
-		// at least GCC-5.4 for ARM (on travis) has a libstdc++ whose debug map$
-		// doesn't seem to support transparent comparators$
-#if ! defined _GLIBCXX_DEBUG
-		auto const i = m_header.find(key);
-#else
-		auto const i = m_header.find(std::string(key));
-#endif
-		if (i == m_header.end()) return boost::none;
-		auto const val = std::atol(i->second.c_str());
+		std::string const& value = header(key);
+		if (value.empty()) return boost::none;
+		auto const val = std::atol(value.c_str());
 		if (val <= 0) return boost::none;
 		return seconds32(val);
 	}
 
+	std::pair<std::string, std::string> const& http_parser::add_header(
+		string_view const name, string_view const value)
+	{
+		if (m_num_headers == int(m_header.size())) m_header.emplace_back();
+		auto& h = m_header[std::size_t(m_num_headers++)];
+		h.first.assign(name.data(), name.size());
+		std::transform(h.first.begin(), h.first.end(), h.first.begin(), &to_lower);
+		h.second.assign(value.data(), value.size());
+		return h;
+	}
+
 	http_parser::~http_parser() = default;
 
 	http_parser::http_parser(int const flags) : m_flags(flags) {}
@@ -192,7 +230,7 @@ restart_response:
 		{
 			TORRENT_ASSERT(!m_finished);
 			TORRENT_ASSERT(pos <= recv_buffer.end());
-			char const* newline = std::find(pos, recv_buffer.end(), '\n');
+			char const* newline = find_newline(pos, recv_buffer.end());
 			// if we don't have a full line yet, wait.
 			if (newline == recv_buffer.end())
 			{
@@ -218,11 +256,19 @@ restart_response:
 			std::get<1>(ret) += int(newline - (m_recv_buffer.data() + start_pos));
 			pos = newline;
 
-			m_protocol = read_until(line, ' ', line_end);
-			if (m_protocol.substr(0, 5) == "HTTP/")
+			string_view const protocol = next_token(line, ' ', line_end);
+			if (protocol.substr(0, 5) == "HTTP/")
 			{
-				m_status_code = atoi(read_until(line, ' ', line_end).c_str());
-				m_server_message = read_until(line, '\r', line_end);
+				m_protocol.assign(protocol.data(), protocol.size());
+				string_view const status = next_token(line, ' ', line_end);
+				m_status_code = 0;
+				for (char const c : status)
+				{
+					if (!is_digit(c) || m_status_code >= 100000) break;
+					m_status_code = m_status_code * 10 + (c - '0');
+				}
+				string_view const message = next_token(line, '\r', line_end);
+				m_server_message.assign(message.data(), message.size());
 
 				// HTTP 1.0 always closes the connection after
 				// each request
@@ -230,13 +276,14 @@ restart_response:
 			}
 			else
 			{
-				m_method = m_protocol;
+				m_method.assign(protocol.data(), protocol.size());
 				std::transform(m_method.begin(), m_method.end(), m_method.begin(), &to_lower);
 				// the content length is assumed to be 0 for requests
 				m_content_length = 0;
-				m_protocol.clear();
-				m_path = read_until(line, ' ', line_end);
-				m_protocol = read_until(line, ' ', line_end);
+				string_view const path = next_token(line, ' ', line_end);
+				m_path.assign(path.data(), path.size());
+				string_view const proto = next_token(line, ' ', line_end);
+				m_protocol.assign(proto.data(), proto.size());
 				m_status_code = 0;
 			}
 			m_state = read_header;
@@ -247,22 +294,22 @@ restart_response:
 		{
 			TORRENT_ASSERT(!m_finished);
 			TORRENT_ASSERT(pos <= recv_buffer.end());
-			char const* newline = std::find(pos, recv_buffer.end(), '\n');
-			std::string line;
+			char const* newline = find_newline(pos, recv_buffer.end());
 
 			while (newline != recv_buffer.end() && m_state == read_header)
 			{
 				// if the LF character is preceded by a CR
-				// character, don't copy it into the line string.
+				// character, don't include it in the line
 				char const* line_end = newline;
 				if (pos != line_end && *(line_end - 1) == '\r') --line_end;
-				line.assign(pos, line_end);
+				string_view const line(pos, std::size_t(line_end - pos));
 				++newline;
 				m_recv_pos += newline - pos;
 				pos = newline;
 
-				std::string::size_type separator = line.find(':');
-				if (separator == std::string::npos)
+				string_view header_name;
+				string_view header_value;
+				if (!split_header(line, header_name, header_value))
 				{
 					if (m_status_code == 100)
 					{
@@ -284,15 +331,9 @@ restart_response:
 					break;
 				}
 
-				std::string name = line.substr(0, separator);
-				std::transform(name.begin(), name.end(), name.begin(), &to_lower);
-				++separator;
-				// skip whitespace
-				while (separator < line.size()
-					&& (line[separator] == ' ' || line[separator] == '\t'))
-					++separator;
-				std::string value = line.substr(separator, std::string::npos);
-				m_header.insert(std::make_pair(name, value));
+				auto const& h = add_header(header_name, header_value);
+				std::string const& name = h.first;
+				std::string const& value = h.second;
 
 				if (name == "content-length")
 				{
@@ -360,7 +401,7 @@ restart_response:
 
 				TORRENT_ASSERT(m_recv_pos <= int(recv_buffer.size()));
 				TORRENT_ASSERT(pos <= recv_buffer.end());
-				newline = std::find(pos, recv_buffer.end(), '\n');
+				newline = find_newline(pos, recv_buffer.end());
 			}
 			std::get<1>(ret) += int(newline - (m_recv_buffer.data() + start_pos));
 		}
@@ -482,7 +523,7 @@ restart_response:
 		if (pos == buf.end()) return false;
 
 		TORRENT_ASSERT(pos <= buf.end());
-		char const* newline = std::find(pos, buf.end(), '\n');
+		char const* newline = find_newline(pos, buf.end());
 		if (newline == buf.end()) return false;
 		++newline;
 
@@ -525,24 +566,26 @@ restart_response:
 			return true;
 		}
 
-		// this is the terminator of the stream. Also read headers
-		std::map<std::string, std::string> tail_headers;
+		// this is the terminator of the stream. Also read headers. They're
+		// added to the header table as they're parsed, and removed again if
+		// the trailer isn't complete yet
+		int const num_headers = m_num_headers;
 		pos = newline;
-		newline = std::find(pos, buf.end(), '\n');
+		newline = find_newline(pos, buf.end());
 
-		std::string line;
 		while (newline != buf.end())
 		{
 			// if the LF character is preceded by a CR
-			// character, don't copy it into the line string.
+			// character, don't include it in the line
 			char const* line_end = newline;
 			if (pos != line_end && *(line_end - 1) == '\r') --line_end;
-			line.assign(pos, line_end);
+			string_view const line(pos, std::size_t(line_end - pos));
 			++newline;
 			pos = newline;
 
-			std::string::size_type separator = line.find(':');
-			if (separator == std::string::npos)
+			string_view name;
+			string_view value;
+			if (!split_header(line, name, value))
 			{
 				// this means we got a blank line,
 				// the header is finished and the body
@@ -551,28 +594,13 @@ restart_response:
 
 				// the newline alone is two bytes
 				TORRENT_ASSERT(newline - buf.data() > 2);
-
-				// we were successful in parsing the headers.
-				// add them to the headers in the parser
-				for (auto const& p : tail_headers)
-					m_header.insert(p);
-
 				return true;
 			}
 
-			std::string name = line.substr(0, separator);
-			std::transform(name.begin(), name.end(), name.begin(), &to_lower);
-			++separator;
-			// skip whitespace
-			while (separator < line.size()
-				&& (line[separator] == ' ' || line[separator] == '\t'))
-				++separator;
-			std::string value = line.substr(separator, std::string::npos);
-			tail_headers.insert(std::make_pair(name, value));
-//			std::fprintf(stderr, "tail_header: %s: %s\n", name.c_str(), value.c_str());
-
-			newline = std::find(pos, buf.end(), '\n');
+			add_header(name, value);
+			newline = find_newline(pos, buf.end());
 		}
+		m_num_headers = num_headers;
 		return false;
 	}
 
@@ -600,7 +628,7 @@ restart_response:
 		m_finished = false;
 		m_state = read_status;
 		m_recv_buffer = span<char const>();
-		m_header.clear();
+		m_num_headers = 0;
 		m_chunked_encoding = false;
 		m_chunked_ranges.clear();
 		m_cur_chunk_end = -1;
@@ -0,0 +1,82 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/interface_table.hpp"
+#include "libtorrent/aux_/time.hpp"
+
+namespace libtorrent { namespace aux {
+
+	std::size_t interface_table::address_hash::operator()(address const& a) const
+	{
+		if (a.is_v4()) return std::hash<std::uint32_t>{}(a.to_v4().to_uint());
+		auto const b = a.to_v6().to_bytes();
+		std::size_t ret = 0;
+		for (auto const c : b) ret = ret * 31 + c;
+		return ret;
+	}
+
+	void interface_table::refresh(io_context& ios, error_code& if_ec
+		, error_code& route_ec)
+	{
+		std::vector<ip_interface> ifs = enum_net_interfaces(ios, if_ec);
+		std::vector<ip_route> routes = enum_routes(ios, route_ec);
+		if (if_ec) ifs = m_interfaces;
+		if (route_ec) routes = m_routes;
+		update(std::move(ifs), std::move(routes));
+	}
+
+	void interface_table::update(std::vector<ip_interface> ifs
+		, std::vector<ip_route> routes)
+	{
+		m_interfaces = std::move(ifs);
+		m_routes = std::move(routes);
+
+		m_devices.clear();
+		for (auto const& iface : m_interfaces)
+		{
+			// if more than one device has the same address, the first one
+			// wins, just like a linear search would
+			m_devices.emplace(iface.interface_address, iface.name);
+		}
+
+		m_last_refresh = aux::time_now();
+		++m_version;
+		m_stale = false;
+	}
+
+	string_view interface_table::device_for_address(address const& addr) const
+	{
+		auto const it = m_devices.find(addr);
+		if (it == m_devices.end()) return {};
+		return it->second;
+	}
+}}
@@ -279,14 +279,12 @@ void lsd::on_announce(error_code const& ec)
 		return;
 	}
 
-	auto const& headers = p.headers();
-
-	auto const cookie_iter = headers.find("cookie");
-	if (cookie_iter != headers.end())
+	std::string const& cookie_str = p.header("cookie");
+	if (!cookie_str.empty())
 	{
 		// we expect it to be hexadecimal
 		// if it isn't, it's not our cookie anyway
-		long const cookie = std::strtol(cookie_iter->second.c_str(), nullptr, 16);
+		long const cookie = std::strtol(cookie_str.c_str(), nullptr, 16);
 		if (cookie == m_cookie)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -297,10 +295,10 @@ void lsd::on_announce(error_code const& ec)
 		}
 	}
 
-	auto const ihs = headers.equal_range("infohash");
-	for (auto i = ihs.first; i != ihs.second; ++i)
+	for (auto const& i : p.headers())
 	{
-		std::string const& ih_str = i->second;
+		if (i.first != "infohash") continue;
+		std::string const& ih_str = i.second;
 		if (ih_str.size() != 40)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/ffs.hpp"
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/invariant_check.hpp"
+#include "libtorrent/hasher.hpp"
 
 namespace libtorrent {
 namespace aux {
@@ -103,6 +104,8 @@ namespace aux {
 		m_tree.clear();
 		m_tree.shrink_to_fit();
 		m_block_verified.clear();
+		m_piece_blocks.clear();
+		m_piece_verified.clear();
 		m_mode = mode_t::empty_tree;
 	}
 
@@ -160,11 +163,15 @@ namespace {
 			TORRENT_ASSERT(first_piece < int(mask.size()));
 			TORRENT_ASSERT(end_piece <= int(mask.size()));
 
-			// if the mask convers all pieces, and nothing below that layer, go
-			// straight to piece_layer mode and validate
-			if (std::all_of(mask.begin() + first_piece, mask.begin() + end_piece, identity())
+			int const below_pieces = merkle_get_first_child(first_piece);
 
-				&& std::all_of(mask.begin() + end_piece, mask.end(), std::logical_not<>()))
+			// if the mask convers all pieces, and nothing below that layer
+			// except block hashes, go straight to piece_layer mode and
+			// validate. This is what build_sparse_vector() produces in
+			// piece_layer mode
+			if (std::all_of(mask.begin() + first_piece, mask.begin() + end_piece, identity())
+				&& std::none_of(mask.begin() + below_pieces, mask.begin() + first_block, identity())
+				&& std::none_of(mask.begin() + end_block, mask.end(), identity()))
 			{
 				// the index in t that points to first_piece
 				auto const piece_index = std::count_if(mask.begin(), mask.begin() + first_piece, identity());
@@ -173,12 +180,58 @@ namespace {
 					return clear();
 
 				m_tree.assign(t.begin() + piece_index, t.begin() + piece_index + piece_count);
+				m_block_verified.clear();
+				m_piece_blocks.clear();
+				m_piece_verified.clear();
 				m_mode = mode_t::piece_layer;
 
 				sha256_hash const piece_layer_pad = merkle_pad(1 << m_blocks_per_piece_log, 1);
 				sha256_hash const r = merkle_root(m_tree, piece_layer_pad);
 				// validation failed!
-				if (r != root()) clear();
+				if (r != root()) return clear();
+
+				// the block hashes of pieces in progress
+				auto cursor = std::count_if(mask.begin(), mask.begin() + first_block, identity());
+				for (int i = first_block; i < end_block && cursor < t.size(); ++i)
+				{
+					if (!mask[std::size_t(i)]) continue;
+					int const block = i - first_block;
+					int const piece = block >> m_blocks_per_piece_log;
+					auto& blocks = m_piece_blocks[piece];
+					if (blocks.hashes.empty())
+					{
+						blocks.hashes.resize(blocks_in_piece(piece));
+						blocks.missing = blocks.hashes.end_index();
+					}
+					blocks.hashes[block & (blocks_per_piece() - 1)] = t[cursor++];
+					--blocks.missing;
+				}
+
+				// pieces whose blocks are all flagged as verified were either
+				// saved without their block hashes, or we have the hashes and
+				// can validate them against the piece hash
+				std::vector<sha256_hash> scratch_space;
+				for (int piece = 0; piece < piece_count; ++piece)
+				{
+					int const start = piece << m_blocks_per_piece_log;
+					int const blocks = blocks_in_piece(piece);
+					if (int(verified.size()) < start + blocks) break;
+					if (!std::all_of(verified.begin() + start, verified.begin() + start + blocks, identity()))
+						continue;
+
+					auto const it = m_piece_blocks.find(piece);
+					if (it == m_piece_blocks.end())
+					{
+						set_piece_verified(piece);
+						continue;
+					}
+					if (merkle_root_scratch(it->second.hashes, blocks_per_piece()
+						, sha256_hash{}, scratch_space) != m_tree[piece])
+						continue;
+					it->second.verified = true;
+					it->second.checked.resize(blocks, false);
+					set_piece_verified(piece);
+				}
 				return;
 			}
 		}
@@ -275,6 +328,9 @@ namespace {
 		// this file
 		m_mode = m_blocks_per_piece_log == 0 ? mode_t::block_layer : mode_t::piece_layer;
 		m_tree = std::move(pieces);
+		m_block_verified.clear();
+		m_piece_blocks.clear();
+		m_piece_verified.clear();
 
 		return true;
 	}
@@ -315,6 +371,9 @@ namespace {
 			return ret;
 		}
 
+		if (m_mode == mode_t::piece_layer)
+			return add_piece_hashes(dest_start_idx, file_piece_offset, hashes, uncle_hashes);
+
 		allocate_full();
 
 		// TODO: this can be optimized by using m_tree as storage to fill this
@@ -489,6 +548,9 @@ namespace {
 		INVARIANT_CHECK;
 		TORRENT_ASSERT(block_index < m_num_blocks);
 
+		if (m_mode == mode_t::piece_layer)
+			return set_piece_block(block_index, h);
+
 		auto const num_leafs = merkle_num_leafs(m_num_blocks);
 		auto const first_leaf = merkle_first_leaf(num_leafs);
 		auto const block_tree_index = first_leaf + block_index;
@@ -506,6 +568,24 @@ namespace {
 
 		m_tree[block_tree_index] = h;
 
+		auto const ret = verify_block_subtree(block_index);
+
+		// attempting to optimize storage is quite costly, only do it if we have
+		// a reason to believe it might have an effect
+		if (std::get<0>(ret) == set_block_result::ok
+			&& (block_index == m_num_blocks - 1 || !m_tree[block_tree_index + 1].is_all_zeros()))
+			optimize_storage();
+
+		return ret;
+	}
+
+	std::tuple<merkle_tree::set_block_result, int, int> merkle_tree::verify_block_subtree(
+		int const block_index)
+	{
+		TORRENT_ASSERT(m_mode == mode_t::full_tree);
+		auto const num_leafs = merkle_num_leafs(m_num_blocks);
+		auto const first_leaf = merkle_first_leaf(num_leafs);
+
 		// to avoid wasting a lot of time hashing nodes only to discover they
 		// cannot be verified, check first to see if the root of the largest
 		// computable subtree is known
@@ -556,14 +636,384 @@ namespace {
 		for (int i = leafs_start; i < leafs_end; ++i)
 			m_block_verified.set_bit(i);
 
-		// attempting to optimize storage is quite costly, only do it if we have
-		// a reason to believe it might have an effect
-		if (block_index == m_num_blocks - 1 || !m_tree[block_tree_index + 1].is_all_zeros())
-			optimize_storage();
-
 		return std::make_tuple(set_block_result::ok, leafs_start, leafs_size);
 	}
 
+	std::tuple<merkle_tree::set_block_result, int, int> merkle_tree::set_block(
+		int const block_index, span<sha256_hash const> const leafs)
+	{
+		TORRENT_ASSERT(!leafs.empty());
+		TORRENT_ASSERT(block_index + leafs.size() <= m_num_blocks);
+
+		if (leafs.size() == 1) return set_block(block_index, leafs[0]);
+
+		// set_piece_block() only hashes a piece once all its blocks are set,
+		// so setting the blocks one at a time doesn't hash anything twice
+		if (m_mode == mode_t::piece_layer)
+			return set_piece_blocks(block_index, leafs);
+
+		INVARIANT_CHECK;
+
+		int const num_blocks = int(leafs.size());
+		auto const first_leaf = merkle_first_leaf(merkle_num_leafs(m_num_blocks));
+
+		// first store all the hashes, so that each subtree is only hashed once,
+		// when it's verified below. Blocks whose hashes are already known are
+		// checked against them
+		int failed_block = -1;
+		for (int i = 0; i < num_blocks; ++i)
+		{
+			int const block = block_index + i;
+			if (blocks_verified(block, 1))
+			{
+				if (failed_block < 0 && !compare_node(first_leaf + block, leafs[i]))
+					failed_block = block;
+				continue;
+			}
+			allocate_full();
+			m_tree[first_leaf + block] = leafs[i];
+		}
+
+		// verify the subtrees covering the range, starting from the end. Each
+		// subtree found covers the blocks before the one it's found from, up
+		// to its start
+		int verified_start = block_index + num_blocks;
+		int verified_end = block_index;
+		bool all_verified = true;
+		bool new_verified = false;
+		std::tuple<set_block_result, int, int> failed_piece{set_block_result::ok, 0, 0};
+		for (int block = block_index + num_blocks - 1; block >= block_index;)
+		{
+			if (blocks_verified(block, 1))
+			{
+				verified_start = std::min(verified_start, block);
+				verified_end = std::max(verified_end, block + 1);
+				--block;
+				continue;
+			}
+
+			auto const r = verify_block_subtree(block);
+			int const start = std::get<1>(r);
+			switch (std::get<0>(r))
+			{
+				case set_block_result::ok:
+					verified_start = std::min(verified_start, start);
+					verified_end = std::max(verified_end, start + std::get<2>(r));
+					new_verified = true;
+					break;
+				case set_block_result::hash_failed:
+					failed_piece = r;
+					all_verified = false;
+					break;
+				case set_block_result::unknown:
+				case set_block_result::block_hash_failed:
+					all_verified = false;
+					break;
+			}
+			block = std::min(block, start) - 1;
+		}
+
+		if (new_verified) optimize_storage();
+
+		if (failed_block >= 0)
+			return std::make_tuple(set_block_result::block_hash_failed, failed_block, 1);
+		if (std::get<0>(failed_piece) == set_block_result::hash_failed)
+			return failed_piece;
+		if (all_verified)
+			return std::make_tuple(set_block_result::ok, verified_start, verified_end - verified_start);
+		return std::make_tuple(set_block_result::unknown, block_index, num_blocks);
+	}
+
+	std::tuple<merkle_tree::set_block_result, int, int> merkle_tree::set_piece_blocks(
+		int const block_index, span<sha256_hash const> const leafs)
+	{
+		int const num_leafs = int(leafs.size());
+
+		// the number of blocks at the start of the range that are covered by
+		// the verified ranges reported so far. Since every verified range is
+		// a subtree including the block that was just set, the range is
+		// fully verified once this reaches the end
+		int verified_end = block_index;
+		int verified_start = block_index;
+		int failed_block = -1;
+		std::tuple<set_block_result, int, int> failed_piece{set_block_result::ok, 0, 0};
+
+		for (int i = 0; i < num_leafs; ++i)
+		{
+			auto const last = set_piece_block(block_index + i, leafs[i]);
+			switch (std::get<0>(last))
+			{
+				case set_block_result::ok:
+				{
+					int const start = std::get<1>(last);
+					int const end = start + std::get<2>(last);
+					// a range reported for a later block may cover earlier ones
+					// that could not be verified when they were set
+					if (start <= verified_end)
+					{
+						verified_start = std::min(verified_start, start);
+						verified_end = std::max(verified_end, end);
+					}
+					break;
+				}
+				case set_block_result::block_hash_failed:
+					if (failed_block < 0) failed_block = block_index + i;
+					break;
+				case set_block_result::hash_failed:
+					failed_piece = last;
+					break;
+				case set_block_result::unknown:
+					break;
+			}
+		}
+
+		if (failed_block >= 0)
+			return std::make_tuple(set_block_result::block_hash_failed, failed_block, 1);
+		if (std::get<0>(failed_piece) == set_block_result::hash_failed)
+			return failed_piece;
+		if (verified_end >= block_index + num_leafs)
+			return std::make_tuple(set_block_result::ok, verified_start, verified_end - verified_start);
+		return std::make_tuple(set_block_result::unknown, block_index, num_leafs);
+	}
+
+	// in piece_layer mode, the block hashes are only kept per piece, until the
+	// piece has been verified. Only then do we know whether they are valid,
+	// and we drop them, since the piece hash is enough to validate the piece
+	// again.
+	std::tuple<merkle_tree::set_block_result, int, int> merkle_tree::set_piece_block(
+		int const block_index, sha256_hash const& h)
+	{
+		int const piece = block_index >> m_blocks_per_piece_log;
+		int const block = block_index & (blocks_per_piece() - 1);
+		int const piece_start = piece << m_blocks_per_piece_log;
+		int const num_blocks = blocks_in_piece(piece);
+
+		auto it = m_piece_blocks.find(piece);
+		if (it != m_piece_blocks.end() && it->second.verified)
+		{
+			// the block hashes are known, check the passed-in hash against it
+			auto& blocks = it->second;
+			if (blocks.hashes[block] != h)
+				return std::make_tuple(set_block_result::block_hash_failed, block_index, 1);
+
+			blocks.checked.set_bit(block);
+			if (blocks.checked.all_set()) m_piece_blocks.erase(it);
+			return std::make_tuple(set_block_result::ok, block_index, 1);
+		}
+
+		if (it == m_piece_blocks.end())
+		{
+			it = m_piece_blocks.emplace(piece, piece_blocks()).first;
+			it->second.hashes.resize(num_blocks);
+			it->second.missing = num_blocks;
+		}
+
+		auto& blocks = it->second;
+		if (blocks.hashes[block].is_all_zeros()) --blocks.missing;
+		blocks.hashes[block] = h;
+
+		if (blocks.missing > 0)
+			return std::make_tuple(set_block_result::unknown, block_index, 1);
+
+		std::vector<sha256_hash> scratch_space;
+		sha256_hash const piece_hash = merkle_root_scratch(blocks.hashes
+			, blocks_per_piece(), sha256_hash{}, scratch_space);
+
+		// either way, we're done with these block hashes. If the piece failed,
+		// we don't know which block was bad
+		m_piece_blocks.erase(it);
+
+		if (piece_hash != m_tree[piece])
+			return std::make_tuple(set_block_result::hash_failed, piece_start, blocks_per_piece());
+
+		set_piece_verified(piece);
+		return std::make_tuple(set_block_result::ok, piece_start, blocks_per_piece());
+	}
+
+	// in piece_layer mode, all nodes from the piece layer and up are known.
+	// Hashes below the piece layer are validated against it, but only block
+	// hashes are stored (in m_piece_blocks).
+	boost::optional<add_hashes_result_t> merkle_tree::add_piece_hashes(
+		int const dest_start_idx
+		, piece_index_t::diff_type const file_piece_offset
+		, span<sha256_hash const> hashes
+		, span<sha256_hash const> uncle_hashes)
+	{
+		add_hashes_result_t ret;
+
+		int const leaf_count = merkle_num_leafs(int(hashes.size()));
+		aux::vector<sha256_hash> tree(merkle_num_nodes(leaf_count));
+		std::copy(hashes.begin(), hashes.end(), tree.end() - leaf_count);
+
+		// the end of a file is a special case, we may need to pad the leaf layer
+		if (leaf_count > hashes.size())
+		{
+			int const leaf_layer_size = num_leafs();
+			int const insert_layer_size = leaf_count << uncle_hashes.size();
+			if (leaf_layer_size != insert_layer_size)
+			{
+				sha256_hash const pad_hash = merkle_pad(leaf_layer_size, insert_layer_size);
+				for (int i = int(hashes.size()); i < leaf_count; ++i)
+					tree[tree.end_index() - leaf_count + i] = pad_hash;
+			}
+		}
+
+		merkle_fill_tree(tree, leaf_count);
+
+		int const base_num_layers = merkle_num_layers(leaf_count);
+		int const insert_root_idx = dest_start_idx >> base_num_layers;
+
+		// the first node below the piece layer. Every node before this one is
+		// known
+		int const below_pieces = merkle_get_first_child(piece_layer_start());
+
+		if (dest_start_idx < below_pieces)
+		{
+			// we already have all these hashes. Make sure they match
+			for (int i = 0; i < int(hashes.size()); ++i)
+			{
+				if (!compare_node(dest_start_idx + i, hashes[i]))
+					return {};
+			}
+			return ret;
+		}
+
+		// walk up the tree, using the uncle hashes, until we reach the piece
+		// layer, where we can validate the hashes
+		int idx = insert_root_idx;
+		sha256_hash h = tree[0];
+		for (auto const& uncle : uncle_hashes)
+		{
+			if (idx < below_pieces) break;
+			h = (idx & 1)
+				? hasher256().update(h).update(uncle).final()
+				: hasher256().update(uncle).update(h).final();
+			idx = merkle_get_parent(idx);
+		}
+		if (idx >= below_pieces || !compare_node(idx, h))
+			return {};
+
+		// the hashes are valid. We only store block hashes though
+		int const first_leaf = block_layer_start();
+		if (dest_start_idx < first_leaf)
+			return ret;
+
+		int const first_block = dest_start_idx - first_leaf;
+		int const end_block = std::min(first_block + int(hashes.size()), m_num_blocks);
+
+		for (int piece = first_block >> m_blocks_per_piece_log
+			; (piece << m_blocks_per_piece_log) < end_block; ++piece)
+		{
+			int const piece_start = piece << m_blocks_per_piece_log;
+			int const num_blocks = blocks_in_piece(piece);
+			bool const whole_piece = first_block <= piece_start
+				&& piece_start + num_blocks <= end_block;
+			auto const file_piece = piece_index_t{piece} + file_piece_offset;
+
+			auto it = m_piece_blocks.find(piece);
+			if (it != m_piece_blocks.end() && it->second.verified)
+				continue;
+
+			if (it == m_piece_blocks.end())
+			{
+				// without the whole piece, we can't record the hashes as
+				// verified. Unless we have the piece already, we'll check them
+				// against the blocks when they arrive
+				if (!whole_piece && piece_verified(piece)) continue;
+				it = m_piece_blocks.emplace(piece, piece_blocks()).first;
+				it->second.hashes.resize(num_blocks);
+				it->second.missing = num_blocks;
+			}
+
+			auto& blocks = it->second;
+			bitfield checked(num_blocks, false);
+			for (int b = std::max(first_block, piece_start) - piece_start
+				, end = std::min(end_block - piece_start, num_blocks); b < end; ++b)
+			{
+				sha256_hash const& block_hash = hashes[piece_start + b - first_block];
+				if (!blocks.hashes[b].is_all_zeros())
+				{
+					if (blocks.hashes[b] != block_hash)
+					{
+						if (!ret.failed.empty() && ret.failed.back().first == file_piece)
+							ret.failed.back().second.push_back(b);
+						else
+							ret.failed.emplace_back(file_piece, std::vector<int>{b});
+					}
+					else
+					{
+						checked.set_bit(b);
+						if (ret.passed.empty() || ret.passed.back() != file_piece)
+							ret.passed.push_back(file_piece);
+					}
+				}
+				else if (!block_hash.is_all_zeros())
+				{
+					--blocks.missing;
+				}
+				blocks.hashes[b] = block_hash;
+			}
+
+			if (!whole_piece) continue;
+
+			blocks.verified = true;
+			blocks.checked = std::move(checked);
+			set_piece_verified(piece);
+			if (blocks.checked.all_set()) m_piece_blocks.erase(it);
+		}
+
+		return ret;
+	}
+
+	sha256_hash merkle_tree::piece_subtree_hash(int idx
+		, std::vector<sha256_hash>& scratch_space) const
+	{
+		TORRENT_ASSERT(m_mode == mode_t::piece_layer);
+		int const first_leaf = block_layer_start();
+		int num_leafs = 1;
+		while (idx < first_leaf)
+		{
+			idx = merkle_get_first_child(idx);
+			num_leafs *= 2;
+		}
+		int const block = idx - first_leaf;
+		if (block >= m_num_blocks) return merkle_pad(num_leafs, 1);
+		if (num_leafs == 1) return piece_block_hash(block);
+
+		auto const it = m_piece_blocks.find(block >> m_blocks_per_piece_log);
+		if (it == m_piece_blocks.end() || !it->second.verified) return sha256_hash{};
+
+		auto const& hashes = it->second.hashes;
+		int const offset = block & (blocks_per_piece() - 1);
+		int const count = std::min(num_leafs, hashes.end_index() - offset);
+		return merkle_root_scratch(span<sha256_hash const>(hashes).subspan(offset, count)
+			, num_leafs, sha256_hash{}, scratch_space);
+	}
+
+	sha256_hash merkle_tree::piece_block_hash(int const block_index) const
+	{
+		TORRENT_ASSERT(m_mode == mode_t::piece_layer);
+		auto const it = m_piece_blocks.find(block_index >> m_blocks_per_piece_log);
+		if (it == m_piece_blocks.end()) return sha256_hash{};
+		return it->second.hashes[block_index & (blocks_per_piece() - 1)];
+	}
+
+	bool merkle_tree::piece_verified(int const piece) const
+	{
+		return !m_piece_verified.empty() && m_piece_verified.get_bit(piece);
+	}
+
+	void merkle_tree::set_piece_verified(int const piece)
+	{
+		if (m_piece_verified.empty()) m_piece_verified.resize(num_pieces(), false);
+		m_piece_verified.set_bit(piece);
+	}
+
+	int merkle_tree::blocks_in_piece(int const piece) const
+	{
+		return std::min(blocks_per_piece(), m_num_blocks - (piece << m_blocks_per_piece_log));
+	}
+
 	std::size_t merkle_tree::size() const
 	{
 		return static_cast<std::size_t>(merkle_num_nodes(merkle_num_leafs(m_num_blocks)));
@@ -606,7 +1056,17 @@ namespace {
 				return false;
 			case mode_t::empty_tree: return idx == 0;
 			case mode_t::full_tree: return !m_tree[idx].is_all_zeros();
-			case mode_t::piece_layer: return idx < merkle_get_first_child(piece_layer_start());
+			case mode_t::piece_layer:
+			{
+				if (idx < merkle_get_first_child(piece_layer_start())) return true;
+				int const block = idx - block_layer_start();
+				if (block >= 0)
+					return block < m_num_blocks && !piece_block_hash(block).is_all_zeros();
+				// the nodes between the block and piece layers are known for
+				// pieces whose block hashes are verified
+				std::vector<sha256_hash> scratch_space;
+				return !piece_subtree_hash(idx, scratch_space).is_all_zeros();
+			}
 			case mode_t::block_layer: return idx < block_layer_start() + m_num_blocks;
 		}
 		TORRENT_ASSERT_FAIL();
@@ -631,6 +1091,9 @@ namespace {
 				int const pieces_end = first + piece_count;
 				int const piece_layer_size = merkle_num_leafs(piece_count);
 				int const end = first + piece_layer_size;
+				int const block = idx - block_layer_start();
+				if (block >= 0 && block < m_num_blocks)
+					return piece_block_hash(block) == h;
 				if (idx >= end)
 					return h.is_all_zeros();
 				if (idx >= pieces_end)
@@ -679,7 +1142,12 @@ namespace {
 					: block_layer_start();
 
 				if (m_mode == mode_t::piece_layer && idx >= merkle_get_first_child(start))
-					return sha256_hash();
+				{
+					int const block = idx - block_layer_start();
+					if (block >= m_num_blocks)
+						return sha256_hash();
+					return piece_subtree_hash(idx, scratch_space);
+				}
 
 				int layer_size = 1;
 				while (idx < start)
@@ -734,6 +1202,17 @@ namespace {
 				std::fill(ret.begin() + start + m_tree.end_index(), ret.begin() + start + piece_layer_size, pad_hash);
 				merkle_fill_tree(span<sha256_hash>(ret).subspan(0, merkle_num_nodes(piece_layer_size))
 					, piece_layer_size);
+
+				// block hashes of pieces in progress. The interior nodes of
+				// the pieces whose block hashes are verified can be filled in
+				int const first_leaf = block_layer_start();
+				for (auto const& p : m_piece_blocks)
+				{
+					int const block_idx = first_leaf + (p.first << m_blocks_per_piece_log);
+					std::copy(p.second.hashes.begin(), p.second.hashes.end(), ret.begin() + block_idx);
+					if (p.second.verified)
+						merkle_fill_tree(ret, blocks_per_piece(), block_idx);
+				}
 				break;
 			}
 			case mode_t::block_layer:
@@ -775,6 +1254,18 @@ namespace {
 				for (int i = merkle_first_leaf(piece_layer_size), end = i + m_tree.end_index(); i < end; ++i)
 					mask[i] = true;
 				ret = m_tree;
+
+				int const first_leaf = block_layer_start();
+				for (auto const& p : m_piece_blocks)
+				{
+					int const block_idx = first_leaf + (p.first << m_blocks_per_piece_log);
+					for (int i = 0; i < p.second.hashes.end_index(); ++i)
+					{
+						if (p.second.hashes[i].is_all_zeros()) continue;
+						ret.push_back(p.second.hashes[i]);
+						mask[block_idx + i] = true;
+					}
+				}
 				break;
 			}
 			case mode_t::block_layer:
@@ -800,7 +1291,16 @@ namespace {
 			case mode_t::empty_tree:
 				return std::vector<bool>(std::size_t(m_num_blocks), m_num_blocks == 1);
 			case mode_t::piece_layer:
-				return std::vector<bool>(std::size_t(m_num_blocks), piece_levels() == 0);
+			{
+				std::vector<bool> ret(std::size_t(m_num_blocks), piece_levels() == 0);
+				for (int i = 0; i < m_piece_verified.size(); ++i)
+				{
+					if (!m_piece_verified.get_bit(i)) continue;
+					int const start = i << m_blocks_per_piece_log;
+					std::fill_n(ret.begin() + start, blocks_in_piece(i), true);
+				}
+				return ret;
+			}
 			case mode_t::block_layer:
 				return std::vector<bool>(std::size_t(m_num_blocks), true);
 			case mode_t::full_tree:
@@ -847,7 +1347,11 @@ namespace {
 			case mode_t::empty_tree:
 				return m_num_blocks == 1;
 			case mode_t::piece_layer:
-				return piece_levels() == 0;
+				if (piece_levels() == 0) return true;
+				for (int i = block_idx >> m_blocks_per_piece_log
+					, end = (block_idx + num_blocks - 1) >> m_blocks_per_piece_log; i <= end; ++i)
+					if (!piece_verified(i)) return false;
+				return true;
 			case mode_t::block_layer:
 				return true;
 			case mode_t::full_tree:
@@ -867,8 +1371,35 @@ namespace {
 		// again.
 		TORRENT_ASSERT(m_mode != mode_t::block_layer);
 		m_tree = aux::vector<sha256_hash>(build_vector());
-		m_mode = mode_t::full_tree;
 		m_block_verified.resize(m_num_blocks, false);
+
+		// the pieces whose block hashes we have (and know are valid) are
+		// still verified in the full tree. The ones we've dropped will have to
+		// be requested again
+		if (m_mode == mode_t::piece_layer)
+		{
+			for (auto const& p : m_piece_blocks)
+			{
+				if (!p.second.verified) continue;
+				int const start = p.first << m_blocks_per_piece_log;
+				for (int i = start, end = start + blocks_in_piece(p.first); i < end; ++i)
+					m_block_verified.set_bit(i);
+			}
+			m_piece_blocks.clear();
+			m_piece_verified.clear();
+		}
+		m_mode = mode_t::full_tree;
+	}
+
+	std::int64_t merkle_tree::memory_usage() const
+	{
+		std::int64_t ret = std::int64_t(m_tree.capacity()) * sha256_hash::size()
+			+ (m_block_verified.size() + m_piece_verified.size()) / 8;
+		// the map node overhead is an estimate
+		for (auto const& p : m_piece_blocks)
+			ret += std::int64_t(p.second.hashes.capacity()) * sha256_hash::size()
+				+ p.second.checked.size() / 8 + 64;
+		return ret;
 	}
 
 	void merkle_tree::optimize_storage()
@@ -984,6 +1515,36 @@ namespace {
 		return ret;
 	}
 
+	std::vector<sha256_hash> merkle_tree::get_hashes(int const base
+		, int const index, int const count, int const proof_layers
+		, int const piece, span<sha256_hash const> const blocks)
+	{
+		if (m_mode != mode_t::piece_layer
+			|| m_piece_blocks.find(piece) != m_piece_blocks.end())
+			return get_hashes(base, index, count, proof_layers);
+
+		if (piece < 0 || piece >= num_pieces()
+			|| int(blocks.size()) != blocks_in_piece(piece))
+			return {};
+
+		std::vector<sha256_hash> scratch_space;
+		if (merkle_root_scratch(blocks, blocks_per_piece(), sha256_hash{}
+			, scratch_space) != m_tree[piece])
+			return {};
+
+		// the block hashes are valid. Hold on to them just while answering
+		// the request
+		auto& entry = m_piece_blocks[piece];
+		entry.hashes.assign(blocks.begin(), blocks.end());
+		entry.verified = true;
+		entry.checked.resize(int(blocks.size()), true);
+		set_piece_verified(piece);
+
+		auto ret = get_hashes(base, index, count, proof_layers);
+		m_piece_blocks.erase(piece);
+		return ret;
+	}
+
 #if TORRENT_USE_INVARIANT_CHECKS
 	void merkle_tree::check_invariant() const
 	{
@@ -998,10 +1559,12 @@ namespace {
 			case mode_t::uninitialized_tree:
 				TORRENT_ASSERT(m_tree.empty());
 				TORRENT_ASSERT(m_block_verified.empty());
+				TORRENT_ASSERT(m_piece_blocks.empty());
 				break;
 			case mode_t::empty_tree:
 				TORRENT_ASSERT(m_tree.empty());
 				TORRENT_ASSERT(m_block_verified.empty());
+				TORRENT_ASSERT(m_piece_blocks.empty());
 				break;
 			case mode_t::full_tree:
 			{
@@ -1064,6 +1627,17 @@ namespace {
 			{
 				TORRENT_ASSERT(merkle_root(m_tree, merkle_pad(1 << m_blocks_per_piece_log, 1)) == root());
 				TORRENT_ASSERT(m_block_verified.empty());
+				TORRENT_ASSERT(m_piece_verified.empty() || m_piece_verified.size() == num_pieces());
+				for (auto const& p : m_piece_blocks)
+				{
+					TORRENT_ASSERT(p.first >= 0 && p.first < num_pieces());
+					TORRENT_ASSERT(p.second.hashes.end_index() == blocks_in_piece(p.first));
+					TORRENT_ASSERT(p.second.missing == std::count_if(p.second.hashes.begin(), p.second.hashes.end()
+						, [](sha256_hash const& h) { return h.is_all_zeros(); }));
+					if (!p.second.verified) continue;
+					TORRENT_ASSERT(piece_verified(p.first));
+					TORRENT_ASSERT(p.second.checked.size() == blocks_in_piece(p.first));
+				}
 				break;
 			}
 			case mode_t::block_layer:
@@ -44,6 +44,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file.hpp" // for file_handle
 
 #include <cstdint>
+#include <algorithm> // for min
 
 #ifdef TORRENT_WINDOWS
 #include "libtorrent/aux_/win_util.hpp"
@@ -52,6 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #if TORRENT_HAVE_MMAP
 #include <sys/mman.h> // for mmap
 #include <sys/stat.h>
+#include <unistd.h> // for sysconf
 #include <fcntl.h> // for open
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
@@ -175,6 +177,7 @@ file_mapping::file_mapping(file_handle file, open_mode_t const mode, std::int64_
 	, m_mapping(m_size > 0 ? mmap(nullptr, static_cast<std::size_t>(m_size)
 			, mmap_prot(mode), mmap_flags(mode), m_file.fd(), 0)
 	: nullptr)
+	, m_direct_io(m_file.direct_io())
 {
 	TORRENT_ASSERT(file_size >= 0);
 	// you can't create an mmap of size 0, so we just set it to null. We
@@ -259,6 +262,7 @@ file_mapping::file_mapping(file_mapping&& rhs)
 	: m_size(rhs.m_size)
 	, m_file(std::move(rhs.m_file))
 	, m_mapping(rhs.m_mapping)
+	, m_direct_io(rhs.m_direct_io)
 	{
 		TORRENT_ASSERT(m_mapping);
 		rhs.m_mapping = nullptr;
@@ -271,6 +275,7 @@ file_mapping::file_mapping(file_mapping&& rhs)
 		m_file = std::move(rhs.m_file);
 		m_size = rhs.m_size;
 		m_mapping = rhs.m_mapping;
+		m_direct_io = rhs.m_direct_io;
 		rhs.m_mapping = nullptr;
 		return *this;
 	}
@@ -282,6 +287,49 @@ file_mapping::file_mapping(file_mapping&& rhs)
 		return file_view(shared_from_this());
 	}
 
+	int file_mapping::pread(span<char> const buf, std::int64_t const offset
+		, error_code& ec)
+	{
+		TORRENT_ASSERT(!m_direct_io
+			|| ((offset | buf.size()) % direct_io_alignment) == 0);
+#if TORRENT_HAVE_MMAP
+		if (m_direct_io)
+		{
+			// retrying after a short read would continue at an unaligned
+			// offset, which O_DIRECT rejects. Leave it to the caller
+			auto const r = ::pread(m_file.fd(), buf.data(), std::size_t(buf.size()), offset);
+			if (r < 0)
+			{
+				ec = error_code(errno, system_category());
+				return -1;
+			}
+			return int(r);
+		}
+#endif
+		return pread_all(m_file.fd(), buf, offset, ec);
+	}
+
+	int file_mapping::pwrite(span<char const> const buf, std::int64_t const offset
+		, error_code& ec)
+	{
+		TORRENT_ASSERT(!m_direct_io
+			|| ((offset | buf.size()) % direct_io_alignment) == 0);
+#if TORRENT_HAVE_MMAP
+		if (m_direct_io)
+		{
+			// see pread()
+			auto const r = ::pwrite(m_file.fd(), buf.data(), std::size_t(buf.size()), offset);
+			if (r < 0)
+			{
+				ec = error_code(errno, system_category());
+				return -1;
+			}
+			return int(r);
+		}
+#endif
+		return pwrite_all(m_file.fd(), buf, offset, ec);
+	}
+
 
 void file_mapping::dont_need(span<byte const> range)
 {
@@ -333,6 +381,67 @@ void file_mapping::page_out(span<byte const> range)
 #endif // MAP_VIEW_OF_FILE
 }
 
+void file_mapping::write_back(std::int64_t const offset, std::int64_t const len
+	, bool const wait)
+{
+	if (m_mapping == nullptr || offset >= m_size || len <= 0) return;
+	std::int64_t const size = std::min(len, m_size - offset);
+
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+	TORRENT_UNUSED(wait);
+	// ignore errors, this is best-effort
+	FlushViewOfFile(static_cast<byte*>(m_mapping) + offset, static_cast<std::size_t>(size));
+#elif TORRENT_USE_SYNC_FILE_RANGE
+	// waiting for any write-back already in progress for this range before
+	// initiating a new one bounds the number of pages under write-back
+	unsigned int flags = SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE;
+	if (wait) flags |= SYNC_FILE_RANGE_WAIT_AFTER;
+
+	// this is best-effort. ignore errors
+	::sync_file_range(m_file.fd(), offset, size, flags);
+#else
+	// msync() requires the start address to be page aligned
+	std::uintptr_t const page_mask = std::uintptr_t(::sysconf(_SC_PAGESIZE)) - 1;
+	auto const first = reinterpret_cast<std::uintptr_t>(static_cast<byte*>(m_mapping) + offset);
+	auto const start = first & ~page_mask;
+	::msync(reinterpret_cast<void*>(start), static_cast<std::size_t>(first - start)
+		+ static_cast<std::size_t>(size), wait ? MS_SYNC : MS_ASYNC);
+#endif
+}
+
+void file_mapping::will_need(span<byte const> range)
+{
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+	// PrefetchVirtualMemory() was introduced in Windows 8
+	struct memory_range_entry
+	{
+		PVOID VirtualAddress;
+		SIZE_T NumberOfBytes;
+	};
+	using PrefetchVirtualMemory_t = BOOL (WINAPI*)(HANDLE, ULONG_PTR
+		, memory_range_entry*, ULONG);
+	auto PrefetchVirtualMemory = aux::get_library_procedure<aux::kernel32
+		, PrefetchVirtualMemory_t>("PrefetchVirtualMemory");
+	if (PrefetchVirtualMemory == nullptr) return;
+
+	memory_range_entry entry{const_cast<byte*>(range.data())
+		, static_cast<SIZE_T>(range.size())};
+	// ignore errors, this is best-effort
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+#elif TORRENT_USE_MADVISE && defined MADV_WILLNEED
+	// madvise() requires the start address to be page aligned
+	std::uintptr_t const page_mask = std::uintptr_t(::sysconf(_SC_PAGESIZE)) - 1;
+	auto const start = reinterpret_cast<std::uintptr_t>(range.data()) & ~page_mask;
+	auto const size = static_cast<std::size_t>(
+		reinterpret_cast<std::uintptr_t>(range.data()) + std::uintptr_t(range.size()) - start);
+
+	// this is best-effort. ignore errors
+	::madvise(reinterpret_cast<void*>(start), size, MADV_WILLNEED);
+#else
+	TORRENT_UNUSED(range);
+#endif
+}
+
 } // aux
 } // libtorrent
 
@@ -64,6 +64,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/file_view_pool.hpp"
 #include "libtorrent/aux_/scope_end.hpp"
 #include "libtorrent/aux_/storage_free_list.hpp"
+#include "libtorrent/aux_/read_ahead.hpp"
+#include "libtorrent/aux_/block_cache.hpp"
+#include "libtorrent/aux_/disk_job_queue.hpp"
+#include "libtorrent/aux_/disk_interface_ext.hpp"
+#include "libtorrent/aux_/storage_mover.hpp"
+#include "libtorrent/disk_observer.hpp"
 
 #ifdef TORRENT_WINDOWS
 #include "signal_error_code.hpp"
@@ -165,6 +171,7 @@ using jobqueue_t = tailqueue<aux::mmap_disk_job>;
 // of disk io jobs
 struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 	: disk_interface
+	, aux::disk_interface_ext
 {
 	mmap_disk_io(io_context& ios, settings_interface const&, counters& cnt);
 #if TORRENT_USE_ASSERTS
@@ -190,6 +197,13 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override;
 	void async_hash2(storage_index_t storage, piece_index_t piece, int offset, disk_job_flags_t flags
 		, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override;
+	void async_read_time_critical(storage_index_t storage, peer_request const& r
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t flags = {}) override;
+	void async_hash_time_critical(storage_index_t storage, piece_index_t piece
+		, span<sha256_hash> v2, disk_job_flags_t flags
+		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override;
+	std::pair<std::int64_t, std::int64_t> move_storage_progress(storage_index_t) const override;
 	void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
 		, std::function<void(status_t, std::string const&, storage_error const&)> handler) override;
 	void async_release_files(storage_index_t storage
@@ -265,12 +279,48 @@ private:
 		// jobs on the job queue (m_queued_jobs)
 		std::condition_variable m_job_cond;
 
-		// jobs queued for servicing
-		jobqueue_t m_queued_jobs;
+		// jobs queued for servicing, by priority
+		aux::disk_job_queue m_queued_jobs;
 	};
 
 	void thread_fun(job_queue& queue, aux::disk_io_thread_pool& pool);
 
+	// a read job that's queued up, whose file range we want to hint to the
+	// operating system before the job is executed
+	struct prefetch_entry
+	{
+		std::shared_ptr<mmap_storage> storage;
+		piece_index_t piece{0};
+		int offset = 0;
+		int length = 0;
+		aux::open_mode_t mode{};
+	};
+
+	// collects up to disk_prefetch_queue_depth read jobs from the front of
+	// the queue that have not been prefetched yet. Must be called with the
+	// job mutex held. Returns the number of entries filled in
+	int collect_prefetch_jobs(job_queue& queue, span<prefetch_entry> entries);
+	void prefetch_jobs(span<prefetch_entry> entries);
+
+	// issue read-ahead for the sequential stream (if any) the read job j
+	// belongs to. Returns true if the range j is about to read has been
+	// prefetched
+	bool read_ahead(aux::mmap_disk_job* j);
+	void update_prefetch_stats(bool hit, std::int64_t read_time);
+
+	// if the dirty pages in the file pool exceed half of the write-back
+	// budget, flush them until they're down to a quarter of it. Only one
+	// thread flushes at a time
+	void write_back_dirty_pages();
+
+	// once the dirty pages drop below half of the write-back budget, notify
+	// the writers that were throttled
+	void check_write_back_level(std::int64_t dirty, std::int64_t limit);
+
+	// returns true if the write-back budget is exceeded, in which case o is
+	// notified once there's room again
+	bool write_back_exceeded(std::shared_ptr<disk_observer> o);
+
 	// returns true if the thread should exit
 	static bool wait_for_job(job_queue& jobq, aux::disk_io_thread_pool& threads
 		, std::unique_lock<std::mutex>& l);
@@ -282,6 +332,13 @@ private:
 
 	void perform_job(aux::mmap_disk_job* j, jobqueue_t& completed_jobs);
 
+	void async_read_impl(storage_index_t storage, peer_request const& r
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t flags, bool time_critical);
+	void async_hash_impl(storage_index_t storage, piece_index_t piece
+		, span<sha256_hash> v2, disk_job_flags_t flags, bool time_critical
+		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler);
+
 	// this queues up another job to be submitted
 	void add_job(aux::mmap_disk_job* j, bool user_add = true);
 	void add_fence_job(aux::mmap_disk_job* j, bool user_add = true);
@@ -297,6 +354,11 @@ private:
 	// returns the maximum number of threads
 	// the actual number of threads may be less
 	int num_threads() const;
+
+	// the max time a queued job is passed over in favor of higher priority
+	// jobs
+	time_duration aging_limit() const;
+
 	job_queue& queue_for_job(aux::mmap_disk_job* j);
 	aux::disk_io_thread_pool& pool_for_job(aux::mmap_disk_job* j);
 
@@ -325,9 +387,36 @@ private:
 	// LRU cache of open files
 	aux::file_view_pool m_file_pool;
 
+	// keeps track of sequential read streams, to prefetch data ahead of
+	// the peers requesting it
+	aux::read_ahead m_read_ahead;
+
+	// popular blocks, kept in memory to be served to peers without reading
+	// them from the file. Disabled unless disk_block_cache_size is set
+	aux::block_cache m_block_cache;
+
 	// disk cache
 	aux::disk_buffer_pool m_buffer_pool;
 
+	// the max number of bytes of dirty pages in the file pool, before
+	// writers are throttled. 0 means flushing is left to the operating
+	// system
+	std::atomic<std::int64_t> m_write_back_limit{0};
+
+	// true while a disk thread is flushing dirty pages
+	std::atomic<bool> m_flushing_dirty_pages{false};
+
+	// protects m_write_back_exceeded and m_write_back_observers
+	std::mutex m_write_back_mutex;
+
+	// set when the dirty pages exceed m_write_back_limit. Writers are
+	// throttled until they drop below half of it
+	bool m_write_back_exceeded = false;
+
+	// writers that were throttled. They are notified once enough dirty pages
+	// have been flushed
+	std::vector<std::weak_ptr<disk_observer>> m_write_back_observers;
+
 	// total number of blocks in use by both the read
 	// and the write cache. This is not supposed to
 	// exceed m_cache_size
@@ -339,6 +428,10 @@ private:
 	// the main thread.
 	io_context& m_ios;
 
+	// copies files ahead of moves to other file systems, while the storage
+	// keeps being used
+	aux::storage_mover m_mover;
+
 	// jobs that are completed are put on this queue
 	// whenever the queue size grows from 0 to 1
 	// a message is posted to the network thread, which
@@ -392,6 +485,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		, m_buffer_pool(ios)
 		, m_stats_counters(cnt)
 		, m_ios(ios)
+		, m_mover(ios)
 		, m_generic_io_jobs(*this)
 		, m_generic_threads(m_generic_io_jobs, ios)
 		, m_hash_io_jobs(*this)
@@ -405,6 +499,12 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		return m_file_pool.get_status(st);
 	}
 
+	std::pair<std::int64_t, std::int64_t> mmap_disk_io::move_storage_progress(
+		storage_index_t const st) const
+	{
+		return m_mover.progress(st);
+	}
+
 	storage_holder mmap_disk_io::new_torrent(storage_params const& params
 		, std::shared_ptr<void> const& owner)
 	{
@@ -425,6 +525,9 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		TORRENT_ASSERT(m_torrents[idx] != nullptr);
 		m_torrents[idx].reset();
 		m_free_slots.add(idx);
+		m_read_ahead.remove_storage(idx);
+		m_block_cache.erase_storage(idx);
+		m_mover.abort(idx);
 	}
 
 #if TORRENT_USE_ASSERTS
@@ -480,6 +583,9 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			i.get()->flags |= aux::mmap_disk_job::aborted;
 		l.unlock();
 
+		DLOG("aborting storage moves\n");
+		m_mover.abort();
+
 		// if there are no disk threads, we can't wait for the jobs here, because
 		// we'd stall indefinitely
 		if (no_threads)
@@ -500,6 +606,17 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		TORRENT_ASSERT(m_magic == 0x1337);
 		m_buffer_pool.set_settings(m_settings);
 		m_file_pool.resize(m_settings.get_int(settings_pack::file_pool_size));
+		m_file_pool.set_eviction_policy(m_settings.get_int(settings_pack::file_pool_eviction_policy));
+		m_file_pool.set_mapped_limit(std::int64_t(m_settings.get_int(settings_pack::file_pool_mapped_limit)) * 1024 * 1024);
+
+		std::int64_t const write_back_limit = std::int64_t(m_settings.get_int(
+			settings_pack::disk_write_back_limit)) * 1024 * 1024;
+		m_write_back_limit = write_back_limit;
+		m_file_pool.track_dirty_ranges(write_back_limit > 0);
+		if (write_back_limit <= 0) check_write_back_level(0, 0);
+
+		m_block_cache.set_max_size(std::int64_t(m_settings.get_int(
+			settings_pack::disk_block_cache_size)) * 1024 * 1024);
 
 		int const num_threads = m_settings.get_int(settings_pack::aio_threads);
 		int const num_hash_threads = m_settings.get_int(settings_pack::hashing_threads);
@@ -507,6 +624,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		m_generic_threads.set_max_threads(num_threads);
 		m_hash_threads.set_max_threads(num_hash_threads);
+		m_mover.set_max_threads(m_settings.get_int(settings_pack::move_storage_threads));
 	}
 
 	void mmap_disk_io::fail_jobs_impl(storage_error const& e, jobqueue_t& src, jobqueue_t& dst)
@@ -622,6 +740,8 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		aux::open_mode_t const file_mode = file_mode_for_job(j);
 		span<char> const b = {buffer.data() + j->d.io.buffer_offset, j->d.io.buffer_size};
 
+		bool const prefetch_hit = read_ahead(j);
+
 		int const ret = j->storage->read(m_settings, b
 			, j->piece, j->d.io.offset, file_mode, j->flags, j->error);
 
@@ -631,6 +751,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (!j->error.ec)
 		{
 			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+			update_prefetch_stats(prefetch_hit, read_time);
 
 			m_stats_counters.inc_stats_counter(counters::num_read_back);
 			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
@@ -657,6 +778,8 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		aux::open_mode_t const file_mode= file_mode_for_job(j);
 		span<char> const b = {buffer.data(), j->d.io.buffer_size};
 
+		bool const prefetch_hit = read_ahead(j);
+
 		int const ret = j->storage->read(m_settings, b
 			, j->piece, j->d.io.offset, file_mode, j->flags, j->error);
 
@@ -666,16 +789,115 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (!j->error.ec)
 		{
 			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+			update_prefetch_stats(prefetch_hit, read_time);
 
 			m_stats_counters.inc_stats_counter(counters::num_read_back);
 			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
 			m_stats_counters.inc_stats_counter(counters::num_read_ops);
 			m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
 			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+
+			// only whole blocks are cached, which is what peers normally
+			// request. The lookup in async_read() already counted this access
+			if (m_block_cache.enabled()
+				&& j->d.io.offset % default_block_size == 0
+				&& j->d.io.buffer_size == std::min(default_block_size
+					, j->storage->files().piece_size(j->piece) - j->d.io.offset))
+			{
+				m_block_cache.insert({j->storage->storage_index(), j->piece, j->d.io.offset}
+					, b, false);
+			}
 		}
 		return status_t::no_error;
 	}
 
+	bool mmap_disk_io::read_ahead(aux::mmap_disk_job* j)
+	{
+		bool hit = j->prefetched;
+
+		int const limit = m_settings.get_int(settings_pack::disk_read_ahead_limit);
+		if (limit <= 0) return hit;
+
+		file_storage const& fs = j->storage->files();
+		std::int64_t const offset = static_cast<int>(j->piece)
+			* std::int64_t(fs.piece_length()) + j->d.io.offset;
+		aux::read_ahead::result const r = m_read_ahead.on_read(
+			j->storage->storage_index(), offset, j->d.io.buffer_size
+			, fs.piece_length(), fs.total_size(), limit);
+
+		if (r.prefetch_length > 0)
+		{
+			piece_index_t const piece(static_cast<int>(r.prefetch_offset / fs.piece_length()));
+			int const piece_offset = static_cast<int>(r.prefetch_offset % fs.piece_length());
+
+			// this is best-effort. Any error will be reported by the read
+			// itself, if it runs into it
+			storage_error ignore;
+			j->storage->prefetch(m_settings, static_cast<std::ptrdiff_t>(r.prefetch_length)
+				, piece, piece_offset, file_mode_for_job(j), ignore);
+			m_stats_counters.inc_stats_counter(counters::num_prefetch_ops);
+		}
+		return hit || r.hit;
+	}
+
+	void mmap_disk_io::update_prefetch_stats(bool const hit, std::int64_t const read_time)
+	{
+		if (!hit)
+		{
+			m_stats_counters.inc_stats_counter(counters::num_prefetch_misses);
+			m_stats_counters.inc_stats_counter(counters::disk_prefetch_miss_time, read_time);
+			return;
+		}
+
+		m_stats_counters.inc_stats_counter(counters::num_prefetch_hits);
+		m_stats_counters.inc_stats_counter(counters::disk_prefetch_hit_time, read_time);
+
+		// estimate the time we saved by comparing against the average read
+		// that missed the prefetch
+		std::int64_t const misses = m_stats_counters[counters::num_prefetch_misses];
+		if (misses == 0) return;
+		std::int64_t const miss_time = m_stats_counters[counters::disk_prefetch_miss_time] / misses;
+		if (miss_time > read_time)
+			m_stats_counters.inc_stats_counter(counters::disk_prefetch_saved_time, miss_time - read_time);
+	}
+
+	int mmap_disk_io::collect_prefetch_jobs(job_queue& queue, span<prefetch_entry> entries)
+	{
+		int const depth = std::min(int(entries.size())
+			, m_settings.get_int(settings_pack::disk_prefetch_queue_depth));
+
+		int num = 0;
+		int i = 0;
+		for (auto it = queue.m_queued_jobs.iterate(); it.get() && i < depth; it.next(), ++i)
+		{
+			aux::mmap_disk_job* j = it.get();
+			if (j->action != aux::job_action_t::read
+				&& j->action != aux::job_action_t::partial_read)
+				continue;
+			if (j->prefetched || (j->flags & aux::mmap_disk_job::aborted))
+				continue;
+			j->prefetched = true;
+			auto& e = entries[num++];
+			e.storage = j->storage;
+			e.piece = j->piece;
+			e.offset = j->d.io.offset;
+			e.length = j->d.io.buffer_size;
+			e.mode = file_mode_for_job(j);
+		}
+		return num;
+	}
+
+	void mmap_disk_io::prefetch_jobs(span<prefetch_entry> entries)
+	{
+		for (auto& e : entries)
+		{
+			storage_error ignore;
+			e.storage->prefetch(m_settings, e.length, e.piece, e.offset, e.mode, ignore);
+			e.storage.reset();
+		}
+		m_stats_counters.inc_stats_counter(counters::num_prefetch_ops, entries.size());
+	}
+
 	status_t mmap_disk_io::do_write(aux::mmap_disk_job* j)
 	{
 		time_point const start_time = clock_type::now();
@@ -700,6 +922,12 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			m_stats_counters.inc_stats_counter(counters::num_write_ops);
 			m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
 			m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+
+			// once the piece passes the hash check, peers will start requesting
+			// the blocks we just downloaded. Offer them to the cache, so they
+			// can be uploaded without reading them back from disk
+			m_block_cache.insert({j->storage->storage_index(), j->piece, j->d.io.offset}
+				, b, true);
 		}
 
 		{
@@ -710,13 +938,105 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		m_store_buffer.erase({j->storage->storage_index(), j->piece, j->d.io.offset});
 
+		write_back_dirty_pages();
+
 		return ret != j->d.io.buffer_size
 			? status_t::fatal_disk_error : status_t::no_error;
 	}
 
-	void mmap_disk_io::async_read(storage_index_t storage, peer_request const& r
+	void mmap_disk_io::write_back_dirty_pages()
+	{
+		std::int64_t const limit = m_write_back_limit;
+		if (limit <= 0) return;
+
+		for (;;)
+		{
+			std::int64_t dirty = m_file_pool.dirty_bytes();
+			if (dirty >= limit)
+			{
+				std::lock_guard<std::mutex> l(m_write_back_mutex);
+				m_write_back_exceeded = true;
+			}
+			check_write_back_level(dirty, limit);
+			if (dirty < limit / 2) return;
+
+			// if another thread is already flushing, it will pick up the pages
+			// we just dirtied too
+			if (m_flushing_dirty_pages.exchange(true)) return;
+
+			time_point const start_time = clock_type::now();
+			while (dirty > limit / 4)
+			{
+				// while writers are throttled, wait for the pages to actually be
+				// written. Releasing the writers any sooner would just let them
+				// dirty more pages than the disk can keep up with
+				bool const wait = dirty >= limit;
+				auto const ret = m_file_pool.flush_dirty(dirty - limit / 4, wait);
+				if (ret.bytes == 0) break;
+				m_stats_counters.inc_stats_counter(counters::num_write_back_ops, ret.operations);
+				dirty = m_file_pool.dirty_bytes();
+				check_write_back_level(dirty, limit);
+			}
+			m_stats_counters.inc_stats_counter(counters::disk_write_back_time
+				, total_microseconds(clock_type::now() - start_time));
+			m_flushing_dirty_pages = false;
+
+			// another thread may have dirtied more pages after we stopped
+			// flushing, but before we cleared the flag. Check again
+		}
+	}
+
+	void mmap_disk_io::check_write_back_level(std::int64_t const dirty
+		, std::int64_t const limit)
+	{
+		std::vector<std::weak_ptr<disk_observer>> cbs;
+		{
+			std::lock_guard<std::mutex> l(m_write_back_mutex);
+			if (!m_write_back_exceeded || dirty > limit / 2) return;
+			m_write_back_exceeded = false;
+			m_write_back_observers.swap(cbs);
+		}
+		if (cbs.empty()) return;
+
+		post(m_ios, [cbs = std::move(cbs)]
+		{
+			for (auto const& i : cbs)
+			{
+				std::shared_ptr<disk_observer> o = i.lock();
+				if (o) o->on_disk();
+			}
+		});
+	}
+
+	bool mmap_disk_io::write_back_exceeded(std::shared_ptr<disk_observer> o)
+	{
+		if (m_write_back_limit <= 0) return false;
+
+		std::lock_guard<std::mutex> l(m_write_back_mutex);
+		if (!m_write_back_exceeded) return false;
+		m_stats_counters.inc_stats_counter(counters::num_write_back_throttled);
+		if (o) m_write_back_observers.push_back(std::move(o));
+		return true;
+	}
+
+	void mmap_disk_io::async_read(storage_index_t const storage, peer_request const& r
 		, std::function<void(disk_buffer_holder, storage_error const&)> handler
 		, disk_job_flags_t const flags)
+	{
+		async_read_impl(storage, r, std::move(handler), flags, false);
+	}
+
+	void mmap_disk_io::async_read_time_critical(storage_index_t const storage
+		, peer_request const& r
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		async_read_impl(storage, r, std::move(handler), flags, true);
+	}
+
+	void mmap_disk_io::async_read_impl(storage_index_t storage, peer_request const& r
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t const flags, bool const time_critical)
 	{
 		TORRENT_ASSERT(valid_flags(flags));
 		TORRENT_ASSERT(r.length <= default_block_size);
@@ -798,6 +1118,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				j->d.io.buffer_size = std::uint16_t((ret == 1) ? len1 : r.length - len1);
 				j->d.io.buffer_offset = std::uint16_t((ret == 1) ? 0 : len1);
 				j->flags = flags;
+				j->time_critical = time_critical;
 				j->callback = std::move(handler);
 
 				if (j->storage->is_blocked(j))
@@ -820,7 +1141,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		}
 		else
 		{
-			if (m_store_buffer.get({ storage, r.piece, block_offset }, [&](char const* buf)
+			auto const copy_block = [&](char const* buf)
 			{
 				buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), r.length);
 				if (!buffer)
@@ -831,7 +1152,11 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				}
 
 				std::memcpy(buffer.data(), buf + read_offset, std::size_t(r.length));
-			}))
+			};
+
+			if (m_store_buffer.get({ storage, r.piece, block_offset }, copy_block)
+				|| m_block_cache.get({ storage, r.piece, block_offset }
+					, read_offset + r.length, copy_block))
 			{
 				handler(std::move(buffer), ec);
 				return;
@@ -844,6 +1169,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->d.io.offset = r.start;
 		j->d.io.buffer_size = std::uint16_t(r.length);
 		j->flags = flags;
+		j->time_critical = time_critical;
 		j->callback = std::move(handler);
 
 		if (j->storage->is_blocked(j))
@@ -871,6 +1197,11 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (!buffer) aux::throw_ex<std::bad_alloc>();
 		std::memcpy(buffer.data(), buf, aux::numeric_cast<std::size_t>(r.length));
 
+		// when there are more dirty pages than the write-back budget allows,
+		// the writer is throttled the same way as when the disk buffer pool
+		// is full
+		if (write_back_exceeded(o)) exceeded = true;
+
 		TORRENT_ASSERT(r.start % default_block_size == 0);
 		TORRENT_ASSERT(r.length <= default_block_size);
 
@@ -903,6 +1234,21 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	void mmap_disk_io::async_hash(storage_index_t const storage
 		, piece_index_t const piece, span<sha256_hash> const v2, disk_job_flags_t const flags
 		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler)
+	{
+		async_hash_impl(storage, piece, v2, flags, false, std::move(handler));
+	}
+
+	void mmap_disk_io::async_hash_time_critical(storage_index_t const storage
+		, piece_index_t const piece, span<sha256_hash> const v2, disk_job_flags_t const flags
+		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler)
+	{
+		async_hash_impl(storage, piece, v2, flags, true, std::move(handler));
+	}
+
+	void mmap_disk_io::async_hash_impl(storage_index_t const storage
+		, piece_index_t const piece, span<sha256_hash> const v2, disk_job_flags_t const flags
+		, bool const time_critical
+		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler)
 	{
 		TORRENT_ASSERT(valid_flags(flags));
 		aux::mmap_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::hash);
@@ -911,6 +1257,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->d.h.block_hashes = v2;
 		j->callback = std::move(handler);
 		j->flags = flags;
+		j->time_critical = time_critical;
 		add_job(j);
 	}
 
@@ -1196,6 +1543,43 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// if this assert fails, something's wrong with the fence logic
 		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
 
+		if (m_settings.get_int(settings_pack::move_storage_threads) > 0)
+		{
+			auto files = j->storage->files_to_precopy(
+				boost::get<std::string>(j->argument), j->move_flags);
+			if (!files.empty())
+			{
+				// the files are moving to another file system, and have to be
+				// copied. Do that without holding the fence, the torrent keeps
+				// using the old location in the meantime. The move job is issued
+				// again once the copies are in place. The handler is taken out of
+				// this job, to not report it as complete
+				auto handler = std::move(boost::get<aux::mmap_disk_job::move_handler>(j->callback));
+				j->callback = aux::mmap_disk_job::move_handler();
+				storage_index_t const storage = j->storage->storage_index();
+				m_mover.async_copy(storage, std::move(files), j->storage->precopy_state()
+					, [this, storage, st = std::weak_ptr<mmap_storage>(j->storage)
+						, p = boost::get<std::string>(j->argument), flags = j->move_flags
+						, handler = std::move(handler)]
+					(error_code const& ec, file_index_t const file) mutable
+				{
+					auto s = st.lock();
+					if (!ec && s && m_torrents[storage] == s)
+					{
+						async_move_storage(storage, std::move(p), flags, std::move(handler));
+						submit_jobs();
+						return;
+					}
+					storage_error se;
+					se.ec = ec ? ec : error_code(boost::asio::error::operation_aborted);
+					se.file(file);
+					se.operation = operation_t::file_copy;
+					handler(status_t::fatal_disk_error, std::string(), se);
+				});
+				return status_t::no_error;
+			}
+		}
+
 		// if files have to be closed, that's the storage's responsibility
 		status_t ret;
 		std::string p;
@@ -1221,6 +1605,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// if this assert fails, something's wrong with the fence logic
 		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
 		j->storage->delete_files(boost::get<remove_flags_t>(j->argument), j->error);
+		m_block_cache.erase_storage(j->storage->storage_index());
 		return j->error ? status_t::fatal_disk_error : status_t::no_error;
 	}
 
@@ -1309,10 +1694,32 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		c.set_value(counters::queued_disk_jobs, m_generic_io_jobs.m_queued_jobs.size()
 			+ m_hash_io_jobs.m_queued_jobs.size());
 
+		for (int i = 0; i < aux::disk_job_queue::num_priorities; ++i)
+		{
+			auto const p = aux::job_priority_t(i);
+			std::int64_t queued = 0;
+			std::int64_t popped = 0;
+			std::int64_t queue_time = 0;
+			for (auto const* q : {&m_generic_io_jobs.m_queued_jobs, &m_hash_io_jobs.m_queued_jobs})
+			{
+				queued += q->size(p);
+				popped += q->num_popped(p);
+				queue_time += q->queue_time(p);
+			}
+			c.set_value(counters::queued_time_critical_jobs + i, queued);
+			c.set_value(counters::time_critical_queue_jobs + i, popped);
+			c.set_value(counters::time_critical_queue_time + i, queue_time);
+		}
+		c.set_value(counters::num_aged_disk_jobs, m_generic_io_jobs.m_queued_jobs.num_aged()
+			+ m_hash_io_jobs.m_queued_jobs.num_aged());
+
 		jl.unlock();
 
 		// gauges
 		c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
+
+		m_file_pool.update_stats_counters(c);
+		m_block_cache.update_stats_counters(c);
 	}
 
 	status_t mmap_disk_io::do_file_priority(aux::mmap_disk_job* j)
@@ -1326,10 +1733,12 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	// this job won't return until all outstanding jobs on this
 	// piece are completed or cancelled and the buffers for it
 	// have been evicted
-	status_t mmap_disk_io::do_clear_piece(aux::mmap_disk_job*)
+	status_t mmap_disk_io::do_clear_piece(aux::mmap_disk_job* j)
 	{
-		// there's nothing to do here, by the time this is called the jobs for
-		// this storage has been completed since this is a fence job
+		// by the time this is called the jobs for this storage has been
+		// completed since this is a fence job. The blocks of the piece are
+		// about to be downloaded again, drop any stale copy of them
+		m_block_cache.erase_piece(j->storage->storage_index(), j->piece);
 		return status_t::no_error;
 	}
 
@@ -1464,7 +1873,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	{
 		while (!m_generic_io_jobs.m_queued_jobs.empty())
 		{
-			aux::mmap_disk_job* j = m_generic_io_jobs.m_queued_jobs.pop_front();
+			aux::mmap_disk_job* j = m_generic_io_jobs.m_queued_jobs.pop_front(aging_limit());
 			execute_job(j);
 		}
 	}
@@ -1581,14 +1990,23 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		time_point next_flush_file = min_time();
 #endif
 
+		// read jobs further down the queue, whose file ranges we hint to the
+		// operating system before executing the job at the front
+		std::array<prefetch_entry, 64> prefetch;
+
 		for (;;)
 		{
 			aux::mmap_disk_job* j = nullptr;
 			bool const should_exit = wait_for_job(queue, pool, l);
 			if (should_exit) break;
-			j = queue.m_queued_jobs.pop_front();
+			j = queue.m_queued_jobs.pop_front(aging_limit());
+			int const num_prefetch = (&pool == &m_generic_threads)
+				? collect_prefetch_jobs(queue, prefetch) : 0;
 			l.unlock();
 
+			if (num_prefetch > 0)
+				prefetch_jobs(span<prefetch_entry>(prefetch).first(num_prefetch));
+
 			TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
 
 			if (&pool == &m_generic_threads && thread_id == pool.first_thread_id())
@@ -1624,6 +2042,11 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 					}
 				}
 
+				// closing files also drops their dirty pages from the budget.
+				// Make sure throttled writers are released even if no more
+				// writes come in
+				write_back_dirty_pages();
+
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 				if (now > next_flush_file)
 				{
@@ -1700,6 +2123,11 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		TORRENT_ASSERT(m_magic == 0x1337);
 	}
 
+	time_duration mmap_disk_io::aging_limit() const
+	{
+		return milliseconds(m_settings.get_int(settings_pack::disk_job_aging_limit));
+	}
+
 	int mmap_disk_io::num_threads() const
 	{
 		return m_generic_threads.max_threads() + m_hash_threads.max_threads();
@@ -103,6 +103,121 @@ error_code translate_error(std::system_error const& err, bool const write)
 
 #endif
 }
+
+	// returns the part of the range [offset, offset + size) of a file that can
+	// be transferred with direct I/O, as offsets relative to ``offset``. The
+	// unaligned head and tail are left to the file mapping, where the page
+	// cache takes care of the read-modify-write of the partial blocks. If
+	// there is no aligned block in the range, {size, size} is returned
+	std::pair<std::ptrdiff_t, std::ptrdiff_t> direct_io_range(
+		std::int64_t const offset, std::ptrdiff_t const size)
+	{
+		std::int64_t const align = aux::direct_io_alignment;
+		std::int64_t const start = (offset + align - 1) / align * align;
+		std::int64_t const end = (offset + size) / align * align;
+		if (end <= start) return {size, size};
+		return {std::ptrdiff_t(start - offset), std::ptrdiff_t(end - offset)};
+	}
+
+	bool is_aligned(char const* p)
+	{
+		return reinterpret_cast<std::uintptr_t>(p) % aux::direct_io_alignment == 0;
+	}
+
+	// disk buffers are aligned, but a file that starts at an unaligned offset
+	// in the torrent makes the part of the buffer mapping to an aligned file
+	// offset unaligned. Such transfers are staged through this buffer
+	span<char> bounce_buffer()
+	{
+		constexpr std::ptrdiff_t size = 4 * default_block_size;
+		thread_local std::unique_ptr<char[]> storage;
+		if (!storage) storage.reset(new char[size + aux::direct_io_alignment]);
+		char* const ptr = storage.get();
+		auto const misalignment = static_cast<std::ptrdiff_t>(
+			reinterpret_cast<std::uintptr_t>(ptr) % aux::direct_io_alignment);
+		return {ptr + (misalignment ? aux::direct_io_alignment - misalignment : 0), size};
+	}
+
+	// the range passed to direct_read() and direct_write() is aligned. A
+	// short transfer, e.g. at the end of a file that was truncated, would
+	// leave the rest of it unaligned, which O_DIRECT rejects. So a short
+	// transfer is an error, rather than something to retry
+	int direct_read(aux::file_view& handle, span<char> buf
+		, std::int64_t offset, error_code& ec)
+	{
+		if (is_aligned(buf.data()))
+		{
+			int const ret = handle.pread(buf, offset, ec);
+			if (ec) return -1;
+			if (ret < buf.size())
+			{
+				ec = boost::asio::error::eof;
+				return -1;
+			}
+			return ret;
+		}
+
+		span<char> const bounce = bounce_buffer();
+		int ret = 0;
+		while (!buf.empty())
+		{
+			span<char> const chunk = bounce.first(std::min(buf.size(), bounce.size()));
+			int const r = handle.pread(chunk, offset, ec);
+			if (ec) return -1;
+			if (r < chunk.size())
+			{
+				ec = boost::asio::error::eof;
+				return -1;
+			}
+			std::memcpy(buf.data(), chunk.data(), static_cast<std::size_t>(r));
+			buf = buf.subspan(r);
+			offset += r;
+			ret += r;
+		}
+		return ret;
+	}
+
+	// the pages written here bypass the page cache, while the same file is
+	// also mapped. Linux writes back dirty cached pages in the range before,
+	// and invalidates them after, a direct write, so the mapping doesn't
+	// see stale data. The exception is a page touched through the mapping
+	// while the write is in flight. The unaligned head and tail of a block
+	// are on different pages than its aligned middle, and disk jobs don't
+	// read a block while it's being written, so that doesn't happen here
+	int direct_write(aux::file_view& handle, span<char const> buf
+		, std::int64_t offset, error_code& ec)
+	{
+		if (is_aligned(buf.data()))
+		{
+			int const ret = handle.pwrite(buf, offset, ec);
+			if (ec) return -1;
+			if (ret < buf.size())
+			{
+				ec = boost::system::errc::make_error_code(boost::system::errc::io_error);
+				return -1;
+			}
+			return ret;
+		}
+
+		span<char> const bounce = bounce_buffer();
+		int ret = 0;
+		while (!buf.empty())
+		{
+			span<char> const chunk = bounce.first(std::min(buf.size(), bounce.size()));
+			std::memcpy(chunk.data(), buf.data(), static_cast<std::size_t>(chunk.size()));
+			int const r = handle.pwrite(chunk, offset, ec);
+			if (ec) return -1;
+			if (r < chunk.size())
+			{
+				ec = boost::system::errc::make_error_code(boost::system::errc::io_error);
+				return -1;
+			}
+			buf = buf.subspan(r);
+			offset += r;
+			ret += r;
+		}
+		return ret;
+	}
 } // namespace
 
 
@@ -163,6 +278,9 @@ error_code translate_error(std::system_error const& err, bool const write)
 			download_priority_t new_prio = prio[i];
 			if (old_prio == dont_download && new_prio != dont_download)
 			{
+				if (m_precopy)
+					m_precopy->written[std::size_t(static_cast<int>(i))] = true;
+
 				// move stuff out of the part file
 				boost::optional<aux::file_view> f = open_file(sett, i, aux::open_mode::write, ec);
 				if (ec)
@@ -175,7 +293,7 @@ error_code translate_error(std::system_error const& err, bool const write)
 				{
 					try
 					{
-						m_part_file->export_file([&f](std::int64_t file_offset, span<char> buf)
+						auto copy_block = [&f](std::int64_t file_offset, span<char> buf)
 							{
 							auto file_range = f->range().subspan(std::ptrdiff_t(file_offset));
 							TORRENT_ASSERT(file_range.size() >= buf.size());
@@ -183,7 +301,23 @@ error_code translate_error(std::system_error const& err, bool const write)
 								std::memcpy(const_cast<char*>(file_range.data()), buf.data()
 									, static_cast<std::size_t>(buf.size()));
 								});
-							}, fs.file_offset(i), fs.file_size(i), ec.ec);
+							};
+
+						// if we can open a file descriptor for the file, the file
+						// system may be able to move the pieces into it without
+						// copying them through memory
+						aux::file_handle dst;
+						try
+						{
+							dst = aux::file_handle(fs.file_path(i, m_save_path)
+								, fs.file_size(i), aux::open_mode::write);
+						}
+						catch (storage_error const&) {}
+
+						if (dst.fd() != invalid_handle)
+							m_part_file->export_file(dst, copy_block, fs.file_offset(i), fs.file_size(i), ec.ec);
+						else
+							m_part_file->export_file(copy_block, fs.file_offset(i), fs.file_size(i), ec.ec);
 
 						if (ec)
 						{
@@ -376,6 +510,10 @@ error_code translate_error(std::system_error const& err, bool const write)
 		std::string const old_name = files().file_path(index, m_save_path);
 		m_pool.release(storage_index(), index);
 
+		// a copy made ahead of a move has the old name
+		if (m_precopy)
+			m_precopy->written[std::size_t(static_cast<int>(index))] = true;
+
 		// if the old file doesn't exist, just succeed and change the filename
 		// that will be created. This shortcut is important because the
 		// destination directory may not exist yet, which would cause a failure
@@ -465,6 +603,7 @@ error_code translate_error(std::system_error const& err, bool const write)
 		// release the underlying part file. Otherwise we may not be able to
 		// delete it
 		if (m_part_file) m_part_file.reset();
+		m_precopy.reset();
 
 		aux::delete_files(files(), m_save_path, m_part_file_name, options, ec);
 	}
@@ -488,8 +627,24 @@ error_code translate_error(std::system_error const& err, bool const write)
 			if (!m_part_file) return;
 			m_part_file->move_partfile(new_save_path, e);
 		};
+
+		std::shared_ptr<aux::precopy_state> precopy;
+		if (m_precopy && m_precopy->destination == complete(save_path))
+			precopy = m_precopy;
+		auto precopied_path = [&](file_index_t const i)
+		{
+			if (!precopy || !precopy->is_copied(i)) return std::string();
+			return aux::precopy_path(files().file_path(i, precopy->destination));
+		};
+
 		std::tie(ret, m_save_path) = aux::move_storage(files(), m_save_path, std::move(save_path)
-			, std::move(move_partfile), flags, ec);
+			, std::move(move_partfile), std::move(precopied_path), flags, ec);
+
+		// if the move failed, the copies are kept for the next attempt.
+		// Otherwise the up-to-date ones are in place now, and the stale ones
+		// (as well as copies made for a different destination) are deleted
+		// along with m_precopy
+		if (!ec) m_precopy.reset();
 
 		// clear the stat cache in case the new location has new files
 		m_stat_cache.clear();
@@ -497,6 +652,65 @@ error_code translate_error(std::system_error const& err, bool const write)
 		return { ret, m_save_path };
 	}
 
+	std::vector<aux::storage_mover::file_copy> mmap_storage::files_to_precopy(
+		std::string const& save_path, move_flags_t const flags)
+	{
+		std::vector<aux::storage_mover::file_copy> ret;
+
+		// when failing if files exist at the destination, nothing may be put
+		// there before the check is made (by the move itself). When resetting
+		// the save path, nothing is copied at all
+		if (flags != move_flags_t::always_replace_files
+			&& flags != move_flags_t::dont_replace)
+			return ret;
+
+		std::string const destination = complete(save_path);
+		if (m_precopy && m_precopy->destination == destination
+			&& m_precopy->complete)
+			return ret;
+
+		error_code ec;
+		if (path_equal(destination, m_save_path)
+			|| same_filesystem(m_save_path, destination, ec)
+			|| ec)
+			return ret;
+
+		// if we've already copied some files into the same destination, only
+		// the remaining ones (and the ones written to since) need to be copied
+		file_storage const& fs = files();
+		if (!m_precopy || m_precopy->destination != destination)
+			m_precopy = std::make_shared<aux::precopy_state>(destination, fs.num_files());
+		m_precopy->complete = false;
+
+		for (auto const i : fs.file_range())
+		{
+			// files moved out to absolute paths are not moved
+			if (fs.file_absolute_path(i) || fs.pad_file_at(i)) continue;
+			if (m_precopy->is_copied(i)) continue;
+
+			std::string source = fs.file_path(i, m_save_path);
+			std::string const dest = fs.file_path(i, destination);
+
+			// files that don't exist (yet) are left to the move itself
+			file_status st;
+			stat_file(source, &st, ec);
+			if (ec) continue;
+
+			if (flags == move_flags_t::dont_replace && exists(dest, ec))
+				continue;
+
+			auto const idx = std::size_t(static_cast<int>(i));
+			m_precopy->copied[idx] = false;
+			m_precopy->written[idx] = false;
+			// the copy is renamed into place by the move itself. Until then,
+			// an existing file at the destination is left alone
+			ret.push_back({i, std::move(source), aux::precopy_path(dest), st.file_size});
+		}
+
+		if (ret.empty()) m_precopy->complete = true;
+		return ret;
+	}
+
 	int mmap_storage::read(settings_interface const& sett
 		, span<char> buffer
 		, piece_index_t const piece, int const offset
@@ -507,8 +721,10 @@ error_code translate_error(std::system_error const& err, bool const write)
 #ifdef TORRENT_SIMULATE_SLOW_READ
 		std::this_thread::sleep_for(seconds(1));
 #endif
+		bool const use_direct_io = sett.get_int(settings_pack::disk_io_read_mode)
+			== settings_pack::direct_io;
 		return readwrite(files(), buffer, piece, offset, error
-			, [this, mode, flags, &sett](file_index_t const file_index
+			, [this, mode, flags, use_direct_io, &sett](file_index_t const file_index
 				, std::int64_t const file_offset
 				, span<char> buf, storage_error& ec)
 		{
@@ -557,11 +773,32 @@ error_code translate_error(std::system_error const& err, bool const write)
 				{
 					if (file_range.size() < buf.size()) buf = buf.first(file_range.size());
 
+					// the aligned middle part of the buffer, to be read with
+					// direct I/O. The rest is copied from the mapping
+					auto const direct = use_direct_io && handle->direct_io()
+						? direct_io_range(file_offset, buf.size())
+						: std::make_pair(buf.size(), buf.size());
+
 					sig::try_signal([&]{
 						std::memcpy(buf.data(), const_cast<char*>(file_range.data())
-							, static_cast<std::size_t>(buf.size()));
+							, static_cast<std::size_t>(direct.first));
+						std::memcpy(buf.data() + direct.second
+							, const_cast<char*>(file_range.data()) + direct.second
+							, static_cast<std::size_t>(buf.size() - direct.second));
 						});
 
+					if (direct.first < direct.second)
+					{
+						error_code e;
+						direct_read(*handle, buf.subspan(direct.first
+							, direct.second - direct.first), file_offset + direct.first, e);
+						if (e)
+						{
+							ec.ec = e;
+							return -1;
+						}
+					}
+
 					if (flags & disk_interface::volatile_read)
 						handle->dont_need(file_range.first(buf.size()));
 					if (flags & disk_interface::flush_piece)
@@ -588,8 +825,10 @@ error_code translate_error(std::system_error const& err, bool const write)
 		, disk_job_flags_t const flags
 		, storage_error& error)
 	{
+		bool const use_direct_io = sett.get_int(settings_pack::disk_io_write_mode)
+			== settings_pack::direct_io;
 		return readwrite(files(), buffer, piece, offset, error
-			, [this, mode, flags, &sett](file_index_t const file_index
+			, [this, mode, flags, use_direct_io, &sett](file_index_t const file_index
 				, std::int64_t const file_offset
 				, span<char> buf, storage_error& ec)
 		{
@@ -623,12 +862,17 @@ error_code translate_error(std::system_error const& err, bool const write)
 			// we're writing to it
 			m_stat_cache.set_dirty(file_index);
 
+			// as well as any copy made of it ahead of moving the storage
+			if (m_precopy)
+				m_precopy->written[std::size_t(static_cast<int>(file_index))] = true;
+
 			auto handle = open_file(sett, file_index
 				, aux::open_mode::write | mode, ec);
 			if (ec) return -1;
 
 			int ret = 0;
 			span<byte> file_range = handle->range().subspan(static_cast<std::ptrdiff_t>(file_offset));
+			std::pair<std::ptrdiff_t, std::ptrdiff_t> direct;
 
 			// set this unconditionally in case the upper layer would like to treat
 			// short reads as errors
@@ -638,10 +882,32 @@ error_code translate_error(std::system_error const& err, bool const write)
 			{
 				TORRENT_ASSERT(file_range.size() >= buf.size());
 
+				// the aligned middle part of the buffer is written with direct
+				// I/O. The rest is copied into the mapping
+				direct = use_direct_io && handle->direct_io()
+					? direct_io_range(file_offset, buf.size())
+					: std::make_pair(buf.size(), buf.size());
+
 				sig::try_signal([&]{
-					std::memcpy(const_cast<char*>(file_range.data()), buf.data(), static_cast<std::size_t>(buf.size()));
+					std::memcpy(const_cast<char*>(file_range.data()), buf.data()
+						, static_cast<std::size_t>(direct.first));
+					std::memcpy(const_cast<char*>(file_range.data()) + direct.second
+						, buf.data() + direct.second
+						, static_cast<std::size_t>(buf.size() - direct.second));
 					});
 
+				if (direct.first < direct.second)
+				{
+					error_code e;
+					direct_write(*handle, buf.subspan(direct.first
+						, direct.second - direct.first), file_offset + direct.first, e);
+					if (e)
+					{
+						ec.ec = e;
+						return -1;
+					}
+				}
+
 				file_range = file_range.subspan(buf.size());
 				ret += static_cast<int>(buf.size());
 
@@ -656,9 +922,18 @@ error_code translate_error(std::system_error const& err, bool const write)
 				return -1;
 			}
 
-#if TORRENT_HAVE_MAP_VIEW_OF_FILE
-			m_pool.record_file_write(storage_index(), file_index, ret);
-#endif
+			// only the part written through the mapping is left dirty in the
+			// page cache
+			if (direct.first > 0)
+			{
+				m_pool.record_file_write(storage_index(), file_index, file_offset
+					, std::uint64_t(direct.first));
+			}
+			if (direct.second < ret)
+			{
+				m_pool.record_file_write(storage_index(), file_index
+					, file_offset + direct.second, std::uint64_t(ret - direct.second));
+			}
 
 			return ret;
 		});
@@ -780,6 +1055,39 @@ error_code translate_error(std::system_error const& err, bool const write)
 		return static_cast<int>(file_range.size());
 	}
 
+	int mmap_storage::prefetch(settings_interface const& sett
+		, std::ptrdiff_t const len
+		, piece_index_t const piece, int const offset
+		, aux::open_mode_t const mode
+		, storage_error& error)
+	{
+		char dummy;
+		return readwrite(files(), {&dummy, len}, piece, offset, error
+			, [this, mode, &sett](file_index_t const file_index
+				, std::int64_t const file_offset
+				, span<char> const buf, storage_error& ec)
+		{
+			// there's nothing to prefetch from pad files, and the part file
+			// is not mapped
+			if (files().pad_file_at(file_index)
+				|| (file_index < m_file_priority.end_index()
+					&& m_file_priority[file_index] == dont_download
+					&& use_partfile(file_index)))
+				return int(buf.size());
+
+			auto handle = open_file(sett, file_index, mode, ec);
+			if (ec) return -1;
+
+			span<byte const> file_range = handle->range();
+			if (file_range.size() <= file_offset) return int(buf.size());
+
+			file_range = file_range.subspan(std::ptrdiff_t(file_offset)
+				, std::min(buf.size(), std::ptrdiff_t(file_range.size() - file_offset)));
+			handle->will_need(file_range);
+			return int(buf.size());
+		});
+	}
+
 	// a wrapper around open_file_impl that, if it fails, makes sure the
 	// directories have been created and retries
 	boost::optional<aux::file_view> mmap_storage::open_file(settings_interface const& sett
@@ -882,6 +1190,14 @@ error_code translate_error(std::system_error const& err, bool const write)
 			mode |= aux::open_mode::no_cache;
 		}
 
+		// the mapping is unaffected by this. It only applies to the I/O made
+		// through the file descriptor
+		if (write_mode == settings_pack::direct_io
+			|| sett.get_int(settings_pack::disk_io_read_mode) == settings_pack::direct_io)
+		{
+			mode |= aux::open_mode::direct_io;
+		}
+
 		try {
 			return m_pool.open_file(storage_index(), m_save_path, file
 				, files(), mode
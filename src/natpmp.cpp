@@ -153,6 +153,14 @@ natpmp::natpmp(io_context& ios
 }
 
 void natpmp::start(ip_interface const& ip)
+{
+	error_code ec;
+	auto const routes = enum_routes(m_ioc, ec);
+	start(ip, routes, ec);
+}
+
+void natpmp::start(ip_interface const& ip, span<ip_route const> const routes
+	, error_code const& route_ec)
 {
 	TORRENT_ASSERT(is_single_thread());
 
@@ -162,8 +170,7 @@ void natpmp::start(ip_interface const& ip)
 
 	address const& local_address = ip.interface_address;
 
-	error_code ec;
-	auto const routes = enum_routes(m_ioc, ec);
+	error_code ec = route_ec;
 	if (ec)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -62,6 +62,10 @@ POSSIBILITY OF SUCH DAMAGE.
   // header to an even multiple of 1024 bytes.
   uint8_t padding[n];
 
+  Once the header has been written, only the piece entries that change are
+  written back when the metadata is flushed. Slots that are freed have their
+  disk space released (punched), until they are reused.
+
 */
 
 #include "libtorrent/part_file.hpp"
@@ -73,6 +77,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <functional> // for std::function
 #include <cstdint>
+#include <algorithm>
 
 namespace {
 
@@ -94,6 +99,8 @@ namespace libtorrent {
 		TORRENT_ASSERT(num_pieces > 0);
 		TORRENT_ASSERT(m_piece_size > 0);
 
+		m_piece_map.resize(num_pieces, slot_index_t(-1));
+
 		error_code ec;
 		auto f = open_file(aux::open_mode::read_only, ec);
 		if (ec) return;
@@ -135,7 +142,9 @@ namespace libtorrent {
 
 			free_slots[slot] = false;
 			m_piece_map[i] = slot;
+			++m_num_pieces;
 		}
+		m_header_on_disk = true;
 
 		// now, populate the free_list with the "holes"
 		for (slot_index_t i(0); i < m_num_allocated; ++i)
@@ -154,7 +163,7 @@ namespace libtorrent {
 	{
 		// the mutex is assumed to be held here, since this is a private function
 
-		TORRENT_ASSERT(m_piece_map.find(piece) == m_piece_map.end());
+		TORRENT_ASSERT(m_piece_map[piece] == slot_index_t(-1));
 		slot_index_t slot(-1);
 		if (!m_free_slots.empty())
 		{
@@ -168,10 +177,24 @@ namespace libtorrent {
 		}
 
 		m_piece_map[piece] = slot;
-		m_dirty_metadata = true;
+		++m_num_pieces;
+		mark_dirty(piece);
 		return slot;
 	}
 
+	void part_file::mark_dirty(piece_index_t const piece)
+	{
+		if (!m_dirty_metadata)
+		{
+			m_dirty_first = piece;
+			m_dirty_last = piece;
+			m_dirty_metadata = true;
+			return;
+		}
+		m_dirty_first = std::min(m_dirty_first, piece);
+		m_dirty_last = std::max(m_dirty_last, piece);
+	}
+
 	int part_file::write(span<char> buf, piece_index_t const piece
 		, int const offset, error_code& ec)
 	{
@@ -182,9 +205,8 @@ namespace libtorrent {
 		auto f = open_file(aux::open_mode::write | aux::open_mode::hidden, ec);
 		if (ec) return -1;
 
-		auto const i = m_piece_map.find(piece);
-		slot_index_t const slot = (i == m_piece_map.end())
-			? allocate_slot(piece) : i->second;
+		slot_index_t const slot = (m_piece_map[piece] == slot_index_t(-1))
+			? allocate_slot(piece) : m_piece_map[piece];
 
 		l.unlock();
 
@@ -199,14 +221,13 @@ namespace libtorrent {
 		TORRENT_ASSERT(int(buf.size()) + offset <= m_piece_size);
 		std::unique_lock<std::mutex> l(m_mutex);
 
-		auto const i = m_piece_map.find(piece);
-		if (i == m_piece_map.end())
+		slot_index_t const slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1))
 		{
 			ec = make_error_code(boost::system::errc::no_such_file_or_directory);
 			return -1;
 		}
 
-		slot_index_t const slot = i->second;
 		l.unlock();
 
 		auto f = open_file(aux::open_mode::read_only | aux::open_mode::hidden, ec);
@@ -242,15 +263,14 @@ namespace libtorrent {
 		TORRENT_ASSERT(int(len) + offset <= m_piece_size);
 		std::unique_lock<std::mutex> l(m_mutex);
 
-		auto const i = m_piece_map.find(piece);
-		if (i == m_piece_map.end())
+		slot_index_t const slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1))
 		{
 			ec = error_code(boost::system::errc::no_such_file_or_directory
 				, boost::system::generic_category());
 			return -1;
 		}
 
-		slot_index_t const slot = i->second;
 		auto f = open_file(aux::open_mode::read_only | aux::open_mode::hidden, ec);
 		if (ec) return -1;
 
@@ -292,19 +312,39 @@ namespace libtorrent {
 
 	void part_file::free_piece(piece_index_t const piece)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
+		std::unique_lock<std::mutex> l(m_mutex);
+		free_piece_impl(piece, l);
+	}
 
-		auto const i = m_piece_map.find(piece);
-		if (i == m_piece_map.end()) return;
+	void part_file::free_piece_impl(piece_index_t const piece
+		, std::unique_lock<std::mutex>& l)
+	{
+		TORRENT_UNUSED(l);
+		TORRENT_ASSERT(l.owns_lock());
+		slot_index_t const slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1)) return;
 
 		// TODO: what do we do if someone is currently reading from the disk
 		// from this piece? does it matter? Since we won't actively erase the
 		// data from disk, but it may be overwritten soon, it's probably not that
 		// big of a deal
 
-		m_free_slots.push_back(i->second);
-		m_piece_map.erase(i);
-		m_dirty_metadata = true;
+		m_piece_map[piece] = slot_index_t(-1);
+		--m_num_pieces;
+		mark_dirty(piece);
+
+		// release the disk space of the slot. This holds the mutex, since
+		// flush_metadata_impl() may delete the file once it's empty. If this
+		// was the last piece, the file is about to be deleted anyway
+		if (m_num_pieces > 0)
+		{
+			error_code ec;
+			auto f = open_file(aux::open_mode::write | aux::open_mode::hidden
+				| aux::open_mode::sparse, ec);
+			if (!ec) aux::punch_hole(f.fd(), slot_offset(slot), m_piece_size);
+		}
+
+		m_free_slots.push_back(slot);
 	}
 
 	void part_file::move_partfile(std::string const& path, error_code& ec)
@@ -314,7 +354,7 @@ namespace libtorrent {
 		flush_metadata_impl(ec);
 		if (ec) return;
 
-		if (!m_piece_map.empty())
+		if (m_num_pieces > 0)
 		{
 			std::string old_path = combine_path(m_path, m_name);
 			std::string new_path = combine_path(path, m_name);
@@ -334,12 +374,26 @@ namespace libtorrent {
 	}
 
 	void part_file::export_file(std::function<void(std::int64_t, span<char>)> f
+		, std::int64_t const offset, std::int64_t const size, error_code& ec)
+	{
+		export_file_impl(nullptr, f, offset, size, ec);
+	}
+
+	void part_file::export_file(aux::file_handle const& dst
+		, std::function<void(std::int64_t, span<char>)> f
+		, std::int64_t const offset, std::int64_t const size, error_code& ec)
+	{
+		export_file_impl(&dst, f, offset, size, ec);
+	}
+
+	void part_file::export_file_impl(aux::file_handle const* dst
+		, std::function<void(std::int64_t, span<char>)> const& f
 		, std::int64_t const offset, std::int64_t size, error_code& ec)
 	{
 		std::unique_lock<std::mutex> l(m_mutex);
 
 		// there's nothing stored in the part_file. Nothing to do
-		if (m_piece_map.empty()) return;
+		if (m_num_pieces == 0) return;
 
 		piece_index_t piece(int(offset / m_piece_size));
 		piece_index_t const end = piece_index_t(int(((offset + size) + m_piece_size - 1) / m_piece_size));
@@ -354,24 +408,42 @@ namespace libtorrent {
 
 		for (; piece < end; ++piece)
 		{
-			auto const i = m_piece_map.find(piece);
+			slot_index_t const slot = m_piece_map[piece];
 			int const block_to_copy = int(std::min(m_piece_size - piece_offset, size));
-			if (i != m_piece_map.end())
+			if (slot != slot_index_t(-1))
 			{
-				slot_index_t const slot = i->second;
-
-				if (!buf) buf.reset(new char[std::size_t(m_piece_size)]);
-
 				// don't hold the lock during disk I/O
 				l.unlock();
 
-				span<char> v = {buf.get(), block_to_copy};
-				auto bytes_read = aux::pread_all(file.fd(), v, slot_offset(slot) + piece_offset, ec);
-				v = v.first(static_cast<std::ptrdiff_t>(bytes_read));
-				TORRENT_ASSERT(!ec);
-				if (ec || v.empty()) return;
+				// first try to have the file system copy the data, or share its
+				// extents between the files, without reading it into memory
+				std::int64_t cloned = 0;
+				if (dst != nullptr)
+				{
+					cloned = aux::clone_range(file.fd(), slot_offset(slot) + piece_offset
+						, dst->fd(), file_offset, block_to_copy, ec);
+					if (ec == boost::system::errc::operation_not_supported)
+					{
+						// don't try again for the remaining pieces
+						dst = nullptr;
+						ec.clear();
+					}
+					if (ec) return;
+				}
 
-				f(file_offset, {buf.get(), block_to_copy});
+				if (cloned < block_to_copy)
+				{
+					if (!buf) buf.reset(new char[std::size_t(m_piece_size)]);
+
+					span<char> v = {buf.get(), block_to_copy - cloned};
+					auto bytes_read = aux::pread_all(file.fd(), v
+						, slot_offset(slot) + piece_offset + cloned, ec);
+					v = v.first(static_cast<std::ptrdiff_t>(bytes_read));
+					TORRENT_ASSERT(!ec);
+					if (ec || v.empty()) return;
+
+					f(file_offset + cloned, {buf.get(), block_to_copy - cloned});
+				}
 
 				// we're done with the disk I/O, grab the lock again to update
 				// the slot map
@@ -380,18 +452,11 @@ namespace libtorrent {
 				if (block_to_copy == m_piece_size)
 				{
 					// since we released the lock, it's technically possible that
-					// another thread removed this slot map entry, and invalidated
-					// our iterator. Now that we hold the lock again, perform
-					// another lookup to be sure.
-					auto const j = m_piece_map.find(piece);
-					if (j != m_piece_map.end())
-					{
-						// if the slot moved, that's really suspicious
-						TORRENT_ASSERT(j->second == slot);
-						m_free_slots.push_back(j->second);
-						m_piece_map.erase(j);
-						m_dirty_metadata = true;
-					}
+					// another thread freed this slot. If the slot moved, that's
+					// really suspicious
+					TORRENT_ASSERT(m_piece_map[piece] == slot
+						|| m_piece_map[piece] == slot_index_t(-1));
+					free_piece_impl(piece, l);
 				}
 			}
 			file_offset += block_to_copy;
@@ -414,11 +479,12 @@ namespace libtorrent {
 		// do we need to flush the metadata?
 		if (m_dirty_metadata == false) return;
 
-		if (m_piece_map.empty())
+		if (m_num_pieces == 0)
 		{
 			// if we don't have any pieces left in the
 			// part file, remove it
 			std::string const p = combine_path(m_path, m_name);
+			m_header_on_disk = false;
 			remove(p, ec);
 
 			if (ec == boost::system::errc::no_such_file_or_directory)
@@ -429,24 +495,35 @@ namespace libtorrent {
 		auto f = open_file(aux::open_mode::write | aux::open_mode::hidden, ec);
 		if (ec) return;
 
-		std::vector<char> header(static_cast<std::size_t>(m_header_size));
-
 		using namespace libtorrent::aux;
 
+		if (m_header_on_disk)
+		{
+			// only the entries of the pieces that changed need updating
+			std::vector<char> entries(std::size_t(
+				static_cast<int>(m_dirty_last) - static_cast<int>(m_dirty_first) + 1) * 4);
+			char* ptr = entries.data();
+			for (piece_index_t piece = m_dirty_first; piece <= m_dirty_last; ++piece)
+				write_int32(static_cast<int>(m_piece_map[piece]), ptr);
+			aux::pwrite_all(f.fd(), entries
+				, (2 + std::int64_t(static_cast<int>(m_dirty_first))) * 4, ec);
+			if (ec) return;
+			m_dirty_metadata = false;
+			return;
+		}
+
+		std::vector<char> header(static_cast<std::size_t>(m_header_size));
+
 		char* ptr = header.data();
 		write_uint32(m_max_pieces, ptr);
 		write_uint32(m_piece_size, ptr);
 
 		for (piece_index_t piece(0); piece < piece_index_t(m_max_pieces); ++piece)
-		{
-			auto const i = m_piece_map.find(piece);
-			slot_index_t const slot(i == m_piece_map.end()
-				? slot_index_t(-1) : i->second);
-			write_int32(static_cast<int>(slot), ptr);
-		}
+			write_int32(static_cast<int>(m_piece_map[piece]), ptr);
 		std::memset(ptr, 0, std::size_t(m_header_size - (ptr - header.data())));
 		aux::pwrite_all(f.fd(), header, 0, ec);
 		if (ec) return;
+		m_header_on_disk = true;
 		m_dirty_metadata = false;
 	}
 }
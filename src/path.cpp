@@ -326,6 +326,56 @@ namespace {
 #endif // TORRENT_WINDOWS
 	}
 
+	namespace {
+
+	std::string closest_existing_path(std::string p)
+	{
+		error_code ignore;
+		while (!exists(p, ignore))
+		{
+			std::string parent = parent_path(p);
+			if (parent.empty() || parent == p) break;
+			p = std::move(parent);
+		}
+		return p;
+	}
+
+	}
+
+	bool same_filesystem(std::string const& f1, std::string const& f2
+		, error_code& ec)
+	{
+		ec.clear();
+		native_path_string const n1 = convert_to_native_path_string(closest_existing_path(f1));
+		native_path_string const n2 = convert_to_native_path_string(closest_existing_path(f2));
+
+#if defined TORRENT_WINRT
+		TORRENT_UNUSED(n1);
+		TORRENT_UNUSED(n2);
+		// there's no way to query the volume of a path. Assume the common case
+		return true;
+#elif defined TORRENT_WINDOWS
+		wchar_t v1[MAX_PATH + 1];
+		wchar_t v2[MAX_PATH + 1];
+		if (GetVolumePathNameW(n1.c_str(), v1, MAX_PATH + 1) == FALSE
+			|| GetVolumePathNameW(n2.c_str(), v2, MAX_PATH + 1) == FALSE)
+		{
+			ec.assign(GetLastError(), system_category());
+			return false;
+		}
+		return _wcsicmp(v1, v2) == 0;
+#else
+		struct ::stat s1;
+		struct ::stat s2;
+		if (::stat(n1.c_str(), &s1) < 0 || ::stat(n2.c_str(), &s2) < 0)
+		{
+			ec.assign(errno, system_category());
+			return false;
+		}
+		return s1.st_dev == s2.st_dev;
+#endif
+	}
+
 	void rename(std::string const& inf, std::string const& newf, error_code& ec)
 	{
 		ec.clear();
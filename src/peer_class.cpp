@@ -63,6 +63,12 @@ namespace libtorrent {
 		pci->download_priority = priority[peer_connection::download_channel];
 	}
 
+	void peer_class::get_stats(peer_class_stats* pcs) const
+	{
+		pcs->total_upload = total_transferred[peer_connection::upload_channel];
+		pcs->total_download = total_transferred[peer_connection::download_channel];
+	}
+
 	void peer_class::set_info(peer_class_info const* pci)
 	{
 		ignore_unchoke_slots = pci->ignore_unchoke_slots;
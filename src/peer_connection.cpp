@@ -361,6 +361,11 @@ namespace libtorrent {
 
 		m_ses.set_peer_classes(this, m_remote.address(), socket_type_idx(m_socket));
 
+		// the local address of outgoing connections isn't known until they
+		// are connected
+		if (!m_connecting)
+			m_ses.add_interface_peer_class(this, m_local.address(), -1);
+
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log(peer_log_alert::info))
 		{
@@ -412,8 +417,10 @@ namespace libtorrent {
 			return;
 		}
 
+		int outgoing_interface = -1;
 		tcp::endpoint const bound_ip = m_ses.bind_outgoing_socket(m_socket
-			, m_remote.address(), ec);
+			, m_remote.address(), outgoing_interface, ec);
+		m_outgoing_interface = std::int16_t(outgoing_interface);
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log(peer_log_alert::outgoing))
 		{
@@ -1106,6 +1113,29 @@ namespace libtorrent {
 			+ m_queued_time_critical * t->block_size() * 1000) / rate);
 	}
 
+	time_duration peer_connection::block_delivery_time() const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		std::shared_ptr<torrent> t = m_torrent.lock();
+		TORRENT_ASSERT(t);
+
+		time_duration const queue = download_queue_time(t->block_size());
+
+		// until we've received a few blocks from this peer, we don't know
+		// how erratic its response times are. Assume a block may take as long
+		// again as it does at the peer's current download rate. If it isn't
+		// sending us anything (yet), assume the estimate may be off by as much
+		// as the estimate itself
+		if (m_request_time.num_samples() < 2)
+		{
+			int const rate = m_statistics.transfer_rate(stat::download_payload);
+			if (rate <= 0) return queue * 2;
+			return queue + milliseconds(std::int64_t(t->block_size()) * 1000 / rate);
+		}
+
+		return queue + milliseconds(m_request_time.avg_deviation());
+	}
+
 	void peer_connection::add_stat(std::int64_t const downloaded, std::int64_t const uploaded)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -1128,6 +1158,7 @@ namespace libtorrent {
 	{
 		TORRENT_ASSERT(is_single_thread());
 		m_statistics.received_bytes(bytes_payload, bytes_protocol);
+		count_class_bytes(download_channel, bytes_payload + bytes_protocol);
 		if (m_ignore_stats) return;
 		std::shared_ptr<torrent> t = m_torrent.lock();
 		if (!t) return;
@@ -1138,6 +1169,7 @@ namespace libtorrent {
 	{
 		TORRENT_ASSERT(is_single_thread());
 		m_statistics.sent_bytes(bytes_payload, bytes_protocol);
+		count_class_bytes(upload_channel, bytes_payload + bytes_protocol);
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		if (bytes_payload)
 		{
@@ -1154,6 +1186,18 @@ namespace libtorrent {
 		t->sent_bytes(bytes_payload, bytes_protocol);
 	}
 
+	void peer_connection::count_class_bytes(int const channel, int const bytes)
+	{
+		if (bytes == 0) return;
+		auto& classes = m_ses.peer_classes();
+		for (int i = 0; i < num_classes(); ++i)
+		{
+			peer_class* pc = classes.at(class_at(i));
+			if (pc == nullptr) continue;
+			pc->total_transferred[channel] += bytes;
+		}
+	}
+
 	void peer_connection::trancieve_ip_packet(int const bytes, bool const ipv6)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -4153,6 +4197,9 @@ namespace libtorrent {
 
 		m_counters.inc_stats_counter(counters::connect_timeouts);
 
+		if (m_outgoing_interface >= 0)
+			m_ses.outgoing_interface_connected(m_outgoing_interface, false);
+
 		std::shared_ptr<torrent> t = m_torrent.lock();
 		TORRENT_ASSERT(!m_connecting || t);
 		if (m_connecting)
@@ -5402,21 +5449,17 @@ namespace libtorrent {
 		{
 			hash_failed[protocol_version::V2] = false;
 
-			int const blocks_in_piece = t->torrent_file().files().blocks_in_piece2(piece);
-
-			TORRENT_ASSERT(blocks_in_piece == int(block_hashes.size()));
+			TORRENT_ASSERT(t->torrent_file().files().blocks_in_piece2(piece)
+				== int(block_hashes.size()));
 
 			t->need_hash_picker();
-			auto picker = t->get_hash_picker();
-			set_block_hash_result result = set_block_hash_result::unknown();
-			for (int i = 0; i < blocks_in_piece; ++i)
+			auto& picker = t->get_hash_picker();
+			set_block_hash_result const result = picker.set_block_hashes(piece, 0, block_hashes);
+			t->update_merkle_tree_memory();
+			if (result.status == set_block_hash_result::result::block_hash_failed
+				|| result.status == set_block_hash_result::result::piece_hash_failed)
 			{
-				result = picker.set_block_hash(piece, i * default_block_size, block_hashes[i]);
-				if (result.status == set_block_hash_result::result::block_hash_failed
-					|| result.status == set_block_hash_result::result::piece_hash_failed)
-				{
-					hash_failed[protocol_version::V2] = true;
-				}
+				hash_failed[protocol_version::V2] = true;
 			}
 
 			// if the last block still couldn't be verified
@@ -6272,6 +6315,16 @@ namespace libtorrent {
 		m_connected = true;
 		m_counters.inc_stats_counter(counters::num_peers_connected);
 
+		if (m_outgoing_interface >= 0)
+			m_ses.outgoing_interface_connected(m_outgoing_interface, true);
+
+		// for SSL sockets, the handshake has completed by now
+		if (aux::is_ssl(m_socket))
+		{
+			m_counters.inc_stats_counter(aux::ssl_session_reused(m_socket)
+				? counters::ssl_resumed_handshakes : counters::ssl_full_handshakes);
+		}
+
 		if (m_disconnecting) return;
 		m_last_receive.set(m_connect, aux::time_now());
 
@@ -6283,6 +6336,8 @@ namespace libtorrent {
 			return;
 		}
 
+		m_ses.add_interface_peer_class(this, m_local.address(), m_outgoing_interface);
+
 		// if there are outgoing interfaces specified, verify this
 		// peer is correctly bound to one of them
 		if (!m_settings.get_str(settings_pack::outgoing_interfaces).empty())
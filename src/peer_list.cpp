@@ -162,6 +162,7 @@ namespace libtorrent {
 			m_peer_allocator.free_peer_entry(p);
 		m_peers.clear();
 		m_num_connect_candidates = 0;
+		m_num_seeds = 0;
 	}
 
 	peer_list::~peer_list()
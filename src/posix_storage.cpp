@@ -320,7 +320,7 @@ namespace aux {
 			m_part_file->move_partfile(new_save_path, e);
 		};
 		std::tie(ret, m_save_path) = aux::move_storage(files(), m_save_path, sp
-			, std::move(move_partfile), flags, ec);
+			, std::move(move_partfile), {}, flags, ec);
 
 		// clear the stat cache in case the new location has new files
 		m_stat_cache.clear();
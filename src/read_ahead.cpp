@@ -0,0 +1,135 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/read_ahead.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+
+#include <algorithm>
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+	// reads are allowed to arrive this far out of order and still be
+	// considered part of the same stream. Requests from the same peer may be
+	// executed by different disk threads
+	std::int64_t const stream_slack = 4 * default_block_size;
+}
+
+	read_ahead::result read_ahead::on_read(storage_index_t const storage
+		, std::int64_t const offset, int const len
+		, int const piece_length, std::int64_t const total_size
+		, int const max_window)
+	{
+		TORRENT_ASSERT(offset >= 0);
+		TORRENT_ASSERT(len > 0);
+		TORRENT_ASSERT(piece_length > 0);
+
+		result ret;
+		if (max_window <= 0) return ret;
+
+		std::int64_t const end = offset + len;
+
+		std::lock_guard<std::mutex> l(m_mutex);
+		++m_clock;
+
+		stream* victim = &m_streams[0];
+		for (auto& s : m_streams)
+		{
+			if (s.next < 0)
+			{
+				if (victim->next >= 0) victim = &s;
+				continue;
+			}
+
+			if (s.storage == storage
+				&& offset >= s.next - stream_slack
+				&& offset <= s.next + stream_slack)
+			{
+				// this is a continuation of an existing stream
+				ret.hit = end <= s.prefetched;
+				s.next = std::max(s.next, end);
+				s.window = std::min(max_window, std::max(s.window, default_block_size) * 2);
+				s.last_use = m_clock;
+
+				// we only issue more advice once half of the window has been
+				// consumed, to avoid calling into the kernel for every block
+				if (s.prefetched - s.next >= s.window / 2) return ret;
+
+				std::int64_t const start = std::max(s.prefetched, s.next);
+				std::int64_t const stop = std::min(total_size, s.next + s.window);
+				if (stop > start)
+				{
+					ret.prefetch_offset = start;
+					ret.prefetch_length = stop - start;
+					s.prefetched = stop;
+				}
+				return ret;
+			}
+
+			if (victim->next >= 0 && s.last_use < victim->last_use)
+				victim = &s;
+		}
+
+		// this is a new stream. Peers tend to request all blocks of a piece, so
+		// we speculatively prefetch the remainder of the piece this read falls
+		// in. Whether more pieces follow is left to the window to figure out
+		std::int64_t const piece_end = std::min(total_size
+			, (offset / piece_length + 1) * std::int64_t(piece_length));
+		std::int64_t const rest = std::min(piece_end - end, std::int64_t(max_window));
+
+		stream& s = *victim;
+		s.storage = storage;
+		s.next = end;
+		s.window = std::min(max_window, default_block_size);
+		s.last_use = m_clock;
+		s.prefetched = end;
+		if (rest > 0)
+		{
+			ret.prefetch_offset = end;
+			ret.prefetch_length = rest;
+			s.prefetched = end + rest;
+		}
+		return ret;
+	}
+
+	void read_ahead::remove_storage(storage_index_t const storage)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (auto& s : m_streams)
+		{
+			if (s.storage != storage) continue;
+			s = stream{};
+		}
+	}
+}
+}
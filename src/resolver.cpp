@@ -35,20 +35,105 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/debug.hpp"
 #include "libtorrent/aux_/time.hpp"
 
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+
 namespace libtorrent {
 namespace aux {
 
-
 	constexpr resolver_flags resolver_interface::cache_only;
 	constexpr resolver_flags resolver_interface::abort_on_shutdown;
 
-	resolver::resolver(io_context& ios)
+	struct resolver::lookup_queue
+	{
+		lookup_queue(io_context& ios_, lookup_function l)
+			: ios(ios_), lookup(std::move(l))
+		{}
+
+		io_context& ios;
+		lookup_function lookup;
+
+		// the resolver to deliver the results to. This is only accessed on
+		// the network thread, and cleared when the resolver is destructed
+		resolver* owner = nullptr;
+
+		std::mutex mutex;
+		std::condition_variable cond;
+
+		// host names waiting for a lookup thread
+		std::deque<std::string> hosts;
+
+		int max_threads = 8;
+		int num_threads = 0;
+		int idle_threads = 0;
+
+		// threads that have been idle for this long exit
+		time_duration idle_timeout = seconds(30);
+
+		// the IDs of threads that have exited, but not been joined yet
+		std::vector<std::thread::id> exited;
+
+		// set by abort(). Threads exit as soon as they run out of work, rather
+		// than waiting for more
+		bool aborted = false;
+
+		// set when the resolver is destructed. The lookup threads exit, and the
+		// results of lookups still running are discarded
+		bool shutdown = false;
+	};
+
+namespace {
+
+#if !defined TORRENT_BUILD_SIMULATOR
+	std::vector<address> system_lookup(std::string const& hostname, error_code& ec)
+	{
+		// the synchronous lookup calls getaddrinfo() on the calling thread,
+		// the io_context is never run
+		io_context ios;
+		tcp::resolver r(ios);
+		std::vector<address> ret;
+		// the port is ignored
+		auto const ips = r.resolve(hostname, "80", ec);
+		if (ec) return ret;
+		for (auto const& i : ips)
+			ret.push_back(i.endpoint().address());
+		return ret;
+	}
+#endif
+}
+
+	resolver::resolver(io_context& ios, lookup_function lookup)
 		: m_ios(ios)
+		, m_queue(std::make_shared<lookup_queue>(ios, std::move(lookup)))
+#if defined TORRENT_BUILD_SIMULATOR
 		, m_resolver(ios)
-		, m_critical_resolver(ios)
+#endif
 		, m_max_size(700)
 		, m_timeout(seconds(1200))
-	{}
+		, m_negative_timeout(seconds(60))
+	{
+#if !defined TORRENT_BUILD_SIMULATOR
+		if (!m_queue->lookup) m_queue->lookup = &system_lookup;
+#endif
+		m_queue->owner = this;
+	}
+
+	resolver::~resolver()
+	{
+		m_queue->owner = nullptr;
+		{
+			std::lock_guard<std::mutex> l(m_queue->mutex);
+			m_queue->shutdown = true;
+			m_queue->hosts.clear();
+			m_queue->cond.notify_all();
+		}
+		// lookups can't be interrupted, this waits for the ones still running
+		// to complete. Their results are discarded
+		for (auto& t : m_threads) t.join();
+	}
 
 	void resolver::callback(resolver_interface::callback_t h
 		, error_code const& ec, std::vector<address> const& ips)
@@ -60,29 +145,141 @@ namespace aux {
 		}
 	}
 
-	void resolver::on_lookup(error_code const& ec, tcp::resolver::results_type ips
-		, std::string const& hostname)
+	void resolver::thread_fun(std::shared_ptr<lookup_queue> q)
+	{
+		std::unique_lock<std::mutex> l(q->mutex);
+		for (;;)
+		{
+			if (q->shutdown) break;
+			if (q->hosts.empty())
+			{
+				// surplus threads (after lowering max_threads) exit rather than
+				// waiting for more work
+				if (q->aborted || q->num_threads > q->max_threads) break;
+				++q->idle_threads;
+				bool const timed_out = q->cond.wait_for(l, q->idle_timeout)
+					== std::cv_status::timeout;
+				--q->idle_threads;
+				if (timed_out && q->hosts.empty()) break;
+				continue;
+			}
+
+			std::string hostname = std::move(q->hosts.front());
+			q->hosts.pop_front();
+			l.unlock();
+
+			error_code ec;
+			time_point const start = clock_type::now();
+			std::vector<address> ips = q->lookup(hostname, ec);
+			time_duration const latency = clock_type::now() - start;
+
+			l.lock();
+			if (q->shutdown) break;
+			post(q->ios, [q, hostname = std::move(hostname), ec, ips = std::move(ips), latency]
+			{
+				if (q->owner) q->owner->on_lookup(hostname, ec, ips, latency);
+			});
+		}
+		--q->num_threads;
+		q->exited.push_back(std::this_thread::get_id());
+	}
+
+	void resolver::join_exited_threads()
 	{
-		COMPLETE_ASYNC("resolver::on_lookup");
-		if (ec)
+		std::vector<std::thread::id> exited;
 		{
-			auto const range = m_callbacks.equal_range(hostname);
-			for (auto c = range.first; c != range.second; ++c)
-				callback(std::move(c->second), ec, {});
-			m_callbacks.erase(range.first, range.second);
+			std::lock_guard<std::mutex> l(m_queue->mutex);
+			exited.swap(m_queue->exited);
+		}
+		for (auto const id : exited)
+		{
+			auto const it = std::find_if(m_threads.begin(), m_threads.end()
+				, [id](std::thread const& t) { return t.get_id() == id; });
+			TORRENT_ASSERT(it != m_threads.end());
+			if (it == m_threads.end()) continue;
+			it->join();
+			m_threads.erase(it);
+		}
+	}
+
+	void resolver::start_lookup(std::string const& hostname)
+	{
+#if defined TORRENT_BUILD_SIMULATOR
+		if (!m_queue->lookup)
+		{
+			time_point const start = clock_type::now();
+			ADD_OUTSTANDING_ASYNC("resolver::on_lookup");
+			// the port is ignored
+			m_resolver.async_resolve(hostname, "80", [this, hostname, start]
+				(error_code const& ec, tcp::resolver::results_type const& ips)
+			{
+				COMPLETE_ASYNC("resolver::on_lookup");
+				std::vector<address> addresses;
+				for (auto const& i : ips)
+					addresses.push_back(i.endpoint().address());
+				on_lookup(hostname, ec, addresses, clock_type::now() - start);
+			});
 			return;
 		}
+#endif
+
+		join_exited_threads();
+
+		std::lock_guard<std::mutex> l(m_queue->mutex);
+		m_queue->hosts.push_back(hostname);
+		if (int(m_queue->hosts.size()) > m_queue->idle_threads
+			&& m_queue->num_threads < m_queue->max_threads)
+		{
+			++m_queue->num_threads;
+			m_threads.emplace_back(&resolver::thread_fun, m_queue);
+		}
+		else
+		{
+			m_queue->cond.notify_one();
+		}
+	}
 
-		dns_cache_entry& ce = m_cache[hostname];
-		ce.last_seen = time_now();
-		ce.addresses.clear();
-		for (auto i : ips)
-			ce.addresses.push_back(i.endpoint().address());
+	void resolver::on_lookup(std::string const& hostname, error_code const& ec
+		, std::vector<address> const& ips, time_duration const latency)
+	{
+		if (ec != boost::asio::error::operation_aborted)
+		{
+			dns_cache_entry& ce = m_cache[hostname];
+			++ce.stats.lookups;
+			ce.stats.last_latency = latency;
+			ce.stats.average_latency = (ce.stats.lookups == 1)
+				? latency : (ce.stats.average_latency * 7 + latency) / 8;
+			ce.hits = 0;
 
-		auto const range = m_callbacks.equal_range(hostname);
-		for (auto c = range.first; c != range.second; ++c)
-			callback(std::move(c->second), ec, ce.addresses);
-		m_callbacks.erase(range.first, range.second);
+			if (ec)
+			{
+				++ce.stats.failures;
+				// if a previous lookup succeeded, keep serving its addresses
+				// until they're too old (see async_resolve()). Otherwise
+				// remember the failure
+				if (ce.addresses.empty())
+				{
+					ce.error = ec;
+					ce.last_seen = time_now();
+				}
+			}
+			else
+			{
+				ce.error.clear();
+				ce.addresses = ips;
+				ce.last_seen = time_now();
+			}
+		}
+
+		auto const it = m_pending.find(hostname);
+		if (it != m_pending.end())
+		{
+			std::vector<resolver_interface::callback_t> callbacks
+				= std::move(it->second.callbacks);
+			m_pending.erase(it);
+			for (auto& c : callbacks)
+				callback(std::move(c), ec, ec ? std::vector<address>{} : ips);
+		}
 
 		// if m_cache grows too big, weed out the
 		// oldest entries
@@ -117,11 +314,39 @@ namespace aux {
 		auto const i = m_cache.find(host);
 		if (i != m_cache.end())
 		{
-			// keep cache entries valid for m_timeout seconds
-			if ((flags & resolver_interface::cache_only)
-				|| i->second.last_seen + m_timeout >= time_now())
+			dns_cache_entry& ce = i->second;
+			time_duration const age = time_now() - ce.last_seen;
+			if (ce.error)
+			{
+				// failed lookups are cached for m_negative_timeout
+				if ((flags & resolver_interface::cache_only)
+					|| age <= m_negative_timeout)
+				{
+					++ce.stats.cache_hits;
+					error_code const err = ce.error;
+					post(m_ios, [=] { callback(h, err, std::vector<address>{}); });
+					return;
+				}
+			}
+			else if (!ce.addresses.empty()
+				&& ((flags & resolver_interface::cache_only) || age <= m_timeout * 2))
 			{
-				std::vector<address> ips = i->second.addresses;
+				// entries are valid for m_timeout. Once expired, they're served
+				// for another m_timeout while they're looked up again in the
+				// background. Entries requested repeatedly are looked up again
+				// shortly before expiring, to not have them expire at all
+				++ce.stats.cache_hits;
+				++ce.hits;
+				bool const stale = age > m_timeout;
+				if (stale) ++ce.stats.stale_hits;
+				if (!(flags & resolver_interface::cache_only)
+					&& (stale || (ce.hits >= 2 && age >= m_timeout * 3 / 4))
+					&& m_pending.emplace(host, pending_lookup{}).second)
+				{
+					start_lookup(host);
+				}
+
+				std::vector<address> ips = ce.addresses;
 				post(m_ios, [=] { callback(h, ec, ips); });
 				return;
 			}
@@ -136,33 +361,61 @@ namespace aux {
 			return;
 		}
 
-		auto iter = m_callbacks.find(host);
-		bool const done = (iter != m_callbacks.end());
+		auto it = m_pending.find(host);
+		bool const running = (it != m_pending.end());
+		if (!running) it = m_pending.emplace(host, pending_lookup{}).first;
 
-		m_callbacks.insert(iter, {host, std::move(h)});
+		// the lookup is only aborted by abort() if none of the callers
+		// requires it to complete
+		if (!(flags & resolver_interface::abort_on_shutdown))
+			it->second.abort_on_shutdown = false;
+		it->second.callbacks.push_back(std::move(h));
 
-		// if there is an existing outtanding lookup, our callback will be
+		// if there is an existing outstanding lookup, our callback will be
 		// called once it completes. We're done here.
-		if (done) return;
+		if (running) return;
 
-		// the port is ignored
-		using namespace std::placeholders;
-		ADD_OUTSTANDING_ASYNC("resolver::on_lookup");
-		if (flags & resolver_interface::abort_on_shutdown)
+		start_lookup(host);
+	}
+
+	void resolver::abort()
+	{
+		// lookups can't be cancelled once started. Fail their callbacks and
+		// cache their results once they complete
+		std::vector<resolver_interface::callback_t> aborted;
+		for (auto it = m_pending.begin(); it != m_pending.end();)
 		{
-			m_resolver.async_resolve(host, "80", std::bind(&resolver::on_lookup, this, _1, _2
-				, host));
+			if (!it->second.abort_on_shutdown)
+			{
+				++it;
+				continue;
+			}
+			for (auto& c : it->second.callbacks)
+				aborted.push_back(std::move(c));
+			it = m_pending.erase(it);
 		}
-		else
+
+		for (auto& c : aborted)
 		{
-			m_critical_resolver.async_resolve(host, "80", std::bind(&resolver::on_lookup, this, _1, _2
-				, host));
+			post(m_ios, [this, c = std::move(c)]() mutable {
+				callback(std::move(c), boost::asio::error::operation_aborted
+					, std::vector<address>{});
+			});
 		}
-	}
 
-	void resolver::abort()
-	{
-		m_resolver.cancel();
+		// drop the aborted lookups that haven't started yet, and make the
+		// threads exit once the lookups that must complete are done. Threads
+		// still running are joined by the destructor
+		{
+			std::lock_guard<std::mutex> l(m_queue->mutex);
+			auto& hosts = m_queue->hosts;
+			hosts.erase(std::remove_if(hosts.begin(), hosts.end()
+				, [this](std::string const& h) { return m_pending.count(h) == 0; })
+				, hosts.end());
+			m_queue->aborted = true;
+			m_queue->cond.notify_all();
+		}
+		join_exited_threads();
 	}
 
 	void resolver::set_cache_timeout(seconds const timeout)
@@ -172,5 +425,42 @@ namespace aux {
 		else
 			m_timeout = seconds(0);
 	}
+
+	void resolver::set_negative_cache_timeout(seconds const timeout)
+	{
+		if (timeout >= seconds(0))
+			m_negative_timeout = timeout;
+		else
+			m_negative_timeout = seconds(0);
+	}
+
+	void resolver::set_max_threads(int const n)
+	{
+		std::lock_guard<std::mutex> l(m_queue->mutex);
+		m_queue->max_threads = std::max(1, n);
+		// wake up idle threads to have the surplus ones exit
+		m_queue->cond.notify_all();
+	}
+
+	void resolver::set_idle_timeout(time_duration const timeout)
+	{
+		std::lock_guard<std::mutex> l(m_queue->mutex);
+		m_queue->idle_timeout = std::max(timeout, time_duration(0));
+		m_queue->cond.notify_all();
+	}
+
+	int resolver::num_threads()
+	{
+		join_exited_threads();
+		std::lock_guard<std::mutex> l(m_queue->mutex);
+		return m_queue->num_threads;
+	}
+
+	boost::optional<resolver::host_stats> resolver::stats(std::string const& hostname) const
+	{
+		auto const i = m_cache.find(hostname);
+		if (i == m_cache.end()) return boost::none;
+		return i->second.stats;
+	}
 }
 }
@@ -235,6 +235,11 @@ namespace libtorrent {
 		async_call(&session_impl::post_dht_stats);
 	}
 
+	void session_handle::post_outgoing_interface_stats()
+	{
+		async_call(&session_impl::post_outgoing_interface_stats);
+	}
+
 	io_context& session_handle::get_context()
 	{
 		std::shared_ptr<session_impl> s = m_impl.lock();
@@ -896,6 +901,11 @@ namespace {
 		return sync_call_ret<peer_class_t>(&session_impl::create_peer_class, name);
 	}
 
+	peer_class_t session_handle::interface_peer_class(std::string const& device)
+	{
+		return sync_call_ret<peer_class_t>(&session_impl::interface_peer_class, device);
+	}
+
 	void session_handle::delete_peer_class(peer_class_t cid)
 	{
 		async_call(&session_impl::delete_peer_class, cid);
@@ -906,6 +916,11 @@ namespace {
 		return sync_call_ret<peer_class_info>(&session_impl::get_peer_class, cid);
 	}
 
+	peer_class_stats session_handle::get_peer_class_stats(peer_class_t cid) const
+	{
+		return sync_call_ret<peer_class_stats>(&session_impl::get_peer_class_stats, cid);
+	}
+
 	void session_handle::set_peer_class(peer_class_t cid, peer_class_info const& pci)
 	{
 		async_call(&session_impl::set_peer_class, cid, pci);
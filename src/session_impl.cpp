@@ -57,6 +57,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <functional>
 #include <type_traits>
 #include <numeric> // for accumulate
+#include <cstdlib> // for atoi
+#include <thread> // for hardware_concurrency
 
 #if TORRENT_USE_INVARIANT_CHECKS
 #include <unordered_set>
@@ -111,6 +113,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/ffs.hpp"
 #include "libtorrent/aux_/array.hpp"
 #include "libtorrent/aux_/set_traffic_class.hpp"
+#include "libtorrent/aux_/disk_interface_ext.hpp"
 
 #ifndef TORRENT_DISABLE_LOGGING
 
@@ -373,6 +376,123 @@ void apply_deprecated_dht_settings(settings_pack& sett, bdecode_node const& s)
 		}
 	}
 
+	std::int64_t outgoing_interface_load::cost() const
+	{
+		// each connection counts as this many bytes per second, so that idle
+		// connections (and connections that are still being established)
+		// are spread across interfaces too
+		std::int64_t const connection_cost = 16 * 1024;
+
+		std::int64_t const load = std::int64_t(rate)
+			+ std::int64_t(num_connections + 1) * connection_cost;
+
+		// scale the load up by the ratio of connection attempts to
+		// successful ones. The counts start at 1, to not divide by zero and
+		// to not draw conclusions from too few attempts
+		int const successes = connect_attempts - connect_failures;
+		return load * (connect_attempts + 2)
+			/ (std::int64_t(successes + 1) * std::max(weight, 1));
+	}
+
+	int pick_outgoing_interface(span<outgoing_interface_load const> const ifs
+		, int const start)
+	{
+		TORRENT_ASSERT(!ifs.empty());
+		int const num = int(ifs.size());
+		int ret = -1;
+		std::int64_t min_cost = 0;
+		for (int i = 0; i < num; ++i)
+		{
+			int const idx = (start + i) % num;
+			std::int64_t const c = ifs[idx].cost();
+			if (ret >= 0 && c >= min_cost) continue;
+			ret = idx;
+			min_cost = c;
+		}
+		return ret;
+	}
+
+	int outgoing_interface_index(listen_socket_t const& ls
+		, span<std::string const> const interfaces, span<address const> const addresses)
+	{
+		TORRENT_ASSERT(interfaces.size() == addresses.size());
+		for (int i = 0; i < int(interfaces.size()); ++i)
+		{
+			if (!ls.device.empty() && ls.device == interfaces[i]) return i;
+			if (!addresses[i].is_unspecified()
+				&& addresses[i] == ls.local_endpoint.address())
+				return i;
+		}
+		return -1;
+	}
+
+	utp_socket_choice pick_utp_listen_socket(
+		span<std::shared_ptr<listen_socket_t> const> const sockets
+		, address const& remote, transport const ssl
+		, span<std::string const> const interfaces
+		, span<address const> const addresses
+		, span<outgoing_interface_load const> const loads, int const start)
+	{
+		TORRENT_ASSERT(interfaces.size() == loads.size());
+
+		std::vector<std::shared_ptr<listen_socket_t>> with_gateways;
+		utp_socket_choice ret;
+		for (auto const& ls : sockets)
+		{
+			if (is_v4(ls->local_endpoint) != remote.is_v4()) continue;
+			if (ls->ssl != ssl) continue;
+			if (!(ls->flags & listen_socket_t::local_network))
+				with_gateways.push_back(ls);
+
+			if (match_addr_mask(ls->local_endpoint.address(), remote, ls->netmask))
+			{
+				// is this better than the previous match?
+				ret.socket = ls;
+			}
+		}
+		if (ret.socket || with_gateways.empty()) return ret;
+
+		// uTP connections go out through the UDP socket of a listen socket.
+		// Pick the listen socket on the least loaded outgoing interface, the
+		// same way TCP connections are bound
+		std::vector<outgoing_interface_load> candidate_loads;
+		// the index into with_gateways and the outgoing interface of each
+		// candidate
+		std::vector<std::pair<int, int>> candidates;
+		int const num_interfaces = int(interfaces.size());
+		int candidate_start = 0;
+		int start_distance = num_interfaces;
+		for (int i = 0; i < int(with_gateways.size()); ++i)
+		{
+			int const idx = outgoing_interface_index(*with_gateways[std::size_t(i)]
+				, interfaces, addresses);
+			if (idx < 0) continue;
+
+			// ties are broken starting at the candidate on the first outgoing
+			// interface at or after ``start``
+			int const distance = (idx - start + num_interfaces) % num_interfaces;
+			if (distance < start_distance)
+			{
+				start_distance = distance;
+				candidate_start = int(candidates.size());
+			}
+			candidate_loads.push_back(loads[idx]);
+			candidates.emplace_back(i, idx);
+		}
+
+		if (!candidates.empty())
+		{
+			auto const& c = candidates[std::size_t(
+				pick_outgoing_interface(candidate_loads, candidate_start))];
+			ret.socket = with_gateways[std::size_t(c.first)];
+			ret.outgoing_interface = c.second;
+			return ret;
+		}
+
+		ret.socket = with_gateways[random(std::uint32_t(with_gateways.size() - 1))];
+		return ret;
+	}
+
 	bool listen_socket_t::can_route(address const& addr) const
 	{
 		// if this is a proxy, we assume it can reach everything
@@ -1134,6 +1254,8 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 				l->sock->close(ec);
 				TORRENT_ASSERT(!ec);
 			}
+			for (auto const& q : l->accept_queues)
+				q->close(ec);
 
 			// TODO: 3 closing the udp sockets here means that
 			// the uTP connections cannot be closed gracefully
@@ -1247,6 +1369,14 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		TORRENT_ASSERT_PRECOND(m_classes.at(cid));
 		if (m_classes.at(cid) == nullptr) return;
 		m_classes.decref(cid);
+
+		// if this is the class of an interface, the interface doesn't have a
+		// class anymore. The ID may be recycled for an unrelated class
+		for (auto i = m_interface_peer_classes.begin(); i != m_interface_peer_classes.end();)
+		{
+			if (i->second == cid) i = m_interface_peer_classes.erase(i);
+			else ++i;
+		}
 	}
 
 	peer_class_info session_impl::get_peer_class(peer_class_t const cid) const
@@ -1275,6 +1405,16 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		return ret;
 	}
 
+	peer_class_stats session_impl::get_peer_class_stats(peer_class_t const cid) const
+	{
+		peer_class_stats ret;
+		peer_class const* pc = m_classes.at(cid);
+		// if you hit this assert, you're passing in an invalid cid
+		TORRENT_ASSERT_PRECOND(pc);
+		if (pc != nullptr) pc->get_stats(&ret);
+		return ret;
+	}
+
 namespace {
 
 	std::uint16_t make_announce_port(std::uint16_t const p)
@@ -1380,6 +1520,56 @@ namespace {
 		}
 	}
 
+	peer_class_t session_impl::interface_peer_class(std::string const& device)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		auto const it = m_interface_peer_classes.find(device);
+		if (it != m_interface_peer_classes.end()) return it->second;
+
+		peer_class_t const ret = m_classes.new_peer_class("interface " + device);
+		m_interface_peer_classes.emplace(device, ret);
+		return ret;
+	}
+
+	void session_impl::add_interface_peer_class(peer_class_set* s
+		, address const& local, int const outgoing_interface)
+	{
+		if (m_interface_peer_classes.empty()) return;
+
+		auto add = [&](string_view name)
+		{
+			auto const it = m_interface_peer_classes.find(name);
+			if (it == m_interface_peer_classes.end()) return false;
+			TORRENT_ASSERT(m_classes.at(it->second));
+			s->add_class(m_classes, it->second);
+			return true;
+		};
+
+		// outgoing TCP connections are attributed to the interface they were
+		// bound to, whether it's specified by name or IP
+		if (outgoing_interface >= 0
+			&& outgoing_interface < int(m_outgoing_interfaces.size())
+			&& add(m_outgoing_interfaces[std::size_t(outgoing_interface)]))
+			return;
+
+		// uTP connections and incoming connections belong to the listen
+		// socket with their local address
+		for (auto const& ls : m_listen_sockets)
+		{
+			if (ls->local_endpoint.address() != local) continue;
+			if (!ls->device.empty() && add(ls->device)) return;
+			break;
+		}
+
+		// otherwise, look up the device the address belongs to
+		error_code if_ec;
+		error_code route_ec;
+		string_view const device = net_interfaces(if_ec, route_ec).device_for_address(local);
+		if (!device.empty() && add(device)) return;
+
+		add(local.to_string());
+	}
+
 	bool session_impl::ignore_unchoke_slots_set(peer_class_set const& set) const
 	{
 		int num = set.num_classes();
@@ -1414,6 +1604,12 @@ namespace {
 		m_disk_thread->submit_jobs();
 	}
 
+	disk_interface_ext* session_impl::disk_thread_ext()
+	{
+		// custom disk I/O subsystems don't need to support this
+		return dynamic_cast<disk_interface_ext*>(m_disk_thread.get());
+	}
+
 	// copies pointers to bandwidth channels from the peer classes
 	// into the array. Only bandwidth channels with a bandwidth limit
 	// is considered pertinent and copied
@@ -1648,6 +1844,27 @@ namespace {
 				}
 #endif // TORRENT_DISABLE_LOGGING
 			}
+
+#ifdef TORRENT_HAS_REUSE_PORT
+			if (m_settings.get_int(settings_pack::listen_accept_queues) > 1)
+			{
+				// the additional accept queues are bound to the same endpoint
+				// once this socket is listening. All of them need SO_REUSEPORT
+				error_code err;
+				ret->sock->set_option(reuse_port(true), err);
+#ifndef TORRENT_DISABLE_LOGGING
+				if (err && should_log())
+				{
+					session_log("failed enable reuse-port on listen socket: %s"
+						, err.message().c_str());
+				}
+#endif // TORRENT_DISABLE_LOGGING
+#ifdef SO_INCOMING_CPU
+				if (!err && m_settings.get_bool(settings_pack::listen_accept_queue_affinity))
+					ret->sock->set_option(incoming_cpu(0), err);
+#endif
+			}
+#endif // TORRENT_HAS_REUSE_PORT
 #endif // TORRENT_WINDOWS
 
 			if (is_v6(bind_ep))
@@ -1791,6 +2008,8 @@ namespace {
 				}
 				return ret;
 			}
+
+			open_accept_queues(*ret, lep, bind_ep);
 		} // accept incoming
 
 		socket_type_t const udp_sock_type
@@ -1925,6 +2144,73 @@ namespace {
 		return ret;
 	}
 
+	void session_impl::open_accept_queues(listen_socket_t& ls
+		, listen_endpoint_t const& lep, tcp::endpoint const& bind_ep)
+	{
+#ifdef TORRENT_HAS_REUSE_PORT
+		int const num_queues = m_settings.get_int(settings_pack::listen_accept_queues);
+#ifdef SO_INCOMING_CPU
+		bool const affinity = m_settings.get_bool(settings_pack::listen_accept_queue_affinity);
+		int const num_cpus = std::max(1, int(std::thread::hardware_concurrency()));
+#endif
+
+		for (int i = 1; i < num_queues; ++i)
+		{
+			error_code ec;
+			auto sock = std::make_shared<tcp::acceptor>(m_io_context);
+			sock->open(bind_ep.protocol(), ec);
+			if (!ec) sock->set_option(tcp::acceptor::reuse_address(true), ec);
+			if (!ec) sock->set_option(reuse_port(true), ec);
+			if (!ec && is_v6(bind_ep))
+				sock->set_option(boost::asio::ip::v6_only(true), ec);
+#if TORRENT_HAS_BINDTODEVICE
+			if (!ec && !lep.device.empty())
+			{
+				// best-effort, like on the primary socket
+				error_code err;
+				bind_device(*sock, lep.device.c_str(), err);
+			}
+#endif
+#ifdef SO_INCOMING_CPU
+			if (!ec && affinity)
+			{
+				error_code err;
+				sock->set_option(incoming_cpu(i % num_cpus), err);
+			}
+#endif
+			if (!ec) sock->bind(bind_ep, ec);
+			if (!ec) sock->listen(m_settings.get_int(settings_pack::listen_queue_size), ec);
+
+			if (ec)
+			{
+				// the primary socket is still accepting connections. The
+				// remaining queues would most likely fail the same way
+#ifndef TORRENT_DISABLE_LOGGING
+				if (should_log())
+				{
+					session_log("failed to open accept queue %d on %s: %s"
+						, i, print_endpoint(bind_ep).c_str(), ec.message().c_str());
+				}
+#endif
+				break;
+			}
+			ls.accept_queues.push_back(std::move(sock));
+		}
+
+#ifndef TORRENT_DISABLE_LOGGING
+		if (!ls.accept_queues.empty() && should_log())
+		{
+			session_log("opened %d accept queues on %s"
+				, int(ls.accept_queues.size()) + 1, print_endpoint(bind_ep).c_str());
+		}
+#endif
+#else
+		TORRENT_UNUSED(ls);
+		TORRENT_UNUSED(lep);
+		TORRENT_UNUSED(bind_ep);
+#endif // TORRENT_HAS_REUSE_PORT
+	}
+
 	void session_impl::on_exception(std::exception const& e)
 	{
 		TORRENT_UNUSED(e);
@@ -1952,12 +2238,52 @@ namespace {
 		else
 			session_log("received error on_ip_change: %d, %s", ec.value(), ec.message().c_str());
 #endif
-		if (ec || m_abort || !m_ip_notifier) return;
+		if (m_abort || !m_ip_notifier) return;
+		if (ec)
+		{
+			// the notifier won't tell us about any more changes. Fall back to
+			// refreshing the interfaces periodically (see net_interfaces())
+			if (ec != boost::asio::error::operation_aborted)
+				m_ip_notifier_failed = true;
+			return;
+		}
 		m_ip_notifier->async_wait([this] (error_code const& e)
 			{ wrap(&session_impl::on_ip_change, e); });
+		m_net_interfaces.invalidate();
 		reopen_network_sockets({});
 	}
 
+namespace {
+
+	// when there's no ip notifier to tell us about changes, a snapshot of the
+	// network interfaces is refreshed after this many seconds
+	constexpr int interface_table_ttl = 5;
+}
+
+	interface_table const& session_impl::net_interfaces(error_code& if_ec
+		, error_code& route_ec)
+	{
+		// without a working ip notifier we won't learn about changes to the
+		// interfaces, so the snapshot is only trusted for a short while
+		if (m_net_interfaces.stale()
+			|| ((!m_ip_notifier || m_ip_notifier_failed)
+				&& aux::time_now() - m_net_interfaces.last_refresh()
+				> seconds(interface_table_ttl)))
+		{
+			m_net_interfaces.refresh(m_io_context, if_ec, route_ec);
+#ifndef TORRENT_DISABLE_LOGGING
+			if (should_log())
+			{
+				session_log("refreshed network interfaces (version: %u interfaces: %d routes: %d)"
+					, m_net_interfaces.version()
+					, int(m_net_interfaces.interfaces().size())
+					, int(m_net_interfaces.routes().size()));
+			}
+#endif
+		}
+		return m_net_interfaces;
+	}
+
 	// TODO: could this function be merged with expand_unspecified_addresses?
 	// right now both listen_endpoint_t and listen_interface_t are almost
 	// identical, maybe the latter could be removed too
@@ -2036,18 +2362,20 @@ namespace {
 		}
 		else
 		{
-			std::vector<ip_interface> const ifs = enum_net_interfaces(m_io_context, ec);
+			error_code route_ec;
+			auto const& table = net_interfaces(ec, route_ec);
 			if (ec && m_alerts.should_post<listen_failed_alert>())
 			{
 				m_alerts.emplace_alert<listen_failed_alert>(""
 					, operation_t::enum_if, ec, socket_type_t::tcp);
 			}
-			auto const routes = enum_routes(m_io_context, ec);
-			if (ec && m_alerts.should_post<listen_failed_alert>())
+			if (route_ec && m_alerts.should_post<listen_failed_alert>())
 			{
 				m_alerts.emplace_alert<listen_failed_alert>(""
-					, operation_t::enum_route, ec, socket_type_t::tcp);
+					, operation_t::enum_route, route_ec, socket_type_t::tcp);
 			}
+			std::vector<ip_interface> const& ifs = table.interfaces();
+			std::vector<ip_route> const& routes = table.routes();
 
 			// expand device names and populate eps
 			for (auto const& iface : m_listen_interfaces)
@@ -2118,6 +2446,7 @@ namespace {
 			}
 #endif
 			if ((*remove_iter)->sock) (*remove_iter)->sock->close(ec);
+			for (auto const& q : (*remove_iter)->accept_queues) q->close(ec);
 			if ((*remove_iter)->udp_sock) (*remove_iter)->udp_sock->sock.close();
 			if ((*remove_iter)->natpmp_mapper) (*remove_iter)->natpmp_mapper->close();
 			if ((*remove_iter)->upnp_mapper) (*remove_iter)->upnp_mapper->close();
@@ -2158,6 +2487,7 @@ namespace {
 
 				TORRENT_ASSERT(bool(s->flags & listen_socket_t::accept_incoming) == bool(s->sock));
 				if (s->sock) async_accept(s->sock, s->ssl);
+				for (auto const& q : s->accept_queues) async_accept(q, s->ssl);
 			}
 		}
 #ifndef BOOST_NO_EXCEPTIONS
@@ -2784,7 +3114,11 @@ namespace {
 
 		auto listen = std::find_if(m_listen_sockets.begin(), m_listen_sockets.end()
 			, [&listener](std::shared_ptr<listen_socket_t> const& l)
-		{ return l->sock == listener; });
+		{
+			return l->sock == listener
+				|| std::find(l->accept_queues.begin(), l->accept_queues.end()
+					, listener) != l->accept_queues.end();
+		});
 		if (listen != m_listen_sockets.end())
 			(*listen)->incoming_connection = true;
 
@@ -2893,6 +3227,9 @@ namespace {
 			return;
 		}
 
+		m_stats_counters.inc_stats_counter(aux::ssl_session_reused(s)
+			? counters::ssl_resumed_handshakes : counters::ssl_full_handshakes);
+
 		incoming_connection(std::move(s));
 	}
 
@@ -3594,6 +3931,8 @@ namespace {
 
 		m_stat.second_tick(tick_interval_ms);
 
+		update_outgoing_load();
+
 		// --------------------------------------------------------------
 		// scrape paused torrents that are auto managed
 		// (unless the session is paused)
@@ -4369,6 +4708,7 @@ namespace {
 		// TODO: 3 there should be a pre-calculated list of all peers eligible for
 		// unchoking
 		std::vector<peer_connection*> peers;
+		peers.reserve(m_connections.size());
 		for (auto i = m_connections.begin(); i != m_connections.end();)
 		{
 			std::shared_ptr<peer_connection> p = *i;
@@ -5067,9 +5407,57 @@ namespace {
 	{
 		std::string const net_interfaces = m_settings.get_str(settings_pack::outgoing_interfaces);
 
+		std::vector<std::string> const old_interfaces = std::move(m_outgoing_interfaces);
+
 		// declared in string_util.hpp
 		parse_comma_separated_string(net_interfaces, m_outgoing_interfaces);
 
+		std::vector<std::string> weights;
+		parse_comma_separated_string(
+			m_settings.get_str(settings_pack::outgoing_interface_weights), weights);
+
+		// interfaces that are still in the list keep their load, and the
+		// connections bound to them follow them to their new index. The
+		// connections of interfaces that were removed aren't bound to any
+		// interface anymore
+		std::vector<int> new_index(old_interfaces.size(), -1);
+		std::vector<outgoing_interface_load> load(m_outgoing_interfaces.size());
+		for (std::size_t i = 0; i < old_interfaces.size(); ++i)
+		{
+			auto const it = std::find(m_outgoing_interfaces.begin()
+				, m_outgoing_interfaces.end(), old_interfaces[i]);
+			if (it == m_outgoing_interfaces.end()) continue;
+			auto const idx = std::size_t(it - m_outgoing_interfaces.begin());
+			new_index[i] = int(idx);
+			if (i < m_outgoing_load.size()) load[idx] = m_outgoing_load[i];
+		}
+		for (std::size_t i = 0; i < load.size(); ++i)
+		{
+			load[i].weight = i < weights.size()
+				? std::max(1, std::atoi(weights[i].c_str())) : 1;
+		}
+		m_outgoing_load = std::move(load);
+		m_interface_index = 0;
+
+		m_outgoing_addresses.clear();
+		for (auto const& name : m_outgoing_interfaces)
+		{
+			error_code ec;
+			address const ip = make_address(name, ec);
+			m_outgoing_addresses.push_back(ec ? address() : ip);
+		}
+
+		if (old_interfaces != m_outgoing_interfaces)
+		{
+			for (auto const& p : m_connections)
+			{
+				int const idx = p->outgoing_interface();
+				if (idx < 0) continue;
+				p->set_outgoing_interface(idx < int(new_index.size())
+					? new_index[std::size_t(idx)] : -1);
+			}
+		}
+
 #ifndef TORRENT_DISABLE_LOGGING
 		if (!net_interfaces.empty() && m_outgoing_interfaces.empty())
 		{
@@ -5080,7 +5468,7 @@ namespace {
 	}
 
 	tcp::endpoint session_impl::bind_outgoing_socket(socket_type& s
-		, address const& remote_address, error_code& ec) const
+		, address const& remote_address, int& outgoing_interface, error_code& ec)
 	{
 		tcp::endpoint bind_ep(address_v4(), 0);
 		if (m_settings.get_int(settings_pack::outgoing_port) > 0)
@@ -5103,9 +5491,6 @@ namespace {
 
 		if (is_utp(s))
 		{
-			// TODO: factor out this logic into a separate function for unit
-			// testing
-
 			utp_socket_impl* impl = nullptr;
 			transport ssl = transport::plaintext;
 #if TORRENT_USE_SSL
@@ -5118,28 +5503,25 @@ namespace {
 #endif
 				impl = boost::get<utp_stream>(s).get_impl();
 
-			std::vector<std::shared_ptr<listen_socket_t>> with_gateways;
-			std::shared_ptr<listen_socket_t> match;
-			for (auto& ls : m_listen_sockets)
-			{
-				if (is_v4(ls->local_endpoint) != remote_address.is_v4()) continue;
-				if (ls->ssl != ssl) continue;
-				if (!(ls->flags & listen_socket_t::local_network))
-					with_gateways.push_back(ls);
+			TORRENT_ASSERT(m_outgoing_addresses.size() == m_outgoing_interfaces.size());
+			utp_socket_choice const match = pick_utp_listen_socket(m_listen_sockets
+				, remote_address, ssl, m_outgoing_interfaces, m_outgoing_addresses
+				, m_outgoing_load, m_interface_index);
 
-				if (match_addr_mask(ls->local_endpoint.address(), remote_address, ls->netmask))
-				{
-					// is this better than the previous match?
-					match = ls;
-				}
+			if (match.outgoing_interface >= 0)
+			{
+				// count the connection right away, like TCP connections
+				int const idx = match.outgoing_interface;
+				m_interface_index = (idx + 1) % int(m_outgoing_interfaces.size());
+				++m_outgoing_load[std::size_t(idx)].num_connections;
+				++m_outgoing_load[std::size_t(idx)].num_utp_connections;
+				outgoing_interface = idx;
 			}
-			if (!match && !with_gateways.empty())
-				match = with_gateways[random(std::uint32_t(with_gateways.size() - 1))];
 
-			if (match)
+			if (match.socket)
 			{
-				impl->m_sock = match;
-				return match->local_endpoint;
+				impl->m_sock = match.socket;
+				return match.socket->local_endpoint;
 			}
 			ec.assign(boost::system::errc::not_supported, generic_category());
 			return {};
@@ -5147,8 +5529,15 @@ namespace {
 
 		if (!m_outgoing_interfaces.empty())
 		{
-			if (m_interface_index >= m_outgoing_interfaces.size()) m_interface_index = 0;
-			std::string const& ifname = m_outgoing_interfaces[m_interface_index++];
+			TORRENT_ASSERT(m_outgoing_load.size() == m_outgoing_interfaces.size());
+			int const idx = pick_outgoing_interface(m_outgoing_load, m_interface_index);
+			m_interface_index = (idx + 1) % int(m_outgoing_interfaces.size());
+
+			// count the connection right away, so the next connection made
+			// before the next tick sees it
+			++m_outgoing_load[std::size_t(idx)].num_connections;
+			outgoing_interface = idx;
+			std::string const& ifname = m_outgoing_interfaces[std::size_t(idx)];
 
 			bind_ep.address(bind_socket_to_device(m_io_context, s
 				, remote_address.is_v4() ? tcp::v4() : tcp::v6()
@@ -5170,6 +5559,79 @@ namespace {
 		return bind_ep;
 	}
 
+	void session_impl::outgoing_interface_connected(int const outgoing_interface
+		, bool const success)
+	{
+		// the outgoing interfaces may have changed since the connection was
+		// bound
+		if (outgoing_interface < 0
+			|| outgoing_interface >= int(m_outgoing_load.size()))
+			return;
+
+		auto& l = m_outgoing_load[std::size_t(outgoing_interface)];
+		++l.connect_attempts;
+		if (!success) ++l.connect_failures;
+	}
+
+	void session_impl::update_outgoing_load()
+	{
+		if (m_outgoing_load.empty()) return;
+
+		for (auto& l : m_outgoing_load)
+		{
+			l.num_connections = 0;
+			l.num_utp_connections = 0;
+			l.rate = 0;
+		}
+
+		int const num_interfaces = int(m_outgoing_load.size());
+		for (auto const& p : m_connections)
+		{
+			int const idx = p->outgoing_interface();
+			if (idx < 0 || idx >= num_interfaces) continue;
+			if (p->is_disconnecting()) continue;
+			auto& l = m_outgoing_load[std::size_t(idx)];
+			++l.num_connections;
+			if (is_utp(p->get_socket())) ++l.num_utp_connections;
+			stat const& st = p->statistics();
+			l.rate += st.upload_rate() + st.download_rate();
+		}
+
+		if (++m_outgoing_load_ticks < 60) return;
+		m_outgoing_load_ticks = 0;
+
+		for (int i = 0; i < num_interfaces; ++i)
+		{
+			auto& l = m_outgoing_load[std::size_t(i)];
+#ifndef TORRENT_DISABLE_LOGGING
+			if (should_log())
+			{
+				session_log("outgoing interface \"%s\" weight: %d connections: %d "
+					"(uTP: %d) rate: %d B/s connect attempts: %d failures: %d"
+					, m_outgoing_interfaces[std::size_t(i)].c_str(), l.weight
+					, l.num_connections, l.num_utp_connections, l.rate
+					, l.connect_attempts, l.connect_failures);
+			}
+#endif
+			l.connect_attempts /= 2;
+			l.connect_failures /= 2;
+		}
+	}
+
+	void session_impl::post_outgoing_interface_stats()
+	{
+		TORRENT_ASSERT(m_outgoing_load.size() == m_outgoing_interfaces.size());
+		std::vector<outgoing_interface_stats> ret;
+		ret.reserve(m_outgoing_load.size());
+		for (std::size_t i = 0; i < m_outgoing_load.size(); ++i)
+		{
+			auto const& l = m_outgoing_load[i];
+			ret.push_back({m_outgoing_interfaces[i], l.weight, l.num_connections
+				, l.num_utp_connections, l.rate, l.connect_attempts, l.connect_failures});
+		}
+		m_alerts.emplace_alert<outgoing_interface_stats_alert>(std::move(ret));
+	}
+
 	// verify that ``addr``s interface allows incoming connections
 	bool session_impl::verify_incoming_interface(address const& addr)
 	{
@@ -5208,9 +5670,22 @@ namespace {
 
 		// we didn't find the address as an IP in the interface list. Now,
 		// resolve which device (if any) has this IP address.
-		std::string const device = device_for_address(addr, m_io_context, ec);
+		error_code route_ec;
+		string_view device = net_interfaces(ec, route_ec).device_for_address(addr);
 		if (ec) return false;
 
+		// the address may have been added after our last snapshot, and
+		// before we've been notified about it. Allow refreshing the
+		// snapshot for an unknown address, but not more than once per
+		// second, to not turn every connection into an interface enumeration
+		if (device.empty()
+			&& aux::time_now() - m_net_interfaces.last_refresh() > seconds(1))
+		{
+			m_net_interfaces.invalidate();
+			device = net_interfaces(ec, route_ec).device_for_address(addr);
+			if (ec) return false;
+		}
+
 		// if no device was found to have this address, we fail
 		if (device.empty()) return false;
 
@@ -5368,6 +5843,13 @@ namespace {
 	{
 		int const timeout = m_settings.get_int(settings_pack::resolver_cache_timeout);
 		m_host_resolver.set_cache_timeout(seconds(timeout));
+		int const negative_timeout = m_settings.get_int(settings_pack::resolver_negative_cache_timeout);
+		m_host_resolver.set_negative_cache_timeout(seconds(negative_timeout));
+	}
+
+	void session_impl::update_resolver_threads()
+	{
+		m_host_resolver.set_max_threads(m_settings.get_int(settings_pack::resolver_threads));
 	}
 
 	void session_impl::update_proxy()
@@ -5625,7 +6107,10 @@ namespace {
 			ip.netmask = s->netmask;
 			std::strncpy(ip.name, s->device.c_str(), sizeof(ip.name) - 1);
 			ip.name[sizeof(ip.name) - 1] = '\0';
-			s->natpmp_mapper->start(ip);
+			error_code if_ec;
+			error_code route_ec;
+			auto const& table = net_interfaces(if_ec, route_ec);
+			s->natpmp_mapper->start(ip, table.routes(), route_ec);
 		}
 	}
 
@@ -6343,6 +6828,11 @@ namespace {
 			{
 				error_code ec;
 				set_traffic_class(*l->sock, value, ec);
+				for (auto const& q : l->accept_queues)
+				{
+					error_code err;
+					set_traffic_class(*q, value, err);
+				}
 
 #ifndef TORRENT_DISABLE_LOGGING
 				if (should_log())
@@ -6532,6 +7022,11 @@ namespace {
 					, l->sock->local_endpoint().port(), print_error(ec).c_str());
 			}
 #endif
+			for (auto const& q : l->accept_queues)
+			{
+				error_code err;
+				set_socket_buffer_size(*q, m_settings, err);
+			}
 		}
 	}
 
@@ -6779,6 +7274,7 @@ namespace {
 		if (m_ip_notifier) return;
 
 		m_ip_notifier = create_ip_notifier(m_io_context);
+		m_ip_notifier_failed = false;
 		m_ip_notifier->async_wait([this](error_code const& e)
 			{ wrap(&session_impl::on_ip_change, e); });
 	}
@@ -6883,6 +7379,7 @@ namespace {
 
 		m_ip_notifier->cancel();
 		m_ip_notifier.reset();
+		m_ip_notifier_failed = false;
 	}
 
 	void session_impl::stop_lsd()
@@ -113,6 +113,17 @@ namespace {
 		METRIC(peer, error_tcp_peers)
 		METRIC(peer, error_utp_peers)
 
+		// the number of HTTP requests sent to web seeds, and how many of them
+		// were sent over a connection that had already been used for an
+		// earlier request (i.e. that were kept alive)
+		METRIC(peer, web_seed_requests)
+		METRIC(peer, web_seed_keepalive_requests)
+
+		// the number of completed SSL handshakes with peers, and how many of
+		// them resumed an earlier session rather than doing a full handshake
+		METRIC(peer, ssl_full_handshakes)
+		METRIC(peer, ssl_resumed_handshakes)
+
 		// these counters break down the reasons to
 		// disconnect peers.
 		METRIC(peer, connect_timeouts)
@@ -318,6 +329,13 @@ namespace {
 		METRIC(picker, piece_picker_rand_loops)
 		METRIC(picker, piece_picker_busy_loops)
 
+		// the number of time-critical pieces that completed before and
+		// after their deadline, and the number of block requests sent to a
+		// second peer because a deadline was at risk
+		METRIC(picker, deadline_pieces_hit)
+		METRIC(picker, deadline_pieces_missed)
+		METRIC(picker, deadline_duplicate_requests)
+
 		// This breaks down the piece picks into the event that
 		// triggered it
 		METRIC(picker, reject_piece_picks)
@@ -379,6 +397,95 @@ namespace {
 		METRIC(disk, disk_hash_time)
 		METRIC(disk, disk_job_time)
 
+		// ``num_prefetch_ops`` is the number of times a file range was hinted
+		// to the operating system ahead of being read, either because it was
+		// requested by a queued read job or by the read-ahead of a sequential
+		// stream. ``num_prefetch_hits`` is the number of block reads that had
+		// been prefetched, and ``num_prefetch_misses`` the ones that had not.
+		METRIC(disk, num_prefetch_ops)
+		METRIC(disk, num_prefetch_hits)
+		METRIC(disk, num_prefetch_misses)
+
+		// cumulative time spent reading blocks that had been prefetched (hit)
+		// and blocks that had not (miss), in microseconds.
+		// ``disk_prefetch_saved_time`` is an estimate of the time saved by
+		// prefetching, based on the average time of a miss.
+		METRIC(disk, disk_prefetch_hit_time)
+		METRIC(disk, disk_prefetch_miss_time)
+		METRIC(disk, disk_prefetch_saved_time)
+
+		// the number of times a file was requested from the pool of open files
+		// while it was already open (``file_pool_hits``), had to be opened
+		// (``file_pool_misses``), and the number of files closed to make room
+		// for others (``file_pool_evictions``).
+		METRIC(disk, file_pool_hits)
+		METRIC(disk, file_pool_misses)
+		METRIC(disk, file_pool_evictions)
+
+		// ``num_write_back_ops`` is the number of flush operations issued to
+		// write back dirty pages, when ``disk_write_back_limit`` is set.
+		// ``num_write_back_throttled`` is the number of writes that exceeded
+		// the budget, throttling the peer. ``disk_write_back_time`` is the
+		// cumulative time spent flushing, in microseconds.
+		METRIC(disk, num_write_back_ops)
+		METRIC(disk, num_write_back_throttled)
+		METRIC(disk, disk_write_back_time)
+
+		// when ``disk_block_cache_size`` is set, the number of block reads
+		// served from the block cache (``block_cache_hits``) and the number
+		// that were not (``block_cache_misses``). ``block_cache_evictions`` is
+		// the number of blocks evicted to make room for more popular ones, and
+		// ``block_cache_rejections`` the number of blocks not admitted because
+		// they were accessed less frequently than the ones they would evict.
+		METRIC(disk, block_cache_hits)
+		METRIC(disk, block_cache_misses)
+		METRIC(disk, block_cache_evictions)
+		METRIC(disk, block_cache_rejections)
+
+		// the number of disk jobs executed in each priority class, and the
+		// cumulative time they spent in the queue, in microseconds. The
+		// classes are time critical jobs (reads and hashes of pieces with a
+		// deadline), reads of blocks requested by peers, writes (and other
+		// jobs not reading files), and hashing and checking.
+		// ``num_aged_disk_jobs`` is the number of jobs executed ahead of higher
+		// priority ones, because they had been queued for longer than
+		// ``disk_job_aging_limit``.
+		METRIC(disk, time_critical_queue_jobs)
+		METRIC(disk, read_queue_jobs)
+		METRIC(disk, write_queue_jobs)
+		METRIC(disk, hash_queue_jobs)
+		METRIC(disk, time_critical_queue_time)
+		METRIC(disk, read_queue_time)
+		METRIC(disk, write_queue_time)
+		METRIC(disk, hash_queue_time)
+		METRIC(disk, num_aged_disk_jobs)
+
+		// the number of files currently open by the disk I/O subsystem, and how
+		// many of those are in the protected (hot) segment of the
+		// ``two_queue_eviction`` policy.
+		METRIC(disk, num_open_files)
+		METRIC(disk, num_hot_open_files)
+
+		// the total number of bytes of the open files that are mapped into
+		// memory, and the number of bytes written to them that have not been
+		// flushed yet.
+		METRIC(disk, file_pool_mapped_bytes)
+		METRIC(disk, file_pool_dirty_bytes)
+
+		// the number of bytes of blocks held in the block cache
+		METRIC(disk, block_cache_bytes)
+
+		// the number of disk jobs currently queued in each priority class
+		METRIC(disk, queued_time_critical_jobs)
+		METRIC(disk, queued_read_jobs)
+		METRIC(disk, queued_write_jobs)
+		METRIC(disk, queued_hash_jobs)
+
+		// the number of bytes of memory used by the merkle hash trees of v2
+		// torrents. Only the block hashes of pieces in progress are kept in
+		// memory, along with the piece layer.
+		METRIC(picker, merkle_tree_bytes)
+
 		// for each kind of disk job, a counter of how many jobs of that kind
 		// are currently blocked by a disk fence
 		METRIC(disk, num_fenced_read)
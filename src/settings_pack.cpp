@@ -149,7 +149,8 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(proxy_password, "", &session_impl::update_proxy),
 		SET(i2p_hostname, "", &session_impl::update_i2p_bridge),
 		SET(peer_fingerprint, "-LT2070-", nullptr),
-		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes)
+		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes),
+		SET(outgoing_interface_weights, "", &session_impl::update_outgoing_interfaces)
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -239,6 +240,7 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(allow_idna, false, nullptr),
 		SET(enable_set_file_valid_data, false, nullptr),
 		SET(socks5_udp_send_local_ep, false, nullptr),
+		SET(listen_accept_queue_affinity, false, nullptr),
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -396,6 +398,18 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(dht_max_infohashes_sample_count, 20, nullptr),
 		SET(max_piece_count, 0x200000, nullptr),
 		SET(metadata_token_limit, 2500000, nullptr),
+		SET(disk_prefetch_queue_depth, 16, nullptr),
+		SET(disk_read_ahead_limit, 1024 * 1024, nullptr),
+		SET(file_pool_eviction_policy, settings_pack::lru_eviction, nullptr),
+		SET(file_pool_mapped_limit, 0, nullptr),
+		SET(disk_write_back_limit, 0, nullptr),
+		SET(disk_block_cache_size, 0, nullptr),
+		SET(disk_job_aging_limit, 500, nullptr),
+		SET(move_storage_threads, 2, nullptr),
+		SET(urlseed_connections, 1, nullptr),
+		SET(resolver_threads, 8, &session_impl::update_resolver_threads),
+		SET(resolver_negative_cache_timeout, 60, &session_impl::update_resolver_cache_timeout),
+		SET(listen_accept_queues, 1, nullptr),
 	}});
 
 #undef SET
@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <numeric>
 #include <cstdio>
 #include <functional>
+#include <algorithm>
 
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/torrent.hpp"
@@ -50,6 +51,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/session_impl.hpp"
 #include "libtorrent/peer_connection.hpp"
 #include "libtorrent/peer_info.hpp"
+#include "libtorrent/peer_connection_handle.hpp"
+#include "libtorrent/aux_/has_block.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/operations.hpp" // for operation_t enum
 
@@ -67,6 +70,29 @@ struct torrent;
 namespace {
 
 
+	struct smart_ban_plugin;
+
+	// attached to every peer connection. It hashes re-downloaded blocks of
+	// failed pieces as they're received, before they are handed to the disk
+	// thread, so that the torrent plugin can attribute data to peers without
+	// reading it back
+	struct smart_ban_peer_plugin final : peer_plugin
+	{
+		smart_ban_peer_plugin(std::weak_ptr<smart_ban_plugin> tp
+			, peer_connection_handle const& pc)
+			: m_tp(std::move(tp))
+			, m_pc(pc)
+		{}
+
+		string_view type() const override { return "smart_ban"; }
+
+		bool on_piece(peer_request const& r, span<char const> buf) override;
+
+	private:
+		std::weak_ptr<smart_ban_plugin> m_tp;
+		peer_connection_handle m_pc;
+	};
+
 	struct smart_ban_plugin final
 		: torrent_plugin
 		, std::enable_shared_from_this<smart_ban_plugin>
@@ -75,63 +101,124 @@ namespace {
 			: m_torrent(t)
 		{}
 
+		std::shared_ptr<peer_plugin> new_connection(peer_connection_handle const& pc) override
+		{
+			return std::make_shared<smart_ban_peer_plugin>(shared_from_this(), pc);
+		}
+
+		void on_block(torrent_peer* const p, peer_request const& r
+			, span<char const> const buf)
+		{
+			if (p == nullptr) return;
+			if (r.start % default_block_size != 0) return;
+
+			// only pieces that have failed before are of interest. Blocks of
+			// a piece failing for the first time are read back from disk
+			if (m_failed.count(r.piece) == 0) return;
+
+			// blocks received while seeding, or for blocks we already have,
+			// are ignored by the peer connection. They never make it into
+			// the piece
+			if (m_torrent.is_seed() || !m_torrent.has_picker()
+				|| m_torrent.picker().is_downloaded(piece_block(r.piece, r.start / default_block_size)))
+				return;
+
+			std::vector<block_record>& received = m_received[r.piece];
+
+			// a peer may keep sending the same blocks while the piece keeps
+			// failing. Only the most recent copies matter, so drop the oldest
+			int const num_blocks = (m_torrent.torrent_file().piece_size(r.piece)
+				+ default_block_size - 1) / default_block_size;
+			if (int(received.size()) >= max_records_per_block * num_blocks)
+				received.erase(received.begin());
+
+			received.push_back({p, p->address()
+				, hasher(buf).final(), r.start / default_block_size});
+		}
+
 		void on_piece_pass(piece_index_t const p) override
 		{
+			std::vector<block_record> received;
+			auto const ri = m_received.find(p);
+			if (ri != m_received.end())
+			{
+				received = std::move(ri->second);
+				m_received.erase(ri);
+			}
+
 			// has this piece failed earlier? If it has, go through the
-			// CRCs from the time it failed and ban the peers that
+			// hashes from the time it failed and ban the peers that
 			// sent bad blocks
-			auto i = m_block_hashes.lower_bound(piece_block(p, 0));
-			if (i == m_block_hashes.end() || i->first.piece_index != p) return;
+			auto const fi = m_failed.find(p);
+			if (fi != m_failed.end())
+			{
+				std::vector<block_entry> const failed = std::move(fi->second);
+				m_failed.erase(fi);
 
 #ifndef TORRENT_DISABLE_LOGGING
-			if (m_torrent.should_log())
-				m_torrent.debug_log("PIECE PASS [ p: %d | block_hash_size: %d ]"
-					, static_cast<int>(p), int(m_block_hashes.size()));
+				if (m_torrent.should_log())
+					m_torrent.debug_log("PIECE PASS [ p: %d | failed_pieces: %d ]"
+						, static_cast<int>(p), int(m_failed.size()));
 #endif
 
-			int size = m_torrent.torrent_file().piece_size(p);
-			peer_request r = {p, 0, std::min(16 * 1024, size)};
-			piece_block pb(p, 0);
-			while (size > 0)
-			{
-				if (i->first.block_index == pb.block_index)
+				int const size = m_torrent.torrent_file().piece_size(p);
+				for (int b = 0; b < int(failed.size()); ++b)
 				{
+					block_entry const& e = failed[std::size_t(b)];
+					if (e.peer == nullptr) continue;
+					piece_block const pb(p, b);
+
+					// the data that made the piece pass was received after the
+					// failure. If every copy of this block we received agrees,
+					// that's the good data and there's no need to read it back
+					sha1_hash const* ok_digest = nullptr;
+					bool ambiguous = false;
+					for (auto const& rec : received)
+					{
+						if (rec.block != b) continue;
+						if (ok_digest != nullptr && *ok_digest != rec.digest)
+						{
+							ambiguous = true;
+							break;
+						}
+						ok_digest = &rec.digest;
+					}
+
+					if (ok_digest != nullptr && !ambiguous)
+					{
+						check_passed_block(pb, e, *ok_digest);
+						continue;
+					}
+
+					// we don't know which copy ended up in the piece, read it
+					// back from disk
+					int const start = b * default_block_size;
+					peer_request const r = {p, start
+						, std::min(default_block_size, size - start)};
 					m_torrent.session().disk_thread().async_read(m_torrent.storage()
 						, r, std::bind(&smart_ban_plugin::on_read_ok_block
-						, shared_from_this(), *i, i->second.peer->address(), _1, r.length, _2));
-					i = m_block_hashes.erase(i);
+						, shared_from_this(), pb, e, _1, r.length, _2));
 				}
-				else
-				{
-					TORRENT_ASSERT(i->first.block_index > pb.block_index);
-				}
-
-				if (i == m_block_hashes.end() || i->first.piece_index != p)
-					break;
-
-				r.start += 16 * 1024;
-				size -= 16 * 1024;
-				r.length = std::min(16 * 1024, size);
-				++pb.block_index;
 			}
 
-#ifndef NDEBUG
-			// make sure we actually removed all the entries for piece 'p'
-			i = m_block_hashes.lower_bound(piece_block(p, 0));
-			TORRENT_ASSERT(i == m_block_hashes.end() || i->first.piece_index != p);
-#endif
-
 			if (m_torrent.is_seed())
 			{
-				std::map<piece_block, block_entry>().swap(m_block_hashes);
-				return;
+				std::map<piece_index_t, std::vector<block_entry>>().swap(m_failed);
+				std::map<piece_index_t, std::vector<block_record>>().swap(m_received);
 			}
 		}
 
 		void on_piece_failed(piece_index_t const p) override
 		{
 			// The piece failed the hash check. Record
-			// the CRC and origin peer of every block
+			// the hash and origin peer of every block
+			std::vector<block_record> received;
+			auto const ri = m_received.find(p);
+			if (ri != m_received.end())
+			{
+				received = std::move(ri->second);
+				m_received.erase(ri);
+			}
 
 			// if the torrent is aborted, no point in starting
 			// a bunch of read operations on it
@@ -140,26 +227,49 @@ namespace {
 			std::vector<torrent_peer*> const downloaders
 				= m_torrent.picker().get_downloaders(p);
 
+			// create the entry right away, so that blocks of this piece
+			// are hashed as soon as they are downloaded again, even if
+			// the reads below haven't completed yet
+			std::vector<block_entry>& blocks = m_failed[p];
+			if (blocks.size() < downloaders.size())
+				blocks.resize(downloaders.size(), block_entry{nullptr, address(), sha1_hash()});
+
 			int size = m_torrent.torrent_file().piece_size(p);
-			peer_request r = {p, 0, std::min(16*1024, size)};
+			peer_request r = {p, 0, std::min(default_block_size, size)};
 			piece_block pb(p, 0);
 			for (auto const& i : downloaders)
 			{
 				if (i != nullptr)
 				{
-					// for very sad and involved reasons, this read need to force a copy out of the cache
-					// since the piece has failed, this block is very likely to be replaced with a newly
-					// downloaded one very soon, and to get a block by reference would fail, since the
-					// block read will have been deleted by the time it gets back to the network thread
-					m_torrent.session().disk_thread().async_read(m_torrent.storage(), r
-						, std::bind(&smart_ban_plugin::on_read_failed_block
-						, shared_from_this(), pb, i->address(), _1, r.length, _2)
-						, disk_interface::force_copy);
+					// the picker knows which peer's copy of the block was
+					// written. The most recent copy we received from that peer
+					// is the one that's in the piece
+					auto const rec = std::find_if(received.rbegin(), received.rend()
+						, [&](block_record const& e)
+						{ return e.block == pb.block_index && e.peer == i; });
+
+					if (rec != received.rend())
+					{
+						on_failed_block(pb, i, rec->digest);
+					}
+					else
+					{
+						// we didn't see this block arrive (the connection may
+						// predate this plugin). Fall back to reading it back.
+						// for very sad and involved reasons, this read need to force a copy out of the cache
+						// since the piece has failed, this block is very likely to be replaced with a newly
+						// downloaded one very soon, and to get a block by reference would fail, since the
+						// block read will have been deleted by the time it gets back to the network thread
+						m_torrent.session().disk_thread().async_read(m_torrent.storage(), r
+							, std::bind(&smart_ban_plugin::on_read_failed_block
+							, shared_from_this(), pb, i, i->address(), _1, r.length, _2)
+							, disk_interface::force_copy);
+					}
 				}
 
-				r.start += 16*1024;
-				size -= 16*1024;
-				r.length = std::min(16*1024, size);
+				r.start += default_block_size;
+				size -= default_block_size;
+				r.length = std::min(default_block_size, size);
 				++pb.block_index;
 			}
 			TORRENT_ASSERT(size <= 0);
@@ -167,16 +277,26 @@ namespace {
 
 	private:
 
-		// this entry ties a specific block CRC to
+		// this entry ties a specific block hash to
 		// a peer.
 		struct block_entry
 		{
 			torrent_peer* peer;
+			address addr;
 			sha1_hash digest;
 		};
 
-		void on_read_failed_block(piece_block const b, address const a
-			, disk_buffer_holder buffer, int const block_size
+		// a block as it was received from a peer, hashed on the way in
+		struct block_record
+		{
+			torrent_peer* peer;
+			address addr;
+			sha1_hash digest;
+			int block;
+		};
+
+		void on_read_failed_block(piece_block const b, torrent_peer* const p
+			, address const a, disk_buffer_holder buffer, int const block_size
 			, storage_error const& error)
 		{
 			TORRENT_ASSERT(m_torrent.session().is_single_thread());
@@ -184,25 +304,33 @@ namespace {
 			// ignore read errors
 			if (error) return;
 
-			hasher h;
-			h.update({buffer.data(), block_size});
-
-			auto const range = m_torrent.find_peers(a);
-
-			// there is no peer with this address anymore
-			if (range.first == range.second) return;
+			// the torrent_peer may have been removed from the peer list while
+			// the read was outstanding. Several peers may share the address,
+			// so make sure it's the same one
+			auto range = m_torrent.find_peers(a);
+			for (; range.first != range.second; ++range.first)
+			{
+				if (*range.first != p) continue;
+				on_failed_block(b, p, hasher(buffer.data(), block_size).final());
+				return;
+			}
+		}
 
-			torrent_peer* p = (*range.first);
-			block_entry e = {p, h.final()};
+		void on_failed_block(piece_block const b, torrent_peer* const p
+			, sha1_hash const& digest)
+		{
+			std::vector<block_entry>& blocks = m_failed[b.piece_index];
+			if (int(blocks.size()) <= b.block_index)
+				blocks.resize(std::size_t(b.block_index) + 1, block_entry{nullptr, address(), sha1_hash()});
 
-			auto i = m_block_hashes.lower_bound(b);
+			block_entry& e = blocks[std::size_t(b.block_index)];
 
-			if (i != m_block_hashes.end() && i->first == b && i->second.peer == p)
+			if (e.peer == p)
 			{
 				// this peer has sent us this block before
 				// if the peer is already banned, it doesn't matter if it sent
 				// good or bad data. Nothings going to change it
-				if (!p->banned && i->second.digest != e.digest)
+				if (!p->banned && e.digest != digest)
 				{
 					// this time the digest of the block is different
 					// from the first time it sent it
@@ -220,8 +348,8 @@ namespace {
 						m_torrent.debug_log("BANNING PEER [ p: %d | b: %d | c: %s"
 							" | hash1: %s | hash2: %s | ip: %s ]"
 							, static_cast<int>(b.piece_index), b.block_index, client
-							, aux::to_hex(i->second.digest).c_str()
 							, aux::to_hex(e.digest).c_str()
+							, aux::to_hex(digest).c_str()
 							, print_endpoint(p->ip()).c_str());
 					}
 #endif
@@ -229,12 +357,14 @@ namespace {
 					if (p->connection) p->connection->disconnect(
 						errors::peer_banned, operation_t::bittorrent);
 				}
-				// we already have this exact entry in the map
-				// we don't have to insert it
+				// we already have this exact entry
 				return;
 			}
 
-			m_block_hashes.insert(i, std::pair<const piece_block, block_entry>(b, e));
+			// the first peer to send a bad copy of this block keeps the slot
+			if (e.peer != nullptr) return;
+
+			e = block_entry{p, p->address(), digest};
 
 #ifndef TORRENT_DISABLE_LOGGING
 			if (m_torrent.should_log())
@@ -246,17 +376,17 @@ namespace {
 					p->connection->get_peer_info(info);
 					client = info.client.c_str();
 				}
-				m_torrent.debug_log("STORE BLOCK CRC [ p: %d | b: %d | c: %s"
+				m_torrent.debug_log("STORE BLOCK HASH [ p: %d | b: %d | c: %s"
 					" | digest: %s | ip: %s ]"
 					, static_cast<int>(b.piece_index), b.block_index, client
-					, aux::to_hex(e.digest).c_str()
+					, aux::to_hex(digest).c_str()
 					, print_address(p->ip().address()).c_str());
 			}
 #endif
 		}
 
-		void on_read_ok_block(std::pair<piece_block, block_entry> const b
-			, address const& a, disk_buffer_holder buffer, int const block_size
+		void on_read_ok_block(piece_block const b, block_entry const e
+			, disk_buffer_holder buffer, int const block_size
 			, storage_error const& error)
 		{
 			TORRENT_ASSERT(m_torrent.session().is_single_thread());
@@ -264,19 +394,23 @@ namespace {
 			// ignore read errors
 			if (error) return;
 
-			hasher h;
-			h.update({buffer.data(), block_size});
-			sha1_hash const ok_digest = h.final();
+			check_passed_block(b, e, hasher(buffer.data(), block_size).final());
+		}
 
-			if (b.second.digest == ok_digest) return;
+		void check_passed_block(piece_block const b, block_entry const& e
+			, sha1_hash const& ok_digest)
+		{
+			if (e.digest == ok_digest) return;
 
-			// find the peer
-			auto range = m_torrent.find_peers(a);
+			// find the peer. The torrent_peer may have been removed from the
+			// peer list since the piece failed, so only trust the pointer if
+			// it's still there
+			auto range = m_torrent.find_peers(e.addr);
 			if (range.first == range.second) return;
 			torrent_peer* p = nullptr;
 			for (; range.first != range.second; ++range.first)
 			{
-				if (b.second.peer != *range.first) continue;
+				if (e.peer != *range.first) continue;
 				p = *range.first;
 			}
 			if (p == nullptr) return;
@@ -293,9 +427,9 @@ namespace {
 				}
 				m_torrent.debug_log("BANNING PEER [ p: %d | b: %d | c: %s"
 					" | ok_digest: %s | bad_digest: %s | ip: %s ]"
-					, static_cast<int>(b.first.piece_index), b.first.block_index, client
+					, static_cast<int>(b.piece_index), b.block_index, client
 					, aux::to_hex(ok_digest).c_str()
-					, aux::to_hex(b.second.digest).c_str()
+					, aux::to_hex(e.digest).c_str()
 					, print_address(p->ip().address()).c_str());
 			}
 #endif
@@ -306,15 +440,41 @@ namespace {
 
 		torrent& m_torrent;
 
-		// This table maps a piece_block (piece and block index
-		// pair) to a peer and the block CRC. The CRC is calculated
-		// from the data in the block + the salt
-		std::map<piece_block, block_entry> m_block_hashes;
+		// the number of copies of each block of a piece we keep in
+		// m_received, on average
+		static constexpr int max_records_per_block = 2;
+
+		// blocks received for pieces that have failed the hash check
+		// before, in the order they arrived. Cleared once the piece is
+		// checked again
+		std::map<piece_index_t, std::vector<block_record>> m_received;
+
+		// for pieces that have failed the hash check, the peer and block
+		// hash of every block, indexed by block. An entry with a nullptr
+		// peer means the block's origin is unknown
+		std::map<piece_index_t, std::vector<block_entry>> m_failed;
 
 		// explicitly disallow assignment, to silence msvc warning
 		smart_ban_plugin& operator=(smart_ban_plugin const&) = delete;
 	};
 
+	bool smart_ban_peer_plugin::on_piece(peer_request const& r
+		, span<char const> const buf)
+	{
+		std::shared_ptr<smart_ban_plugin> tp = m_tp.lock();
+		if (!tp) return false;
+
+		// neither are blocks we didn't ask this peer for
+		std::shared_ptr<peer_connection> const pc = m_pc.native_handle();
+		auto const& queue = pc->download_queue();
+		if (std::none_of(queue.begin(), queue.end()
+			, aux::has_block(piece_block(r.piece, r.start / default_block_size))))
+			return false;
+
+		tp->on_block(pc->peer_info_struct(), r, buf);
+		return false;
+	}
+
 } }
 
 namespace libtorrent {
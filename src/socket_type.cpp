@@ -157,6 +157,27 @@ namespace aux {
 		return boost::apply_visitor(get_close_reason_visitor{}, s);
 	}
 
+#if TORRENT_USE_SSL
+	struct ssl_session_reused_visitor
+	{
+		template <typename T>
+		bool operator()(ssl_stream<T>& s) const
+		{ return ssl::session_reused(s.handle()); }
+		template <typename T>
+		bool operator()(T&) const { return false; }
+	};
+#endif
+
+	bool ssl_session_reused(socket_type& s)
+	{
+#if TORRENT_USE_SSL
+		return boost::apply_visitor(ssl_session_reused_visitor{}, s);
+#else
+		TORRENT_UNUSED(s);
+		return false;
+#endif
+	}
+
 #if TORRENT_USE_SSL
 	struct set_ssl_hostname_visitor
 	{
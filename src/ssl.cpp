@@ -36,6 +36,11 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #if TORRENT_USE_SSL
 
+#include "libtorrent/random.hpp"
+
+#include <algorithm>
+#include <iterator>
+
 #ifdef TORRENT_USE_OPENSSL
 #include <openssl/x509v3.h> // for GENERAL_NAME
 #endif
@@ -170,7 +175,119 @@ context_handle_type get_context(stream_handle_type s)
 #endif
 }
 
+bool session_reused(stream_handle_type s)
+{
+#if defined TORRENT_USE_OPENSSL
+	return SSL_session_reused(s) == 1;
+#elif defined TORRENT_USE_GNUTLS
+	return gnutls_session_is_resumed(s->native_handle()) != 0;
+#endif
+}
+
+void set_session_id_context(context_handle_type c, string_view id, error_code& ec)
+{
+#if defined TORRENT_USE_OPENSSL
+	if (SSL_CTX_set_session_id_context(c
+		, reinterpret_cast<unsigned char const*>(id.data())
+		, static_cast<unsigned int>(std::min(id.size(), std::size_t(SSL_MAX_SID_CTX_LENGTH)))) != 1)
+	{
+		ec = error_code(int(ERR_get_error()), error::get_ssl_category());
+	}
+#elif defined TORRENT_USE_GNUTLS
+	// GnuTLS binds resumed sessions to the server's credentials instead
+	TORRENT_UNUSED(c);
+	TORRENT_UNUSED(id);
+	TORRENT_UNUSED(ec);
+#endif
+}
+
 #if defined TORRENT_USE_OPENSSL
+namespace {
+
+	void free_endpoint(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+	{
+		delete static_cast<tcp::endpoint*>(ptr);
+	}
+
+	// the remote endpoint of an outgoing stream, for client_session_cache
+	int endpoint_index()
+	{
+		static int const idx = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_endpoint);
+		return idx;
+	}
+
+	// the client_session_cache installed on a context
+	int session_cache_index()
+	{
+		static int const idx = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+		return idx;
+	}
+}
+
+client_session_cache::client_session_cache(context_handle_type const c, int const max_size)
+	: m_ctx(c)
+	, m_max_size(max_size)
+{
+	SSL_CTX_set_ex_data(m_ctx, session_cache_index(), this);
+	// we keep the sessions ourselves, keyed by endpoint. OpenSSL's internal
+	// client cache can't be looked up
+	SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(m_ctx, &client_session_cache::on_new_session);
+}
+
+client_session_cache::~client_session_cache()
+{
+	// streams created from the context may outlive us
+	SSL_CTX_sess_set_new_cb(m_ctx, nullptr);
+	SSL_CTX_set_ex_data(m_ctx, session_cache_index(), nullptr);
+	for (auto const& s : m_sessions) SSL_SESSION_free(s.second);
+}
+
+void client_session_cache::prepare(stream_handle_type const s, tcp::endpoint const& ep)
+{
+	SSL_set_ex_data(s, endpoint_index(), new tcp::endpoint(ep));
+
+	auto const i = m_sessions.find(ep);
+	if (i == m_sessions.end()) return;
+
+	// if the server doesn't accept the session anymore, the handshake falls
+	// back to a full one
+	SSL_set_session(s, i->second);
+}
+
+int client_session_cache::on_new_session(SSL* const s, SSL_SESSION* const sess)
+{
+	auto* const self = static_cast<client_session_cache*>(
+		SSL_CTX_get_ex_data(SSL_get_SSL_CTX(s), session_cache_index()));
+	auto const* const ep = static_cast<tcp::endpoint const*>(
+		SSL_get_ex_data(s, endpoint_index()));
+
+	// returning 0 tells OpenSSL we didn't keep a reference to the session
+	if (self == nullptr || ep == nullptr) return 0;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	if (!SSL_SESSION_is_resumable(sess)) return 0;
+#endif
+
+	auto const i = self->m_sessions.find(*ep);
+	if (i != self->m_sessions.end())
+	{
+		SSL_SESSION_free(i->second);
+		i->second = sess;
+		return 1;
+	}
+
+	if (int(self->m_sessions.size()) >= self->m_max_size)
+	{
+		// make room by dropping an arbitrary session
+		auto const victim = std::next(self->m_sessions.begin()
+			, int(random(std::uint32_t(self->m_sessions.size() - 1))));
+		SSL_SESSION_free(victim->second);
+		self->m_sessions.erase(victim);
+	}
+	self->m_sessions.emplace(*ep, sess);
+	return 1;
+}
+
 namespace {
 	struct lifecycle
 	{
@@ -0,0 +1,240 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/aux_/storage_mover.hpp"
+#include "libtorrent/aux_/storage_utils.hpp"
+#include "libtorrent/aux_/path.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+
+namespace libtorrent {
+namespace aux {
+
+	precopy_state::precopy_state(std::string dest, int const num_files)
+		: destination(std::move(dest))
+		, copied(std::size_t(num_files))
+		, written(std::size_t(num_files))
+	{}
+
+	precopy_state::~precopy_state()
+	{
+		// delete the copies that were never renamed into place, and the
+		// directories created for them, if they're empty
+		for (auto const& f : m_files)
+		{
+			error_code ec;
+			remove(f, ec);
+			for (std::string dir = parent_path(f);
+				!dir.empty() && !path_equal(dir, destination) && !ec;
+				dir = parent_path(dir))
+			{
+				remove(dir, ec);
+			}
+		}
+	}
+
+	void precopy_state::set_copied(file_index_t const f, std::string path)
+	{
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			if (std::find(m_files.begin(), m_files.end(), path) == m_files.end())
+				m_files.push_back(std::move(path));
+		}
+		copied[std::size_t(static_cast<int>(f))] = true;
+	}
+
+	storage_mover::storage_mover(io_context& ios)
+		: m_ios(ios)
+	{}
+
+	storage_mover::~storage_mover()
+	{
+		abort();
+	}
+
+	void storage_mover::set_max_threads(int const n)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_max_threads = std::max(1, n);
+	}
+
+	void storage_mover::async_copy(storage_index_t const storage
+		, std::vector<file_copy> files
+		, std::shared_ptr<precopy_state> state
+		, copy_handler handler)
+	{
+		auto t = std::make_shared<task>(m_ios);
+		t->storage = storage;
+		t->state = std::move(state);
+		t->handler = std::move(handler);
+
+		// copy the largest files first, to not end up waiting for a single
+		// large file on one thread at the end
+		std::sort(files.begin(), files.end(), [](file_copy const& lhs, file_copy const& rhs)
+			{ return lhs.size > rhs.size; });
+		for (auto const& f : files) t->total += f.size;
+		t->files = std::move(files);
+
+		std::lock_guard<std::mutex> l(m_mutex);
+		if (m_abort)
+		{
+			post(m_ios, [h = std::move(t->handler)]
+				{ h(boost::asio::error::operation_aborted, file_index_t(-1)); });
+			return;
+		}
+		// a new move of the same storage supersedes any previous one. The
+		// superseded task may still have copies in flight, so the new one
+		// isn't started until it's gone (see thread_fun())
+		auto const tasks = m_tasks;
+		for (auto const& p : tasks)
+		{
+			if (p->storage != storage) continue;
+			p->aborted = true;
+			maybe_complete(p);
+		}
+		m_tasks.push_back(t);
+		maybe_complete(t);
+
+		int const want = std::min(m_max_threads, int(t->files.size()));
+		while (int(m_threads.size()) < want)
+			m_threads.emplace_back([this] { thread_fun(); });
+		m_cond.notify_all();
+	}
+
+	void storage_mover::abort(storage_index_t const storage)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto const tasks = m_tasks;
+		for (auto const& t : tasks)
+		{
+			if (t->storage != storage) continue;
+			t->aborted = true;
+			maybe_complete(t);
+		}
+	}
+
+	void storage_mover::abort()
+	{
+		std::vector<std::thread> threads;
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			m_abort = true;
+			for (auto const& t : m_tasks) t->aborted = true;
+			threads.swap(m_threads);
+			m_cond.notify_all();
+		}
+		for (auto& t : threads) t.join();
+
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto const tasks = m_tasks;
+		for (auto const& t : tasks) maybe_complete(t);
+		TORRENT_ASSERT(m_tasks.empty());
+	}
+
+	std::pair<std::int64_t, std::int64_t> storage_mover::progress(storage_index_t const storage) const
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (auto const& t : m_tasks)
+		{
+			if (t->storage != storage) continue;
+			return {t->copied.load(), t->total};
+		}
+		return {0, 0};
+	}
+
+	void storage_mover::maybe_complete(std::shared_ptr<task> const& t)
+	{
+		if (t->in_flight > 0) return;
+		if (!t->aborted && !t->error && t->next < t->files.size()) return;
+
+		auto const it = std::find(m_tasks.begin(), m_tasks.end(), t);
+		if (it == m_tasks.end()) return;
+		m_tasks.erase(it);
+
+		error_code ec = t->error;
+		file_index_t file = t->error_file;
+		if (!ec && t->aborted)
+			ec = boost::asio::error::operation_aborted;
+		if (!ec) t->state->complete = true;
+
+		post(m_ios, [h = std::move(t->handler), ec, file] { h(ec, file); });
+	}
+
+	void storage_mover::thread_fun()
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		for (;;)
+		{
+			std::shared_ptr<task> t;
+			for (auto i = m_tasks.begin(); i != m_tasks.end(); ++i)
+			{
+				auto const& c = *i;
+				if (c->aborted || c->error || c->next >= c->files.size()) continue;
+				// wait for an earlier task for the same storage to drain
+				if (std::any_of(m_tasks.begin(), i, [&](std::shared_ptr<task> const& e)
+					{ return e->storage == c->storage; }))
+					continue;
+				t = c;
+				break;
+			}
+
+			if (!t)
+			{
+				if (m_abort) return;
+				m_cond.wait(l);
+				continue;
+			}
+
+			file_copy const& f = t->files[t->next++];
+			++t->in_flight;
+			l.unlock();
+
+			error_code ec;
+			precopy_file(f.source, f.destination, t->copied, t->aborted, ec);
+			if (!ec)
+				t->state->set_copied(f.file, f.destination);
+
+			l.lock();
+			--t->in_flight;
+			if (ec && !t->error && ec != boost::asio::error::operation_aborted)
+			{
+				t->error = ec;
+				t->error_file = f.file;
+			}
+			maybe_complete(t);
+			m_cond.notify_all();
+		}
+	}
+}
+}
@@ -38,6 +38,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file_storage.hpp"
 #include "libtorrent/aux_/alloca.hpp"
 #include "libtorrent/aux_/path.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/aux_/open_mode.hpp"
 #include "libtorrent/session.hpp" // for session::delete_files
 #include "libtorrent/stat_cache.hpp"
 #include "libtorrent/add_torrent_params.hpp"
@@ -50,7 +52,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <unistd.h> // for symlink()
 #endif
 
+#ifndef TORRENT_WINDOWS
+#include <unistd.h> // for lseek()
+#include <cerrno>
+#endif
+
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <tuple>
 
 namespace libtorrent { namespace aux {
 
@@ -143,6 +153,7 @@ namespace libtorrent { namespace aux {
 		, std::string save_path
 		, std::string const& destination_save_path
 		, std::function<void(std::string const&, error_code&)> const& move_partfile
+		, std::function<std::string(file_index_t)> const& precopied_path
 		, move_flags_t const flags, storage_error& ec)
 	{
 		status_t ret = status_t::no_error;
@@ -203,6 +214,10 @@ namespace libtorrent { namespace aux {
 		// later
 		aux::vector<bool, file_index_t> copied_files(std::size_t(f.num_files()), false);
 
+		// the paths of the files that were copied ahead of time, and renamed
+		// into place. In case of an error, they're renamed back
+		aux::vector<std::string, file_index_t> precopies(std::size_t(f.num_files()));
+
 		// track how far we got in case of an error
 		file_index_t file_index{};
 		error_code e;
@@ -214,13 +229,31 @@ namespace libtorrent { namespace aux {
 			std::string const old_path = combine_path(save_path, f.file_path(i));
 			std::string const new_path = combine_path(new_save_path, f.file_path(i));
 
+			std::string precopy = precopied_path ? precopied_path(i) : std::string();
+
 			error_code ignore;
 			if (flags == move_flags_t::dont_replace && exists(new_path, ignore))
 			{
+				if (!precopy.empty()) remove(precopy, ignore);
 				if (ret == status_t::no_error) ret = status_t::need_full_check;
 				continue;
 			}
 
+			// the file was copied ahead of time, while the torrent kept using
+			// the source. All that's left is to put it in place and delete the
+			// source. If that fails, fall back to moving the source
+			if (!precopy.empty())
+			{
+				rename(precopy, new_path, e);
+				if (!e)
+				{
+					copied_files[i] = true;
+					precopies[i] = std::move(precopy);
+					continue;
+				}
+				e.clear();
+			}
+
 			// TODO: ideally, if we end up copying files because of a move across
 			// volumes, the source should not be deleted until they've all been
 			// copied. That would let us rollback with higher confidence.
@@ -271,13 +304,21 @@ namespace libtorrent { namespace aux {
 				// files moved out to absolute paths are not moved
 				if (f.file_absolute_path(file_index)) continue;
 
+				std::string const old_path = combine_path(save_path, f.file_path(file_index));
+				std::string const new_path = combine_path(new_save_path, f.file_path(file_index));
+
+				// copies made ahead of time are kept for the next attempt
+				if (!precopies[file_index].empty())
+				{
+					error_code ignore;
+					rename(new_path, precopies[file_index], ignore);
+					continue;
+				}
+
 				// if we ended up copying the file, don't do anything during
 				// roll-back
 				if (copied_files[file_index]) continue;
 
-				std::string const old_path = combine_path(save_path, f.file_path(file_index));
-				std::string const new_path = combine_path(new_save_path, f.file_path(file_index));
-
 				// ignore errors when rolling back
 				error_code ignore;
 				move_file(new_path, old_path, ignore);
@@ -331,6 +372,136 @@ namespace libtorrent { namespace aux {
 
 	namespace {
 
+	// returns the range of the next run of data in the file at or after
+	// ``offset``, skipping holes. File systems that don't report holes have
+	// data all the way to the end
+	std::pair<std::int64_t, std::int64_t> next_data(handle_type const fd
+		, std::int64_t const offset, std::int64_t const size)
+	{
+#if defined SEEK_DATA && defined SEEK_HOLE
+		off_t const data = ::lseek(fd, off_t(offset), SEEK_DATA);
+		if (data < 0)
+		{
+			// ENXIO means there's only a hole past offset
+			if (errno == ENXIO) return {size, size};
+			return {offset, size};
+		}
+		off_t const hole = ::lseek(fd, data, SEEK_HOLE);
+		if (hole < 0) return {std::int64_t(data), size};
+		return {std::min(std::int64_t(data), size), std::min(std::int64_t(hole), size)};
+#else
+		TORRENT_UNUSED(fd);
+		return {offset, size};
+#endif
+	}
+
+	}
+
+	void precopy_file(std::string const& from, std::string const& to
+		, std::atomic<std::int64_t>& progress
+		, std::atomic<bool> const& abort
+		, error_code& ec)
+	{
+		// large chunks keep the number of system calls (and seeks, when
+		// several files are copied in parallel) down
+		std::int64_t const chunk_size = 4 * 1024 * 1024;
+
+		ec.clear();
+		try
+		{
+			create_directories(parent_path(to), ec);
+			if (ec) return;
+
+			aux::file_handle in(from, 0, aux::open_mode::read_only);
+			std::int64_t const size = in.get_size();
+			aux::file_handle out(to, size
+				, aux::open_mode::write | aux::open_mode::truncate | aux::open_mode::sparse);
+
+			// first try to have the kernel copy the data, it doesn't need to
+			// pass through user space and the file system may not have to copy
+			// it at all. Holes in the source are skipped, to keep them in the
+			// (sparse) destination
+			bool kernel_copy = true;
+			std::vector<char> buffer;
+			std::int64_t offset = 0;
+			std::int64_t data_end = 0;
+			while (offset < size)
+			{
+				if (abort)
+				{
+					ec = boost::asio::error::operation_aborted;
+					break;
+				}
+
+				if (offset >= data_end)
+				{
+					std::int64_t data_start;
+					std::tie(data_start, data_end) = next_data(in.fd(), offset, size);
+					progress += data_start - offset;
+					offset = data_start;
+					if (offset >= size) break;
+				}
+
+				std::int64_t const len = std::min(data_end - offset, chunk_size);
+				if (kernel_copy)
+				{
+					std::int64_t const ret = aux::clone_range(in.fd(), offset
+						, out.fd(), offset, len, ec);
+					if (ec == boost::system::errc::operation_not_supported)
+					{
+						ec.clear();
+						kernel_copy = false;
+					}
+					else if (ec)
+					{
+						break;
+					}
+					else
+					{
+						if (ret == 0) break;
+						offset += ret;
+						progress += ret;
+						continue;
+					}
+				}
+
+				if (buffer.empty()) buffer.resize(std::size_t(chunk_size));
+				span<char> buf(buffer.data(), std::ptrdiff_t(len));
+				int const ret = aux::pread_all(in.fd(), buf, offset, ec);
+				if (ec == boost::asio::error::eof) ec.clear();
+				if (ec || ret == 0) break;
+				buf = buf.first(ret);
+				if (std::any_of(buf.begin(), buf.end(), [](char const c) { return c != 0; }))
+				{
+					aux::pwrite_all(out.fd(), buf, offset, ec);
+					if (ec) break;
+				}
+				offset += ret;
+				progress += ret;
+			}
+
+			// the source file shrunk under our feet
+			if (!ec && offset < size) ec = boost::asio::error::eof;
+		}
+		catch (storage_error const& e)
+		{
+			ec = e.ec;
+		}
+
+		if (ec)
+		{
+			error_code ignore;
+			remove(to, ignore);
+		}
+	}
+
+	std::string precopy_path(std::string const& path)
+	{
+		return path + ".moving";
+	}
+
+	namespace {
+
 	void delete_one_file(std::string const& p, error_code& ec)
 	{
 		remove(p, ec);
@@ -123,12 +123,18 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include "libtorrent/aux_/torrent_impl.hpp"
+#include "libtorrent/aux_/disk_interface_ext.hpp"
 
 using namespace std::placeholders;
 
 namespace libtorrent {
 namespace {
 
+#if defined TORRENT_SSL_PEERS && defined TORRENT_USE_OPENSSL
+// the max number of peers we keep SSL sessions for, per torrent
+constexpr int max_ssl_sessions = 1000;
+#endif
+
 bool is_downloading_state(int const st)
 {
 	switch (st)
@@ -433,6 +439,7 @@ bool is_downloading_state(int const st)
 				m_merkle_trees[i].load_tree(trees_import[i], verified_bitmask);
 			}
 		}
+		update_merkle_tree_memory();
 	}
 
 	void torrent::inc_stats_counter(int c, int value)
@@ -717,9 +724,12 @@ bool is_downloading_state(int const st)
 		// just in case, make sure the session accounting is kept right
 		for (auto p : m_connections)
 			m_ses.close_connection(p);
+
+		m_ses.stats_counters().inc_stats_counter(counters::merkle_tree_bytes
+			, -m_merkle_tree_memory);
 	}
 
-	void torrent::read_piece(piece_index_t const piece)
+	void torrent::read_piece(piece_index_t const piece, bool const time_critical)
 	{
 		error_code ec;
 		if (m_abort || m_deleted)
@@ -772,6 +782,8 @@ bool is_downloading_state(int const st)
 		if (read_mode == settings_pack::disable_os_cache)
 			flags |= disk_interface::volatile_read;
 
+		auto* const critical_disk = time_critical ? m_ses.disk_thread_ext() : nullptr;
+
 		peer_request r;
 		r.piece = piece;
 		r.start = 0;
@@ -779,10 +791,12 @@ bool is_downloading_state(int const st)
 		for (int i = 0; i < blocks_in_piece; ++i, r.start += block_size())
 		{
 			r.length = std::min(piece_size - r.start, block_size());
-			m_ses.disk_thread().async_read(m_storage, r
-				, [self, r, rp](disk_buffer_holder block, storage_error const& se) mutable
-				{ self->on_disk_read_complete(std::move(block), se, r, rp); }
-				, flags);
+			auto handler = [self, r, rp](disk_buffer_holder block, storage_error const& se) mutable
+				{ self->on_disk_read_complete(std::move(block), se, r, rp); };
+			if (critical_disk)
+				critical_disk->async_read_time_critical(m_storage, r, std::move(handler), flags);
+			else
+				m_ses.disk_thread().async_read(m_storage, r, std::move(handler), flags);
 		}
 		m_ses.deferred_submit_jobs();
 	}
@@ -1210,6 +1224,11 @@ bool is_downloading_state(int const st)
 
 		if (m_have_all) pp->we_have_all();
 
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+		// the picker tracks piece availability from now on
+		m_swarm_copies.clear();
+#endif
+
 		// initialize the file progress too
 		if (m_file_progress.empty())
 			m_file_progress.init(*pp, m_torrent_file->files());
@@ -1667,6 +1686,28 @@ bool is_downloading_state(int const st)
 			return;
 		}
 
+		// incoming connections are accepted with the session's SSL context
+		// and switched to this one once the SNI names the torrent. They
+		// resume sessions from the session context's cache (or its session
+		// tickets), so this ID is what prevents a session established with
+		// one torrent from being resumed into another
+		string_view const id = m_info_hash.has_v2()
+			? string_view(m_info_hash.v2.data(), std::size_t(m_info_hash.v2.size()))
+			: string_view(m_info_hash.v1.data(), std::size_t(m_info_hash.v1.size()));
+		ssl::set_session_id_context(ssl::get_handle(*ctx), id, ec);
+		if (ec)
+		{
+			set_error(ec, torrent_status::error_file_ssl_ctx);
+			pause();
+			return;
+		}
+
+#ifdef TORRENT_USE_OPENSSL
+		m_ssl_sessions.reset();
+		m_ssl_sessions = std::make_unique<ssl::client_session_cache>(
+			ssl::get_handle(*ctx), max_ssl_sessions);
+#endif
+
 #if 0
 		char filename[100];
 		std::snprintf(filename, sizeof(filename), "/tmp/%u.pem", random());
@@ -4174,92 +4215,73 @@ namespace {
 		// the blocks are guaranteed to represent exactly one piece
 		TORRENT_ASSERT(blocks_in_piece == int(block_hashes.size()));
 
-		TORRENT_ALLOCA(block_passed, bool, blocks_in_piece);
-		std::fill(block_passed.begin(), block_passed.end(), false);
-
-		set_block_hash_result last_result = set_block_hash_result(set_block_hash_result::result::unknown);
-
-		for (int i = 0; i < blocks_in_piece; ++i)
-		{
-			// if there was an enoent or eof error the block hashes array may be incomplete
-			// bail if we've hit the end of the valid hashes
-			if (block_hashes[i].is_all_zeros()) return false;
-
-			auto const result = get_hash_picker().set_block_hash(piece
-				, i * default_block_size, block_hashes[i]);
-			last_result = result;
-
-			if (result.status == set_block_hash_result::result::success)
-			{
-				TORRENT_ASSERT(result.first_verified_block < blocks_in_piece);
-				TORRENT_ASSERT(blocks_in_piece <= blocks_per_piece);
-
-				// all verified ranges should always be full pieces or less
-				TORRENT_ASSERT(result.first_verified_block >= 0
-					|| (result.first_verified_block % blocks_per_piece) == 0);
-				TORRENT_ASSERT(result.num_verified <= blocks_per_piece
-					|| (result.num_verified % blocks_per_piece) == 0);
-
-				// note that result.num_verified may cover pad blocks too, and
-				// so may be > blocks_in_piece
-
-				// sometimes, completing a single block may "unlock" validating
-				// multiple pieces. e.g. if we don't have the piece layer yet,
-				// but we completed the last block in the whole torrent, now we
-				// can validate everything. For this reason,
-				// first_verified_block may be negative.
-
-				// In this call, we track the blocks in this piece though, in
-				// the block_passed array. For that tracking we need to clamp
-				// the start index to 0.
-				auto const first_block = std::max(0, result.first_verified_block);
-				auto const count = std::min(blocks_in_piece - first_block, result.num_verified);
-				std::fill_n(block_passed.begin() + first_block, count, true);
-
-				// the current block (i) should be part of the range that was
-				// verified
-				TORRENT_ASSERT(first_block <= i);
-				TORRENT_ASSERT(i < first_block + count);
-
-				using delta = piece_index_t::diff_type;
-
-				// if the hashes for more than one piece have been verified,
-				// check for any pieces which were already checked but couldn't
-				// be verified and mark them as verified
-				for (piece_index_t verified_piece = piece + delta(result.first_verified_block / blocks_per_piece)
-					, end = verified_piece + delta(result.num_verified / blocks_per_piece)
-					; verified_piece < end; ++verified_piece)
-				{
-					if (!has_picker()
-						|| verified_piece == piece
-						|| !m_picker->is_piece_finished(verified_piece)
-						|| m_picker->has_piece_passed(verified_piece))
-						continue;
+		// if there was an enoent or eof error the block hashes array may be
+		// incomplete. Only set the valid hashes, and fail the piece
+		auto const valid_end = std::find_if(block_hashes.begin(), block_hashes.end()
+			, [](sha256_hash const& h) { return h.is_all_zeros(); });
+		int const num_valid = int(valid_end - block_hashes.begin());
+		if (num_valid < blocks_in_piece) ret = false;
+		if (num_valid == 0) return ret;
+
+		// all blocks of the piece are set in one call, which lets the merkle
+		// tree validate them against the piece hash in a single pass
+		auto const result = get_hash_picker().set_block_hashes(piece
+			, 0, block_hashes.first(num_valid));
+		update_merkle_tree_memory();
+
+		if (result.status == set_block_hash_result::result::success)
+		{
+			TORRENT_ASSERT(result.first_verified_block < blocks_in_piece);
+			TORRENT_ASSERT(blocks_in_piece <= blocks_per_piece);
+
+			// all verified ranges should always be full pieces or less
+			TORRENT_ASSERT(result.first_verified_block >= 0
+				|| (result.first_verified_block % blocks_per_piece) == 0);
+			TORRENT_ASSERT(result.num_verified <= blocks_per_piece
+				|| (result.num_verified % blocks_per_piece) == 0);
+
+			// note that result.num_verified may cover pad blocks too, and
+			// so may be > blocks_in_piece
+
+			// sometimes, completing a single block may "unlock" validating
+			// multiple pieces. e.g. if we don't have the piece layer yet,
+			// but we completed the last block in the whole torrent, now we
+			// can validate everything. For this reason,
+			// first_verified_block may be negative.
+			TORRENT_ASSERT(result.first_verified_block <= 0);
+			TORRENT_ASSERT(result.first_verified_block + result.num_verified >= num_valid);
+
+			using delta = piece_index_t::diff_type;
+
+			// if the hashes for more than one piece have been verified,
+			// check for any pieces which were already checked but couldn't
+			// be verified and mark them as verified
+			for (piece_index_t verified_piece = piece + delta(result.first_verified_block / blocks_per_piece)
+				, end = verified_piece + delta(result.num_verified / blocks_per_piece)
+				; verified_piece < end; ++verified_piece)
+			{
+				if (!has_picker()
+					|| verified_piece == piece
+					|| !m_picker->is_piece_finished(verified_piece)
+					|| m_picker->has_piece_passed(verified_piece))
+					continue;
 
-					TORRENT_ASSERT(get_hash_picker().piece_verified(verified_piece));
-					m_picker->we_have(verified_piece);
-					update_gauge();
-					we_have(verified_piece);
-				}
-			}
-			else if (result.status == set_block_hash_result::result::block_hash_failed)
-			{
-				ret = false;
+				TORRENT_ASSERT(get_hash_picker().piece_verified(verified_piece));
+				m_picker->we_have(verified_piece);
+				update_gauge();
+				we_have(verified_piece);
 			}
+
+			if (boost::indeterminate(ret)) ret = true;
 		}
-		if (last_result.status == set_block_hash_result::result::piece_hash_failed)
+		else if (result.status == set_block_hash_result::result::block_hash_failed
+			|| result.status == set_block_hash_result::result::piece_hash_failed)
 		{
-			// only if the *last* block causes the piece to fail, do we know
-			// it actually failed. Otherwise it might have been failing
-			// because of other, previously existing block hashes.
+			// since all block hashes of the piece were set in a single call,
+			// any block (or subtree) failing its hash check means this
+			// piece failed
 			ret = false;
 		}
-
-		if (boost::indeterminate(ret) && std::all_of(block_passed.begin(), block_passed.end()
-			, [](bool e) { return e; }))
-		{
-			ret = true;
-		}
 		return ret;
 	}
 
@@ -4645,6 +4667,9 @@ namespace {
 		else
 		{
 			TORRENT_ASSERT(is_seed() || !m_have_all);
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			update_swarm_copies(index, 1);
+#endif
 		}
 	}
 
@@ -4661,6 +4686,9 @@ namespace {
 		else
 		{
 			TORRENT_ASSERT(is_seed() || !m_have_all);
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			update_swarm_copies(bits, 1);
+#endif
 		}
 	}
 
@@ -4674,6 +4702,9 @@ namespace {
 		else
 		{
 			TORRENT_ASSERT(is_seed() || !m_have_all);
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			update_swarm_copies(peer->get_bitfield(), 1);
+#endif
 		}
 	}
 
@@ -4689,6 +4720,9 @@ namespace {
 		else
 		{
 			TORRENT_ASSERT(is_seed() || !m_have_all);
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			update_swarm_copies(bits, -1);
+#endif
 		}
 	}
 
@@ -4702,6 +4736,9 @@ namespace {
 		else
 		{
 			TORRENT_ASSERT(is_seed() || !m_have_all);
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			update_swarm_copies(index, -1);
+#endif
 		}
 	}
 
@@ -4818,7 +4855,16 @@ namespace {
 		set_need_save_resume();
 		state_updated();
 
-		if (m_super_seeding) return;
+		if (m_super_seeding)
+		{
+			if (valid_metadata() && !has_picker()) init_swarm_copies();
+			return;
+		}
+
+		m_swarm_copies.clear();
+		m_swarm_copies.shrink_to_fit();
+		m_superseed_reveals.clear();
+		m_superseed_reveals.shrink_to_fit();
 
 		// disable super seeding for all peers
 		for (auto pc : *this)
@@ -4827,49 +4873,117 @@ namespace {
 		}
 	}
 
+	void torrent::init_swarm_copies()
+	{
+		TORRENT_ASSERT(valid_metadata());
+		int const num_pieces = m_torrent_file->num_pieces();
+		m_swarm_copies.assign(std::size_t(num_pieces), 0);
+
+		for (auto pc : *this)
+		{
+			auto const& bits = pc->get_bitfield();
+			if (bits.size() != num_pieces) continue;
+			for (auto const i : bits.range())
+			{
+				if (bits[i] && m_swarm_copies[i] < std::numeric_limits<std::uint16_t>::max())
+					++m_swarm_copies[i];
+			}
+		}
+	}
+
+	void torrent::update_swarm_copies(piece_index_t const index, int const delta)
+	{
+		if (m_swarm_copies.empty()) return;
+		TORRENT_ASSERT(index < m_swarm_copies.end_index());
+		int const copies = m_swarm_copies[index] + delta;
+		m_swarm_copies[index] = std::uint16_t(std::max(0
+			, std::min(copies, int(std::numeric_limits<std::uint16_t>::max()))));
+	}
+
+	void torrent::update_swarm_copies(typed_bitfield<piece_index_t> const& bits
+		, int const delta)
+	{
+		if (m_swarm_copies.empty()) return;
+		if (bits.size() != m_swarm_copies.end_index()) return;
+		for (auto const i : bits.range())
+		{
+			if (bits[i]) update_swarm_copies(i, delta);
+		}
+	}
+
+	std::pair<int, int> torrent::swarm_distributed_copies() const
+	{
+		// this mirrors piece_picker::distributed_copies(). The integer part is
+		// the lowest number of copies of any piece (including ours) and the
+		// fraction is the share of pieces with more copies than that, in
+		// thousandths
+		int const num_pieces = int(m_swarm_copies.size());
+		if (num_pieces == 0) return {1, 0};
+		int const min_copies = *std::min_element(m_swarm_copies.begin()
+			, m_swarm_copies.end());
+		int const above = int(std::count_if(m_swarm_copies.begin()
+			, m_swarm_copies.end(), [=](std::uint16_t const c) { return c > min_copies; }));
+		return {min_copies + 1, above * 1000 / num_pieces};
+	}
+
 	// TODO: 3 this should return optional<>. piece index -1 should not be
 	// allowed
 	piece_index_t torrent::get_piece_to_super_seed(typed_bitfield<piece_index_t> const& bits)
 	{
-		// return a piece with low availability that is not in
-		// the bitfield and that is not currently being super
-		// seeded by any peer
+		// return the piece with the fewest copies in the swarm that the peer
+		// doesn't have. Pieces currently being super seeded to another peer
+		// are avoided, and ties are broken by how many times we've already
+		// revealed the piece, since those copies are likely still on their
+		// way into the swarm
 		TORRENT_ASSERT(m_super_seeding);
 
-		// do a linear search from the first piece
-		int min_availability = 9999;
+		int const num_pieces = m_torrent_file->num_pieces();
+		if (m_superseed_reveals.size() != std::size_t(num_pieces))
+			m_superseed_reveals.assign(std::size_t(num_pieces), 0);
+
+		// if we have a picker, it's already tracking piece availability
+		if (!has_picker() && m_swarm_copies.empty())
+			init_swarm_copies();
+
+		// collect the pieces currently being super seeded to peers once, rather
+		// than asking every peer for every piece
+		typed_bitfield<piece_index_t> in_flight(num_pieces);
+		for (auto pc : *this)
+		{
+			for (piece_index_t const p : pc->super_seeded_pieces())
+			{
+				if (p >= piece_index_t(0) && p < in_flight.end_index())
+					in_flight.set_bit(p);
+			}
+		}
+
+		std::tuple<bool, int, int> min_key{true
+			, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
 		std::vector<piece_index_t> avail_vec;
 		for (auto const i : m_torrent_file->piece_range())
 		{
 			if (bits[i]) continue;
 
-			int availability = 0;
-			for (auto pc : *this)
-			{
-				if (pc->super_seeded_piece(i))
-				{
-					// avoid super-seeding the same piece to more than one
-					// peer if we can avoid it. Do this by artificially
-					// increase the availability
-					availability = 999;
-					break;
-				}
-				if (pc->has_piece(i)) ++availability;
-			}
-			if (availability > min_availability) continue;
-			if (availability == min_availability)
+			int const copies = has_picker()
+				? m_picker->get_availability(i)
+				: int(m_swarm_copies[i]);
+			std::tuple<bool, int, int> const key{in_flight[i], copies
+				, int(m_superseed_reveals[i])};
+
+			if (key > min_key) continue;
+			if (key < min_key)
 			{
-				avail_vec.push_back(i);
-				continue;
+				min_key = key;
+				avail_vec.clear();
 			}
-			TORRENT_ASSERT(availability < min_availability);
-			min_availability = availability;
-			avail_vec.clear();
 			avail_vec.push_back(i);
 		}
 
 		if (avail_vec.empty()) return piece_index_t{-1};
-		return avail_vec[random(std::uint32_t(avail_vec.size() - 1))];
+		piece_index_t const ret = avail_vec[random(std::uint32_t(avail_vec.size() - 1))];
+		if (m_superseed_reveals[ret] < std::numeric_limits<std::uint16_t>::max())
+			++m_superseed_reveals[ret];
+		return ret;
 	}
 #endif
 
@@ -4949,9 +5063,13 @@ namespace {
 #ifndef TORRENT_DISABLE_STREAMING
 	void torrent::cancel_non_critical()
 	{
-		std::set<piece_index_t> time_critical;
+		std::vector<piece_index_t> time_critical;
+		time_critical.reserve(m_time_critical_pieces.size());
 		for (auto const& p : m_time_critical_pieces)
-			time_critical.insert(p.piece);
+			time_critical.push_back(p.piece);
+		std::sort(time_critical.begin(), time_critical.end());
+		auto const is_critical = [&time_critical](piece_index_t const p)
+		{ return std::binary_search(time_critical.begin(), time_critical.end(), p); };
 
 		for (auto p : m_connections)
 		{
@@ -4964,7 +5082,7 @@ namespace {
 			std::vector<pending_block> dq = p->download_queue();
 			for (auto const& k : dq)
 			{
-				if (time_critical.count(k.block.piece_index)) continue;
+				if (is_critical(k.block.piece_index)) continue;
 				if (k.not_wanted || k.timed_out) continue;
 				p->cancel_request(k.block, true);
 			}
@@ -4974,7 +5092,7 @@ namespace {
 			std::vector<pending_block> rq = p->request_queue();
 			for (auto const& k : rq)
 			{
-				if (time_critical.count(k.block.piece_index)) continue;
+				if (is_critical(k.block.piece_index)) continue;
 				p->cancel_request(k.block, true);
 			}
 		}
@@ -5010,7 +5128,7 @@ namespace {
 		if (is_seed() || (has_picker() && m_picker->has_piece_passed(piece)))
 		{
 			if (flags & torrent_handle::alert_when_available)
-				read_piece(piece);
+				read_piece(piece, true);
 			return;
 		}
 
@@ -5113,8 +5231,22 @@ namespace {
 			{
 				if (i->flags & torrent_handle::alert_when_available)
 				{
-					read_piece(i->piece);
+					read_piece(i->piece, true);
+				}
+
+				time_point const now = aux::time_now();
+				bool const hit = now <= i->deadline;
+				m_stats_counters.inc_stats_counter(hit
+					? counters::deadline_pieces_hit
+					: counters::deadline_pieces_missed);
+#ifndef TORRENT_DISABLE_LOGGING
+				if (should_log())
+				{
+					debug_log("deadline piece %d %s by %d ms"
+						, static_cast<int>(piece), hit ? "hit" : "missed"
+						, int(std::abs(total_milliseconds(i->deadline - now))));
 				}
+#endif
 
 				// if first_requested is min_time(), it wasn't requested as a critical piece
 				// and we shouldn't adjust any average download times
@@ -6026,6 +6158,12 @@ namespace {
 					m_picker->dec_refcount(pieces, pp);
 				}
 			}
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+			else
+			{
+				update_swarm_copies(p->get_bitfield(), -1);
+			}
+#endif
 		}
 
 		if (!p->is_choked() && !p->ignore_unchoke_slots())
@@ -6712,11 +6850,46 @@ namespace {
 		return f.get_hashes(req.base, req.index, req.count, req.proof_layers);
 	}
 
+	bool torrent::async_get_block_hashes(hash_request const& req
+		, std::function<void(std::vector<sha256_hash>)> handler)
+	{
+		if (!m_torrent_file->is_valid() || !m_storage) return false;
+		TORRENT_ASSERT(validate_hash_request(req, m_torrent_file->files()));
+
+		// only requests within a single piece
+		auto const& fs = m_torrent_file->files();
+		int const piece_layer = merkle_num_layers(fs.piece_length() / default_block_size);
+		if (req.base >= piece_layer) return false;
+		int const first_block = req.index << req.base;
+		int const last_block = ((req.index + req.count) << req.base) - 1;
+		if ((first_block >> piece_layer) != (last_block >> piece_layer))
+			return false;
+
+		int const file_piece = first_block >> piece_layer;
+		piece_index_t const piece = fs.piece_index_at_file(req.file) + piece_index_t::diff_type(file_piece);
+		if (piece >= fs.end_piece() || !have_piece(piece)) return false;
+
+		aux::vector<sha256_hash> hashes(torrent_file().orig_files().blocks_in_piece2(piece));
+		span<sha256_hash> v2_span(hashes);
+		m_ses.disk_thread().async_hash(m_storage, piece, v2_span, {}
+			, [self = shared_from_this(), req, file_piece, hashes = std::move(hashes)
+			, h = std::move(handler)](piece_index_t, sha1_hash const&, storage_error const& error)
+			{
+				if (error || !self->m_torrent_file->is_valid())
+					return h({});
+				h(self->m_merkle_trees[req.file].get_hashes(req.base, req.index
+					, req.count, req.proof_layers, file_piece, hashes));
+			});
+		m_ses.deferred_submit_jobs();
+		return true;
+	}
+
 	bool torrent::add_hashes(hash_request const& req, span<sha256_hash> hashes)
 	{
 		need_hash_picker();
 		if (!m_hash_picker) return true;
 		add_hashes_result const result = m_hash_picker->add_hashes(req, hashes);
+		update_merkle_tree_memory();
 		for (auto& p : result.hash_failed)
 		{
 			if (torrent_file().info_hashes().has_v1() && have_piece(p.first))
@@ -7368,6 +7541,14 @@ namespace {
 					m_torrent_file->info_hashes().get(peerinfo->protocol()));
 
 				boost::apply_visitor(hostname_visitor{host_name}, ret);
+
+#ifdef TORRENT_USE_OPENSSL
+				// resume the session from our last connection to this peer,
+				// if we have one
+				auto const stream_handle = boost::apply_visitor(ssl_handle_visitor{}, ret);
+				if (stream_handle && m_ssl_sessions)
+					m_ssl_sessions->prepare(stream_handle, a);
+#endif
 			}
 #endif
 			return ret;
@@ -7484,9 +7665,27 @@ namespace {
 		m_v2_piece_layers_validated = valid;
 
 		m_torrent_file->free_piece_layers();
+		update_merkle_tree_memory();
 		return {};
 	}
 
+	void torrent::update_merkle_tree_memory()
+	{
+		std::int64_t memory = 0;
+		if (m_hash_picker)
+		{
+			memory = m_hash_picker->tree_memory();
+		}
+		else
+		{
+			for (auto const& t : m_merkle_trees)
+				memory += t.memory_usage();
+		}
+		m_ses.stats_counters().inc_stats_counter(counters::merkle_tree_bytes
+			, memory - m_merkle_tree_memory);
+		m_merkle_tree_memory = memory;
+	}
+
 	bool torrent::set_metadata(span<char const> metadata_buf)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -7915,6 +8114,9 @@ namespace {
 
 		if (!m_connections.empty()) return true;
 
+		// to report the progress of moving the storage
+		if (m_moving_storage) return true;
+
 		// we might want to connect web seeds
 		if (!is_finished() && !m_web_seeds.empty() && m_files_checked)
 			return true;
@@ -8543,6 +8745,7 @@ namespace {
 			m_ses.disk_thread().async_move_storage(m_storage, std::move(path), flags
 				, std::bind(&torrent::on_storage_moved, shared_from_this(), _1, _2, _3));
 			m_moving_storage = true;
+			update_want_tick();
 			m_ses.deferred_submit_jobs();
 		}
 		else
@@ -8566,6 +8769,7 @@ namespace {
 		TORRENT_ASSERT(is_single_thread());
 
 		m_moving_storage = false;
+		update_want_tick();
 		if (status == status_t::no_error
 			|| status == status_t::need_full_check)
 		{
@@ -9939,6 +10143,19 @@ namespace {
 			set_upload_mode(false);
 		}
 
+		if (m_moving_storage && m_storage && m_ses.disk_thread_ext()
+			&& alerts().should_post<storage_move_progress_alert>())
+		{
+			// this is only reported while files are being copied to another
+			// file system
+			auto const progress = m_ses.disk_thread_ext()->move_storage_progress(m_storage);
+			if (progress.second > 0)
+			{
+				alerts().emplace_alert<storage_move_progress_alert>(get_handle()
+					, progress.first, progress.second);
+			}
+		}
+
 		if (is_paused() && !m_graceful_pause_mode)
 		{
 			// let the stats fade out to 0
@@ -10117,6 +10334,8 @@ namespace {
 			return;
 		}
 
+		update_parallel_web_seeds();
+
 		// when set to unlimited, use 100 as the limit
 		int limit = zero_or(settings().get_int(settings_pack::max_web_seed_connections)
 			, 100);
@@ -10139,6 +10358,55 @@ namespace {
 		}
 	}
 
+	void torrent::update_parallel_web_seeds()
+	{
+		int const num_connections = std::max(1
+			, settings().get_int(settings_pack::urlseed_connections));
+
+		for (auto i = m_web_seeds.begin(); i != m_web_seeds.end();)
+		{
+			auto const w = i++;
+			if (w->removed || w->type != web_seed_entry::url_seed) continue;
+
+			auto const same_seed = [&](web_seed_t const& e)
+			{ return !e.removed && e.type == w->type && e.url == w->url; };
+
+			if (w->parallel)
+			{
+				// remove parallel entries once we want fewer connections, or
+				// once the entry they were created for has been removed
+				int const rank = int(std::count_if(m_web_seeds.begin(), w, same_seed));
+				if (rank >= num_connections
+					|| std::none_of(m_web_seeds.begin(), m_web_seeds.end()
+						, [&](web_seed_t const& e) { return same_seed(e) && !e.parallel; }))
+				{
+					remove_web_seed_iter(w);
+				}
+				continue;
+			}
+
+			// don't open more connections to a server until we have
+			// successfully connected to it once
+			auto const* c = static_cast<peer_connection const*>(w->peer_info.connection);
+			if (c == nullptr || c->is_connecting() || w->peer_info.banned) continue;
+
+			int const existing = int(std::count_if(m_web_seeds.begin()
+				, m_web_seeds.end(), same_seed));
+			for (int n = existing; n < num_connections; ++n)
+			{
+				web_seed_t ent(*w);
+				ent.peer_info = ipv4_peer{tcp::endpoint(), true, {}};
+				ent.peer_info.web_seed = true;
+				ent.ephemeral = true;
+				ent.parallel = true;
+				ent.resolving = false;
+				ent.restart_request = peer_request{piece_index_t(-1), -1, -1};
+				ent.restart_piece.clear();
+				m_web_seeds.insert(i, std::move(ent));
+			}
+		}
+	}
+
 #ifndef TORRENT_DISABLE_SHARE_MODE
 	void torrent::recalc_share_mode()
 	{
@@ -10471,7 +10739,7 @@ namespace {
 
 	void pick_time_critical_block(std::vector<peer_connection*>& peers
 		, std::vector<peer_connection*>& ignore_peers
-		, std::set<peer_connection*>& peers_with_requests
+		, std::vector<peer_connection*>& peers_with_requests
 		, piece_picker::downloading_piece const& pi
 		, time_critical_piece* i
 		, piece_picker const* picker
@@ -10614,7 +10882,7 @@ namespace {
 
 				// we inserted a new block in the request queue, this
 				// makes us actually send it later
-				peers_with_requests.insert(peers_with_requests.begin(), &c);
+				peers_with_requests.push_back(&c);
 			}
 			else
 			{
@@ -10634,7 +10902,9 @@ namespace {
 				std::printf("requested block [%d, %d]\n"
 					, b.piece_index, b.block_index);
 #endif
-				peers_with_requests.insert(peers_with_requests.begin(), &c);
+				if (busy_mode)
+					c.stats_counters().inc_stats_counter(counters::deadline_duplicate_requests);
+				peers_with_requests.push_back(&c);
 			}
 
 			if (!busy_mode) i->last_requested = now;
@@ -10651,9 +10921,9 @@ namespace {
 				continue;
 			}
 
-			// resort p, since it will have a higher download_queue_time now
-			while (p != peers.end()-1 && (*p)->download_queue_time()
-				> (*(p+1))->download_queue_time())
+			// resort p, since it will have a higher block_delivery_time now
+			while (p != peers.end()-1 && (*p)->block_delivery_time()
+				> (*(p+1))->block_delivery_time())
 			{
 				std::iter_swap(p, p+1);
 				++p;
@@ -10663,6 +10933,36 @@ namespace {
 
 	} // anonymous namespace
 
+	int time_critical_timeouts(time_point const now, time_point const last_requested
+		, time_point const deadline, int const average_piece_time
+		, int const piece_time_deviation)
+	{
+		time_duration const waited = now - last_requested;
+
+		// if it's been more than half of the typical download time
+		// of a piece since we requested the last block, allow
+		// one more request per block
+		int timed_out = 0;
+		if (average_piece_time > 0)
+			timed_out = int(total_milliseconds(waited)
+				/ std::max(average_piece_time + piece_time_deviation / 2, 1));
+		if (timed_out > 0) return timed_out;
+
+		// a deadline that has already passed can't be saved by duplicate
+		// requests any more than by the ones outstanding
+		if (deadline <= now) return 0;
+
+		// the outstanding requests are expected to arrive once they've been
+		// waiting for the typical piece time. If they've been waiting longer
+		// than that, assume they'll take as long again. If that's after the
+		// deadline, it's at risk. Allow each block to be requested from a
+		// second peer, the fastest one predicted to deliver it
+		time_duration const expected = average_piece_time > 0
+			? milliseconds(average_piece_time) : waited;
+		time_point const projected = now + std::max(expected - waited, waited);
+		return projected > deadline ? 1 : 0;
+	}
+
 	void torrent::request_time_critical_pieces()
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -10683,12 +10983,13 @@ namespace {
 			, std::back_inserter(peers), [] (peer_connection* p)
 			{ return !p->can_request_time_critical(); });
 
-		// sort by the time we believe it will take this peer to send us all
-		// blocks we've requested from it. The shorter time, the better candidate
-		// it is to request a time critical block from.
-		std::sort(peers.begin(), peers.end()
-			, [] (peer_connection const* lhs, peer_connection const* rhs)
-			{ return lhs->download_queue_time(16*1024) < rhs->download_queue_time(16*1024); });
+		// sort by the time we believe it will take this peer to deliver one
+		// more block, given what we've already requested from it and how
+		// consistently it has responded. The shorter time, the better
+		// candidate it is to request a time critical block from.
+		auto const by_delivery_time = [] (peer_connection const* lhs, peer_connection const* rhs)
+			{ return lhs->block_delivery_time() < rhs->block_delivery_time(); };
+		std::sort(peers.begin(), peers.end(), by_delivery_time);
 
 		// remove the bottom 10% of peers from the candidate set.
 		// this is just to remove outliers that might stall downloads
@@ -10700,8 +11001,9 @@ namespace {
 		// at the end of this function. Instead of sending the requests right
 		// away, we batch them up and send them in a single write to the TCP
 		// socket, increasing the chance that they will all be sent in the same
-		// packet.
-		std::set<peer_connection*> peers_with_requests;
+		// packet. A peer may be added more than once, duplicates are removed
+		// at the end
+		std::vector<peer_connection*> peers_with_requests;
 
 		// peers that should be temporarily ignored for a specific piece
 		// in order to give priority to other peers. They should be used for
@@ -10766,12 +11068,8 @@ namespace {
 				if (i.last_requested == min_time())
 					i.last_requested = now;
 
-				// if it's been more than half of the typical download time
-				// of a piece since we requested the last block, allow
-				// one more request per block
-				if (m_average_piece_time > 0)
-					timed_out = int(total_milliseconds(now - i.last_requested)
-						/ std::max(int(m_average_piece_time + m_piece_time_deviation / 2), 1));
+				timed_out = time_critical_timeouts(now, i.last_requested, i.deadline
+					, m_average_piece_time, m_piece_time_deviation);
 
 #if TORRENT_DEBUG_STREAMING > 0
 				i.timed_out = timed_out;
@@ -10820,9 +11118,7 @@ namespace {
 
 				// TODO: instead of resorting the whole list, insert the peers
 				// directly into the right place
-				std::sort(peers.begin(), peers.end()
-					, [] (peer_connection const* lhs, peer_connection const* rhs)
-					{ return lhs->download_queue_time(16*1024) < rhs->download_queue_time(16*1024); });
+				std::sort(peers.begin(), peers.end(), by_delivery_time);
 			}
 
 			// if this peer's download time exceeds 2 seconds, we're done.
@@ -10832,6 +11128,9 @@ namespace {
 		}
 
 		// commit all the time critical requests
+		std::sort(peers_with_requests.begin(), peers_with_requests.end());
+		peers_with_requests.erase(std::unique(peers_with_requests.begin()
+			, peers_with_requests.end()), peers_with_requests.end());
 		for (auto p : peers_with_requests)
 		{
 			p->send_block_requests();
@@ -10855,14 +11154,16 @@ namespace {
 
 	void torrent::remove_web_seed(std::string const& url, web_seed_entry::type_t const type)
 	{
-		auto const i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, [&] (web_seed_t const& w) { return w.url == url && w.type == type; });
-
-		if (i != m_web_seeds.end())
+		// this also removes the parallel entries for the URL
+		bool removed = false;
+		for (auto i = m_web_seeds.begin(); i != m_web_seeds.end();)
 		{
-			remove_web_seed_iter(i);
-			set_need_save_resume();
+			auto const w = i++;
+			if (w->url != url || w->type != type) continue;
+			remove_web_seed_iter(w);
+			removed = true;
 		}
+		if (removed) set_need_save_resume();
 	}
 
 	void torrent::disconnect_web_seed(peer_connection* p)
@@ -11130,6 +11431,14 @@ namespace {
 		if (torrent_file().info_hashes().has_v1())
 			flags |= disk_interface::v1_hash;
 
+		// the piece isn't available until it has passed the hash check
+		aux::disk_interface_ext* critical_disk = nullptr;
+#ifndef TORRENT_DISABLE_STREAMING
+		if (std::any_of(m_time_critical_pieces.begin(), m_time_critical_pieces.end()
+			, [piece](time_critical_piece const& p) { return p.piece == piece; }))
+			critical_disk = m_ses.disk_thread_ext();
+#endif
+
 		aux::vector<sha256_hash> hashes;
 		if (torrent_file().info_hashes().has_v2())
 		{
@@ -11145,10 +11454,13 @@ namespace {
 		}
 
 		span<sha256_hash> v2_span(hashes);
-		m_ses.disk_thread().async_hash(m_storage, piece, v2_span, flags
-			, [self = shared_from_this(), hashes = std::move(hashes)]
+		auto handler = [self = shared_from_this(), hashes = std::move(hashes)]
 			(piece_index_t p, sha1_hash const& h, storage_error const& error) mutable
-			{ self->on_piece_verified(std::move(hashes), p, h, error); });
+			{ self->on_piece_verified(std::move(hashes), p, h, error); };
+		if (critical_disk)
+			critical_disk->async_hash_time_critical(m_storage, piece, v2_span, flags, std::move(handler));
+		else
+			m_ses.disk_thread().async_hash(m_storage, piece, v2_span, flags, std::move(handler));
 		m_picker->started_hash_job(piece);
 		m_ses.deferred_submit_jobs();
 	}
@@ -11799,6 +12111,23 @@ namespace {
 				+ float(st->distributed_fraction) / 1000;
 #endif
 		}
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+		else if ((flags & torrent_handle::query_distributed_copies)
+			&& !m_swarm_copies.empty())
+		{
+			// we're super seeding without a piece picker. Report the
+			// distribution of pieces across the swarm, as observed from the
+			// peers' bitfields and HAVE messages
+			std::tie(st->distributed_full_copies, st->distributed_fraction) =
+				swarm_distributed_copies();
+#if TORRENT_NO_FPU
+			st->distributed_copies = -1.f;
+#else
+			st->distributed_copies = float(st->distributed_full_copies)
+				+ float(st->distributed_fraction) / 1000;
+#endif
+		}
+#endif
 		else
 		{
 			st->distributed_full_copies = -1;
@@ -706,7 +706,7 @@ namespace libtorrent {
 
 	void torrent_handle::read_piece(piece_index_t piece) const
 	{
-		async_call(&torrent::read_piece, piece);
+		async_call(&torrent::read_piece, piece, false);
 	}
 
 	bool torrent_handle::have_piece(piece_index_t piece) const
@@ -878,7 +878,7 @@ namespace libtorrent {
 #else
 		TORRENT_UNUSED(deadline);
 		if (flags & alert_when_available)
-			async_call(&torrent::read_piece, index);
+			async_call(&torrent::read_piece, index, true);
 #endif
 	}
 
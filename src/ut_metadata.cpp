@@ -38,7 +38,9 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
 
+#include <algorithm>
 #include <functional>
+#include <map>
 #include <vector>
 #include <utility>
 #include <numeric>
@@ -82,8 +84,18 @@ namespace {
 		// we may hit this case (and the client requesting
 		// doesn't throttle its requests)
 		max_incoming_requests = 1024,
+
+		// the number of metadata requests we keep outstanding to a single
+		// peer. Large info-dictionaries (hundreds of pieces) would otherwise
+		// take a round-trip per 16 kiB block
+		max_outstanding_requests = 8,
 	};
 
+	// a request that hasn't been answered within this time is considered
+	// lost. It no longer occupies a slot in the peer's request queue and
+	// the block may be requested from another peer
+	constexpr seconds request_timeout(3);
+
 	enum class msg_t : std::uint8_t
 	{
 		request, piece, dont_have
@@ -131,9 +143,18 @@ namespace {
 			, span<char const> buf, int piece, int total_size);
 
 		// returns a piece of the metadata that
-		// we should request.
+		// we should request from ``requester``.
 		// returns -1 if we should hold off the request
-		int metadata_request(bool has_metadata);
+		int metadata_request(ut_metadata_peer_plugin const& requester
+			, bool has_metadata);
+
+		// the request for ``piece`` was rejected or will not be answered.
+		// Allow it to be requested from another peer right away
+		void cancel_request(int const piece)
+		{
+			if (piece < 0 || piece >= m_requested_metadata.end_index()) return;
+			m_requested_metadata[piece].last_request = min_time();
+		}
 
 		void on_piece_pass(piece_index_t) override
 		{
@@ -143,18 +164,64 @@ namespace {
 				metadata();
 		}
 
-		void metadata_size(int const size)
+		bool metadata_size_known() const { return !m_metadata.empty(); }
+
+		// a peer announced the size of the metadata in its extension
+		// handshake. Returns false if the size is invalid
+		bool metadata_size(int const size)
 		{
-			if (m_torrent.valid_metadata()) return;
-			if (size <= 0 || size > 4 * 1024 * 1024) return;
-			m_metadata.resize(size);
-			m_requested_metadata.resize(div_round_up(size, 16 * 1024));
+			if (m_torrent.valid_metadata()) return false;
+			if (size <= 0 || size > m_torrent.session().settings().get_int(settings_pack::max_metadata_size))
+				return false;
+			++m_size_votes[size];
+			maybe_switch_size(size);
+			return true;
+		}
+
+		// the peer that announced ``size`` disconnected, or announced
+		// another size
+		void withdraw_metadata_size(int const size)
+		{
+			auto const i = m_size_votes.find(size);
+			if (i == m_size_votes.end()) return;
+			if (--i->second == 0) m_size_votes.erase(i);
 		}
 
 		// explicitly disallow assignment, to silence msvc warning
 		ut_metadata_plugin& operator=(ut_metadata_plugin const&) = delete;
 
 	private:
+
+		// peers may disagree about the size of the metadata. A later
+		// announcement only overrides the size we're downloading if more
+		// peers agree with it than with the current size. Blocks downloaded
+		// for the previous size are discarded
+		void maybe_switch_size(int const size)
+		{
+			int const current = int(m_metadata.size());
+			if (size == current) return;
+			if (current > 0)
+			{
+				auto const cur = m_size_votes.find(current);
+				auto const cand = m_size_votes.find(size);
+				int const cur_votes = cur == m_size_votes.end() ? 0 : cur->second;
+				int const cand_votes = cand == m_size_votes.end() ? 0 : cand->second;
+				if (cand_votes <= cur_votes) return;
+			}
+
+#ifndef TORRENT_DISABLE_LOGGING
+			if (current > 0 && m_torrent.should_log())
+			{
+				m_torrent.debug_log("metadata size changed from %d to %d"
+					, current, size);
+			}
+#endif
+			m_metadata.clear();
+			m_metadata.resize(size);
+			m_requested_metadata.clear();
+			m_requested_metadata.resize(div_round_up(size, 16 * 1024));
+		}
+
 		torrent& m_torrent;
 
 		// this buffer is filled with the info-section of
@@ -163,6 +230,10 @@ namespace {
 		// torrent_info of the underlying torrent
 		aux::vector<char> m_metadata;
 
+		// the metadata sizes announced by the peers we're connected to, and
+		// the number of peers announcing each
+		std::map<int, int> m_size_votes;
+
 		struct metadata_piece
 		{
 			metadata_piece() = default;
@@ -177,6 +248,10 @@ namespace {
 		// block has been requested and who we ended up getting it from
 		// std::numeric_limits<int>::max() means we have the piece
 		aux::vector<metadata_piece> m_requested_metadata;
+
+		// the time we sent the first request for metadata. Used to log how
+		// long it took to receive all of it
+		time_point m_first_request = min_time();
 	};
 
 
@@ -215,9 +290,20 @@ namespace {
 			if (index == -1) return false;
 			m_message_index = index;
 
+			// the extension handshake may be sent more than once, only the
+			// latest size announced counts
+			if (m_metadata_size > 0)
+			{
+				m_tp.withdraw_metadata_size(m_metadata_size);
+				m_metadata_size = 0;
+			}
+
 			int metadata_size = int(h.dict_find_int_value("metadata_size"));
 			if (metadata_size > 0)
-				m_tp.metadata_size(metadata_size);
+			{
+				if (m_tp.metadata_size(metadata_size))
+					m_metadata_size = metadata_size;
+			}
 			else
 				m_pc.set_has_metadata(false);
 
@@ -369,10 +455,10 @@ namespace {
 				break;
 				case msg_t::piece:
 				{
-					auto const i = std::find(m_sent_requests.begin()
-						, m_sent_requests.end(), piece);
+					auto const i = find_request(piece);
 
-					// unwanted piece?
+					// unwanted piece? Requests that have timed out are kept
+					// around for a while, a late response is still useful
 					if (i == m_sent_requests.end())
 					{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -392,11 +478,11 @@ namespace {
 				case msg_t::dont_have:
 				{
 					m_request_limit = std::max(aux::time_now() + minutes(1), m_request_limit);
-					auto const i = std::find(m_sent_requests.begin()
-						, m_sent_requests.end(), piece);
+					auto const i = find_request(piece);
 					// unwanted piece?
 					if (i == m_sent_requests.end()) return true;
 					m_sent_requests.erase(i);
+					m_tp.cancel_request(piece);
 				}
 				break;
 			}
@@ -406,8 +492,33 @@ namespace {
 			return true;
 		}
 
+		void on_disconnect(error_code const&) override
+		{
+			if (m_metadata_size > 0)
+			{
+				m_tp.withdraw_metadata_size(m_metadata_size);
+				m_metadata_size = 0;
+			}
+
+			// let other peers pick up the requests this peer won't answer
+			time_point const now = aux::time_now();
+			for (auto const& r : m_sent_requests)
+			{
+				if (now - r.sent < request_timeout)
+					m_tp.cancel_request(r.piece);
+			}
+			m_sent_requests.clear();
+		}
+
 		void tick() override
 		{
+			// forget requests that have gone unanswered for so long that
+			// there's no point in waiting for them any more
+			time_point const now = aux::time_now();
+			m_sent_requests.erase(std::remove_if(m_sent_requests.begin(), m_sent_requests.end()
+				, [now](sent_request const& r) { return now - r.sent > minutes(1); })
+				, m_sent_requests.end());
+
 			maybe_send_request();
 			while (!m_incoming_requests.empty()
 				&& m_pc.send_buffer_size() < send_buffer_limit)
@@ -426,19 +537,37 @@ namespace {
 			// supports the request metadata extension
 			// and we aren't currently waiting for a request
 			// reply. Then, send a request for some metadata.
-			if (!m_torrent.valid_metadata()
-				&& m_message_index != 0
-				&& m_sent_requests.size() < 2
-				&& has_metadata())
+			if (m_torrent.valid_metadata()
+				|| m_message_index == 0
+				|| !has_metadata())
+				return;
+
+			time_point const now = aux::time_now();
+			int in_flight = int(std::count_if(m_sent_requests.begin(), m_sent_requests.end()
+				, [now](sent_request const& r) { return now - r.sent < request_timeout; }));
+
+			// until we know the size of the metadata, there's only one
+			// block we can ask for
+			int const limit = m_tp.metadata_size_known() ? max_outstanding_requests : 1;
+
+			while (in_flight < limit)
 			{
-				int const piece = m_tp.metadata_request(m_pc.has_metadata());
+				int const piece = m_tp.metadata_request(*this, m_pc.has_metadata());
 				if (piece == -1) return;
 
-				m_sent_requests.push_back(piece);
+				m_sent_requests.push_back({piece, now});
 				write_metadata_packet(msg_t::request, piece);
+				++in_flight;
 			}
 		}
 
+		bool has_outstanding_request(int const piece, time_point const now) const
+		{
+			return std::any_of(m_sent_requests.begin(), m_sent_requests.end()
+				, [=](sent_request const& r)
+				{ return r.piece == piece && now - r.sent < request_timeout; });
+		}
+
 		bool has_metadata() const
 		{
 			return m_pc.has_metadata() || (aux::time_now() > m_request_limit);
@@ -464,8 +593,24 @@ namespace {
 		// we receive metadata that fails the info hash check
 		time_point m_request_limit;
 
+		struct sent_request
+		{
+			int piece;
+			time_point sent;
+		};
+
+		std::vector<sent_request>::iterator find_request(int const piece)
+		{
+			return std::find_if(m_sent_requests.begin(), m_sent_requests.end()
+				, [=](sent_request const& r) { return r.piece == piece; });
+		}
+
+		// the metadata size this peer announced in its extension handshake,
+		// or 0
+		int m_metadata_size = 0;
+
 		// request queues
-		std::vector<int> m_sent_requests;
+		std::vector<sent_request> m_sent_requests;
 		std::vector<int> m_incoming_requests;
 
 		torrent& m_torrent;
@@ -485,30 +630,37 @@ namespace {
 	// has_metadata is false if the peer making the request has not announced
 	// that it has metadata. In this case, it shouldn't prevent other peers
 	// from requesting this block by setting a timeout on it.
-	int ut_metadata_plugin::metadata_request(bool const has_metadata)
+	int ut_metadata_plugin::metadata_request(ut_metadata_peer_plugin const& requester
+		, bool const has_metadata)
 	{
-		auto i = std::min_element(
-			m_requested_metadata.begin(), m_requested_metadata.end());
-
 		if (m_requested_metadata.empty())
 		{
 			// if we don't know how many pieces there are
 			// just ask for piece 0
 			m_requested_metadata.resize(1);
-			i = m_requested_metadata.begin();
 		}
 
-		int const piece = int(i - m_requested_metadata.begin());
-
-		// don't request the same block more than once every 3 seconds
-		// unless the source is disconnected
-		auto source = m_requested_metadata[piece].source.lock();
 		time_point const now = aux::time_now();
-		if (m_requested_metadata[piece].last_request != min_time()
-			&& source
-			&& !source->m_pc.is_disconnecting()
-			&& total_seconds(now - m_requested_metadata[piece].last_request) < 3)
-			return -1;
+		if (m_first_request == min_time()) m_first_request = now;
+
+		// pick the block that has been requested the fewest times, among the
+		// ones we don't have and that don't have a request in flight. This
+		// spreads the requests across all peers. A request that times out
+		// makes its block eligible again, to be re-requested from someone
+		// else
+		int piece = -1;
+		for (int i = 0; i < m_requested_metadata.end_index(); ++i)
+		{
+			metadata_piece const& mp = m_requested_metadata[i];
+			if (mp.num_requests == std::numeric_limits<int>::max()) continue;
+			if (mp.last_request != min_time()
+				&& now - mp.last_request < request_timeout)
+				continue;
+			if (requester.has_outstanding_request(i, now)) continue;
+			if (piece == -1 || mp.num_requests < m_requested_metadata[piece].num_requests)
+				piece = i;
+		}
+		if (piece == -1) return -1;
 
 		++m_requested_metadata[piece].num_requests;
 
@@ -534,21 +686,15 @@ namespace {
 			return false;
 		}
 
-		if (m_metadata.empty())
+		// verify the total_size
+		if (total_size <= 0 || total_size > m_torrent.session().settings().get_int(settings_pack::max_metadata_size))
 		{
-			// verify the total_size
-			if (total_size <= 0 || total_size > m_torrent.session().settings().get_int(settings_pack::max_metadata_size))
-			{
 #ifndef TORRENT_DISABLE_LOGGING
-				source.m_pc.peer_log(peer_log_alert::info, "UT_METADATA"
-					, "metadata size too big: %d", total_size);
+			source.m_pc.peer_log(peer_log_alert::info, "UT_METADATA"
+				, "metadata size too big: %d", total_size);
 #endif
 // #error post alert
-				return false;
-			}
-
-			m_metadata.resize(total_size);
-			m_requested_metadata.resize(div_round_up(total_size, 16 * 1024));
+			return false;
 		}
 
 		if (piece < 0 || piece >= m_requested_metadata.end_index())
@@ -607,10 +753,30 @@ namespace {
 
 					peer->failed_hash_check(single_peer ? now + minutes(5) : now);
 				}
+
+				// the size may have been a lie. If peers disagree about it, stop
+				// trusting this one and try the size most of the others agree on
+				if (m_size_votes.size() > 1)
+				{
+					m_size_votes.erase(int(m_metadata.size()));
+					auto const best = std::max_element(m_size_votes.begin(), m_size_votes.end()
+						, [](std::pair<int const, int> const& lhs, std::pair<int const, int> const& rhs)
+						{ return lhs.second < rhs.second; });
+					maybe_switch_size(best->first);
+				}
 			}
 			return false;
 		}
 
+#ifndef TORRENT_DISABLE_LOGGING
+		if (m_torrent.should_log())
+		{
+			m_torrent.debug_log("received metadata: %d bytes in %d blocks, %d ms"
+				, int(m_metadata.size()), int(m_requested_metadata.size())
+				, int(total_milliseconds(aux::time_now() - m_first_request)));
+		}
+#endif
+
 		// free our copy of the metadata and get a reference
 		// to the torrent's copy instead. No need to keep two
 		// identical copies around
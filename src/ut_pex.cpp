@@ -48,6 +48,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/extensions/ut_pex.hpp"
 #include "libtorrent/aux_/time.hpp"
 #include "libtorrent/aux_/ip_helpers.hpp" // for is_v4
+#include "libtorrent/aux_/ut_pex_msg.hpp"
+
+#include <algorithm>
+#include <cstdio> // for snprintf
+#include <map>
+#include <memory>
+#include <vector>
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
 
@@ -73,8 +80,44 @@ namespace libtorrent { namespace {
 		return true;
 	}
 
+	// the endpoint we advertise for a peer. If the peer has told us which
+	// port it's listening on, use that port. But only if we didn't connect
+	// to the peer. if we connected to it, use the port we know works
+	tcp::endpoint pex_endpoint(bt_peer_connection const& p)
+	{
+		tcp::endpoint remote = p.remote();
+		if (!p.is_outgoing())
+		{
+			torrent_peer const* const pi = p.peer_info_struct();
+			if (pi != nullptr && pi->port > 0)
+				remote.port(pi->port);
+		}
+		return remote;
+	}
+
+	pex_flags_t pex_peer_flags(bt_peer_connection const& p)
+	{
+		// 0x01 - peer supports encryption
+		// 0x02 - peer is a seed
+		// 0x04 - supports uTP. This is only a positive flags
+		//        passing 0 doesn't mean the peer doesn't
+		//        support uTP
+		// 0x08 - supports hole punching protocol. If this
+		//        flag is received from a peer, it can be
+		//        used as a rendezvous point in case direct
+		//        connections to the peer fail
+		pex_flags_t flags = p.is_seed() ? pex_seed : pex_flags_t{};
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		flags |= p.supports_encryption() ? pex_encryption : pex_flags_t{};
+#endif
+		flags |= is_utp(p.get_socket()) ? pex_utp : pex_flags_t{};
+		flags |= p.supports_holepunch() ? pex_holepunch : pex_flags_t{};
+		return flags;
+	}
+
 	struct ut_pex_plugin final
 		: torrent_plugin
+		, std::enable_shared_from_this<ut_pex_plugin>
 	{
 		// randomize when we rebuild the pex message
 		// to evenly spread it out across all torrents
@@ -98,9 +141,60 @@ namespace libtorrent { namespace {
 			return m_peers_in_message;
 		}
 
+		// called by the peer plugins once their connection is one we may
+		// advertise. Returns false if the endpoint is already in the set
+		// (i.e. advertised on behalf of another connection)
+		bool peer_added(tcp::endpoint const& ep, pex_flags_t const flags)
+		{
+			if (!m_peers.emplace(ep, flags).second) return false;
+
+			// if it was dropped and came back before the next message, it's
+			// still advertised. There's no need to mention it at all
+			auto const i = std::find(m_dropped.begin(), m_dropped.end(), ep);
+			if (i != m_dropped.end())
+			{
+				*i = m_dropped.back();
+				m_dropped.pop_back();
+			}
+			else
+			{
+				m_added.push_back(ep);
+			}
+			return true;
+		}
+
+		void peer_dropped(tcp::endpoint const& ep)
+		{
+			if (m_peers.erase(ep) == 0) return;
+
+			// peers that haven't been advertised yet don't need to be
+			// dropped
+			auto const i = std::find(m_added.begin(), m_added.end(), ep);
+			if (i != m_added.end())
+				m_added.erase(i);
+			else
+				m_dropped.push_back(ep);
+		}
+
+		// writes a message listing (up to max_peer_entries of) the peers
+		// we're currently connected to
+		void write_full_msg(std::vector<char>& out) const
+		{
+			std::vector<std::pair<tcp::endpoint, pex_flags_t>> added;
+			added.reserve(std::min(std::size_t(max_peer_entries), m_peers.size()));
+			for (auto const& p : m_peers)
+			{
+				if (int(added.size()) >= max_peer_entries) break;
+				added.emplace_back(p.first, p.second);
+			}
+			aux::write_pex_msg(out, added, {});
+		}
+
 		// the second tick of the torrent
-		// each minute the new lists of "added" + "added.f" and "dropped"
-		// are calculated here and the pex message is created
+		// each minute the lists of peers added and dropped since the last
+		// message are turned into the pex message. They are maintained as
+		// peers connect and disconnect, so this is proportional to the
+		// churn, not the number of peers.
 		// each peer connection will use this message
 		// max_peer_entries limits the packet size
 		void tick() override
@@ -111,112 +205,43 @@ namespace libtorrent { namespace {
 			if (now - seconds(60) < m_last_msg) return;
 			m_last_msg = now;
 
-			if (m_torrent.num_peers() == 0) return;
-
-			entry pex;
-			std::string& pla = pex["added"].string();
-			std::string& pld = pex["dropped"].string();
-			std::string& plf = pex["added.f"].string();
-			std::back_insert_iterator<std::string> pla_out(pla);
-			std::back_insert_iterator<std::string> pld_out(pld);
-			std::back_insert_iterator<std::string> plf_out(plf);
-			std::string& pla6 = pex["added6"].string();
-			std::string& pld6 = pex["dropped6"].string();
-			std::string& plf6 = pex["added6.f"].string();
-			std::back_insert_iterator<std::string> pla6_out(pla6);
-			std::back_insert_iterator<std::string> pld6_out(pld6);
-			std::back_insert_iterator<std::string> plf6_out(plf6);
-
-			std::set<tcp::endpoint> dropped;
-			m_old_peers.swap(dropped);
-
-			m_peers_in_message = 0;
-			int num_added = 0;
-			for (auto const peer : m_torrent)
-			{
-				if (!send_peer(*peer)) continue;
-
-				tcp::endpoint remote = peer->remote();
-				m_old_peers.insert(remote);
+			// don't write too big of a package. The remaining added peers are
+			// left for the next message
+			auto const added_end = m_added.begin()
+				+ std::min(std::ptrdiff_t(max_peer_entries), std::ptrdiff_t(m_added.size()));
 
-				auto const di = dropped.find(remote);
-				if (di == dropped.end())
-				{
-					// don't write too big of a package
-					if (num_added >= max_peer_entries) break;
-
-					// only send proper bittorrent peers
-					if (peer->type() != connection_type::bittorrent)
-						continue;
-
-					auto const* const p = static_cast<bt_peer_connection const*>(peer);
-
-					// if the peer has told us which port its listening on,
-					// use that port. But only if we didn't connect to the peer.
-					// if we connected to it, use the port we know works
-					if (!p->is_outgoing())
-					{
-						torrent_peer const* const pi = peer->peer_info_struct();
-						if (pi != nullptr && pi->port > 0)
-							remote.port(pi->port);
-					}
-
-					// no supported flags to set yet
-					// 0x01 - peer supports encryption
-					// 0x02 - peer is a seed
-					// 0x04 - supports uTP. This is only a positive flags
-					//        passing 0 doesn't mean the peer doesn't
-					//        support uTP
-					// 0x08 - supports hole punching protocol. If this
-					//        flag is received from a peer, it can be
-					//        used as a rendezvous point in case direct
-					//        connections to the peer fail
-					pex_flags_t flags = p->is_seed() ? pex_seed : pex_flags_t{};
-#if !defined TORRENT_DISABLE_ENCRYPTION
-					flags |= p->supports_encryption() ? pex_encryption : pex_flags_t{};
-#endif
-					flags |= is_utp(p->get_socket()) ? pex_utp : pex_flags_t{};
-					flags |= p->supports_holepunch() ? pex_holepunch : pex_flags_t{};
-
-					// i->first was added since the last time
-					if (aux::is_v4(remote))
-					{
-						aux::write_endpoint(remote, pla_out);
-						aux::write_uint8(static_cast<std::uint8_t>(flags), plf_out);
-					}
-					else
-					{
-						aux::write_endpoint(remote, pla6_out);
-						aux::write_uint8(static_cast<std::uint8_t>(flags), plf6_out);
-					}
-					++num_added;
-					++m_peers_in_message;
-				}
-				else
-				{
-					// this was in the previous message
-					// so, it wasn't dropped
-					dropped.erase(di);
-				}
-			}
-
-			for (auto const& i : dropped)
+			m_added_entries.clear();
+			for (auto i = m_added.begin(); i != added_end; ++i)
 			{
-				if (aux::is_v4(i))
-					aux::write_endpoint(i, pld_out);
-				else
-					aux::write_endpoint(i, pld6_out);
-				++m_peers_in_message;
+				auto const p = m_peers.find(*i);
+				TORRENT_ASSERT(p != m_peers.end());
+				m_added_entries.emplace_back(p->first, p->second);
 			}
 
-			m_ut_pex_msg.clear();
-			bencode(std::back_inserter(m_ut_pex_msg), pex);
+			m_peers_in_message = int(m_added_entries.size() + m_dropped.size());
+			aux::write_pex_msg(m_ut_pex_msg, m_added_entries, m_dropped);
+
+			m_added.erase(m_added.begin(), added_end);
+			m_dropped.clear();
 		}
 
 	private:
 		torrent& m_torrent;
 
-		std::set<tcp::endpoint> m_old_peers;
+		// the peers we advertise (or will advertise in the next message),
+		// and their flags as of when they were added
+		std::map<tcp::endpoint, pex_flags_t> m_peers;
+
+		// peers that have been added to m_peers since the last message
+		std::vector<tcp::endpoint> m_added;
+
+		// peers that were advertised and have disconnected since the last
+		// message
+		std::vector<tcp::endpoint> m_dropped;
+
+		// scratch space for building the message, kept to reuse its storage
+		std::vector<std::pair<tcp::endpoint, pex_flags_t>> m_added_entries;
+
 		time_point m_last_msg;
 		std::vector<char> m_ut_pex_msg;
 		int m_peers_in_message;
@@ -228,13 +253,15 @@ namespace libtorrent { namespace {
 	struct ut_pex_peer_plugin final
 		: ut_pex_peer_store, peer_plugin
 	{
-		ut_pex_peer_plugin(torrent& t, peer_connection& pc, ut_pex_plugin& tp)
+		ut_pex_peer_plugin(torrent& t, bt_peer_connection& pc
+			, std::shared_ptr<ut_pex_plugin> tp)
 			: m_torrent(t)
 			, m_pc(pc)
-			, m_tp(tp)
+			, m_tp(std::move(tp))
 			, m_last_msg(min_time())
 			, m_message_index(0)
 			, m_first_time(true)
+			, m_advertised(false)
 		{
 			const int num_pex_timers = sizeof(m_last_pex) / sizeof(m_last_pex[0]);
 			for (int i = 0; i < num_pex_timers; ++i)
@@ -243,25 +270,42 @@ namespace libtorrent { namespace {
 			}
 		}
 
+		// the plugin may be destructed without on_disconnect() being called,
+		// e.g. when the peer_connection is destructed
+		~ut_pex_peer_plugin() override
+		{
+			if (m_advertised) m_tp->peer_dropped(m_endpoint);
+		}
+
 		void add_handshake(entry& h) override
 		{
 			entry& messages = h["m"];
 			messages[extension_name] = extension_index;
 		}
 
+		// even if the peer doesn't support ut_pex, we stay attached to the
+		// connection, to advertise it to the peers that do (and drop it once
+		// it disconnects). We just never send it any messages
 		bool on_extension_handshake(bdecode_node const& h) override
 		{
 			m_message_index = 0;
-			if (h.type() != bdecode_node::dict_t) return false;
+			if (h.type() != bdecode_node::dict_t) return true;
 			bdecode_node const messages = h.dict_find_dict("m");
-			if (!messages) return false;
+			if (!messages) return true;
 
 			int const index = int(messages.dict_find_int_value(extension_name, -1));
-			if (index == -1) return false;
+			if (index == -1) return true;
 			m_message_index = index;
 			return true;
 		}
 
+		void on_disconnect(error_code const&) override
+		{
+			if (!m_advertised) return;
+			m_tp->peer_dropped(m_endpoint);
+			m_advertised = false;
+		}
+
 		bool on_extended(int const length, int const msg, span<char const> body) override
 		{
 			if (msg != extension_index) return false;
@@ -424,6 +468,14 @@ namespace libtorrent { namespace {
 		// every minute we send a pex message
 		void tick() override
 		{
+			// once the connection is established (and we know the peer's
+			// listen port) it becomes part of the set of peers we advertise
+			if (!m_advertised && send_peer(m_pc))
+			{
+				m_endpoint = pex_endpoint(m_pc);
+				m_advertised = m_tp->peer_added(m_endpoint, pex_peer_flags(m_pc));
+			}
+
 			// no handshake yet
 			if (!m_message_index) return;
 
@@ -457,9 +509,9 @@ namespace libtorrent { namespace {
 			if (m_torrent.flags() & torrent_flags::disable_pex) return;
 
 			// if there's no change in out peer set, don't send anything
-			if (m_tp.peers_in_msg() == 0) return;
+			if (m_tp->peers_in_msg() == 0) return;
 
-			std::vector<char> const& pex_msg = m_tp.get_ut_pex_msg();
+			std::vector<char> const& pex_msg = m_tp->get_ut_pex_msg();
 
 			char msg[6];
 			char* ptr = msg;
@@ -502,75 +554,8 @@ namespace libtorrent { namespace {
 		{
 			if (m_torrent.flags() & torrent_flags::disable_pex) return;
 
-			entry pex;
-			// leave the dropped string empty
-			pex["dropped"].string();
-			std::string& pla = pex["added"].string();
-			std::string& plf = pex["added.f"].string();
-			std::back_insert_iterator<std::string> pla_out(pla);
-			std::back_insert_iterator<std::string> plf_out(plf);
-
-			pex["dropped6"].string();
-			std::string& pla6 = pex["added6"].string();
-			std::string& plf6 = pex["added6.f"].string();
-			std::back_insert_iterator<std::string> pla6_out(pla6);
-			std::back_insert_iterator<std::string> plf6_out(plf6);
-
-			int num_added = 0;
-			for (auto const peer : m_torrent)
-			{
-				if (!send_peer(*peer)) continue;
-
-				// don't write too big of a package
-				if (num_added >= max_peer_entries) break;
-
-				// only send proper bittorrent peers
-				if (peer->type() != connection_type::bittorrent)
-					continue;
-
-				auto const* const p = static_cast<bt_peer_connection const*>(peer);
-
-				// no supported flags to set yet
-				// 0x01 - peer supports encryption
-				// 0x02 - peer is a seed
-				// 0x04 - supports uTP. This is only a positive flags
-				//        passing 0 doesn't mean the peer doesn't
-				//        support uTP
-				// 0x08 - supports hole punching protocol. If this
-				//        flag is received from a peer, it can be
-				//        used as a rendezvous point in case direct
-				//        connections to the peer fail
-				int flags = p->is_seed() ? 2 : 0;
-#if !defined TORRENT_DISABLE_ENCRYPTION
-				flags |= p->supports_encryption() ? 1 : 0;
-#endif
-				flags |= is_utp(p->get_socket()) ? 4 :  0;
-				flags |= p->supports_holepunch() ? 8 : 0;
-
-				tcp::endpoint remote = peer->remote();
-
-				if (!p->is_outgoing())
-				{
-					torrent_peer const* const pi = peer->peer_info_struct();
-					if (pi != nullptr && pi->port > 0)
-						remote.port(pi->port);
-				}
-
-				// i->first was added since the last time
-				if (aux::is_v4(remote))
-				{
-					aux::write_endpoint(remote, pla_out);
-					aux::write_uint8(flags, plf_out);
-				}
-				else
-				{
-					aux::write_endpoint(remote, pla6_out);
-					aux::write_uint8(flags, plf6_out);
-				}
-				++num_added;
-			}
 			std::vector<char> pex_msg;
-			bencode(std::back_inserter(pex_msg), pex);
+			m_tp->write_full_msg(pex_msg);
 
 			char msg[6];
 			char* ptr = msg;
@@ -586,13 +571,20 @@ namespace libtorrent { namespace {
 
 #ifndef TORRENT_DISABLE_LOGGING
 			m_pc.peer_log(peer_log_alert::outgoing_message, "PEX_FULL"
-				, "added: %d msg_size: %d", num_added, int(pex_msg.size()));
+				, "msg_size: %d", int(pex_msg.size()));
 #endif
 		}
 
 		torrent& m_torrent;
-		peer_connection& m_pc;
-		ut_pex_plugin& m_tp;
+		bt_peer_connection& m_pc;
+
+		// the connection may outlive the torrent, this keeps the set of
+		// advertised peers alive until we've been removed from it
+		std::shared_ptr<ut_pex_plugin> m_tp;
+
+		// the endpoint this connection is advertised as, valid if
+		// m_advertised is set
+		tcp::endpoint m_endpoint;
 
 		// the last pex messages we received
 		// [0] is the oldest one. There is a problem with
@@ -612,6 +604,10 @@ namespace libtorrent { namespace {
 		// message should be sent.
 		bool m_first_time;
 
+		// true if this peer is in the torrent plugin's set of peers to
+		// advertise
+		bool m_advertised;
+
 		// explicitly disallow assignment, to silence msvc warning
 		ut_pex_peer_plugin& operator=(ut_pex_peer_plugin const&) = delete;
 	};
@@ -621,7 +617,7 @@ namespace libtorrent { namespace {
 		if (pc.type() != connection_type::bittorrent) return {};
 
 		bt_peer_connection* c = static_cast<bt_peer_connection*>(pc.native_handle().get());
-		auto p = std::make_shared<ut_pex_peer_plugin>(m_torrent, *c, *this);
+		auto p = std::make_shared<ut_pex_peer_plugin>(m_torrent, *c, shared_from_this());
 		c->set_ut_pex(p);
 		return p;
 	}
@@ -641,4 +637,64 @@ namespace libtorrent {
 	}
 }
 
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	void write_string_header(std::vector<char>& out, string_view const key
+		, int const len)
+	{
+		char buf[30];
+		int n = std::snprintf(buf, sizeof(buf), "%d:", int(key.size()));
+		out.insert(out.end(), buf, buf + n);
+		out.insert(out.end(), key.begin(), key.end());
+		n = std::snprintf(buf, sizeof(buf), "%d:", len);
+		out.insert(out.end(), buf, buf + n);
+	}
+}
+
+	void write_pex_msg(std::vector<char>& out
+		, std::vector<std::pair<tcp::endpoint, pex_flags_t>> const& added
+		, std::vector<tcp::endpoint> const& dropped)
+	{
+		int num_added4 = 0;
+		int num_added6 = 0;
+		for (auto const& a : added)
+			++(aux::is_v4(a.first) ? num_added4 : num_added6);
+		int num_dropped4 = 0;
+		int num_dropped6 = 0;
+		for (auto const& d : dropped)
+			++(aux::is_v4(d) ? num_dropped4 : num_dropped6);
+
+		out.clear();
+		auto it = std::back_inserter(out);
+		out.push_back('d');
+
+		write_string_header(out, "added", num_added4 * 6);
+		for (auto const& a : added)
+			if (aux::is_v4(a.first)) aux::write_endpoint(a.first, it);
+		write_string_header(out, "added.f", num_added4);
+		for (auto const& a : added)
+			if (aux::is_v4(a.first)) aux::write_uint8(static_cast<std::uint8_t>(a.second), it);
+
+		write_string_header(out, "added6", num_added6 * 18);
+		for (auto const& a : added)
+			if (!aux::is_v4(a.first)) aux::write_endpoint(a.first, it);
+		write_string_header(out, "added6.f", num_added6);
+		for (auto const& a : added)
+			if (!aux::is_v4(a.first)) aux::write_uint8(static_cast<std::uint8_t>(a.second), it);
+
+		write_string_header(out, "dropped", num_dropped4 * 6);
+		for (auto const& d : dropped)
+			if (aux::is_v4(d)) aux::write_endpoint(d, it);
+		write_string_header(out, "dropped6", num_dropped6 * 18);
+		for (auto const& d : dropped)
+			if (!aux::is_v4(d)) aux::write_endpoint(d, it);
+
+		out.push_back('e');
+	}
+}
+}
+
 #endif
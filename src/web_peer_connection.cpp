@@ -59,6 +59,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/random.hpp"
 #include "libtorrent/torrent.hpp"
 #include "libtorrent/http_parser.hpp"
+#include "libtorrent/performance_counters.hpp"
 
 namespace libtorrent {
 
@@ -91,7 +92,16 @@ web_peer_connection::web_peer_connection(peer_connection_args& pack
 
 	// we prefer downloading large chunks from web seeds,
 	// but still want to be able to split requests
-	int const preferred_size = std::max(min_size, m_settings.get_int(settings_pack::urlseed_max_request_bytes));
+	int preferred_size = std::max(min_size, m_settings.get_int(settings_pack::urlseed_max_request_bytes));
+
+	// with several connections to each URL seed, make the spans small enough
+	// for all of them to have something to request
+	int const num_connections = m_settings.get_int(settings_pack::urlseed_connections);
+	if (num_connections > 1)
+	{
+		preferred_size = std::max(min_size, int(std::min(std::int64_t(preferred_size)
+			, tor->torrent_file().total_size() / num_connections)));
+	}
 
 	prefer_contiguous_blocks(preferred_size / tor->block_size());
 
@@ -335,6 +345,14 @@ piece_block_progress web_peer_connection::downloading_piece_progress() const
 	return ret;
 }
 
+void web_peer_connection::count_request()
+{
+	// any request but the first one on this connection reuses it
+	if (!m_first_request)
+		stats_counters().inc_stats_counter(counters::web_seed_keepalive_requests);
+	stats_counters().inc_stats_counter(counters::web_seed_requests);
+}
+
 void web_peer_connection::write_request(peer_request const& r)
 {
 	INVARIANT_CHECK;
@@ -431,6 +449,7 @@ void web_peer_connection::write_request(peer_request const& r)
 		request += "-";
 		request += to_string(file_req.start + file_req.length - 1).data();
 		request += "\r\n\r\n";
+		count_request();
 		m_first_request = false;
 
 		m_file_requests.push_back(file_req);
@@ -488,6 +507,7 @@ void web_peer_connection::write_request(peer_request const& r)
 			request += "-";
 			request += to_string(f.offset + f.size - 1).data();
 			request += "\r\n\r\n";
+			count_request();
 			m_first_request = false;
 
 #if 0
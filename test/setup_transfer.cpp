@@ -1163,7 +1163,8 @@ namespace {
 pid_type web_server_pid = 0;
 }
 
-int start_web_server(bool ssl, bool chunked_encoding, bool keepalive, int min_interval)
+int start_web_server(bool ssl, bool chunked_encoding, bool keepalive, int min_interval
+	, int rate_limit)
 {
 	int const port = find_available_port();
 
@@ -1172,8 +1173,9 @@ int start_web_server(bool ssl, bool chunked_encoding, bool keepalive, int min_in
 	for (auto const& python_exe : python_exes)
 	{
 		char buf[200];
-		std::snprintf(buf, sizeof(buf), "%s .." SEPARATOR "web_server.py %d %d %d %d %d"
-			, python_exe.c_str(), port, chunked_encoding, ssl, keepalive, min_interval);
+		std::snprintf(buf, sizeof(buf), "%s .." SEPARATOR "web_server.py %d %d %d %d %d %d"
+			, python_exe.c_str(), port, chunked_encoding, ssl, keepalive, min_interval
+			, rate_limit);
 
 		std::printf("%s starting web_server on port %d...\n", time_now_string().c_str(), port);
 
@@ -43,6 +43,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/path.hpp"
 #include <iostream>
 #include <tuple>
+#include <algorithm> // for max
 
 #include "test.hpp"
 #include "test_utils.hpp"
@@ -144,6 +145,7 @@ void test_swarm(test_flags_t const flags)
 	float sum_dl_rate3 = 0.f;
 	int count_dl_rates2 = 0;
 	int count_dl_rates3 = 0;
+	float max_distributed_copies = -1.f;
 
 	for (int i = 0; i < 80; ++i)
 	{
@@ -159,6 +161,17 @@ void test_swarm(test_flags_t const flags)
 		{
 			TEST_CHECK(st1.is_seeding);
 			TEST_CHECK(tor1.flags() & torrent_flags::super_seeding);
+
+			// the super seed keeps track of how pieces spread through the
+			// swarm, even though it doesn't have a piece picker. It's not
+			// reported until the first piece has been super seeded
+			torrent_status const ds = tor1.status(torrent_handle::query_distributed_copies);
+			TEST_CHECK(ds.distributed_full_copies == -1 || ds.distributed_full_copies >= 1);
+			if (ds.distributed_full_copies != -1)
+			{
+				max_distributed_copies = std::max(max_distributed_copies
+					, float(ds.distributed_full_copies) + float(ds.distributed_fraction) / 1000.f);
+			}
 		}
 
 		if (st2.progress < 1.f && st2.progress > 0.5f)
@@ -187,6 +200,15 @@ void test_swarm(test_flags_t const flags)
 	std::cout << "average rate: " << (average2 / 1000.f) << "kB/s - "
 		<< (average3 / 1000.f) << "kB/s" << std::endl;
 
+	if (flags & test_flags::super_seeding)
+	{
+		std::cout << "distributed copies: " << max_distributed_copies << std::endl;
+
+		// the leechers' copies count on top of the super seed's own
+		TEST_CHECK(max_distributed_copies != -1.f);
+		TEST_CHECK(max_distributed_copies > 1.f);
+	}
+
 	if (tor2.status().is_seeding && tor3.status().is_seeding) std::cout << "done\n";
 
 	// make sure the files are deleted
@@ -184,10 +184,12 @@ TORRENT_TEST(alerts_types)
 	TEST_ALERT_TYPE(file_prio_alert, 97, alert_priority::normal, alert_category::storage);
 	TEST_ALERT_TYPE(oversized_file_alert, 98, alert_priority::normal, alert_category::storage);
 	TEST_ALERT_TYPE(torrent_conflict_alert, 99, alert_priority::high, alert_category::error);
+	TEST_ALERT_TYPE(storage_move_progress_alert, 100, alert_priority::normal, alert_category::storage);
+	TEST_ALERT_TYPE(outgoing_interface_stats_alert, 101, alert_priority::normal, alert_category_t{});
 
 #undef TEST_ALERT_TYPE
 
-	TEST_EQUAL(num_alert_types, 100);
+	TEST_EQUAL(num_alert_types, 102);
 	TEST_EQUAL(num_alert_types, count_alert_types);
 }
 
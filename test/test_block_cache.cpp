@@ -0,0 +1,183 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/block_cache.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+
+#include <vector>
+
+using lt::aux::block_cache;
+using lt::aux::torrent_location;
+using lt::default_block_size;
+
+namespace {
+
+	lt::storage_index_t const st0(0);
+	lt::storage_index_t const st1(1);
+
+	std::vector<char> make_block(char const fill, int const size = default_block_size)
+	{
+		return std::vector<char>(std::size_t(size), fill);
+	}
+
+	torrent_location loc(lt::storage_index_t const st, int const piece, int const block)
+	{
+		return {st, lt::piece_index_t(piece), block * default_block_size};
+	}
+
+	// returns the first byte of the cached block, or 0 if it's not in the
+	// cache
+	char lookup(block_cache& c, torrent_location const l, int const size = default_block_size)
+	{
+		char ret = 0;
+		c.get(l, size, [&](char const* buf) { ret = buf[size - 1]; });
+		return ret;
+	}
+
+	std::int64_t stat(block_cache const& c, int const counter)
+	{
+		lt::counters cnt;
+		c.update_stats_counters(cnt);
+		return cnt[counter];
+	}
+}
+
+TORRENT_TEST(disabled_by_default)
+{
+	block_cache c;
+	TEST_CHECK(!c.enabled());
+	c.insert(loc(st0, 0, 0), make_block('a'), true);
+	TEST_EQUAL(lookup(c, loc(st0, 0, 0)), 0);
+	TEST_EQUAL(stat(c, lt::counters::block_cache_bytes), 0);
+}
+
+TORRENT_TEST(insert_get)
+{
+	block_cache c;
+	c.set_max_size(1024 * default_block_size);
+	TEST_CHECK(c.enabled());
+
+	c.insert(loc(st0, 0, 0), make_block('a'), false);
+	c.insert(loc(st0, 0, 1), make_block('b', 100), false);
+	TEST_EQUAL(lookup(c, loc(st0, 0, 0)), 'a');
+	TEST_EQUAL(lookup(c, loc(st0, 0, 1), 100), 'b');
+
+	// a short block can't satisfy a longer read
+	TEST_EQUAL(lookup(c, loc(st0, 0, 1), 101), 0);
+	TEST_EQUAL(lookup(c, loc(st1, 0, 0)), 0);
+
+	TEST_EQUAL(stat(c, lt::counters::block_cache_hits), 2);
+	TEST_EQUAL(stat(c, lt::counters::block_cache_misses), 2);
+	TEST_EQUAL(stat(c, lt::counters::block_cache_bytes), default_block_size + 100);
+}
+
+TORRENT_TEST(replace)
+{
+	block_cache c;
+	c.set_max_size(1024 * default_block_size);
+	c.insert(loc(st0, 0, 0), make_block('a'), false);
+	c.insert(loc(st0, 0, 0), make_block('b'), false);
+	TEST_EQUAL(lookup(c, loc(st0, 0, 0)), 'b');
+	TEST_EQUAL(stat(c, lt::counters::block_cache_bytes), default_block_size);
+}
+
+TORRENT_TEST(erase_piece)
+{
+	block_cache c;
+	c.set_max_size(1024 * default_block_size);
+	c.insert(loc(st0, 0, 0), make_block('a'), false);
+	c.insert(loc(st0, 0, 1), make_block('b'), false);
+	c.insert(loc(st0, 1, 0), make_block('c'), false);
+	c.insert(loc(st1, 0, 0), make_block('d'), false);
+
+	c.erase_piece(st0, lt::piece_index_t(0));
+	TEST_EQUAL(lookup(c, loc(st0, 0, 0)), 0);
+	TEST_EQUAL(lookup(c, loc(st0, 0, 1)), 0);
+	TEST_EQUAL(lookup(c, loc(st0, 1, 0)), 'c');
+	TEST_EQUAL(lookup(c, loc(st1, 0, 0)), 'd');
+	TEST_EQUAL(stat(c, lt::counters::block_cache_bytes), 2 * default_block_size);
+}
+
+TORRENT_TEST(erase_storage)
+{
+	block_cache c;
+	c.set_max_size(1024 * default_block_size);
+	c.insert(loc(st0, 0, 0), make_block('a'), false);
+	c.insert(loc(st0, 1, 0), make_block('b'), false);
+	c.insert(loc(st1, 0, 0), make_block('c'), false);
+
+	c.erase_storage(st0);
+	TEST_EQUAL(lookup(c, loc(st0, 0, 0)), 0);
+	TEST_EQUAL(lookup(c, loc(st0, 1, 0)), 0);
+	TEST_EQUAL(lookup(c, loc(st1, 0, 0)), 'c');
+}
+
+TORRENT_TEST(disable_frees_blocks)
+{
+	block_cache c;
+	c.set_max_size(1024 * default_block_size);
+	c.insert(loc(st0, 0, 0), make_block('a'), false);
+	c.set_max_size(0);
+	TEST_CHECK(!c.enabled());
+	TEST_EQUAL(stat(c, lt::counters::block_cache_bytes), 0);
+}
+
+TORRENT_TEST(frequency_admission)
+{
+	block_cache c;
+	// room for a single block per shard
+	c.set_max_size(16 * default_block_size);
+
+	// fill the cache with blocks that have never been requested. Once a
+	// shard is full, blocks that are no more popular than the one they would
+	// evict are rejected
+	for (int i = 0; i < 256; ++i)
+		c.insert(loc(st0, i, 0), make_block('a'), false);
+	TEST_EQUAL(stat(c, lt::counters::block_cache_bytes), 16 * default_block_size);
+	TEST_EQUAL(stat(c, lt::counters::block_cache_rejections), 256 - 16);
+	TEST_EQUAL(stat(c, lt::counters::block_cache_evictions), 0);
+
+	// a block that's requested repeatedly is admitted, evicting a cold one
+	torrent_location const hot = loc(st1, 0, 0);
+	TEST_EQUAL(lookup(c, hot), 0);
+	TEST_EQUAL(lookup(c, hot), 0);
+	c.insert(hot, make_block('h'), false);
+	TEST_EQUAL(lookup(c, hot), 'h');
+	TEST_EQUAL(stat(c, lt::counters::block_cache_evictions), 1);
+
+	// and a cold block can't displace it
+	for (int i = 0; i < 256; ++i)
+		c.insert(loc(st1, i + 1, 0), make_block('c'), true);
+	TEST_EQUAL(lookup(c, hot), 'h');
+}
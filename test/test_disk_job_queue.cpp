@@ -0,0 +1,162 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_job_queue.hpp"
+
+#include <vector>
+
+using namespace lt;
+using lt::aux::disk_job_queue;
+using lt::aux::job_action_t;
+using lt::aux::job_priority_t;
+using lt::aux::mmap_disk_job;
+
+namespace {
+
+	mmap_disk_job& make_job(std::vector<std::unique_ptr<mmap_disk_job>>& jobs
+		, job_action_t const action, bool const time_critical = false)
+	{
+		jobs.emplace_back(new mmap_disk_job);
+		jobs.back()->action = action;
+		jobs.back()->time_critical = time_critical;
+		return *jobs.back();
+	}
+
+	time_duration const no_aging = seconds(1000);
+}
+
+TORRENT_TEST(priority_for_job)
+{
+	std::vector<std::unique_ptr<mmap_disk_job>> jobs;
+	auto const prio = [&](job_action_t const a, bool const time_critical = false)
+	{ return aux::priority_for_job(make_job(jobs, a, time_critical)); };
+
+	TEST_CHECK(prio(job_action_t::read, true) == job_priority_t::time_critical);
+	TEST_CHECK(prio(job_action_t::hash, true) == job_priority_t::time_critical);
+	TEST_CHECK(prio(job_action_t::read) == job_priority_t::read);
+	TEST_CHECK(prio(job_action_t::partial_read) == job_priority_t::read);
+	TEST_CHECK(prio(job_action_t::write) == job_priority_t::write);
+	TEST_CHECK(prio(job_action_t::release_files) == job_priority_t::write);
+	TEST_CHECK(prio(job_action_t::hash) == job_priority_t::hash);
+	TEST_CHECK(prio(job_action_t::hash2) == job_priority_t::hash);
+	TEST_CHECK(prio(job_action_t::check_fastresume) == job_priority_t::hash);
+}
+
+TORRENT_TEST(priority_order)
+{
+	std::vector<std::unique_ptr<mmap_disk_job>> jobs;
+	disk_job_queue q;
+	auto& hash = make_job(jobs, job_action_t::hash);
+	auto& write = make_job(jobs, job_action_t::write);
+	auto& read1 = make_job(jobs, job_action_t::read);
+	auto& read2 = make_job(jobs, job_action_t::read);
+	auto& critical = make_job(jobs, job_action_t::read, true);
+
+	for (auto* j : {&hash, &write, &read1, &read2, &critical}) q.push_back(j);
+	TEST_EQUAL(q.size(), 5);
+	TEST_EQUAL(q.size(job_priority_t::read), 2);
+
+	TEST_CHECK(q.pop_front(no_aging) == &critical);
+	TEST_CHECK(q.pop_front(no_aging) == &read1);
+	TEST_CHECK(q.pop_front(no_aging) == &read2);
+	TEST_CHECK(q.pop_front(no_aging) == &write);
+	TEST_CHECK(q.pop_front(no_aging) == &hash);
+	TEST_CHECK(q.empty());
+
+	TEST_EQUAL(q.num_popped(job_priority_t::read), 2);
+	TEST_EQUAL(q.num_popped(job_priority_t::hash), 1);
+	TEST_EQUAL(q.num_aged(), 0);
+}
+
+TORRENT_TEST(aging)
+{
+	std::vector<std::unique_ptr<mmap_disk_job>> jobs;
+	disk_job_queue q;
+	auto& hash = make_job(jobs, job_action_t::hash);
+	auto& read = make_job(jobs, job_action_t::read);
+	q.push_back(&hash);
+	q.push_back(&read);
+
+	// the hash job has been waiting for longer than the aging limit, it's
+	// executed ahead of the read
+	hash.queued_time -= seconds(2);
+	TEST_CHECK(q.pop_front(seconds(1)) == &hash);
+	TEST_EQUAL(q.num_aged(), 1);
+	TEST_CHECK(q.pop_front(seconds(1)) == &read);
+	TEST_CHECK(q.queue_time(job_priority_t::hash) >= 2000000);
+}
+
+TORRENT_TEST(no_aging_limit_is_fifo)
+{
+	std::vector<std::unique_ptr<mmap_disk_job>> jobs;
+	disk_job_queue q;
+	auto& hash = make_job(jobs, job_action_t::hash);
+	auto& write = make_job(jobs, job_action_t::write);
+	auto& read = make_job(jobs, job_action_t::read);
+	q.push_back(&hash);
+	q.push_back(&write);
+	q.push_back(&read);
+	// all jobs must have been queued in the past, to have reached the
+	// aging limit of 0
+	hash.queued_time -= milliseconds(3);
+	write.queued_time = hash.queued_time + milliseconds(1);
+	read.queued_time = hash.queued_time + milliseconds(2);
+
+	TEST_CHECK(q.pop_front(seconds(0)) == &hash);
+	TEST_CHECK(q.pop_front(seconds(0)) == &write);
+	TEST_CHECK(q.pop_front(seconds(0)) == &read);
+}
+
+TORRENT_TEST(iterate)
+{
+	std::vector<std::unique_ptr<mmap_disk_job>> jobs;
+	disk_job_queue q;
+	TEST_CHECK(q.iterate().get() == nullptr);
+
+	auto& hash = make_job(jobs, job_action_t::hash);
+	auto& read = make_job(jobs, job_action_t::read);
+	auto& write = make_job(jobs, job_action_t::write);
+
+	tailqueue<mmap_disk_job> tq;
+	tq.push_back(&hash);
+	tq.push_back(&read);
+	tq.push_back(&write);
+	q.append(std::move(tq));
+
+	std::vector<mmap_disk_job*> order;
+	for (auto i = q.iterate(); i.get(); i.next())
+		order.push_back(i.get());
+	TEST_CHECK((order == std::vector<mmap_disk_job*>{&read, &write, &hash}));
+
+	while (!q.empty()) q.pop_front(no_aging);
+}
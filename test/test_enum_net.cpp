@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/enum_net.hpp"
 #include "libtorrent/address.hpp"
 #include "libtorrent/aux_/ip_helpers.hpp"
+#include "libtorrent/aux_/interface_table.hpp"
 #include "libtorrent/error_code.hpp"
 #include <cstring>
 
@@ -276,3 +277,53 @@ TORRENT_TEST(has_internet_route)
 	TEST_CHECK(has_internet_route("tun1", AF_INET, routes));
 	TEST_CHECK(has_internet_route("tun1", AF_INET6, routes));
 }
+
+TORRENT_TEST(interface_table_lookup)
+{
+	interface_table t;
+	TEST_CHECK(t.stale());
+	TEST_CHECK(t.device_for_address(make_address("192.168.0.130")).empty());
+
+	t.update({ip("192.168.0.130", "eth0"), ip("2a02::4567", "eth0")
+		, ip("10.0.0.2", "tun0"), ip("10.0.0.2", "tun1")}
+		, {rt("0.0.0.0", "eth0", "192.168.0.1", "255.255.255.0")});
+
+	TEST_CHECK(!t.stale());
+	TEST_EQUAL(t.version(), 1);
+	TEST_EQUAL(t.interfaces().size(), 4);
+	TEST_EQUAL(t.routes().size(), 1);
+
+	TEST_EQUAL(t.device_for_address(make_address("192.168.0.130")), "eth0");
+	TEST_EQUAL(t.device_for_address(make_address("2a02::4567")), "eth0");
+	// if more than one device has the address, the first one is returned
+	TEST_EQUAL(t.device_for_address(make_address("10.0.0.2")), "tun0");
+	TEST_CHECK(t.device_for_address(make_address("192.168.0.131")).empty());
+
+	t.invalidate();
+	TEST_CHECK(t.stale());
+
+	t.update({ip("192.168.0.131", "eth1")}, {});
+	TEST_CHECK(!t.stale());
+	TEST_EQUAL(t.version(), 2);
+	TEST_CHECK(t.device_for_address(make_address("192.168.0.130")).empty());
+	TEST_EQUAL(t.device_for_address(make_address("192.168.0.131")), "eth1");
+}
+
+TORRENT_TEST(interface_table_refresh)
+{
+	io_context ios;
+	error_code if_ec;
+	error_code route_ec;
+	interface_table t;
+	t.refresh(ios, if_ec, route_ec);
+	TEST_CHECK(!t.stale());
+	TEST_EQUAL(t.version(), 1);
+
+	// the table agrees with a full enumeration of the interfaces
+	error_code ec;
+	for (auto const& iface : enum_net_interfaces(ios, ec))
+	{
+		TEST_EQUAL(t.device_for_address(iface.interface_address)
+			, device_for_address(iface.interface_address, ios, ec));
+	}
+}
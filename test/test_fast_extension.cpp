@@ -50,6 +50,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/session.hpp"
 #include "libtorrent/session_params.hpp"
+#include "libtorrent/alert_types.hpp"
 
 #include <cstring>
 #include <functional>
@@ -269,14 +270,16 @@ void send_bitfield(tcp::socket& s, char const* bits)
 	if (ec) TEST_ERROR(ec.message());
 }
 
-void do_handshake(tcp::socket& s, info_hash_t const& ih, char* buffer)
+void do_handshake(tcp::socket& s, info_hash_t const& ih, char* buffer
+	, char const* pid = "aaaaaaaaaaaaaaaaaaaa")
 {
 	char handshake[] = "\x13" "BitTorrent protocol\0\0\0\0\0\x10\0\x04"
 		"                    " // space for info-hash
-		"aaaaaaaaaaaaaaaaaaaa"; // peer-id
+		"                    "; // space for peer-id
 	log("==> handshake");
 	error_code ec;
 	std::memcpy(handshake + 28, ih.v1.data(), 20);
+	std::memcpy(handshake + 48, pid, 20);
 	boost::asio::write(s, boost::asio::buffer(handshake, sizeof(handshake) - 1)
 		, boost::asio::transfer_all(), ec);
 	if (ec)
@@ -1132,5 +1135,188 @@ TORRENT_TEST(dht_port_no_support)
 	std::this_thread::sleep_for(lt::milliseconds(500));
 	print_session_log(*ses);
 }
+#ifndef TORRENT_DISABLE_EXTENSIONS
+namespace {
+
+void send_piece(tcp::socket& s, peer_request const& r, bool const corrupt)
+{
+	log("==> piece: %d s: %d l: %d%s", static_cast<int>(r.piece), r.start
+		, r.length, corrupt ? " (corrupt)" : "");
+	using namespace lt::aux;
+	std::vector<char> msg(std::size_t(13 + r.length));
+	char* ptr = msg.data();
+	write_int32(9 + r.length, ptr);
+	write_uint8(7, ptr);
+	write_int32(static_cast<int>(r.piece), ptr);
+	write_int32(r.start, ptr);
+	// this is the content ::create_torrent() hashes every piece with
+	for (int i = 0; i < r.length; ++i)
+		write_uint8(((r.start + i) % 26) + 'A', ptr);
+	if (corrupt) msg[13] = char(~msg[13]);
+	error_code ec;
+	boost::asio::write(s, boost::asio::buffer(msg)
+		, boost::asio::transfer_all(), ec);
+	if (ec) TEST_ERROR(ec.message());
+}
+
+void send_reject(tcp::socket& s, peer_request const& r)
+{
+	log("==> reject: %d s: %d l: %d", static_cast<int>(r.piece), r.start, r.length);
+	using namespace lt::aux;
+	char msg[17];
+	char* ptr = msg;
+	write_int32(13, ptr);
+	write_uint8(0x10, ptr);
+	write_int32(static_cast<int>(r.piece), ptr);
+	write_int32(r.start, ptr);
+	write_int32(r.length, ptr);
+	error_code ec;
+	boost::asio::write(s, boost::asio::buffer(msg, sizeof(msg))
+		, boost::asio::transfer_all(), ec);
+	if (ec) TEST_ERROR(ec.message());
+}
+
+// reads a request message, if one has arrived on the socket
+bool incoming_request(tcp::socket& s, span<char> buffer, peer_request& r)
+{
+	error_code ec;
+	if (!s.is_open() || s.available(ec) < 4 || ec) return false;
+	int const len = read_message(s, buffer);
+	if (len <= 0) return false;
+	print_message(buffer.first(len));
+	if (buffer[0] != 0x6 || len != 13) return false;
+	char const* ptr = buffer.data() + 1;
+	r.piece = piece_index_t(aux::read_int32(ptr));
+	r.start = aux::read_int32(ptr);
+	r.length = aux::read_int32(ptr);
+	return true;
+}
+
+} // anonymous namespace
+
+// a piece fails the hash check because one peer sent a corrupt block. Once
+// the piece is downloaded again and passes, smart-ban identifies and bans
+// that peer, but not the one that sent the other block of the piece
+TORRENT_TEST(smart_ban_after_failed_piece)
+{
+	std::cout << "\n === test smart ban ===\n" << std::endl;
+
+	error_code ec;
+	remove(combine_path("tmp1_smart_ban", "temporary").c_str(), ec);
+
+	// two blocks per piece, so each piece can come from two peers. If a
+	// single peer sent the whole piece, it would be banned when it fails
+	std::shared_ptr<torrent_info> ti = ::create_torrent(nullptr, "temporary"
+		, 2 * default_block_size, 4, false, create_torrent::v1_only);
+
+	settings_pack sett = settings();
+	sett.set_str(settings_pack::listen_interfaces, test_listen_interface());
+	sett.set_bool(settings_pack::enable_dht, false);
+	sett.set_int(settings_pack::in_enc_policy, settings_pack::pe_disabled);
+	sett.set_int(settings_pack::out_enc_policy, settings_pack::pe_disabled);
+	lt::session ses(sett);
+
+	add_torrent_params p;
+	p.flags &= ~torrent_flags::paused;
+	p.flags &= ~torrent_flags::auto_managed;
+	p.ti = ti;
+	p.save_path = "tmp1_smart_ban";
+	torrent_handle h = ses.add_torrent(p);
+	wait_for_downloading(ses, "ses");
+
+	io_context ios;
+	char recv_buffer[1000];
+	peer_request r;
+
+	// the bad peer keeps us choked and only allows piece 0. It sends a
+	// corrupt first block and rejects the second one, which removes piece 0
+	// from its allowed fast set
+	tcp::socket bad(ios);
+	bad.connect(ep("127.0.0.1", ses.listen_port()), ec);
+	if (ec) TEST_ERROR(ec.message());
+	tcp::endpoint const bad_ep = bad.local_endpoint(ec);
+	do_handshake(bad, ti->info_hashes(), recv_buffer);
+	send_have_all(bad);
+	send_allow_fast(bad, 0);
+
+	bool sent_corrupt = false;
+	time_point const start = clock_type::now();
+	while (!sent_corrupt && clock_type::now() - start < seconds(10))
+	{
+		if (!incoming_request(bad, recv_buffer, r))
+		{
+			std::this_thread::sleep_for(lt::milliseconds(10));
+			continue;
+		}
+		TEST_EQUAL(r.piece, piece_index_t(0));
+		if (r.start == 0)
+		{
+			send_piece(bad, r, true);
+			sent_corrupt = true;
+		}
+		else
+		{
+			send_reject(bad, r);
+		}
+	}
+	TEST_CHECK(sent_corrupt);
+
+	// make sure the corrupt block has been received before the good peer
+	// shows up, so it's not requested from it too
+	for (int i = 0; i < 100; ++i)
+	{
+		std::vector<partial_piece_info> const queue = h.get_download_queue();
+		if (!queue.empty() && queue.front().blocks[0].state >= block_info::writing)
+			break;
+		std::this_thread::sleep_for(lt::milliseconds(50));
+	}
+
+	tcp::socket good(ios);
+	good.connect(ep("127.0.0.1", ses.listen_port()), ec);
+	if (ec) TEST_ERROR(ec.message());
+	// the peers connect from the same IP, so they need distinct peer-ids
+	do_handshake(good, ti->info_hashes(), recv_buffer, "bbbbbbbbbbbbbbbbbbbb");
+	send_have_all(good);
+	send_unchoke(good);
+
+	int hash_failures = 0;
+	bool bad_banned = false;
+	bool good_banned = false;
+	while (clock_type::now() - start < seconds(30))
+	{
+		std::vector<alert*> alerts;
+		ses.pop_alerts(&alerts);
+		for (alert* a : alerts)
+		{
+			std::printf("%-3d [%s] %s\n", int(total_seconds(clock_type::now() - start))
+				, a->what(), a->message().c_str());
+			if (alert_cast<hash_failed_alert>(a)) ++hash_failures;
+			auto const* pd = alert_cast<peer_disconnected_alert>(a);
+			if (pd == nullptr || pd->error != errors::peer_banned) continue;
+			if (pd->endpoint == bad_ep) bad_banned = true;
+			else good_banned = true;
+		}
+
+		if (bad_banned && h.status().is_seeding) break;
+
+		// the bad peer rejects anything else it's asked for
+		while (incoming_request(bad, recv_buffer, r))
+			send_reject(bad, r);
+		bool idle = true;
+		while (incoming_request(good, recv_buffer, r))
+		{
+			send_piece(good, r, false);
+			idle = false;
+		}
+		if (idle) std::this_thread::sleep_for(lt::milliseconds(10));
+	}
+
+	TEST_EQUAL(hash_failures, 1);
+	TEST_CHECK(bad_banned);
+	TEST_CHECK(!good_banned);
+	TEST_CHECK(h.status().is_seeding);
+}
+#endif // TORRENT_DISABLE_EXTENSIONS
+
 // TODO: test sending invalid requests (out of bound piece index, offsets and
 // sizes)
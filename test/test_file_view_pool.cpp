@@ -0,0 +1,236 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+
+#include "libtorrent/aux_/file_view_pool.hpp"
+#include "libtorrent/aux_/path.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/disk_interface.hpp" // for open_file_state
+
+#include <algorithm>
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+
+using namespace lt;
+using namespace lt::aux;
+
+namespace {
+
+int const file_size = 0x4000;
+storage_index_t const st0(0);
+
+file_storage make_files(int const num_files)
+{
+	file_storage fs;
+	for (int i = 0; i < num_files; ++i)
+	{
+		char name[100];
+		std::snprintf(name, sizeof(name), "file_view_pool_test/%d", i);
+		fs.add_file(name, file_size);
+	}
+	fs.set_piece_length(file_size);
+	fs.set_num_pieces(num_files);
+	return fs;
+}
+
+void open(file_view_pool& pool, file_storage const& fs, int const idx)
+{
+	pool.open_file(st0, complete("."), file_index_t(idx), fs, open_mode::write
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+		, std::make_shared<std::mutex>()
+#endif
+		);
+}
+
+bool is_open(file_view_pool const& pool, int const idx)
+{
+	auto const st = pool.get_status(st0);
+	return std::any_of(st.begin(), st.end(), [idx](open_file_state const& f)
+		{ return f.file_index == file_index_t(idx); });
+}
+
+void setup()
+{
+	error_code ec;
+	remove_all("file_view_pool_test", ec);
+	create_directory("file_view_pool_test", ec);
+}
+
+// open files 0 and 1, have them evicted and re-opened, then scan through
+// a lot of other files
+void scan_with_reopened_files(file_view_pool& pool, file_storage const& fs)
+{
+	open(pool, fs, 0);
+	open(pool, fs, 1);
+	for (int i = 2; i < 11; ++i) open(pool, fs, i);
+	TEST_CHECK(!is_open(pool, 0));
+	TEST_CHECK(!is_open(pool, 1));
+	open(pool, fs, 0);
+	open(pool, fs, 1);
+
+	for (int i = 11; i < 40; ++i) open(pool, fs, i);
+}
+
+}
+
+TORRENT_TEST(lru_eviction)
+{
+	setup();
+	file_storage const fs = make_files(40);
+	file_view_pool pool(10);
+	pool.set_eviction_policy(settings_pack::lru_eviction);
+
+	scan_with_reopened_files(pool, fs);
+
+	// the scan evicted the files we used before it
+	TEST_CHECK(!is_open(pool, 0));
+	TEST_CHECK(!is_open(pool, 1));
+	TEST_CHECK(is_open(pool, 39));
+}
+
+TORRENT_TEST(two_queue_scan_resistance)
+{
+	setup();
+	file_storage const fs = make_files(40);
+	file_view_pool pool(10);
+	pool.set_eviction_policy(settings_pack::two_queue_eviction);
+
+	scan_with_reopened_files(pool, fs);
+
+	// files 0 and 1 were re-opened after being evicted, which made them hot.
+	// The scan should not have evicted them
+	TEST_CHECK(is_open(pool, 0));
+	TEST_CHECK(is_open(pool, 1));
+	TEST_CHECK(is_open(pool, 39));
+	TEST_CHECK(!is_open(pool, 20));
+}
+
+TORRENT_TEST(two_queue_hot_files_evicted)
+{
+	setup();
+	file_storage const fs = make_files(40);
+	file_view_pool pool(4);
+	pool.set_eviction_policy(settings_pack::two_queue_eviction);
+
+	// when all files are hot, we still need to be able to close files
+	for (int k = 0; k < 3; ++k)
+		for (int i = 0; i < 8; ++i) open(pool, fs, i);
+
+	TEST_CHECK(int(pool.get_status(st0).size()) <= 4);
+}
+
+TORRENT_TEST(mapped_limit)
+{
+	setup();
+	file_storage const fs = make_files(10);
+	file_view_pool pool(10);
+	pool.set_mapped_limit(3 * file_size);
+
+	for (int i = 0; i < 10; ++i) open(pool, fs, i);
+
+	auto const st = pool.get_file_stats(st0);
+	TEST_EQUAL(int(st.size()), 3);
+	TEST_CHECK(is_open(pool, 9));
+	TEST_CHECK(is_open(pool, 8));
+	TEST_CHECK(is_open(pool, 7));
+	for (auto const& f : st)
+		TEST_EQUAL(f.mapped_bytes, file_size);
+
+	// lowering the limit closes files right away
+	pool.set_mapped_limit(file_size);
+	TEST_EQUAL(int(pool.get_status(st0).size()), 1);
+}
+
+TORRENT_TEST(file_stats)
+{
+	setup();
+	file_storage const fs = make_files(2);
+	file_view_pool pool(10);
+
+	open(pool, fs, 0);
+	open(pool, fs, 0);
+	open(pool, fs, 0);
+	open(pool, fs, 1);
+	pool.record_file_write(st0, file_index_t(1), 0, 100);
+
+	auto st = pool.get_file_stats(st0);
+	std::sort(st.begin(), st.end()
+		, [](file_view_pool::file_stats const& lhs, file_view_pool::file_stats const& rhs)
+		{ return lhs.file_index < rhs.file_index; });
+	TEST_EQUAL(int(st.size()), 2);
+	TEST_EQUAL(st[0].hits, 2);
+	TEST_EQUAL(st[0].dirty_bytes, 0);
+	TEST_EQUAL(st[1].hits, 0);
+	TEST_EQUAL(st[1].dirty_bytes, 100);
+}
+
+TORRENT_TEST(dirty_ranges)
+{
+	setup();
+	file_storage const fs = make_files(2);
+	file_view_pool pool(10);
+	pool.track_dirty_ranges(true);
+
+	open(pool, fs, 0);
+	open(pool, fs, 1);
+
+	// overlapping writes are only counted once
+	pool.record_file_write(st0, file_index_t(0), 0, 0x1000);
+	pool.record_file_write(st0, file_index_t(0), 0x800, 0x1000);
+	pool.record_file_write(st0, file_index_t(0), 0x3000, 0x1000);
+	pool.record_file_write(st0, file_index_t(1), 0, 0x100);
+	TEST_EQUAL(pool.dirty_bytes(), 0x2800 + 0x100);
+
+	// the file with the most dirty bytes is flushed first. Its two ranges
+	// are close enough to be flushed in one operation
+	auto ret = pool.flush_dirty(1, false);
+	TEST_EQUAL(ret.bytes, 0x2800);
+	TEST_EQUAL(ret.operations, 1);
+	TEST_EQUAL(pool.dirty_bytes(), 0x100);
+
+	// once flushed, the range counts as dirty again
+	pool.record_file_write(st0, file_index_t(0), 0, 0x1000);
+	TEST_EQUAL(pool.dirty_bytes(), 0x1100);
+
+	ret = pool.flush_dirty(0x10000, true);
+	TEST_EQUAL(ret.bytes, 0x1100);
+	TEST_EQUAL(ret.operations, 2);
+	TEST_EQUAL(pool.dirty_bytes(), 0);
+}
+
+#else
+
+TORRENT_TEST(dummy) {}
+
+#endif
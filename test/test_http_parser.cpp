@@ -373,8 +373,8 @@ TORRENT_TEST(http_parser)
 		TEST_EQUAL(chunk_size, 0);
 		TEST_EQUAL(header_size, sizeof(chunk_header2) - 1);
 
-		TEST_EQUAL(parser.headers().find("test1")->second, "foo");
-		TEST_EQUAL(parser.headers().find("test2")->second, "bar");
+		TEST_EQUAL(parser.header("test1"), "foo");
+		TEST_EQUAL(parser.header("test2"), "bar");
 	}
 
 	// test url parsing
@@ -640,6 +640,36 @@ TORRENT_TEST(chunked_encoding_overflow)
 	TEST_CHECK(error == true);
 }
 
+TORRENT_TEST(header_table_reset)
+{
+	http_parser parser;
+	feed_bytes(parser
+		, "HTTP/1.1 206 Partial Content\r\n"
+		"Content-Range: bytes 0-3/10\r\n"
+		"X-Multiple: a\r\n"
+		"X-Multiple: b\r\n"
+		"Location: somewhere\r\n"
+		"\r\n"
+		"test");
+	TEST_EQUAL(parser.headers().size(), 4);
+	TEST_EQUAL(parser.header("x-multiple"), "a");
+	TEST_EQUAL(parser.headers()[2].second, "b");
+	TEST_EQUAL(parser.header("location"), "somewhere");
+
+	// the headers of the previous response must not leak into the next one
+	feed_bytes(parser
+		, "HTTP/1.1 200 OK\r\n"
+		"Content-Length: 2\r\n"
+		"\r\n"
+		"ok");
+	TEST_EQUAL(parser.status_code(), 200);
+	TEST_EQUAL(parser.message(), "OK");
+	TEST_EQUAL(parser.headers().size(), 1);
+	TEST_EQUAL(parser.headers()[0].first, "content-length");
+	TEST_EQUAL(parser.header("location"), "");
+	TEST_EQUAL(parser.header("x-multiple"), "");
+}
+
 TORRENT_TEST(invalid_content_length)
 {
 	char const chunked_input[] =
@@ -536,3 +536,197 @@ TORRENT_TEST(interface_to_endpoint)
 		== eps{ep("10.0.1.1", 1234, "eth0", ls::was_expanded | ls::accept_incoming)}));
 }
 
+
+namespace {
+
+	int pick(std::vector<aux::outgoing_interface_load>& ifs, int& start)
+	{
+		int const idx = aux::pick_outgoing_interface(ifs, start);
+		start = (idx + 1) % int(ifs.size());
+		++ifs[std::size_t(idx)].num_connections;
+		return idx;
+	}
+}
+
+TORRENT_TEST(pick_outgoing_interface_round_robin)
+{
+	// with equal weights and no traffic, connections are spread evenly
+	std::vector<aux::outgoing_interface_load> ifs(3);
+	int start = 0;
+	TEST_EQUAL(pick(ifs, start), 0);
+	TEST_EQUAL(pick(ifs, start), 1);
+	TEST_EQUAL(pick(ifs, start), 2);
+	TEST_EQUAL(pick(ifs, start), 0);
+	TEST_EQUAL(pick(ifs, start), 1);
+}
+
+TORRENT_TEST(pick_outgoing_interface_weights)
+{
+	// an interface with 3 times the weight gets 3 times the connections
+	std::vector<aux::outgoing_interface_load> ifs(2);
+	ifs[0].weight = 3;
+	int start = 0;
+	for (int i = 0; i < 40; ++i) pick(ifs, start);
+	TEST_EQUAL(ifs[0].num_connections, 30);
+	TEST_EQUAL(ifs[1].num_connections, 10);
+}
+
+TORRENT_TEST(pick_outgoing_interface_rate)
+{
+	// the interface carrying more traffic relative to its weight is avoided
+	std::vector<aux::outgoing_interface_load> ifs(2);
+	ifs[0].num_connections = 2;
+	ifs[0].rate = 1000000;
+	ifs[1].num_connections = 10;
+	ifs[1].rate = 10000;
+	TEST_EQUAL(aux::pick_outgoing_interface(ifs, 0), 1);
+
+	// unless its weight makes up for it
+	ifs[0].weight = 100;
+	TEST_EQUAL(aux::pick_outgoing_interface(ifs, 1), 0);
+}
+
+TORRENT_TEST(pick_outgoing_interface_failures)
+{
+	// an interface where connection attempts fail is avoided
+	std::vector<aux::outgoing_interface_load> ifs(2);
+	ifs[0].connect_attempts = 20;
+	ifs[0].connect_failures = 15;
+	ifs[1].connect_attempts = 20;
+	ifs[1].connect_failures = 0;
+	ifs[1].num_connections = 2;
+	TEST_EQUAL(aux::pick_outgoing_interface(ifs, 0), 1);
+}
+
+namespace {
+
+	std::shared_ptr<aux::listen_socket_t> utp_sock(char const* ip
+		, char const* device, char const* netmask)
+	{
+		auto s = sock(ip, 6881, device);
+		s->netmask = make_address(netmask);
+		return s;
+	}
+
+	// the addresses of outgoing interfaces, the way the session parses them
+	std::vector<address> outgoing_addresses(std::vector<std::string> const& ifs)
+	{
+		std::vector<address> ret;
+		for (auto const& i : ifs)
+		{
+			error_code ec;
+			address const a = make_address(i, ec);
+			ret.push_back(ec ? address() : a);
+		}
+		return ret;
+	}
+
+	aux::utp_socket_choice pick_utp(
+		std::vector<std::shared_ptr<aux::listen_socket_t>> const& sockets
+		, char const* remote, std::vector<std::string> const& ifs
+		, std::vector<aux::outgoing_interface_load> const& loads, int const start)
+	{
+		return aux::pick_utp_listen_socket(sockets, make_address(remote)
+			, tp::plaintext, ifs, outgoing_addresses(ifs), loads, start);
+	}
+}
+
+TORRENT_TEST(pick_utp_listen_socket_local_network)
+{
+	// a listen socket on the peer's local network is used regardless of the
+	// load of the outgoing interfaces
+	std::vector<std::shared_ptr<aux::listen_socket_t>> sockets = {
+		utp_sock("10.0.0.1", "eth0", "255.255.255.0")
+		, utp_sock("192.168.1.1", "eth1", "255.255.255.0")
+	};
+	std::vector<aux::outgoing_interface_load> loads(2);
+	loads[1].num_connections = 100;
+	auto const c = pick_utp(sockets, "192.168.1.5", {"eth0", "eth1"}, loads, 0);
+	TEST_CHECK(c.socket == sockets[1]);
+	TEST_EQUAL(c.outgoing_interface, -1);
+}
+
+TORRENT_TEST(pick_utp_listen_socket_least_loaded)
+{
+	std::vector<std::shared_ptr<aux::listen_socket_t>> sockets = {
+		utp_sock("10.0.0.1", "eth0", "255.255.255.0")
+		, utp_sock("192.168.1.1", "eth1", "255.255.255.0")
+	};
+	std::vector<aux::outgoing_interface_load> loads(2);
+	loads[0].num_connections = 5;
+	auto c = pick_utp(sockets, "8.8.8.8", {"eth0", "eth1"}, loads, 0);
+	TEST_CHECK(c.socket == sockets[1]);
+	TEST_EQUAL(c.outgoing_interface, 1);
+
+	// the outgoing interface index is the one in outgoing_interfaces, not
+	// the index of the listen socket
+	std::vector<aux::outgoing_interface_load> loads3(3);
+	loads3[1].num_connections = 5;
+	c = pick_utp(sockets, "8.8.8.8", {"eth2", "eth1", "eth0"}, loads3, 0);
+	TEST_CHECK(c.socket == sockets[0]);
+	TEST_EQUAL(c.outgoing_interface, 2);
+}
+
+TORRENT_TEST(pick_utp_listen_socket_start)
+{
+	// ties are broken at the outgoing interface at or after start, even
+	// when not every outgoing interface has a listen socket
+	std::vector<std::shared_ptr<aux::listen_socket_t>> sockets = {
+		utp_sock("192.168.2.1", "eth2", "255.255.255.0")
+		, utp_sock("192.168.1.1", "eth1", "255.255.255.0")
+	};
+	std::vector<std::string> const ifs = {"eth0", "eth1", "eth2"};
+	std::vector<aux::outgoing_interface_load> const loads(3);
+
+	auto c = pick_utp(sockets, "8.8.8.8", ifs, loads, 0);
+	TEST_EQUAL(c.outgoing_interface, 1);
+	TEST_CHECK(c.socket == sockets[1]);
+
+	c = pick_utp(sockets, "8.8.8.8", ifs, loads, 1);
+	TEST_EQUAL(c.outgoing_interface, 1);
+	TEST_CHECK(c.socket == sockets[1]);
+
+	c = pick_utp(sockets, "8.8.8.8", ifs, loads, 2);
+	TEST_EQUAL(c.outgoing_interface, 2);
+	TEST_CHECK(c.socket == sockets[0]);
+}
+
+TORRENT_TEST(pick_utp_listen_socket_by_address)
+{
+	// outgoing interfaces given by IP address match listen sockets with
+	// that address
+	std::vector<std::shared_ptr<aux::listen_socket_t>> sockets = {
+		utp_sock("10.0.0.1", "", "255.255.255.0")
+		, utp_sock("192.168.1.1", "", "255.255.255.0")
+	};
+	std::vector<aux::outgoing_interface_load> const loads(1);
+	auto const c = pick_utp(sockets, "8.8.8.8", {"192.168.1.1"}, loads, 0);
+	TEST_CHECK(c.socket == sockets[1]);
+	TEST_EQUAL(c.outgoing_interface, 0);
+}
+
+TORRENT_TEST(pick_utp_listen_socket_no_outgoing_interface)
+{
+	std::vector<std::shared_ptr<aux::listen_socket_t>> sockets = {
+		utp_sock("10.0.0.1", "eth0", "255.255.255.0")
+		, utp_sock("192.168.1.1", "eth1", "255.255.255.0")
+	};
+
+	// none of the listen sockets are on an outgoing interface, any one with
+	// a gateway will do
+	std::vector<aux::outgoing_interface_load> const loads(2);
+	auto c = pick_utp(sockets, "8.8.8.8", {"eth2", "eth3"}, loads, 0);
+	TEST_CHECK(c.socket == sockets[0] || c.socket == sockets[1]);
+	TEST_EQUAL(c.outgoing_interface, -1);
+
+	// listen sockets on the local network only can't reach the peer
+	sockets[0]->flags |= aux::listen_socket_t::local_network;
+	sockets[1]->flags |= aux::listen_socket_t::local_network;
+	c = pick_utp(sockets, "8.8.8.8", {"eth0", "eth1"}, loads, 0);
+	TEST_CHECK(!c.socket);
+	TEST_EQUAL(c.outgoing_interface, -1);
+
+	// and there's no IPv6 socket
+	c = pick_utp(sockets, "2001::1", {}, {}, 0);
+	TEST_CHECK(!c.socket);
+}
@@ -932,6 +932,310 @@ TORRENT_TEST(add_hashes_partial_proofs)
 	TEST_CHECK(t.verified_leafs() == none_set(num_blocks));
 }
 
+TORRENT_TEST(set_block_piece_layer_mode)
+{
+	int const blocks_per_piece = 4;
+	int const num_pieces = (num_blocks + 3) / 4;
+	aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+	t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+	auto const baseline = t.memory_usage();
+
+	for (int block = 0; block < num_blocks; ++block)
+	{
+		auto const result = t.set_block(block, f[511 + block]);
+		if ((block % blocks_per_piece) == blocks_per_piece - 1 || block == num_blocks - 1)
+		{
+			TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::ok);
+			TEST_EQUAL(std::get<1>(result), block - (block % blocks_per_piece));
+			TEST_EQUAL(std::get<2>(result), blocks_per_piece);
+			TEST_CHECK(t.verified_leafs() == set_range(none_set(num_blocks), 0, block + 1));
+		}
+		else
+		{
+			TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::unknown);
+			TEST_CHECK(t.verified_leafs() == set_range(none_set(num_blocks), 0, block - (block % blocks_per_piece)));
+			TEST_CHECK(t.has_node(511 + block));
+		}
+	}
+
+	// the block hashes are dropped once each piece is verified. Only the
+	// padding nodes above the block layer are still known
+	for (int i = 255; i < 255 + (num_blocks + 1) / 2; ++i)
+		TEST_CHECK(!t.has_node(i));
+	for (int i = 511; i < 1023; ++i)
+		TEST_CHECK(!t.has_node(i));
+	TEST_CHECK(t.memory_usage() <= baseline + (num_pieces + 7) / 8);
+	TEST_CHECK(t.blocks_verified(0, num_blocks));
+	for (int i = 0; i < 255; ++i)
+		TEST_EQUAL(t[i], f[i]);
+
+	// downloading a piece again still checks it against the piece hash
+	for (int block = 8; block < 11; ++block)
+	{
+		auto const result = t.set_block(block, f[511 + block]);
+		TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::unknown);
+	}
+	auto const result = t.set_block(11, rand_sha256());
+	TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::hash_failed);
+	TEST_EQUAL(std::get<1>(result), 8);
+	TEST_CHECK(t.verified_leafs() == all_set(num_blocks));
+}
+
+TORRENT_TEST(add_hashes_piece_layer_mode)
+{
+	int const blocks_per_piece = 4;
+	int const num_pieces = (num_blocks + 3) / 4;
+	aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+	t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+
+	int const piece = 5;
+	int const first_block = piece * blocks_per_piece;
+
+	// the first block is good, the second is bad
+	t.set_block(first_block, f[511 + first_block]);
+	t.set_block(first_block + 1, rand_sha256());
+
+	{
+		// invalid block hashes are rejected
+		auto const result = t.add_hashes(511 + first_block, pdiff(1)
+			, corrupt(range(f, 511 + first_block, blocks_per_piece)), span<sha256_hash const>());
+		TEST_CHECK(!result);
+	}
+
+	auto const result = t.add_hashes(511 + first_block, pdiff(1)
+		, range(f, 511 + first_block, blocks_per_piece), span<sha256_hash const>());
+	TEST_CHECK(result);
+	if (!result) return;
+
+	TEST_EQUAL(result->passed.size(), 1);
+	TEST_CHECK(result->passed.front() == piece_index_t(piece + 1));
+	TEST_EQUAL(result->failed.size(), 1);
+	TEST_CHECK(result->failed.front().first == piece_index_t(piece + 1));
+	TEST_CHECK(result->failed.front().second == std::vector<int>{1});
+
+	TEST_CHECK(t.verified_leafs() == set_range(none_set(num_blocks), first_block, blocks_per_piece));
+	for (int i = 0; i < blocks_per_piece; ++i)
+		TEST_EQUAL(t[511 + first_block + i], f[511 + first_block + i]);
+
+	// the block hashes are known, so blocks are checked individually
+	{
+		auto const r = t.set_block(first_block + 1, rand_sha256());
+		TEST_CHECK(std::get<0>(r) == aux::merkle_tree::set_block_result::block_hash_failed);
+	}
+	for (int i = 1; i < blocks_per_piece; ++i)
+	{
+		auto const r = t.set_block(first_block + i, f[511 + first_block + i]);
+		TEST_CHECK(std::get<0>(r) == aux::merkle_tree::set_block_result::ok);
+		TEST_EQUAL(std::get<1>(r), first_block + i);
+		TEST_EQUAL(std::get<2>(r), 1);
+	}
+
+	// now that all blocks have been checked, the hashes are dropped
+	TEST_CHECK(!t.has_node(511 + first_block));
+	TEST_CHECK(t.verified_leafs() == set_range(none_set(num_blocks), first_block, blocks_per_piece));
+}
+
+TORRENT_TEST(get_hashes_piece_layer_mode)
+{
+	int const blocks_per_piece = 4;
+	int const num_pieces = (num_blocks + 3) / 4;
+	aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+	t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+
+	// we have the first two pieces, and the last one. Their block hashes are
+	// dropped once they're verified
+	for (int block = 0; block < 2 * blocks_per_piece; ++block)
+		t.set_block(block, f[511 + block]);
+	for (int block = 256; block < num_blocks; ++block)
+		t.set_block(block, f[511 + block]);
+	TEST_CHECK(t.get_hashes(0, 0, blocks_per_piece, 0).empty());
+
+	// requests can still be answered with the block hashes of the piece,
+	// computed from its data
+	{
+		auto const h = t.get_hashes(0, 0, blocks_per_piece, 0
+			, 0, range(f, 511, blocks_per_piece));
+		TEST_CHECK(s(h) == range(f, 511, blocks_per_piece));
+	}
+
+	// with proof layers up to the root of the tree
+	{
+		auto const h = t.get_hashes(0, blocks_per_piece, blocks_per_piece, 8
+			, 1, range(f, 511 + blocks_per_piece, blocks_per_piece));
+		TEST_EQUAL(int(h.size()), blocks_per_piece + 7);
+		TEST_CHECK(s(h).first(blocks_per_piece) == range(f, 511 + blocks_per_piece, blocks_per_piece));
+		TEST_CHECK(s(h).subspan(blocks_per_piece) == s(build_proof(f, 128)));
+	}
+
+	// proofs below the piece layer are computed from the block hashes
+	{
+		auto const h = t.get_hashes(0, 4, 2, 3, 1, range(f, 515, blocks_per_piece));
+		TEST_EQUAL(int(h.size()), 5);
+		TEST_CHECK(s(h).first(2) == range(f, 515, 2));
+		TEST_CHECK(s(h).subspan(2) == s(build_proof(f, 257, 31)));
+	}
+
+	// the layer between the blocks and the pieces
+	{
+		auto const h = t.get_hashes(1, 0, 2, 0, 0, range(f, 511, blocks_per_piece));
+		TEST_CHECK(s(h) == range(f, 255, 2));
+	}
+
+	// the last piece is only partially backed by blocks
+	{
+		auto const h = t.get_hashes(0, 256, 4, 0, 64, range(f, 511 + 256, num_blocks - 256));
+		TEST_EQUAL(int(h.size()), 4);
+		TEST_CHECK(s(h).first(num_blocks - 256) == range(f, 511 + 256, num_blocks - 256));
+		TEST_CHECK(h.back().is_all_zeros());
+	}
+
+	// the block hashes are not kept
+	TEST_CHECK(t.get_hashes(0, 0, blocks_per_piece, 0).empty());
+	TEST_CHECK(t.verified_leafs() == set_range(set_range(none_set(num_blocks)
+		, 0, 2 * blocks_per_piece), 256, num_blocks - 256));
+
+	// hashes that don't match the piece hash
+	TEST_CHECK(t.get_hashes(0, 0, blocks_per_piece, 0
+		, 0, corrupt(range(f, 511, blocks_per_piece))).empty());
+
+	// requests covering other pieces too
+	TEST_CHECK(t.get_hashes(0, 0, 2 * blocks_per_piece, 0
+		, 0, range(f, 511, blocks_per_piece)).empty());
+	TEST_CHECK(t.get_hashes(0, 8, 4, 0, 0, range(f, 511, blocks_per_piece)).empty());
+}
+
+TORRENT_TEST(roundtrip_piece_layer_mode)
+{
+	int const blocks_per_piece = 4;
+	int const num_pieces = (num_blocks + 3) / 4;
+	aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+	t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+
+	// one verified piece, one piece in progress and one piece whose block
+	// hashes are verified
+	for (int i = 0; i < 6; ++i)
+		t.set_block(i, f[511 + i]);
+	t.add_hashes(511 + 12, pdiff(1), range(f, 511 + 12, blocks_per_piece), span<sha256_hash const>());
+
+	aux::vector<bool> mask;
+	std::vector<sha256_hash> tree;
+	std::tie(tree, mask) = t.build_sparse_vector();
+
+	aux::merkle_tree t2(num_blocks, blocks_per_piece, f[0].data());
+	t2.load_sparse_tree(tree, mask, t.verified_leafs());
+
+	TEST_CHECK(t.verified_leafs() == t2.verified_leafs());
+	TEST_CHECK(t.build_vector() == t2.build_vector());
+	for (int i = 0; i < int(t.size()); ++i)
+	{
+		TEST_EQUAL(t[i], t2[i]);
+		TEST_EQUAL(t.has_node(i), t2.has_node(i));
+	}
+}
+
+TORRENT_TEST(set_block_range)
+{
+	int const blocks_per_piece = 4;
+	int const num_pieces = (num_blocks + 3) / 4;
+
+	for (bool const piece_layer : {false, true})
+	{
+		aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+		if (piece_layer)
+			t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+		else
+			t.add_hashes(127, pdiff(1), range(f, 127, 128), span<sha256_hash const>());
+
+		for (int piece = 0; piece < num_pieces; ++piece)
+		{
+			int const first_block = piece * blocks_per_piece;
+			int const count = std::min(blocks_per_piece, num_blocks - first_block);
+
+			// a partial piece cannot be verified
+			auto result = t.set_block(first_block, range(f, 511 + first_block, count - 1));
+			TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::unknown);
+
+			result = t.set_block(first_block, range(f, 511 + first_block, count));
+			TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::ok);
+			TEST_EQUAL(std::get<1>(result), first_block);
+			TEST_EQUAL(std::get<2>(result), blocks_per_piece);
+		}
+		TEST_CHECK(t.verified_leafs() == all_set(num_blocks));
+	}
+
+	for (bool const piece_layer : {false, true})
+	{
+		aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+		if (piece_layer)
+			t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+		else
+			t.add_hashes(127, pdiff(1), range(f, 127, 128), span<sha256_hash const>());
+
+		auto const result = t.set_block(0, corrupt(range(f, 511, blocks_per_piece)));
+		TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::hash_failed);
+		TEST_EQUAL(std::get<1>(result), 0);
+		TEST_EQUAL(std::get<2>(result), blocks_per_piece);
+		TEST_CHECK(t.verified_leafs() == none_set(num_blocks));
+	}
+
+	// once the block hashes are known, a bad block is identified
+	{
+		aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+		t.add_hashes(511, pdiff(1), range(f, 511, 512), span<sha256_hash const>());
+		auto hashes = corrupt(range(f, 511 + 8, blocks_per_piece));
+		auto const bad_block = int(std::find_if(hashes.begin(), hashes.end(), [&](sha256_hash const& h)
+			{ return std::find(f.begin(), f.end(), h) == f.end(); }) - hashes.begin());
+		auto const result = t.set_block(8, hashes);
+		TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::block_hash_failed);
+		TEST_EQUAL(std::get<1>(result), 8 + bad_block);
+		TEST_EQUAL(std::get<2>(result), 1);
+	}
+}
+
+TORRENT_TEST(set_block_range_pieces)
+{
+	int const blocks_per_piece = 4;
+	int const num_pieces = (num_blocks + 3) / 4;
+
+	// a range spanning several pieces is verified as a whole
+	for (bool const piece_layer : {false, true})
+	{
+		aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+		if (piece_layer)
+			t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+		else
+			t.add_hashes(127, pdiff(1), range(f, 127, 128), span<sha256_hash const>());
+
+		auto const result = t.set_block(0, range(f, 511, num_blocks));
+		TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::ok);
+		TEST_EQUAL(std::get<1>(result), 0);
+		TEST_EQUAL(std::get<2>(result), num_pieces * blocks_per_piece);
+		TEST_CHECK(t.verified_leafs() == all_set(num_blocks));
+	}
+
+	// a failed piece in the middle of the range doesn't prevent the others
+	// from being verified
+	for (bool const piece_layer : {false, true})
+	{
+		aux::merkle_tree t(num_blocks, blocks_per_piece, f[0].data());
+		if (piece_layer)
+			t.load_piece_layer(span<char const>(f[127].data(), sha256_hash::size() * num_pieces));
+		else
+			t.add_hashes(127, pdiff(1), range(f, 127, 128), span<sha256_hash const>());
+
+		std::vector<sha256_hash> hashes(f.begin() + 511, f.begin() + 511 + 3 * blocks_per_piece);
+		hashes[std::size_t(blocks_per_piece + 1)] = rand_sha256();
+		auto const result = t.set_block(0, hashes);
+		TEST_CHECK(std::get<0>(result) == aux::merkle_tree::set_block_result::hash_failed);
+		TEST_EQUAL(std::get<1>(result), blocks_per_piece);
+		TEST_EQUAL(std::get<2>(result), blocks_per_piece);
+
+		TEST_CHECK(t.blocks_verified(0, blocks_per_piece));
+		TEST_CHECK(!t.blocks_verified(blocks_per_piece, 1));
+		TEST_CHECK(t.blocks_verified(2 * blocks_per_piece, blocks_per_piece));
+	}
+}
+
 // TODO: add test for load_piece_layer()
 // TODO: add test for add_hashes() with an odd number of blocks
 // TODO: add test for set_block() (setting the last block) with an odd number of blocks
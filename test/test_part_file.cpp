@@ -33,6 +33,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <cstring>
 #include <array>
+#include <vector>
+#include <algorithm>
 
 #include "test.hpp"
 #include "test_utils.hpp"
@@ -40,6 +42,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/posix_part_file.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/error_code.hpp"
+#include "libtorrent/file.hpp"
 
 using namespace lt;
 
@@ -148,6 +151,96 @@ TORRENT_TEST(part_file)
 	}
 }
 
+TORRENT_TEST(part_file_update_header)
+{
+	error_code ec;
+	std::string const cwd = complete(".");
+	std::string const dir = combine_path(cwd, "partfile_test_dir3");
+	remove_all(dir, ec);
+	create_directory(dir, ec);
+
+	int const piece_size = 0x4000;
+	std::vector<char> buf(static_cast<std::size_t>(piece_size));
+
+	{
+		part_file pf(dir, "partfile.parts", 10, piece_size);
+		std::fill(buf.begin(), buf.end(), char(1));
+		pf.write(buf, 1_piece, 0, ec);
+		std::fill(buf.begin(), buf.end(), char(3));
+		pf.write(buf, 3_piece, 0, ec);
+		pf.flush_metadata(ec);
+		TEST_CHECK(!ec);
+
+		// the freed slot is reused by piece 7. Only the entries of pieces 1
+		// and 7 are written to the header
+		pf.free_piece(1_piece);
+		std::fill(buf.begin(), buf.end(), char(7));
+		pf.write(buf, 7_piece, 0, ec);
+		pf.flush_metadata(ec);
+		TEST_CHECK(!ec);
+	}
+
+	{
+		part_file pf(dir, "partfile.parts", 10, piece_size);
+		pf.read(buf, 1_piece, 0, ec);
+		TEST_CHECK(ec == boost::system::errc::no_such_file_or_directory);
+		ec.clear();
+
+		pf.read(buf, 3_piece, 0, ec);
+		TEST_CHECK(!ec);
+		TEST_CHECK(std::all_of(buf.begin(), buf.end(), [](char c) { return c == 3; }));
+
+		pf.read(buf, 7_piece, 0, ec);
+		TEST_CHECK(!ec);
+		TEST_CHECK(std::all_of(buf.begin(), buf.end(), [](char c) { return c == 7; }));
+	}
+}
+
+TORRENT_TEST(part_file_export_to_file)
+{
+	error_code ec;
+	std::string const cwd = complete(".");
+	std::string const dir = combine_path(cwd, "partfile_test_dir4");
+	remove_all(dir, ec);
+	create_directory(dir, ec);
+
+	int const piece_size = 0x4000;
+	std::vector<char> buf(static_cast<std::size_t>(piece_size));
+
+	part_file pf(dir, "partfile.parts", 10, piece_size);
+	std::fill(buf.begin(), buf.end(), char(2));
+	pf.write(buf, 2_piece, 0, ec);
+	std::fill(buf.begin(), buf.end(), char(5));
+	pf.write(buf, 5_piece, 0, ec);
+	pf.flush_metadata(ec);
+	TEST_CHECK(!ec);
+
+	// export a file spanning pieces 1 - 6, starting in the middle of piece 1
+	std::int64_t const file_offset = piece_size + piece_size / 2;
+	std::int64_t const file_size = 5 * piece_size;
+	aux::file_handle dst(combine_path(dir, "exported"), file_size, aux::open_mode::write);
+
+	// blocks the file system can't copy are written by the callback
+	pf.export_file(dst, [&](std::int64_t const offset, span<char> data)
+	{
+		error_code e;
+		aux::pwrite_all(dst.fd(), data, offset, e);
+		TEST_CHECK(!e);
+	}, file_offset, file_size, ec);
+	TEST_CHECK(!ec);
+
+	aux::pread_all(dst.fd(), buf, piece_size / 2, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(std::all_of(buf.begin(), buf.end(), [](char c) { return c == 2; }));
+	aux::pread_all(dst.fd(), buf, piece_size / 2 + 3 * piece_size, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(std::all_of(buf.begin(), buf.end(), [](char c) { return c == 5; }));
+
+	// both pieces were entirely exported, so the part file is empty now
+	pf.flush_metadata(ec);
+	TEST_CHECK(!exists(combine_path(dir, "partfile.parts"), ec));
+}
+
 TORRENT_TEST(posix_part_file)
 {
 	error_code ec;
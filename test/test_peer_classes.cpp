@@ -32,12 +32,20 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "test.hpp"
+#include "setup_transfer.hpp"
+#include "settings.hpp"
+#include "test_utils.hpp"
 #include "libtorrent/peer_class.hpp"
 #include "libtorrent/peer_class_set.hpp"
 #include "libtorrent/peer_class_type_filter.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/ip_filter.hpp"
 #include "libtorrent/session.hpp"
+#include "libtorrent/socket.hpp"
+#include "libtorrent/torrent_info.hpp"
+
+#include <cstring>
+#include <thread>
 
 using namespace lt;
 
@@ -149,3 +157,130 @@ TORRENT_TEST(session_peer_class_type_filter)
 
 	TEST_CHECK(ses.get_peer_class_type_filter() == f);
 }
+
+TORRENT_TEST(session_interface_peer_class)
+{
+	using namespace libtorrent;
+	session ses;
+	peer_class_t const eth0 = ses.interface_peer_class("eth0");
+	peer_class_t const eth1 = ses.interface_peer_class("10.0.0.1");
+
+	// asking again returns the same class
+	TEST_CHECK(ses.interface_peer_class("eth0") == eth0);
+	TEST_CHECK(eth0 != eth1);
+
+	peer_class_info info = ses.get_peer_class(eth0);
+	TEST_EQUAL(info.label, "interface eth0");
+	TEST_EQUAL(ses.get_peer_class_stats(eth0).total_upload, 0);
+	TEST_EQUAL(ses.get_peer_class_stats(eth0).total_download, 0);
+
+	// each interface is rate limited separately
+	info.upload_limit = 100000;
+	info.download_limit = 200000;
+	ses.set_peer_class(eth0, info);
+
+	info = ses.get_peer_class(eth0);
+	TEST_EQUAL(info.upload_limit, 100000);
+	TEST_EQUAL(info.download_limit, 200000);
+
+	info = ses.get_peer_class(eth1);
+	TEST_EQUAL(info.label, "interface 10.0.0.1");
+	TEST_EQUAL(info.upload_limit, 0);
+	TEST_EQUAL(info.download_limit, 0);
+}
+
+TORRENT_TEST(delete_interface_peer_class)
+{
+	using namespace libtorrent;
+	session ses;
+	peer_class_t const eth0 = ses.interface_peer_class("eth0");
+	ses.delete_peer_class(eth0);
+
+	// the ID of the deleted class may be recycled. The interface must not
+	// end up with someone else's class
+	peer_class_t const other = ses.create_peer_class("other");
+	peer_class_t const eth0_2 = ses.interface_peer_class("eth0");
+	TEST_CHECK(eth0_2 != other);
+	TEST_EQUAL(ses.get_peer_class(eth0_2).label, "interface eth0");
+	TEST_EQUAL(ses.get_peer_class(other).label, "other");
+}
+
+TORRENT_TEST(interface_peer_class_loopback)
+{
+	using namespace libtorrent;
+	settings_pack pack = settings();
+	pack.set_str(settings_pack::listen_interfaces, test_listen_interface());
+	pack.set_bool(settings_pack::enable_dht, false);
+	pack.set_int(settings_pack::in_enc_policy, settings_pack::pe_disabled);
+	pack.set_int(settings_pack::out_enc_policy, settings_pack::pe_disabled);
+	session ses(pack);
+
+	peer_class_t const lo = ses.interface_peer_class("127.0.0.1");
+	peer_class_t const eth0 = ses.interface_peer_class("10.0.0.1");
+
+	std::shared_ptr<torrent_info> ti = ::create_torrent();
+	add_torrent_params p;
+	p.flags &= ~torrent_flags::paused;
+	p.flags &= ~torrent_flags::auto_managed;
+	p.ti = ti;
+	p.save_path = "tmp1_interface_class";
+	ses.add_torrent(p);
+	wait_for_downloading(ses, "ses");
+
+	io_context ios;
+	tcp::socket s(ios);
+	error_code ec;
+	s.connect(ep("127.0.0.1", ses.listen_port()), ec);
+	TEST_CHECK(!ec);
+
+	char handshake[] = "\x13" "BitTorrent protocol\0\0\0\0\0\0\0\0"
+		"                    " // space for info-hash
+		"aaaaaaaaaaaaaaaaaaaa"; // peer-id
+	std::memcpy(handshake + 28, ti->info_hashes().v1.data(), 20);
+	boost::asio::write(s, boost::asio::buffer(handshake, sizeof(handshake) - 1)
+		, boost::asio::transfer_all(), ec);
+	TEST_CHECK(!ec);
+
+	char response[68];
+	boost::asio::read(s, boost::asio::buffer(response, sizeof(response))
+		, boost::asio::transfer_all(), ec);
+	TEST_CHECK(!ec);
+
+	// the connection is a member of the loopback interface's class, so
+	// its handshake counts towards the class' totals
+	peer_class_stats stats;
+	for (int i = 0; i < 50; ++i)
+	{
+		stats = ses.get_peer_class_stats(lo);
+		if (stats.total_download >= 68 && stats.total_upload >= 68) break;
+		std::this_thread::sleep_for(lt::milliseconds(100));
+	}
+	TEST_CHECK(stats.total_download >= 68);
+	TEST_CHECK(stats.total_upload >= 68);
+
+	stats = ses.get_peer_class_stats(eth0);
+	TEST_EQUAL(stats.total_download, 0);
+	TEST_EQUAL(stats.total_upload, 0);
+}
+
+TORRENT_TEST(peer_class_transfer_totals)
+{
+	peer_class_pool pool;
+	peer_class_t const id = pool.new_peer_class("test");
+	pool.at(id)->total_transferred[0] += 1000;
+	pool.at(id)->total_transferred[1] += 3000;
+
+	peer_class_stats cls;
+	pool.at(id)->get_stats(&cls);
+	TEST_EQUAL(cls.total_upload, 1000);
+	TEST_EQUAL(cls.total_download, 3000);
+
+	// a recycled class starts over
+	pool.decref(id);
+	peer_class_t const id2 = pool.new_peer_class("test2");
+	TEST_CHECK(id2 == id);
+	pool.at(id2)->get_stats(&cls);
+	TEST_EQUAL(cls.total_upload, 0);
+	TEST_EQUAL(cls.total_download, 0);
+	pool.decref(id2);
+}
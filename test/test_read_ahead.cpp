@@ -0,0 +1,161 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/read_ahead.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+
+using lt::aux::read_ahead;
+using lt::default_block_size;
+
+namespace {
+
+	lt::storage_index_t const st0(0);
+	lt::storage_index_t const st1(1);
+
+	int const piece_size = 16 * default_block_size;
+	std::int64_t const total_size = 100 * std::int64_t(piece_size);
+	int const max_window = 8 * default_block_size;
+}
+
+TORRENT_TEST(disabled)
+{
+	read_ahead ra;
+	auto const r = ra.on_read(st0, 0, default_block_size, piece_size, total_size, 0);
+	TEST_CHECK(!r.hit);
+	TEST_EQUAL(r.prefetch_length, 0);
+}
+
+TORRENT_TEST(new_stream_prefetches_rest_of_piece)
+{
+	read_ahead ra;
+	auto const r = ra.on_read(st0, 2 * default_block_size, default_block_size
+		, piece_size, total_size, 1024 * 1024);
+	TEST_CHECK(!r.hit);
+	TEST_EQUAL(r.prefetch_offset, 3 * default_block_size);
+	TEST_EQUAL(r.prefetch_length, piece_size - 3 * default_block_size);
+}
+
+TORRENT_TEST(new_stream_capped_by_window)
+{
+	read_ahead ra;
+	auto const r = ra.on_read(st0, 0, default_block_size, piece_size, total_size, max_window);
+	TEST_EQUAL(r.prefetch_offset, default_block_size);
+	TEST_EQUAL(r.prefetch_length, max_window);
+}
+
+TORRENT_TEST(last_block)
+{
+	read_ahead ra;
+	// the last block of the torrent has nothing following it
+	auto const r = ra.on_read(st0, total_size - default_block_size, default_block_size
+		, piece_size, total_size, max_window);
+	TEST_EQUAL(r.prefetch_length, 0);
+}
+
+TORRENT_TEST(sequential_hits)
+{
+	read_ahead ra;
+	ra.on_read(st0, 0, default_block_size, piece_size, total_size, max_window);
+
+	// reading sequentially through the prefetched range are hits, and the
+	// prefetched range is extended ahead of the stream, never overlapping
+	// what we've already hinted
+	std::int64_t prefetched = default_block_size + max_window;
+	for (int i = 1; i < 40; ++i)
+	{
+		std::int64_t const offset = i * std::int64_t(default_block_size);
+		auto const r = ra.on_read(st0, offset, default_block_size, piece_size, total_size, max_window);
+		TEST_CHECK(r.hit);
+		if (r.prefetch_length > 0)
+		{
+			TEST_EQUAL(r.prefetch_offset, prefetched);
+			prefetched += r.prefetch_length;
+		}
+		TEST_CHECK(prefetched <= offset + default_block_size + max_window);
+		TEST_CHECK(prefetched > offset + default_block_size);
+	}
+}
+
+TORRENT_TEST(out_of_order)
+{
+	read_ahead ra;
+	ra.on_read(st0, 0, default_block_size, piece_size, total_size, max_window);
+
+	// a block arriving slightly out of order still belongs to the stream
+	auto r = ra.on_read(st0, 2 * default_block_size, default_block_size
+		, piece_size, total_size, max_window);
+	TEST_CHECK(r.hit);
+	r = ra.on_read(st0, default_block_size, default_block_size
+		, piece_size, total_size, max_window);
+	TEST_CHECK(r.hit);
+}
+
+TORRENT_TEST(separate_storages)
+{
+	read_ahead ra;
+	ra.on_read(st0, 0, default_block_size, piece_size, total_size, max_window);
+
+	// the same offset in a different torrent is not part of the stream
+	auto const r = ra.on_read(st1, default_block_size, default_block_size
+		, piece_size, total_size, max_window);
+	TEST_CHECK(!r.hit);
+}
+
+TORRENT_TEST(remove_storage)
+{
+	read_ahead ra;
+	ra.on_read(st0, 0, default_block_size, piece_size, total_size, max_window);
+	ra.remove_storage(st0);
+	auto const r = ra.on_read(st0, default_block_size, default_block_size
+		, piece_size, total_size, max_window);
+	TEST_CHECK(!r.hit);
+}
+
+TORRENT_TEST(evict_oldest_stream)
+{
+	read_ahead ra;
+	// start more streams than we have slots for. The first stream should be
+	// evicted
+	for (int i = 0; i < 40; ++i)
+	{
+		ra.on_read(st0, i * std::int64_t(piece_size), default_block_size
+			, piece_size, total_size, max_window);
+	}
+	auto r = ra.on_read(st0, default_block_size, default_block_size
+		, piece_size, total_size, max_window);
+	TEST_CHECK(!r.hit);
+
+	r = ra.on_read(st0, 39 * std::int64_t(piece_size) + default_block_size
+		, default_block_size, piece_size, total_size, max_window);
+	TEST_CHECK(r.hit);
+}
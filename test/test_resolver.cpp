@@ -0,0 +1,384 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/resolver.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/address.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace lt;
+using lt::aux::resolver;
+using lt::aux::resolver_interface;
+
+namespace {
+
+// stands in for the system resolver. Host names starting with "bad" fail,
+// all others resolve to 10.0.0.<n>, where n is the number of lookups made so
+// far. Each lookup takes the specified number of milliseconds
+struct fake_dns
+{
+	explicit fake_dns(int delay_ms = 0) : delay(delay_ms) {}
+
+	std::vector<address> operator()(std::string const& hostname, error_code& ec) const
+	{
+		std::this_thread::sleep_for(lt::milliseconds(delay));
+		int const n = ++*lookups;
+		if (hostname.substr(0, 3) == "bad")
+		{
+			ec = boost::asio::error::host_not_found;
+			return {};
+		}
+		return {make_address_v4("10.0.0." + std::to_string(n))};
+	}
+
+	int delay;
+	std::shared_ptr<std::atomic<int>> lookups = std::make_shared<std::atomic<int>>(0);
+};
+
+// blocks all lookups until open() is called. Keeps track of how many lookups
+// are running at the same time
+struct gated_dns
+{
+	std::vector<address> operator()(std::string const&, error_code&)
+	{
+		std::unique_lock<std::mutex> l(mutex);
+		++running;
+		max_running = std::max(max_running, running);
+		cond.notify_all();
+		cond.wait(l, [this] { return is_open; });
+		--running;
+		++lookups;
+		return {make_address_v4("10.0.0.1")};
+	}
+
+	// waits for n lookups to be blocked. Returns false if they don't show up
+	bool wait_for_running(int const n)
+	{
+		std::unique_lock<std::mutex> l(mutex);
+		return cond.wait_for(l, seconds(10), [=] { return running >= n; });
+	}
+
+	void open()
+	{
+		std::lock_guard<std::mutex> l(mutex);
+		is_open = true;
+		cond.notify_all();
+	}
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool is_open = false;
+	int running = 0;
+	int max_running = 0;
+	int lookups = 0;
+};
+
+struct result
+{
+	error_code ec;
+	std::vector<address> ips;
+	bool done = false;
+};
+
+resolver_interface::callback_t store(result& r)
+{
+	return [&r](error_code const& ec, std::vector<address> const& ips)
+	{
+		r.ec = ec;
+		r.ips = ips;
+		r.done = true;
+	};
+}
+
+void run(io_context& ios, std::vector<result> const& results)
+{
+	for (int i = 0; i < 1000; ++i)
+	{
+		ios.restart();
+		ios.poll();
+		if (std::all_of(results.begin(), results.end()
+			, [](result const& r) { return r.done; }))
+			return;
+		std::this_thread::sleep_for(lt::milliseconds(5));
+	}
+}
+
+void run(io_context& ios, result const& r)
+{
+	for (int i = 0; i < 1000 && !r.done; ++i)
+	{
+		ios.restart();
+		ios.poll();
+		if (r.done) return;
+		std::this_thread::sleep_for(lt::milliseconds(5));
+	}
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(parallel_lookups)
+{
+	io_context ios;
+	gated_dns dns;
+	resolver res(ios, std::ref(dns));
+	res.set_max_threads(8);
+
+	std::vector<result> results(8);
+	for (int i = 0; i < 8; ++i)
+		res.async_resolve("host" + std::to_string(i), {}, store(results[std::size_t(i)]));
+
+	// all lookups are blocked in the lookup function at the same time
+	TEST_CHECK(dns.wait_for_running(8));
+	dns.open();
+	run(ios, results);
+
+	for (auto const& r : results)
+	{
+		TEST_CHECK(r.done);
+		TEST_CHECK(!r.ec);
+		TEST_EQUAL(r.ips.size(), 1);
+	}
+	TEST_EQUAL(dns.lookups, 8);
+	TEST_EQUAL(dns.max_running, 8);
+}
+
+TORRENT_TEST(max_threads)
+{
+	io_context ios;
+	gated_dns dns;
+	resolver res(ios, std::ref(dns));
+	res.set_max_threads(2);
+
+	std::vector<result> results(6);
+	for (int i = 0; i < 6; ++i)
+		res.async_resolve("host" + std::to_string(i), {}, store(results[std::size_t(i)]));
+
+	TEST_CHECK(dns.wait_for_running(2));
+	TEST_EQUAL(res.num_threads(), 2);
+	dns.open();
+	run(ios, results);
+
+	for (auto const& r : results)
+		TEST_CHECK(r.done);
+	TEST_EQUAL(dns.lookups, 6);
+	TEST_EQUAL(dns.max_running, 2);
+}
+
+TORRENT_TEST(idle_threads_exit)
+{
+	io_context ios;
+	fake_dns dns;
+	resolver res(ios, dns);
+	res.set_idle_timeout(seconds(0));
+
+	std::vector<result> results(4);
+	for (int i = 0; i < 4; ++i)
+		res.async_resolve("host" + std::to_string(i), {}, store(results[std::size_t(i)]));
+	run(ios, results);
+	TEST_EQUAL(*dns.lookups, 4);
+
+	for (int i = 0; i < 1000 && res.num_threads() > 0; ++i)
+		std::this_thread::sleep_for(lt::milliseconds(5));
+	TEST_EQUAL(res.num_threads(), 0);
+
+	// new threads are started for new lookups
+	result r;
+	res.async_resolve("example.com", {}, store(r));
+	run(ios, r);
+	TEST_CHECK(!r.ec);
+	TEST_EQUAL(*dns.lookups, 5);
+}
+
+TORRENT_TEST(destructor_joins_threads)
+{
+	io_context ios;
+	gated_dns dns;
+	result r;
+	std::thread opener;
+	{
+		resolver res(ios, std::ref(dns));
+		res.async_resolve("example.com", {}, store(r));
+		TEST_CHECK(dns.wait_for_running(1));
+		opener = std::thread([&dns] {
+			std::this_thread::sleep_for(lt::milliseconds(50));
+			dns.open();
+		});
+	}
+	// the destructor waited for the lookup to complete, and discarded its
+	// result
+	TEST_EQUAL(dns.lookups, 1);
+	ios.restart();
+	ios.poll();
+	TEST_CHECK(!r.done);
+	opener.join();
+}
+
+TORRENT_TEST(concurrent_lookups_of_same_host)
+{
+	io_context ios;
+	fake_dns dns(100);
+	resolver res(ios, dns);
+
+	std::vector<result> results(3);
+	for (auto& r : results)
+		res.async_resolve("example.com", {}, store(r));
+	run(ios, results);
+
+	TEST_EQUAL(*dns.lookups, 1);
+	for (auto const& r : results)
+	{
+		TEST_CHECK(!r.ec);
+		TEST_CHECK(r.ips == std::vector<address>{make_address_v4("10.0.0.1")});
+	}
+}
+
+TORRENT_TEST(negative_cache)
+{
+	io_context ios;
+	fake_dns dns;
+	resolver res(ios, dns);
+
+	result r1;
+	res.async_resolve("bad.example.com", {}, store(r1));
+	run(ios, r1);
+	TEST_EQUAL(r1.ec, error_code(boost::asio::error::host_not_found));
+	TEST_EQUAL(*dns.lookups, 1);
+
+	// the failure is cached
+	result r2;
+	res.async_resolve("bad.example.com", {}, store(r2));
+	run(ios, r2);
+	TEST_EQUAL(r2.ec, error_code(boost::asio::error::host_not_found));
+	TEST_EQUAL(*dns.lookups, 1);
+
+	// until it times out
+	res.set_negative_cache_timeout(seconds(0));
+	std::this_thread::sleep_for(lt::milliseconds(10));
+	result r3;
+	res.async_resolve("bad.example.com", {}, store(r3));
+	run(ios, r3);
+	TEST_EQUAL(*dns.lookups, 2);
+
+	auto const st = res.stats("bad.example.com");
+	TEST_CHECK(st);
+	TEST_EQUAL(st->lookups, 2);
+	TEST_EQUAL(st->failures, 2);
+	TEST_EQUAL(st->cache_hits, 1);
+}
+
+TORRENT_TEST(stale_while_revalidate)
+{
+	io_context ios;
+	fake_dns dns;
+	resolver res(ios, dns);
+	res.set_cache_timeout(seconds(1));
+
+	result r1;
+	res.async_resolve("example.com", {}, store(r1));
+	run(ios, r1);
+	TEST_CHECK(r1.ips == std::vector<address>{make_address_v4("10.0.0.1")});
+
+	std::this_thread::sleep_for(lt::milliseconds(1100));
+
+	// the expired entry is served straight away, and looked up again in the
+	// background
+	result r2;
+	res.async_resolve("example.com", {}, store(r2));
+	run(ios, r2);
+	TEST_CHECK(r2.ips == std::vector<address>{make_address_v4("10.0.0.1")});
+
+	for (int i = 0; i < 200 && *dns.lookups < 2; ++i)
+		std::this_thread::sleep_for(lt::milliseconds(5));
+	TEST_EQUAL(*dns.lookups, 2);
+
+	// until the result of the background lookup has been delivered, the
+	// stale entry keeps being served
+	int stale_hits = 1;
+	result r3;
+	for (int i = 0; i < 100; ++i)
+	{
+		r3 = result{};
+		res.async_resolve("example.com", {}, store(r3));
+		run(ios, r3);
+		if (r3.ips == std::vector<address>{make_address_v4("10.0.0.2")}) break;
+		++stale_hits;
+	}
+	TEST_CHECK(r3.ips == std::vector<address>{make_address_v4("10.0.0.2")});
+
+	auto const st = res.stats("example.com");
+	TEST_CHECK(st);
+	TEST_EQUAL(st->lookups, 2);
+	TEST_EQUAL(st->failures, 0);
+	TEST_EQUAL(st->stale_hits, stale_hits);
+	TEST_CHECK(st->cache_hits >= 2);
+}
+
+TORRENT_TEST(cache_only)
+{
+	io_context ios;
+	fake_dns dns;
+	resolver res(ios, dns);
+
+	result r1;
+	res.async_resolve("example.com", resolver_interface::cache_only, store(r1));
+	run(ios, r1);
+	TEST_EQUAL(r1.ec, error_code(boost::asio::error::host_not_found));
+	TEST_EQUAL(*dns.lookups, 0);
+}
+
+TORRENT_TEST(abort)
+{
+	io_context ios;
+	fake_dns dns(100);
+	resolver res(ios, dns);
+
+	result r1;
+	result r2;
+	res.async_resolve("example.com", resolver_interface::abort_on_shutdown, store(r1));
+	res.async_resolve("tracker.example.com", {}, store(r2));
+	res.abort();
+	run(ios, r1);
+	run(ios, r2);
+
+	TEST_EQUAL(r1.ec, error_code(boost::asio::error::operation_aborted));
+	TEST_CHECK(!r2.ec);
+	TEST_EQUAL(r2.ips.size(), 1);
+}
@@ -253,6 +253,134 @@ TORRENT_TEST(session_stats)
 		, lt::counters::utp_fast_retransmit);
 }
 
+TORRENT_TEST(listen_accept_queues)
+{
+	settings_pack p = settings();
+	p.set_str(settings_pack::listen_interfaces, "127.0.0.1:0");
+	p.set_int(settings_pack::listen_accept_queues, 4);
+	p.set_bool(settings_pack::listen_accept_queue_affinity, true);
+	p.set_int(settings_pack::listen_queue_size, 64);
+	lt::session ses(p);
+
+	wait_for_alert(ses, listen_succeeded_alert::alert_type, "ses");
+	int const port = ses.listen_port();
+	TEST_CHECK(port != 0);
+
+	auto cnt = get_counters(ses);
+#ifdef TORRENT_HAS_REUSE_PORT
+	int const expect_queues = 4;
+#else
+	int const expect_queues = 1;
+#endif
+	TEST_EQUAL(cnt["ses.num_outstanding_accept"], expect_queues);
+
+	// flood the listen endpoint with connections
+	int const num_connections = 200;
+	lt::io_context ios;
+	std::vector<tcp::socket> socks;
+	for (int i = 0; i < num_connections; ++i)
+	{
+		error_code ec;
+		socks.emplace_back(ios);
+		socks.back().connect(tcp::endpoint(make_address_v4("127.0.0.1")
+			, std::uint16_t(port)), ec);
+		TEST_CHECK(!ec);
+	}
+
+	time_point const end_time = clock_type::now() + seconds(10);
+	std::int64_t accepted = 0;
+	while (clock_type::now() < end_time)
+	{
+		cnt = get_counters(ses);
+		accepted = cnt["net.on_accept_counter"];
+		if (accepted >= num_connections) break;
+		std::this_thread::sleep_for(lt::milliseconds(100));
+	}
+	TEST_EQUAL(accepted, num_connections);
+	TEST_EQUAL(cnt["ses.num_outstanding_accept"], expect_queues);
+}
+
+namespace {
+
+outgoing_interface_stats_alert const* get_outgoing_interface_stats(lt::session& ses)
+{
+	ses.post_outgoing_interface_stats();
+	return alert_cast<outgoing_interface_stats_alert>(wait_for_alert(ses
+		, outgoing_interface_stats_alert::alert_type, "ses"));
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(outgoing_interface_stats)
+{
+	settings_pack p = settings();
+	p.set_str(settings_pack::listen_interfaces, "127.0.0.1:0");
+	p.set_str(settings_pack::outgoing_interfaces, "127.0.0.1,10.0.0.1");
+	// favour the loopback interface, 10.0.0.1 can't be bound to
+	p.set_str(settings_pack::outgoing_interface_weights, "3,2");
+	p.set_bool(settings_pack::enable_outgoing_utp, false);
+	p.set_bool(settings_pack::enable_dht, false);
+	lt::session ses(p);
+
+	add_torrent_params atp;
+	atp.ti = ::create_torrent();
+	atp.flags &= ~torrent_flags::paused;
+	atp.flags &= ~torrent_flags::auto_managed;
+	atp.save_path = ".";
+	torrent_handle h = ses.add_torrent(atp);
+	wait_for_downloading(ses, "ses");
+
+	lt::io_context ios;
+	tcp::acceptor l(ios);
+	l.open(tcp::v4());
+	l.bind(tcp::endpoint(make_address_v4("127.0.0.1"), 0));
+	l.listen();
+	l.non_blocking(true);
+	h.connect_peer(l.local_endpoint());
+
+	// the connection is bound to the loopback interface
+	tcp::socket s(ios);
+	time_point const end_time = clock_type::now() + seconds(10);
+	error_code ec = boost::asio::error::would_block;
+	while (ec && clock_type::now() < end_time)
+	{
+		l.accept(s, ec);
+		if (ec) std::this_thread::sleep_for(lt::milliseconds(50));
+	}
+	TEST_CHECK(!ec);
+
+	auto const* a = get_outgoing_interface_stats(ses);
+	TEST_CHECK(a != nullptr);
+	if (a == nullptr) return;
+	TEST_EQUAL(a->interfaces.size(), 2);
+	if (a->interfaces.size() != 2) return;
+	TEST_EQUAL(a->interfaces[0].device, "127.0.0.1");
+	TEST_EQUAL(a->interfaces[0].weight, 3);
+	TEST_EQUAL(a->interfaces[0].num_connections, 1);
+	TEST_EQUAL(a->interfaces[1].device, "10.0.0.1");
+	TEST_EQUAL(a->interfaces[1].weight, 2);
+	TEST_EQUAL(a->interfaces[1].num_connections, 0);
+
+	// when the interfaces are reordered, the connection follows its
+	// interface, also once the load is recounted from the connections
+	p.set_str(settings_pack::outgoing_interfaces, "10.0.0.1,127.0.0.1");
+	p.set_str(settings_pack::outgoing_interface_weights, "");
+	ses.apply_settings(p);
+	std::this_thread::sleep_for(lt::milliseconds(2500));
+
+	a = get_outgoing_interface_stats(ses);
+	TEST_CHECK(a != nullptr);
+	if (a == nullptr) return;
+	TEST_EQUAL(a->interfaces.size(), 2);
+	if (a->interfaces.size() != 2) return;
+	TEST_EQUAL(a->interfaces[0].device, "10.0.0.1");
+	TEST_EQUAL(a->interfaces[0].weight, 1);
+	TEST_EQUAL(a->interfaces[0].num_connections, 0);
+	TEST_EQUAL(a->interfaces[1].device, "127.0.0.1");
+	TEST_EQUAL(a->interfaces[1].weight, 1);
+	TEST_EQUAL(a->interfaces[1].num_connections, 1);
+}
+
 TORRENT_TEST(paused_session)
 {
 	lt::session s(settings());
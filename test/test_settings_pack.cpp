@@ -244,6 +244,7 @@ TORRENT_TEST(settings_pack_abi)
 	// strings
 	TEST_EQUAL(settings_pack::outgoing_interfaces, settings_pack::string_type_base + 4);
 	TEST_EQUAL(settings_pack::dht_bootstrap_nodes, settings_pack::string_type_base + 11);
+	TEST_EQUAL(settings_pack::outgoing_interface_weights, settings_pack::string_type_base + 12);
 
 	// bool
 	TEST_EQUAL(settings_pack::use_dht_as_fallback, settings_pack::bool_type_base + 4);
@@ -54,6 +54,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
 #include <functional>
+#include <thread>
 #include <tuple>
 #include <fstream>
 #include <iostream>
@@ -603,8 +604,136 @@ void test_malicious_peer()
 	}
 }
 
+void set_peer_certificate(torrent_handle h)
+{
+	h.set_ssl_certificate(
+		combine_path("..", combine_path("ssl", "peer_certificate.pem"))
+		, combine_path("..", combine_path("ssl", "peer_private_key.pem"))
+		, combine_path("..", combine_path("ssl", "dhparams.pem"))
+		, "test");
+}
+
+bool wait_for_seeding(lt::session& ses1, lt::session& ses2, torrent_handle const& h)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+		print_alerts(ses1, "ses1", true, true);
+		print_alerts(ses2, "ses2", true, true);
+		if (h.status().is_seeding) return true;
+		std::this_thread::sleep_for(lt::milliseconds(100));
+	}
+	return false;
+}
+
+// download the same SSL torrent twice, from the same seed. The seed makes
+// the outgoing connection both times, and the second handshake is expected
+// to resume the session established by the first one
+void test_ssl_session_resumption()
+{
+	session_proxy p1;
+	session_proxy p2;
+
+	error_code ec;
+	remove_all("tmp1_ssl", ec);
+	remove_all("tmp2_ssl", ec);
+
+	int port = 1024 + rand() % 50000;
+	settings_pack sett = settings();
+	sett.set_int(settings_pack::max_retry_port_bind, 100);
+
+	char listen_iface[100];
+	std::snprintf(listen_iface, sizeof(listen_iface), "0.0.0.0:%ds", port);
+	sett.set_str(settings_pack::listen_interfaces, listen_iface);
+	sett.set_bool(settings_pack::enable_incoming_utp, false);
+	sett.set_bool(settings_pack::enable_outgoing_utp, false);
+	sett.set_bool(settings_pack::enable_dht, false);
+	sett.set_bool(settings_pack::enable_lsd, false);
+	sett.set_bool(settings_pack::enable_upnp, false);
+	sett.set_bool(settings_pack::enable_natpmp, false);
+
+	lt::session ses1(session_params{sett, {}});
+
+	port += 20;
+	std::snprintf(listen_iface, sizeof(listen_iface), "0.0.0.0:%d,0.0.0.0:%ds", port + 20, port);
+	sett.set_str(settings_pack::listen_interfaces, listen_iface);
+	lt::session ses2(session_params{sett, {}});
+
+	wait_for_listen(ses1, "ses1");
+	wait_for_listen(ses2, "ses2");
+
+	create_directory("tmp1_ssl", ec);
+	std::ofstream file("tmp1_ssl/temporary");
+	std::shared_ptr<torrent_info> t = ::create_torrent(&file, "temporary"
+		, 16 * 1024, 13, false, {}, combine_path("..", combine_path("ssl", "root_ca_cert.pem")));
+	file.close();
+
+	add_torrent_params addp;
+	addp.save_path = "tmp1_ssl";
+	addp.flags &= ~torrent_flags::paused;
+	addp.flags &= ~torrent_flags::auto_managed;
+
+	torrent_handle tor1;
+	torrent_handle tor2;
+	std::tie(tor1, tor2, ignore) = setup_transfer(&ses1, &ses2, nullptr
+		, true, false, false, "_ssl", 16 * 1024, &t, false, &addp, true);
+
+	set_peer_certificate(tor1);
+	set_peer_certificate(tor2);
+	ses1.listen_port();
+	ses2.listen_port();
+
+	wait_for_alert(ses1, torrent_finished_alert::alert_type, "ses1");
+	wait_for_downloading(ses2, "ses2");
+
+	tcp::endpoint const ep(make_address("127.0.0.1", ec), std::uint16_t(port));
+	tor1.connect_peer(ep);
+	TEST_CHECK(wait_for_seeding(ses1, ses2, tor2));
+
+	// start over on the downloading side
+	std::string const save_path = tor2.status().save_path;
+	ses2.remove_torrent(tor2, lt::session::delete_files);
+	wait_for_alert(ses2, torrent_deleted_alert::alert_type, "ses2");
+
+	add_torrent_params addp2;
+	addp2.ti = t;
+	addp2.save_path = save_path;
+	addp2.flags &= ~torrent_flags::paused;
+	addp2.flags &= ~torrent_flags::auto_managed;
+	tor2 = ses2.add_torrent(addp2);
+	set_peer_certificate(tor2);
+	ses2.listen_port();
+	wait_for_downloading(ses2, "ses2");
+
+	// the seed remembers the downloader as a seed, and wouldn't connect to
+	// it again
+	tor1.clear_peers();
+	tor1.connect_peer(ep);
+	TEST_CHECK(wait_for_seeding(ses1, ses2, tor2));
+
+	auto const cnt1 = get_counters(ses1);
+	auto const cnt2 = get_counters(ses2);
+	std::printf("ses1 full: %d resumed: %d\nses2 full: %d resumed: %d\n"
+		, int(cnt1.at("peer.ssl_full_handshakes"))
+		, int(cnt1.at("peer.ssl_resumed_handshakes"))
+		, int(cnt2.at("peer.ssl_full_handshakes"))
+		, int(cnt2.at("peer.ssl_resumed_handshakes")));
+
+	TEST_EQUAL(cnt1.at("peer.ssl_full_handshakes"), 1);
+	TEST_EQUAL(cnt1.at("peer.ssl_resumed_handshakes"), 1);
+	TEST_EQUAL(cnt2.at("peer.ssl_full_handshakes"), 1);
+	TEST_EQUAL(cnt2.at("peer.ssl_resumed_handshakes"), 1);
+
+	p1 = ses1.abort();
+	p2 = ses2.abort();
+}
+
 } // anonymous namespace
 
+TORRENT_TEST(ssl_session_resumption)
+{
+	test_ssl_session_resumption();
+}
+
 TORRENT_TEST(malicious_peer)
 {
 	test_malicious_peer();
@@ -54,6 +54,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/mmap_disk_job.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/aux_/storage_utils.hpp"
+#include "libtorrent/aux_/storage_mover.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/mmap_disk_io.hpp"
@@ -1458,8 +1459,238 @@ TORRENT_TEST(dont_move_intermingled_files)
 	TEST_CHECK(!exists(combine_path(test_path, combine_path("temp_storage"
 		, combine_path("_folder3", "alien_folder1")))));
 }
+
+TORRENT_TEST(mmap_direct_io)
+{
+	std::string const save_path = complete("save_path_direct_io");
+	delete_dirs(save_path);
+
+	// the second file starts at an unaligned offset in the torrent, which
+	// makes the aligned part of its blocks unaligned in the buffers
+	file_storage fs;
+	fs.add_file(combine_path("temp_storage", "test1.tmp"), 5000);
+	fs.add_file(combine_path("temp_storage", "test2.tmp"), 0x10000 + 123);
+	fs.set_piece_length(0x4000);
+	fs.set_num_pieces(aux::calc_num_pieces(fs));
+
+	aux::vector<download_priority_t, file_index_t> priorities;
+	sha1_hash info_hash;
+	storage_params p{
+		fs,
+		nullptr,
+		save_path,
+		storage_mode_sparse,
+		priorities,
+		info_hash
+	};
+	aux::file_view_pool fp;
+	auto s = std::make_shared<mmap_storage>(p, fp);
+
+	aux::session_settings set;
+	set.set_int(settings_pack::disk_io_write_mode, settings_pack::direct_io);
+	set.set_int(settings_pack::disk_io_read_mode, settings_pack::direct_io);
+
+	storage_error se;
+	s->initialize(set, se);
+	TEST_CHECK(!se);
+
+	std::vector<char> data = new_piece(std::size_t(fs.total_size()));
+	for (piece_index_t i(0); i < fs.end_piece(); ++i)
+	{
+		int const size = fs.piece_size(i);
+		span<char> b = span<char>(data).subspan(static_cast<int>(i) * 0x4000, size);
+
+		// write the piece as two unaligned halves
+		int const split = size / 2 + 7;
+		TEST_EQUAL(write(s, set, b.first(split), i, 0, aux::open_mode::write, se), split);
+		TEST_EQUAL(write(s, set, b.subspan(split), i, split, aux::open_mode::write, se)
+			, size - split);
+		TEST_CHECK(!se);
+		if (se) print_error("write", 0, se);
+	}
+
+	std::vector<char> piece(0x4000);
+	for (piece_index_t i(0); i < fs.end_piece(); ++i)
+	{
+		int const size = fs.piece_size(i);
+		span<char> b = span<char>(piece).first(size);
+		TEST_EQUAL(read(s, set, b, i, 0, aux::open_mode::read_only, se), size);
+		TEST_CHECK(!se);
+		TEST_CHECK(b == span<char>(data).subspan(static_cast<int>(i) * 0x4000, size));
+	}
+
+	storage_error ec;
+	release_files(s, ec);
+
+	// the files must have the same content when read back through the page
+	// cache
+	std::vector<char> file_buf;
+	error_code e;
+	TEST_EQUAL(load_file(combine_path(save_path, combine_path("temp_storage", "test1.tmp"))
+		, file_buf, e), 0);
+	TEST_CHECK(file_buf == std::vector<char>(data.begin(), data.begin() + 5000));
+	TEST_EQUAL(load_file(combine_path(save_path, combine_path("temp_storage", "test2.tmp"))
+		, file_buf, e), 0);
+	TEST_CHECK(file_buf == std::vector<char>(data.begin() + 5000, data.end()));
+}
 #endif
 
+TORRENT_TEST(move_storage_precopy)
+{
+	std::string const save_path = complete("save_path_precopy_1");
+	std::string const test_path = complete("save_path_precopy_2");
+	delete_dirs(save_path);
+	delete_dirs(test_path);
+
+	file_storage fs;
+	fs.add_file(combine_path("temp_storage", "test1.tmp"), 0x500000);
+	fs.add_file(combine_path("temp_storage", "test2.tmp"), 0x8000);
+	fs.set_piece_length(0x4000);
+	fs.set_num_pieces(aux::calc_num_pieces(fs));
+
+	// the first file is larger than one copy chunk, and has a range of zeros
+	std::vector<char> data1 = new_piece(0x500000);
+	std::fill(data1.begin() + 0x100000, data1.begin() + 0x200000, '\0');
+	std::vector<char> data2 = new_piece(0x8000);
+
+	error_code ec;
+	create_directories(combine_path(save_path, "temp_storage"), ec);
+	TEST_CHECK(!ec);
+	ofstream(fs.file_path(0_file, save_path).c_str())
+		.write(data1.data(), std::streamsize(data1.size()));
+	ofstream(fs.file_path(1_file, save_path).c_str())
+		.write(data2.data(), std::streamsize(data2.size()));
+
+	io_context ios;
+	aux::storage_mover mover(ios);
+	auto state = std::make_shared<aux::precopy_state>(test_path, fs.num_files());
+	std::string const copy = aux::precopy_path(fs.file_path(0_file, test_path));
+
+	bool done = false;
+	mover.async_copy(storage_index_t(0)
+		, {{0_file, fs.file_path(0_file, save_path), copy, 0x500000}}
+		, state, [&](error_code const& e, file_index_t)
+		{
+			TEST_CHECK(!e);
+			done = true;
+		});
+	ios.run();
+	TEST_CHECK(done);
+	TEST_CHECK(state->complete);
+	TEST_CHECK(state->is_copied(0_file));
+	TEST_CHECK(!state->is_copied(1_file));
+	TEST_CHECK(mover.progress(storage_index_t(0)) == std::make_pair(std::int64_t(0), std::int64_t(0)));
+
+	// the copy is complete, and the source is untouched. The copy doesn't
+	// have its final name yet
+	std::vector<char> file_buf;
+	TEST_EQUAL(load_file(copy, file_buf, ec), 0);
+	TEST_CHECK(file_buf == data1);
+	TEST_CHECK(!exists(fs.file_path(0_file, test_path)));
+	TEST_CHECK(exists(fs.file_path(0_file, save_path)));
+
+	// the pre-copied file is renamed into place and its source is removed.
+	// The other file is moved
+	storage_error se;
+	auto const ret = aux::move_storage(fs, save_path, test_path, {}
+		, [&](file_index_t const i)
+		{ return state->is_copied(i) ? copy : std::string(); }
+		, move_flags_t::always_replace_files, se);
+	TEST_CHECK(!se);
+	TEST_CHECK(ret.first == status_t::no_error);
+	TEST_EQUAL(ret.second, test_path);
+	TEST_CHECK(!exists(fs.file_path(0_file, save_path)));
+	TEST_CHECK(!exists(fs.file_path(1_file, save_path)));
+	TEST_EQUAL(load_file(fs.file_path(0_file, test_path), file_buf, ec), 0);
+	TEST_CHECK(file_buf == data1);
+	TEST_EQUAL(load_file(fs.file_path(1_file, test_path), file_buf, ec), 0);
+	TEST_CHECK(file_buf == data2);
+	TEST_CHECK(!exists(copy));
+
+	// the files that were renamed into place are kept
+	mover.abort();
+	state.reset();
+	TEST_CHECK(exists(fs.file_path(0_file, test_path)));
+}
+
+TORRENT_TEST(move_storage_precopy_abandoned)
+{
+	std::string const save_path = complete("save_path_precopy_4");
+	std::string const test_path = complete("save_path_precopy_5");
+	delete_dirs(save_path);
+	delete_dirs(test_path);
+
+	error_code ec;
+	create_directories(save_path, ec);
+	TEST_CHECK(!ec);
+	std::vector<char> const data = new_piece(0x8000);
+	std::string const source = combine_path(save_path, "test1.tmp");
+	ofstream(source.c_str()).write(data.data(), std::streamsize(data.size()));
+
+	// a file the move would replace
+	create_directories(test_path, ec);
+	TEST_CHECK(!ec);
+	std::vector<char> const existing = new_piece(0x100);
+	std::string const existing_source = combine_path(save_path, "test2.tmp");
+	std::string const existing_dest = combine_path(test_path, "test2.tmp");
+	ofstream(existing_source.c_str()).write(data.data(), std::streamsize(data.size()));
+	ofstream(existing_dest.c_str()).write(existing.data(), std::streamsize(existing.size()));
+
+	io_context ios;
+	aux::storage_mover mover(ios);
+	auto state = std::make_shared<aux::precopy_state>(test_path, 2);
+
+	std::string const dest = aux::precopy_path(
+		combine_path(combine_path(test_path, "sub"), "test1.tmp"));
+	mover.async_copy(storage_index_t(0), {{0_file, source, dest, 0x8000}
+		, {1_file, existing_source, aux::precopy_path(existing_dest), 0x8000}}
+		, state, [](error_code const& e, file_index_t) { TEST_CHECK(!e); });
+	ios.run();
+	TEST_CHECK(state->is_copied(0_file));
+	TEST_CHECK(state->is_copied(1_file));
+	TEST_CHECK(exists(dest));
+
+	// the move is abandoned (e.g. re-targeted or the torrent removed) before
+	// the copies were used. They are deleted, along with the directory
+	// created for them, but not the source nor the existing file
+	mover.abort();
+	state.reset();
+	TEST_CHECK(!exists(dest));
+	TEST_CHECK(!exists(aux::precopy_path(existing_dest)));
+	TEST_CHECK(!exists(combine_path(test_path, "sub")));
+	TEST_CHECK(exists(test_path));
+	TEST_CHECK(exists(source));
+	std::vector<char> file_buf;
+	TEST_EQUAL(load_file(existing_dest, file_buf, ec), 0);
+	TEST_CHECK(file_buf == existing);
+}
+
+TORRENT_TEST(move_storage_precopy_error)
+{
+	std::string const save_path = complete("save_path_precopy_3");
+	delete_dirs(save_path);
+
+	io_context ios;
+	aux::storage_mover mover(ios);
+	auto state = std::make_shared<aux::precopy_state>(save_path, 2);
+
+	// the source file doesn't exist
+	bool done = false;
+	mover.async_copy(storage_index_t(0)
+		, {{1_file, combine_path(save_path, "missing.tmp"), combine_path(save_path, "copy.tmp"), 100}}
+		, state, [&](error_code const& e, file_index_t const f)
+		{
+			TEST_CHECK(e);
+			TEST_EQUAL(f, 1_file);
+			done = true;
+		});
+	ios.run();
+	TEST_CHECK(done);
+	TEST_CHECK(!state->complete);
+	TEST_CHECK(!state->is_copied(1_file));
+	TEST_CHECK(!exists(combine_path(save_path, "copy.tmp")));
+}
+
 namespace {
 
 void sync(lt::io_context& ioc, int& outstanding)
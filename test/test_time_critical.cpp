@@ -36,6 +36,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "test_utils.hpp"
 #include "libtorrent/download_priority.hpp"
 #include "libtorrent/torrent_info.hpp"
+#include "libtorrent/torrent.hpp"
+#include "libtorrent/time.hpp"
 
 TORRENT_TEST(time_crititcal)
 {
@@ -59,3 +61,44 @@ TORRENT_TEST(time_crititcal_zero_prio)
 	h.set_piece_deadline(0_piece, 0, lt::torrent_handle::alert_when_available);
 }
 
+#ifndef TORRENT_DISABLE_STREAMING
+TORRENT_TEST(time_critical_at_risk)
+{
+	using lt::time_critical_timeouts;
+	using lt::seconds;
+	using lt::milliseconds;
+
+	lt::time_point const now = lt::clock_type::now();
+
+	// requested 100 ms ago, pieces typically take a second and the deadline
+	// is far away. No duplicate requests
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(100)
+		, now + seconds(10), 1000, 0), 0);
+
+	// the requests are expected in 900 ms, but the deadline is in 500 ms.
+	// The piece is at risk, and each block may be requested once more
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(100)
+		, now + milliseconds(500), 1000, 0), 1);
+
+	// a deadline of 0 (i.e. as soon as possible) or one that has passed
+	// already doesn't make the piece at risk
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(100)
+		, now, 1000, 0), 0);
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(100)
+		, now - seconds(1), 1000, 0), 0);
+
+	// without a piece time average, the outstanding requests are expected to
+	// take as long again as they've been waiting
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(300)
+		, now + milliseconds(500), 0, 0), 0);
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(600)
+		, now + milliseconds(500), 0, 0), 1);
+
+	// a stalled piece allows more requests the longer it's stalled,
+	// regardless of its deadline
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(1100)
+		, now - seconds(1), 1000, 0), 1);
+	TEST_EQUAL(time_critical_timeouts(now, now - milliseconds(2100)
+		, now + seconds(10), 1000, 0), 2);
+}
+#endif
@@ -0,0 +1,118 @@
+/*
+
+Copyright (c) 2022, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/ut_pex_msg.hpp"
+#include "libtorrent/bencode.hpp"
+#include "libtorrent/entry.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/socket_io.hpp"
+#include "libtorrent/pex_flags.hpp"
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef TORRENT_DISABLE_EXTENSIONS
+
+using namespace lt;
+
+namespace {
+
+tcp::endpoint ep(char const* ip, int const port)
+{
+	return tcp::endpoint(make_address(ip), std::uint16_t(port));
+}
+
+std::string compact(std::vector<tcp::endpoint> const& eps)
+{
+	std::string ret;
+	auto it = std::back_inserter(ret);
+	for (auto const& e : eps) aux::write_endpoint(e, it);
+	return ret;
+}
+
+// the message as the bencoder would write it
+std::vector<char> reference_msg(std::string const& added, std::string const& added_f
+	, std::string const& added6, std::string const& added6_f
+	, std::string const& dropped, std::string const& dropped6)
+{
+	entry e;
+	e["added"] = added;
+	e["added.f"] = added_f;
+	e["added6"] = added6;
+	e["added6.f"] = added6_f;
+	e["dropped"] = dropped;
+	e["dropped6"] = dropped6;
+	std::vector<char> ret;
+	bencode(std::back_inserter(ret), e);
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(write_pex_msg_empty)
+{
+	std::vector<char> out;
+	aux::write_pex_msg(out, {}, {});
+	TEST_CHECK(out == reference_msg("", "", "", "", "", ""));
+}
+
+TORRENT_TEST(write_pex_msg_added_dropped)
+{
+	std::vector<std::pair<tcp::endpoint, pex_flags_t>> const added = {
+		{ep("10.0.0.1", 6881), pex_seed},
+		{ep("2001:db8::1", 1337), pex_encryption | pex_utp},
+		{ep("10.0.0.2", 51413), pex_flags_t{}},
+	};
+	std::vector<tcp::endpoint> const dropped = {
+		ep("2001:db8::2", 80),
+		ep("192.168.1.1", 1024),
+	};
+
+	std::vector<char> out;
+	aux::write_pex_msg(out, added, dropped);
+
+	std::string const added_f{char(static_cast<std::uint8_t>(pex_seed)), char(0)};
+	std::string const added6_f{char(static_cast<std::uint8_t>(pex_encryption | pex_utp))};
+	TEST_CHECK(out == reference_msg(
+		compact({ep("10.0.0.1", 6881), ep("10.0.0.2", 51413)}), added_f
+		, compact({ep("2001:db8::1", 1337)}), added6_f
+		, compact({ep("192.168.1.1", 1024)})
+		, compact({ep("2001:db8::2", 80)})));
+
+	// the buffer is reused
+	aux::write_pex_msg(out, {}, {});
+	TEST_CHECK(out == reference_msg("", "", "", "", "", ""));
+}
+
+#endif // TORRENT_DISABLE_EXTENSIONS
@@ -34,6 +34,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "test.hpp"
 #include "setup_transfer.hpp"
 #include "web_seed_suite.hpp"
+#include "make_torrent.hpp"
+#include "test_utils.hpp"
+#include "settings.hpp"
+#include "libtorrent/session.hpp"
+#include "libtorrent/session_params.hpp"
+#include "libtorrent/torrent_status.hpp"
+
+#include <thread>
+#include <algorithm>
 
 using namespace lt;
 
@@ -50,3 +59,99 @@ TORRENT_TEST(web_seed)
 {
 	run_http_suite(proxy, "http", false);
 }
+
+namespace {
+
+struct web_seed_download
+{
+	lt::time_duration elapsed;
+	int max_peers;
+	std::int64_t requests;
+	std::int64_t keepalive_requests;
+};
+
+// downloads a 2 MiB torrent from a web server that sends at most
+// ``rate_limit`` bytes per second on each connection, opening
+// ``connections`` connections to the URL seed
+web_seed_download download_web_seed(int const connections, int const rate_limit)
+{
+	int const port = start_web_server(false, false, true, 30, rate_limit);
+
+	char url[512];
+	std::snprintf(url, sizeof(url), "http://127.0.0.1:%d/web_seed_parallel", port);
+
+	error_code ec;
+	create_directories(combine_path("web_seed_parallel", "torrent_dir"), ec);
+
+	std::shared_ptr<torrent_info> ti = make_test_torrent(torrent_args()
+		.file("524288").file("524288").file("524288").file("524288")
+		.name("torrent_dir")
+		.url_seed(url));
+	generate_files(*ti, "web_seed_parallel");
+
+	settings_pack pack = settings();
+	pack.set_str(settings_pack::listen_interfaces, test_listen_interface());
+	pack.set_bool(settings_pack::enable_lsd, false);
+	pack.set_bool(settings_pack::enable_natpmp, false);
+	pack.set_bool(settings_pack::enable_upnp, false);
+	pack.set_bool(settings_pack::enable_dht, false);
+	pack.set_int(settings_pack::urlseed_connections, connections);
+	lt::session ses(session_params{pack, {}});
+
+	remove_all("tmp2_web_seed_parallel", ec);
+	add_torrent_params p;
+	p.flags &= ~torrent_flags::paused;
+	p.flags &= ~torrent_flags::auto_managed;
+	p.ti = ti;
+	p.save_path = "tmp2_web_seed_parallel";
+	lt::time_point const start = lt::clock_type::now();
+	torrent_handle th = ses.add_torrent(p);
+
+	web_seed_download ret{};
+	for (int i = 0; i < 300; ++i)
+	{
+		torrent_status const st = th.status();
+		ret.max_peers = std::max(ret.max_peers, st.num_peers);
+		print_alerts(ses, "  >>  ses");
+		if (st.is_seeding) break;
+		std::this_thread::sleep_for(lt::milliseconds(100));
+	}
+	ret.elapsed = lt::clock_type::now() - start;
+
+	TEST_CHECK(th.status().is_seeding);
+	// the parallel connections share the URL of the web seed
+	TEST_EQUAL(th.url_seeds().size(), 1);
+
+	std::map<std::string, std::int64_t> cnt = get_counters(ses);
+	ret.requests = cnt["peer.web_seed_requests"];
+	ret.keepalive_requests = cnt["peer.web_seed_keepalive_requests"];
+
+	std::printf("connections: %d time: %d ms requests: %d keep-alive: %d max-connections: %d\n"
+		, connections, int(total_milliseconds(ret.elapsed)), int(ret.requests)
+		, int(ret.keepalive_requests), ret.max_peers);
+
+	stop_web_server();
+	return ret;
+}
+
+}
+
+TORRENT_TEST(web_seed_parallel_connections)
+{
+	// limit each connection to 256 kiB/s. A single connection needs about 8
+	// seconds to download the torrent, several connections should divide that
+	int const rate_limit = 256 * 1024;
+	int const total_size = 4 * 524288;
+
+	web_seed_download const single = download_web_seed(1, rate_limit);
+	web_seed_download const parallel = download_web_seed(4, rate_limit);
+
+	std::printf("1 connection: %d kB/s, 4 connections: %d kB/s\n"
+		, int(std::int64_t(total_size) / std::max(std::int64_t(1), total_milliseconds(single.elapsed)))
+		, int(std::int64_t(total_size) / std::max(std::int64_t(1), total_milliseconds(parallel.elapsed))));
+
+	TEST_EQUAL(single.max_peers, 1);
+	TEST_CHECK(parallel.max_peers > 1);
+	TEST_CHECK(parallel.requests >= 4);
+	TEST_CHECK(parallel.keepalive_requests > 0);
+}
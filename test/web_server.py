@@ -6,12 +6,16 @@ import ssl
 import gzip
 import base64
 import socket
+import socketserver
+import time
 import traceback
 
 from http.server import HTTPServer, BaseHTTPRequestHandler
 
 chunked_encoding = False
 keepalive = True
+# when > 0, the number of bytes per second to send on each connection
+rate_limit = 0
 
 try:
     fin = open('test_file', 'rb')
@@ -32,6 +36,12 @@ class http_server_with_timeout(HTTPServer):
         raise Exception('timeout')
 
 
+# serves each connection on its own thread, so that several (rate limited)
+# connections can be served in parallel
+class threading_http_server(socketserver.ThreadingMixIn, http_server_with_timeout):
+    daemon_threads = True
+
+
 class http_handler(BaseHTTPRequestHandler):
 
     def do_GET(self):
@@ -189,6 +199,8 @@ class http_handler(BaseHTTPRequestHandler):
                     if chunked_encoding:
                         self.wfile.write(b'\r\n')
                     length -= to_send
+                    if rate_limit > 0:
+                        time.sleep(to_send / rate_limit)
                     print('sent %d bytes (%d bytes left)' % (len(data), length))
                     sys.stdout.flush()
                 if chunked_encoding:
@@ -215,10 +227,15 @@ if __name__ == '__main__':
     use_ssl = sys.argv[3] != '0'
     keepalive = sys.argv[4] != '0'
     min_interval = sys.argv[5]
+    if len(sys.argv) > 6:
+        rate_limit = int(sys.argv[6])
     print('python version: %s' % sys.version_info.__str__())
 
     http_handler.protocol_version = 'HTTP/1.1'
-    httpd = http_server_with_timeout(('127.0.0.1', port), http_handler)
+    if rate_limit > 0:
+        httpd = threading_http_server(('127.0.0.1', port), http_handler)
+    else:
+        httpd = http_server_with_timeout(('127.0.0.1', port), http_handler)
     if use_ssl:
         httpd.socket = ssl.wrap_socket(httpd.socket, certfile='../ssl/server.pem', server_side=True)
 